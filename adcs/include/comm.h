@@ -12,12 +12,48 @@
 #include "global_definitions.h"
 #include "sensors.h"
 #include <CRC16.h>
+#include <Fixed.h>
+#include <HeartbeatSchema.h>
+#include <PacketCRC.h>
+#include <PacketPool.h>
+#include <SampleBatch.h>
+#include <SPSCRingBuffer.h>
 #include <Wire.h>
 #include <stdint.h>
 
 // packet sizes in bytes
 #define COMMAND_LEN 4
-#define PACKET_LEN 30
+#define PACKET_LEN HEARTBEAT_LEN
+
+// number of bytes the UART receive interrupt can buffer before the command
+// task drains them, must be a power of two
+#define UART_RX_BUF_LEN 64
+
+// a partially received command is discarded if the next byte does not arrive
+// within this many milliseconds
+#define COMMAND_TIMEOUT_MS 10
+
+// number of packets that can wait for the UART transmitter, a send() that finds
+// all of them in use drops its packet
+#define TX_POOL_LEN 4
+
+// sendFrameBlocking waits up to TX_WAIT_TRIES times TX_WAIT_MS milliseconds for
+// a free packet
+#define TX_WAIT_MS 5
+#define TX_WAIT_TRIES 10
+
+// largest frame the UART transmitter takes, heartbeat or IMU batch
+#define TX_FRAME_LEN 128
+
+// an I2C transfer not finished within this many milliseconds is taken off the
+// bus and fails, a 255 byte read takes 6 ms at 400 kHz
+#define I2C_TIMEOUT_MS 20
+
+// nominal period of the IMU samples, IMU_SMPLRT_DIV in sensors.h sets the real
+// one, and the number of samples after which an IMU batch frame is sent even
+// if more would fit
+#define IMU_BATCH_PERIOD_MS 5
+#define IMU_BATCH_SAMPLES 16
 
 /**
  * @brief      Commands that the ADCS should expect to receive from the satellite
@@ -36,6 +72,12 @@ enum Command : uint8_t
 	CMD_TST_BLDC = 0xa7,	// test functionality of BLDC
 	CMD_TST_MTX = 0xa8,	// test functionality of magnetorquers
 
+	CMD_DBG_TIMING = 0xd0, // send timing reports of the periodic loops, mode unchanged
+	CMD_DBG_TRACE = 0xd1,  // dump the latency trace on SERCOM_USB, ADCS_TRACE builds only
+	CMD_DBG_TASKS = 0xd2,  // send CPU share, stack and heap use of every task, mode unchanged
+
+	CMD_IMU_RAW = 0x90, // read the raw IMU samples, mode unchanged
+	CMD_IMU_DMP = 0x91, // read the quaternions of the IMU DMP, IMU_DMP builds only, mode unchanged
 
 
 	CMD_ORIENT_DEFAULT = 0x80, // should be orienting to something like X+
@@ -50,26 +92,19 @@ enum Command : uint8_t
  */
 enum Status : uint8_t
 {
-	STATUS_OK = 0xaa,		  // "Heartbeat"
-	STATUS_HELLO = 0xaf,	  // Sent upon system init
-	STATUS_ADCS_ERROR = 0xf0, // Sent upon runtime error
-	STATUS_COMM_ERROR = 0x99, // Sent upon invalid communication
-	STATUS_FUDGED = 0x00,	  // Data is not real, just test output
-	STATUS_TEST_START = 0xb0, // starting test
-	STATUS_TEST_END = 0xb1,	  // test finished
-	STATUS_MOTOR_TEST = 0xb2, // middle of the motor test
-	STATUS_MTX_TEST = 0xb3,   // middle of the Mtx test 
+#define STATUS_ENUM(id, code) STATUS_##id = code,
+	HEARTBEAT_STATUS(STATUS_ENUM)
+#undef STATUS_ENUM
 };
 
 /**
  * @brief
  * Defines a fixed-point data type that is one byte wide. Five bits are reserved
- * for the integer part and 3 bits are reserved for the fraction part. While in
- * fixed-point form, the data cannot be read - it must be converted back to
- * floating-point first. Functions that convert float to fixed and back are
- * declared below.
+ * for the integer part, including the sign, and 3 bits are reserved for the
+ * fraction part, covering -16 .. 15.875. Conversions from float round to the
+ * nearest step and saturate at the ends of the range, see Fixed.h.
  */
-typedef int8_t fixed5_3_t;
+typedef Fixed<5, 3, int8_t> fixed5_3_t;
 
 /**
  * @brief
@@ -117,43 +152,14 @@ public:
 class ADCSdata
 {
 private:
-	union
-	{
-		// Data can be accessed as a single array - used to send via UART
-		uint8_t _data[PACKET_LEN];
+	// Fields bit packed as laid out in HeartbeatSchema.h, followed by the CRC
+	// of the bytes before it - sent via UART as is
+	uint8_t _data[PACKET_LEN];
 
-		struct
-		{
-			// Data can be accessed as fields - used to build packet
-			uint16_t _status; //2
-			fixed5_3_t _voltage; //1
-			int16_t _current; //2
-			uint8_t _freq; //1
-
-			uint8_t _motor_en; //1 
-			uint8_t _buck_en; //1
-			uint8_t _mtx1; //1  0xb:break, 0xa:standby, 0x1:forward, 0x2:reverse, 0x0 error 
-			uint8_t _mtx2; //1  0xb:break, 0xa:standby, 0x1:forward, 0x2:reverse, 0x0 error 
-
-			int8_t _magX; //1
-			int8_t _magY; //1
-			int8_t _magZ; //1
-			fixed5_3_t _gyroX; //1
-			fixed5_3_t _gyroY; //1
-			fixed5_3_t _gyroZ; //1
-
-			uint16_t _pd_xpos; //2
-			uint16_t _pd_xneg; //2
-			uint16_t _pd_ypos; //2
-			uint16_t _pd_yneg; //2
-			uint16_t _pd_zpos; //2
-			uint16_t _pd_zneg; //2 
-			
-			uint16_t _crc; //2 
-			//Total = 30 bytes
-		};
-	};
-	
+	// CRC of the packed fields, patched as fields are set
+	PacketCRC<HEARTBEAT_PAYLOAD_LEN> _crc_state;
+
+	void setField(HeartbeatField field, int32_t value);
 	void computeCRC();
 
 public:
@@ -167,7 +173,25 @@ public:
 	void setActStatus(); 
 	uint8_t *getBytes();
 	void clear();
-	void send();
+	bool send(TaskHandle_t notify = NULL);
+	void sendPolled();
+};
+
+/**
+ * @brief
+ * Collects consecutive gyro/magnetometer samples into a delta encoded batch
+ * frame, see SampleBatch.h. Sent next to the heartbeat so the satellite gets
+ * every IMU sample instead of one every 500 ms.
+ */
+class IMUbatch
+{
+private:
+	SampleBatchEncoder<TX_FRAME_LEN> _encoder;
+
+public:
+	IMUbatch();
+	void add(IMUdata data, uint32_t t_ms);
+	bool send();
 };
 
 /* HARDWARE INIT FUNCTIONS ================================================== */
@@ -176,8 +200,28 @@ void initUSB(void);
 void initUART(void);
 void initI2C(void);
 
-// fixed/float conversions
-fixed5_3_t floatToFixed(float f);
-float fixedToFloat(fixed5_3_t fix);
+/* UART RECEIVE PATH ======================================================== */
+
+// bytes received by the UART interrupt, drained by the command task
+extern SPSCRingBuffer<uint8_t, UART_RX_BUF_LEN> uart_rx_buf;
+
+void attachUARTrx(TaskHandle_t task);
+
+/* UART TRANSMIT PATH ======================================================= */
+
+// packets waiting for the UART transmit interrupt
+extern PacketPool<TX_POOL_LEN, TX_FRAME_LEN> uart_tx_pool;
+
+void attachUARTtx(void);
+bool sendFrame(const uint8_t *frame, uint8_t len, TaskHandle_t notify = NULL);
+bool sendFrameBlocking(const uint8_t *frame, uint8_t len);
+void sendFramePolled(const uint8_t *frame, uint8_t len);
+
+/* I2C TRANSFER QUEUE ======================================================= */
+
+void attachI2C(void);
+bool i2cTransfer(uint8_t addr, const uint8_t *tx, uint16_t tx_len, uint8_t *rx, uint16_t rx_len,
+				 SemaphoreHandle_t done);
+bool i2cBusy(void);
 
 #endif
\ No newline at end of file
@@ -12,12 +12,37 @@
 // set to 1 for the ADCS to print to the usb serial connection from SAMD51
 #define DEBUG 1
 
+// set to 1, or build with -DADCS_TRACE=1, to record the trace points of trace.h
+#ifndef ADCS_TRACE
+#define ADCS_TRACE 0
+#endif
+
 // create more descriptive names for serial interfaces
 #define SERCOM_USB Serial
 #define SERCOM_UART Serial1
 #define SERCOM_I2C Wire
 #define AD0_VAL 1
 
+// hardware behind SERCOM_UART, used to route its receive interrupt to the
+// command task and its transmit interrupt to the packet pool instead of the
+// Arduino Uart driver
+#define SERCOM_UART_HW sercom5
+#define SERCOM_UART_RX_IRQn SERCOM5_2_IRQn
+#define SERCOM_UART_RX_VECTOR pfnSERCOM5_2_Handler
+#define SERCOM_UART_TX_IRQn SERCOM5_0_IRQn
+#define SERCOM_UART_TX_VECTOR pfnSERCOM5_0_Handler
+
+// hardware behind SERCOM_I2C, its interrupts run the I2C transfer queue
+// instead of the Wire driver waiting for each byte: 0 master on bus, 1 slave
+// on bus (a byte was received), 3 error
+#define SERCOM_I2C_HW SERCOM2
+#define SERCOM_I2C_MB_IRQn SERCOM2_0_IRQn
+#define SERCOM_I2C_MB_VECTOR pfnSERCOM2_0_Handler
+#define SERCOM_I2C_SB_IRQn SERCOM2_1_IRQn
+#define SERCOM_I2C_SB_VECTOR pfnSERCOM2_1_Handler
+#define SERCOM_I2C_ERROR_IRQn SERCOM2_3_IRQn
+#define SERCOM_I2C_ERROR_VECTOR pfnSERCOM2_3_Handler
+
 //Actuator Pin Definitions 
 #define MTX1_F_PIN 24
 #define MTX1_R_PIN 23
@@ -30,6 +55,9 @@
 #define FR_PIN 9
 #define RD_PIN 5
 
+// ICM-20948 INT, pulses when a new sample is in the output registers
+#define IMU_INT_PIN A2
+
 
 
 #endif
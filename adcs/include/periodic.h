@@ -0,0 +1,65 @@
+/**
+ * @defgroup   PERIODIC periodic.cpp
+ *
+ * @brief      Fixed rate scheduling of the sensor and control loops.
+ * @details    A periodic loop waits with vTaskDelayUntil, so its releases stay
+ *             on a fixed schedule no matter how long the work of a period
+ *             takes. Release jitter, execution time and deadline misses of
+ *             every loop are recorded in PeriodStats and sent to the satellite
+ *             on CMD_DBG_TIMING.
+ *
+ *             A loop released by an interrupt instead, like readIMU by the
+ *             IMU data ready pin, calls release with the time of the
+ *             interrupt. Its jitter is then the latency from the interrupt.
+ */
+#ifndef __PERIODIC_H__
+#define __PERIODIC_H__
+
+#include <global_definitions.h>
+#include <comm.h>
+#include <sensors.h>
+#include <FreeRTOS_SAMD51.h>
+#include <PeriodStats.h>
+
+// periodic loops: id, period in ms, deadline in ms after the ideal release,
+// which is the interrupt for PERIODIC_READ_IMU without IMU_FIFO
+#define PERIODIC_TASKS(X)                                                \
+	X(PERIODIC_READ_IMU, IMU_READ_PERIOD_MS, IMU_READ_PERIOD_MS)        \
+	X(PERIODIC_HEARTBEAT, 500, 100)                                      \
+	X(PERIODIC_DETUMBLE, 10, 10)                                         \
+	X(PERIODIC_SLOW_SENSORS, 250, 250)
+
+#define PERIODIC_ID(id, period, deadline) id,
+enum PeriodicTask : uint8_t
+{
+	PERIODIC_TASKS(PERIODIC_ID)
+	NUM_PERIODIC
+};
+#undef PERIODIC_ID
+
+/**
+ * @brief      Schedule and timing statistics of one periodic loop
+ */
+class Periodic
+{
+private:
+	TickType_t _period;
+	TickType_t _last_wake;
+	PeriodStats _stats;
+
+public:
+	Periodic(uint16_t period_ms, uint16_t deadline_ms);
+
+	void start(void);
+	void wait(void);
+	void release(uint32_t event_us);
+	void done(void);
+
+	PeriodStats stats(void);
+};
+
+extern Periodic periodic[NUM_PERIODIC];
+
+void sendPeriodicStats(void);
+
+#endif
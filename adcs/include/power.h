@@ -0,0 +1,27 @@
+/**
+ * @defgroup   POWER power.cpp
+ *
+ * @brief      Low power idle and the standby policy.
+ * @details    With configUSE_TICKLESS_IDLE the idle task stops the tick and
+ *             sleeps until the next task is due, instead of being woken by
+ *             every SysTick interrupt. Any interrupt ends the sleep early, so
+ *             a command from the satellite is handled as soon as it arrives.
+ *             While an I2C transfer is on the bus its next interrupt is a
+ *             byte time away, so the idle task waits for it with the tick
+ *             running instead.
+ *
+ *             In CMD_STANDBY nothing needs the sensors: the sensor tasks block
+ *             until another mode is entered and put the IMU to sleep and the
+ *             INA209 in power down meanwhile, so the MCU can sleep for as long
+ *             as the tick allows.
+ */
+#ifndef __POWER_H__
+#define __POWER_H__
+
+#include <global_definitions.h>
+#include <FreeRTOS_SAMD51.h>
+
+void initPower(void);
+EventBits_t sensorModes(void);
+
+#endif
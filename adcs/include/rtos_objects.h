@@ -0,0 +1,99 @@
+/**
+ * @defgroup   RTOS_OBJECTS rtos_objects.cpp
+ *
+ * @brief      Every task, queue, semaphore and event group of the ADCS in one
+ *             place.
+ * @details    The objects are declared in the tables below and created by
+ *             initRTOSObjects and createTask. With STATIC_RTOS set they are
+ *             allocated in .bss instead of the FreeRTOS heap. Their total size
+ *             is checked against RTOS_RAM_BUDGET when compiling, so running out
+ *             of memory is a build error instead of a failed create at run
+ *             time.
+ */
+#ifndef __RTOS_OBJECTS_H__
+#define __RTOS_OBJECTS_H__
+
+#include <global_definitions.h>
+#include <FreeRTOS_SAMD51.h>
+#include <TaskReport.h>
+
+// set to 1 to allocate the RTOS objects statically, 0 for the FreeRTOS heap
+#define STATIC_RTOS 1
+
+// RAM set aside for the objects below, the rest of the SAMD51's 256 KB holds
+// the FreeRTOS heap, the Arduino core and the libraries
+#define RTOS_RAM_BUDGET (16 * 1024)
+#define SAMD51_RAM (256 * 1024)
+
+/* OBJECT TABLES ============================================================ */
+
+// tasks that run for the whole mission: id, function, name, stack depth in
+// words, priority. The IMU task has extra stack for the topic callbacks.
+#define RTOS_TASKS(X)                                          \
+	X(TASK_COMMAND_RX, receiveCommand, "Read UART", 256, 3)    \
+	X(TASK_HEARTBEAT, heartbeat, "Write UART", 256, 2)         \
+	X(TASK_READ_IMU, readIMU, "IMU read", 320, 1)              \
+	X(TASK_READ_SLOW, readSlowSensors, "Slow sensors", 256, 1)
+
+// queues: handle, length, item size. Sensor readings go through the
+// topics in sensors.h instead. imuModeQ holds an IMUMode readIMU has not
+// switched to yet.
+#define RTOS_QUEUES(X)               \
+	X(modeQ, 1, sizeof(uint8_t))     \
+	X(imuModeQ, 1, sizeof(uint8_t))
+
+// binary semaphores, created empty. The IMU and INA209 tasks wait on theirs
+// for their transfers on SERCOM_I2C, which queues the transfers of both.
+#define RTOS_BINARY_SEMAPHORES(X) \
+	X(imuI2CDone)                 \
+	X(inaI2CDone)
+
+// modeLock serializes mode transitions
+#define RTOS_MUTEXES(X) \
+	X(modeLock)
+
+#define RTOS_EVENT_GROUPS(X) \
+	X(modeEvents)
+
+// test tasks only exist while their mode is active, see mode_tasks in
+// rtos_tasks.cpp. Two slots, because a test that ends itself is only deleted
+// at the next mode change, after the next test task may have been created.
+#define MODE_TASK_SLOTS 2
+#define MODE_TASK_STACK_WORDS 256
+
+/* IDS AND HANDLES ========================================================== */
+
+#define RTOS_TASK_ID(id, fn, name, stack, prio) id,
+enum RTOSTask : uint8_t
+{
+	RTOS_TASKS(RTOS_TASK_ID)
+	RTOS_NUM_TASKS
+};
+#undef RTOS_TASK_ID
+
+#define RTOS_QUEUE_HANDLE(handle, len, size) extern QueueHandle_t handle;
+#define RTOS_SEMAPHORE_HANDLE(handle) extern SemaphoreHandle_t handle;
+#define RTOS_EVENT_GROUP_HANDLE(handle) extern EventGroupHandle_t handle;
+RTOS_QUEUES(RTOS_QUEUE_HANDLE)
+RTOS_BINARY_SEMAPHORES(RTOS_SEMAPHORE_HANDLE)
+RTOS_MUTEXES(RTOS_SEMAPHORE_HANDLE)
+RTOS_EVENT_GROUPS(RTOS_EVENT_GROUP_HANDLE)
+#undef RTOS_QUEUE_HANDLE
+#undef RTOS_SEMAPHORE_HANDLE
+#undef RTOS_EVENT_GROUP_HANDLE
+
+/* FUNCTIONS ================================================================ */
+
+void initRTOSObjects(void);
+TaskHandle_t createTask(RTOSTask id);
+
+TaskHandle_t createModeTask(TaskFunction_t task, const char *name, void *params, UBaseType_t priority);
+void deleteModeTask(TaskHandle_t task);
+
+void sendTaskReport(void);
+
+#if DEBUG
+void printRTOSMemory(void);
+#endif
+
+#endif
@@ -12,20 +12,25 @@
 #include <global_definitions.h>
 #include <comm.h>
 #include <actuators.h>
+#include <CommandFramer.h>
 #include <FreeRTOS_SAMD51.h>
+#include <rtos_objects.h>
 
 extern DRV10970 flywhl;
 extern ZXMB5210 Mtx1;
 extern ZXMB5210 Mtx2;
 extern ICM_20948_I2C IMU1;
-extern QueueHandle_t modeQ;
-extern QueueHandle_t IMUq;
-extern SemaphoreHandle_t IMUsemphr;
+
+// waitForMode argument that matches every mode
+#define MODE_BITS_ALL ((EventBits_t)0x00FFFFFF)
 
 void state_machine_transition(uint8_t cmd);
-void create_test_tasks(void);
+void init_mode_tasks(void);
+
+EventBits_t modeBit(uint8_t mode);
+uint8_t waitForMode(EventBits_t modes);
 
-MotorDirection getDirection(PDdata); // get direction the adcs should turn to align X+ with the light source
+MotorDirection getDirection(PDdata_int); // get direction the adcs should turn to align X+ with the light source
 
 // RTOS TASKS /////////////////////////////////////////////////////
 void receiveCommand(void *pvParameters);
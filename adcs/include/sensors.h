@@ -14,23 +14,68 @@
 #include "ADCSPhotodiodeArray.h"
 #include "ICM_20948.h"
 #include "INA209.h"
+#include <TelemetryHub.h>
 
 #define NUM_IMUS 1
 #define INA 1
 #define pds 1
 
+// set to 1 to read the IMU every IMU_FIFO_BURST_MS in bursts from its FIFO, to
+// 0 to read each sample when the INT pin pulses for it. Only IMU1 has a FIFO
+// reader.
+#define IMU_FIFO 1
+#define IMU_FIFO_BURST_MS 10
+
+// ICM-20948 output data rate of the gyroscope and accelerometer, 1125 Hz / (1 +
+// IMU_SMPLRT_DIV): 375 Hz through the FIFO, 187.5 Hz on the INT pin. readIMU
+// reads each sample once and publishes the average every IMU_READ_PERIOD_MS.
+#if IMU_FIFO
+	#define IMU_SMPLRT_DIV 2
+	#define IMU_READ_PERIOD_MS IMU_FIFO_BURST_MS
+#else
+	#define IMU_SMPLRT_DIV 5
+	#define IMU_READ_PERIOD_MS IMU_BATCH_PERIOD_MS
+#endif
+#define IMU_SAMPLE_PERIOD_US ((1 + IMU_SMPLRT_DIV) * 1000000UL / 1125)
+
+// raw samples that go into the IMU batch frames, about one per
+// IMU_BATCH_PERIOD_MS
+#define IMU_BATCH_DECIMATION ((IMU_BATCH_PERIOD_MS * 1000UL + IMU_SAMPLE_PERIOD_US / 2) / IMU_SAMPLE_PERIOD_US)
+
+// without an interrupt for this long readIMU polls the IMU once, so a broken
+// INT line slows the samples down instead of stopping them
+#define IMU_INT_TIMEOUT_MS (4 * IMU_BATCH_PERIOD_MS)
+
+// print the averaged IMU reading once a second in DEBUG builds
+#define IMU_PRINT_DECIMATION (1000 / IMU_READ_PERIOD_MS)
+
+// set by -DICM_20948_USE_DMP in platformio.ini, which builds the driver with
+// the firmware of the Digital Motion Processor. initIMU loads it and
+// CMD_IMU_DMP switches readIMU from the raw samples to the quaternions the
+// DMP computes, CMD_IMU_RAW back. Set IMU_DMP_AT_BOOT to start in DMP mode.
+#ifdef ICM_20948_USE_DMP
+	#define IMU_DMP 1
+#else
+	#define IMU_DMP 0
+#endif
+#define IMU_DMP_AT_BOOT 0
+
+// initializeDMP sets the divider to 19, 56.25 Hz, and the gyroscope to
+// +-2000 dps. Packets read at once, a burst holds one or two.
+#define IMU_DMP_SMPLRT_DIV 19
+#define IMU_DMP_PERIOD_US ((1 + IMU_DMP_SMPLRT_DIV) * 1000000UL / 1125)
+#define IMU_DMP_GYRO_DPS 2000.0f
+#define IMU_DMP_MAX_PACKETS 8
+
+// print the DMP attitude once a second in DEBUG builds
+#define IMU_DMP_PRINT_DECIMATION (1000000UL / IMU_DMP_PERIOD_US)
+
 // SENSOR VARIABLES DEFINED IN `sensors.cpp` //////////////////////////////////////
 extern INA209 ina209;
 extern ICM_20948_I2C IMU2;
 extern ICM_20948_I2C IMU1;
 extern ADCSPhotodiodeArray sunSensors;
-// RTOS VARIABLES DEFINED IN `sensors.cpp` ///////////////////////////////////////
-extern QueueHandle_t IMUq;
-extern QueueHandle_t INAq;
-extern QueueHandle_t PDq;
-extern SemaphoreHandle_t IMUsemphr;
-extern SemaphoreHandle_t INAsemphr;
-extern SemaphoreHandle_t PDsemphr;
+// RTOS VARIABLES ARE DECLARED IN `rtos_objects.h` ///////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
 /* DATA TYPES =============================================================== */
@@ -46,6 +91,22 @@ typedef struct
 	float gyrZ;
 } IMUdata;
 
+// orientation from the DMP of IMU1, unit quaternions w, x, y, z that rotate
+// the sensor frame into the reference frame of the DMP
+typedef struct
+{
+	float quat9[4];			// gyroscope, accelerometer and magnetometer, heading to magnetic north
+	float quat6[4];			// gyroscope and accelerometer, heading drifts
+	int16_t quat9_accuracy; // heading accuracy of quat9 from the DMP
+} IMUattitude;
+
+// readIMU source, set with CMD_IMU_RAW and CMD_IMU_DMP
+enum IMUMode : uint8_t
+{
+	IMU_MODE_RAW, // raw samples from the FIFO, averaged on the MCU
+	IMU_MODE_DMP  // quaternions and calibrated samples from the DMP
+};
+
 // voltage and current from INA209
 typedef struct
 {
@@ -84,12 +145,26 @@ typedef union
 	};
 } PDdata_int;
 
+// SENSOR TOPICS DEFINED IN `sensors.cpp` ////////////////////////////////////////
+// each sensor is read once per sample by its task, consumers subscribe to or
+// read the topic instead of the sensor, see TelemetryHub.h
+extern Topic<IMUdata> imu_topic;	 // gyro averaged over 32 reads, latest magnetometer
+extern Topic<IMUdata> imu_raw_topic; // every single read, for the batch frames
+extern Topic<IMUattitude> attitude_topic; // every DMP packet, IMU_MODE_DMP only
+extern Topic<INAdata> ina_topic;
+extern Topic<PDdata_int> pd_topic;
+
 /* HARDWARE INIT FUNCTIONS ================================================== */
 
 void initIMU(void);
 void initINA(void);
 void initSunSensors(void);
 
+/* IMU MODE ================================================================= */
+
+void requestIMUMode(IMUMode mode);
+IMUMode getIMUMode(void);
+
 /* SENSOR READING FUNCTIONS ================================================= */
 
 INAdata readINA(void);
@@ -100,7 +175,7 @@ int simple_PD_filter(int channel);
 /* SENSOR RTOS TASKS ======================================================== */
 
 void readIMU(void *pvParameters);
-void readINA_rtos(void *pvParameters);
+void readSlowSensors(void *pvParameters);
 
 /* PRINTING FUNCTIONS ======================================================= */
 
@@ -0,0 +1,32 @@
+/**
+ * @defgroup   TRACE trace.cpp
+ *
+ * @brief      Latency trace of the hot paths, see Trace.h.
+ * @details    TRACE records a trace point with a timestamp from the DWT cycle
+ *             counter of the Cortex-M4. Build with ADCS_TRACE set to record,
+ *             without it TRACE compiles to nothing, its arguments included.
+ *             CMD_DBG_TRACE dumps the buffer on SERCOM_USB for
+ *             tools/trace_analyzer.
+ */
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <global_definitions.h>
+#include <FreeRTOS_SAMD51.h>
+#include <Trace.h>
+
+// events kept in RAM, 8 bytes each. 512 hold about a second of the IMU and
+// detumble loops.
+#define TRACE_BUFFER_LEN 512
+
+#if ADCS_TRACE
+	#define TRACE(point, tag) traceEvent(point, tag)
+#else
+	#define TRACE(point, tag) ((void)0)
+#endif
+
+void initTrace(void);
+void traceEvent(uint8_t point, uint16_t tag);
+void dumpTrace(void);
+
+#endif
@@ -0,0 +1,239 @@
+/**
+ * @brief      Schema driven bit packing of telemetry fields.
+ * @details    A schema is a table of fields, each with a width in bits, a
+ *             signedness and a scale to physical units. Fields are packed back
+ *             to back with no padding, least significant bit first: bit n of
+ *             the stream is bit (n % 8) of byte n / 8. A field that starts on
+ *             a byte boundary with a multiple of 8 bits therefore reads as a
+ *             plain little endian integer.
+ *
+ *             Values that do not fit their field saturate instead of wrapping,
+ *             so an out of range reading shows up as the largest value rather
+ *             than as garbage.
+ *
+ *             Schemas are written once as an X macro, see HeartbeatSchema.h.
+ *             The same table gives the firmware its packing offsets and the
+ *             host decoder its field names and scales.
+ */
+#ifndef BIT_PACK_H
+#define BIT_PACK_H
+
+#include <stdint.h>
+
+/**
+ * @brief      One entry of a schema table
+ */
+typedef struct
+{
+	const char *name;
+	uint8_t bits;	 // 1 .. 32
+	bool is_signed;	 // two's complement when set
+	float scale;	 // physical value = raw value * scale
+} FieldSpec;
+
+/**
+ * @brief      Smallest and largest raw value of a field
+ */
+inline int64_t fieldMin(uint8_t bits, bool is_signed)
+{
+	return is_signed ? -((int64_t)1 << (bits - 1)) : 0;
+}
+
+inline int64_t fieldMax(uint8_t bits, bool is_signed)
+{
+	return is_signed ? ((int64_t)1 << (bits - 1)) - 1 : ((int64_t)1 << bits) - 1;
+}
+
+/**
+ * @brief      Write bits of value at a bit offset, other bits are kept
+ *
+ * @param      buf     Packed buffer
+ * @param[in]  offset  Bit offset of the field
+ * @param[in]  bits    Field width
+ * @param[in]  value   Raw value, only the low bits are used
+ */
+inline void packBits(uint8_t *buf, uint16_t offset, uint8_t bits, uint32_t value)
+{
+	uint8_t *p = buf + (offset >> 3);
+	uint8_t shift = offset & 7;
+
+	while (bits > 0)
+	{
+		uint8_t n = (bits < 8 - shift) ? bits : 8 - shift;
+		uint8_t mask = (uint8_t)(((1u << n) - 1) << shift);
+
+		*p = (uint8_t)((*p & ~mask) | ((value << shift) & mask));
+
+		value >>= n;
+		bits -= n;
+		shift = 0;
+		p++;
+	}
+}
+
+/**
+ * @brief      Read bits at a bit offset
+ *
+ * @return     Raw value, zero extended
+ */
+inline uint32_t unpackBits(const uint8_t *buf, uint16_t offset, uint8_t bits)
+{
+	const uint8_t *p = buf + (offset >> 3);
+	uint8_t shift = offset & 7;
+	uint32_t value = 0;
+	uint8_t done = 0;
+
+	while (done < bits)
+	{
+		uint8_t n = (bits - done < 8 - shift) ? bits - done : 8 - shift;
+
+		value |= (uint32_t)((*p >> shift) & ((1u << n) - 1)) << done;
+
+		done += n;
+		shift = 0;
+		p++;
+	}
+
+	return value;
+}
+
+/**
+ * @brief      Saturate a value to its field and pack it
+ *
+ * @param      buf     Packed buffer
+ * @param[in]  offset  Bit offset of the field
+ * @param[in]  spec    The field
+ * @param[in]  value   Raw value
+ */
+inline void packField(uint8_t *buf, uint16_t offset, const FieldSpec &spec, int32_t value)
+{
+	if (value < fieldMin(spec.bits, spec.is_signed))
+		value = (int32_t)fieldMin(spec.bits, spec.is_signed);
+	else if (value > fieldMax(spec.bits, spec.is_signed))
+		value = (int32_t)fieldMax(spec.bits, spec.is_signed);
+
+	packBits(buf, offset, spec.bits, (uint32_t)value);
+}
+
+/**
+ * @brief      Unpack a field and sign extend it
+ */
+inline int32_t unpackField(const uint8_t *buf, uint16_t offset, const FieldSpec &spec)
+{
+	uint32_t raw = unpackBits(buf, offset, spec.bits);
+
+	if (spec.is_signed && spec.bits < 32 && (raw & ((uint32_t)1 << (spec.bits - 1))))
+		raw |= ~(uint32_t)0 << spec.bits;
+
+	return (int32_t)raw;
+}
+
+/**
+ * @brief      Unpack a field at a bit offset known at compile time. Compiles
+ *             to a few loads and shifts, for decoders that run over a lot of
+ *             packets.
+ */
+template <uint16_t OFFSET, uint8_t BITS, bool SIGNED>
+inline int32_t unpackFieldAt(const uint8_t *buf)
+{
+	static_assert(BITS >= 1 && OFFSET % 8 + BITS <= 32, "field must fit a 32 bit load");
+
+	const uint8_t *p = buf + OFFSET / 8;
+	uint32_t raw = 0;
+
+	for (uint8_t i = 0; i < (OFFSET % 8 + BITS + 7) / 8; i++)
+		raw |= (uint32_t)p[i] << (8 * i);
+
+	raw >>= OFFSET % 8;
+	if (BITS < 32)
+		raw &= ((uint32_t)1 << (BITS % 32)) - 1;
+
+	if (SIGNED && BITS < 32 && (raw & ((uint32_t)1 << ((BITS - 1) % 32))))
+		raw |= ~(uint32_t)0 << (BITS % 32);
+
+	return (int32_t)raw;
+}
+
+/**
+ * @brief      Pack every field of a schema. Fields go through a 64 bit
+ *             accumulator and are written out a byte at a time, the unused
+ *             bits of the last byte are cleared.
+ *
+ * @param[in]  schema  The field table
+ * @param[in]  n       Number of fields
+ * @param[in]  values  One raw value per field
+ * @param      buf     Receives the packed fields
+ *
+ * @return     Number of bits written
+ */
+inline uint16_t packFields(const FieldSpec *schema, uint8_t n, const int32_t *values, uint8_t *buf)
+{
+	uint64_t acc = 0;
+	uint8_t fill = 0;
+	uint16_t total = 0;
+
+	for (uint8_t i = 0; i < n; i++)
+	{
+		const FieldSpec &spec = schema[i];
+		int32_t value = values[i];
+
+		if (value < fieldMin(spec.bits, spec.is_signed))
+			value = (int32_t)fieldMin(spec.bits, spec.is_signed);
+		else if (value > fieldMax(spec.bits, spec.is_signed))
+			value = (int32_t)fieldMax(spec.bits, spec.is_signed);
+
+		uint64_t mask = ((uint64_t)1 << spec.bits) - 1;
+		acc |= ((uint64_t)(uint32_t)value & mask) << fill;
+		fill += spec.bits;
+		total += spec.bits;
+
+		while (fill >= 8)
+		{
+			*buf++ = (uint8_t)acc;
+			acc >>= 8;
+			fill -= 8;
+		}
+	}
+
+	if (fill > 0)
+		*buf = (uint8_t)acc;
+
+	return total;
+}
+
+/**
+ * @brief      Unpack every field of a schema
+ *
+ * @return     Number of bits read
+ */
+inline uint16_t unpackFields(const FieldSpec *schema, uint8_t n, const uint8_t *buf, int32_t *values)
+{
+	uint64_t acc = 0;
+	uint8_t fill = 0;
+	uint16_t total = 0;
+
+	for (uint8_t i = 0; i < n; i++)
+	{
+		const FieldSpec &spec = schema[i];
+
+		while (fill < spec.bits)
+		{
+			acc |= (uint64_t)*buf++ << fill;
+			fill += 8;
+		}
+
+		uint32_t raw = (uint32_t)(acc & (((uint64_t)1 << spec.bits) - 1));
+		acc >>= spec.bits;
+		fill -= spec.bits;
+		total += spec.bits;
+
+		if (spec.is_signed && spec.bits < 32 && (raw & ((uint32_t)1 << (spec.bits - 1))))
+			raw |= ~(uint32_t)0 << spec.bits;
+
+		values[i] = (int32_t)raw;
+	}
+
+	return total;
+}
+
+#endif
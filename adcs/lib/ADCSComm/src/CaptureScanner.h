@@ -0,0 +1,242 @@
+/**
+ * @brief      Finds telemetry frames in a raw capture of the ADCS UART stream.
+ * @details    A capture is every byte the ADCS sent, as logged by the test
+ *             setup: heartbeats (HeartbeatSchema.h) and IMU batch frames
+ *             (SampleBatch.h) back to back, with noise wherever the logger
+ *             dropped or corrupted bytes. Neither frame has a sync word, so a
+ *             frame is recognized by its first byte and its CRC16: heartbeats
+ *             start with a known status code, batch frames with BATCH_FRAME_ID.
+ *             A run of zero bytes passes the CRC with status STATUS_FUDGED, so
+ *             an all zero heartbeat is taken for dropped bytes instead.
+ *             After a frame is found the scan continues right after it, so in
+ *             a clean capture every frame costs exactly one CRC check.
+ *
+ *             Frames are handed to a visitor as pointers into the capture, the
+ *             scanner never copies them. A capture can be split into chunks
+ *             scanned independently, e.g. one per thread: each chunk reports
+ *             the frames starting inside it, and scans CAPTURE_SYNC_LEN bytes
+ *             before its start first to get in step with the frame boundaries.
+ */
+#ifndef CAPTURE_SCANNER_H
+#define CAPTURE_SCANNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <CRC16.h>
+#include <CRCTemplate.h>
+#include <HeartbeatSchema.h>
+#include <SampleBatch.h>
+
+// bytes scanned ahead of a chunk to find the frame boundaries, several times
+// the longest frame
+#define CAPTURE_SYNC_LEN 1024
+
+// consecutive heartbeats checked side by side, see heartbeatRun
+#define CAPTURE_LANES 4
+
+/**
+ * @brief      Counts of one scan
+ */
+typedef struct
+{
+	uint64_t heartbeats;
+	uint64_t batches;
+	uint64_t bad_bytes; // bytes that are not part of any frame
+} CaptureStats;
+
+/**
+ * @brief      Set of status codes a heartbeat may start with
+ */
+class StatusSet
+{
+private:
+	uint32_t _bits[8];
+
+public:
+	StatusSet() { memset(_bits, 0, sizeof(_bits)); }
+
+	StatusSet(const uint8_t *codes, uint8_t n)
+	{
+		memset(_bits, 0, sizeof(_bits));
+		for (uint8_t i = 0; i < n; i++)
+			add(codes[i]);
+	}
+
+	void add(uint8_t code) { _bits[code >> 5] |= (uint32_t)1 << (code & 31); }
+
+	bool contains(uint8_t code) const { return (_bits[code >> 5] >> (code & 31)) & 1; }
+};
+
+// same parameters as the CRC16 class defaults: zero start value, no
+// reflection and no final xor, so the bare table engine gives the same CRC
+typedef Crc<16, CRC16_DEFAULT_POLYNOME> capture_crc;
+static_assert(capture_crc::check("123456789", 9) == 0x31C3, "heartbeat CRC is CRC-16/XMODEM");
+
+/**
+ * @brief      Check for a heartbeat of all zero bytes at p, its CRC is 0 too.
+ *             Stops at the first byte that is not 0, so only costs anything
+ *             for status 0x00.
+ */
+inline bool isZeroHeartbeat(const uint8_t *p)
+{
+	for (uint8_t i = 0; i < HEARTBEAT_PAYLOAD_LEN; i++)
+	{
+		if (p[i] != 0)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief      Check for a heartbeat at p
+ *
+ * @param[in]  p      Candidate first byte
+ * @param[in]  avail  Bytes available from p on
+ */
+inline bool isHeartbeat(const uint8_t *p, size_t avail, const StatusSet &status)
+{
+	return avail >= HEARTBEAT_LEN && status.contains(p[0]) && !isZeroHeartbeat(p) &&
+		   capture_crc::calculate(p, HEARTBEAT_PAYLOAD_LEN) ==
+			   (p[HEARTBEAT_PAYLOAD_LEN] | ((uint16_t)p[HEARTBEAT_PAYLOAD_LEN + 1] << 8));
+}
+
+/**
+ * @brief      Count the heartbeats directly following each other at p. The
+ *             CRCs of CAPTURE_LANES frames are computed side by side, so the
+ *             table lookups of different frames overlap instead of each
+ *             waiting for the previous byte of the same frame.
+ *
+ * @return     Number of valid heartbeats in a row, at most CAPTURE_LANES
+ */
+inline uint8_t heartbeatRun(const uint8_t *p, size_t avail, const StatusSet &status)
+{
+	typedef capture_crc::engine engine;
+
+	if (avail < CAPTURE_LANES * HEARTBEAT_LEN)
+		return isHeartbeat(p, avail, status) ? 1 : 0;
+
+	uint8_t lanes = 0;
+	while (lanes < CAPTURE_LANES && status.contains(p[lanes * HEARTBEAT_LEN]) &&
+		   !isZeroHeartbeat(p + lanes * HEARTBEAT_LEN))
+		lanes++;
+
+	if (lanes < 2)
+		return isHeartbeat(p, avail, status) ? 1 : 0;
+
+	uint16_t reg[CAPTURE_LANES] = {0};
+	uint8_t i = 0;
+
+	for (; i + 4 <= HEARTBEAT_PAYLOAD_LEN; i += 4)
+	{
+		for (uint8_t l = 0; l < CAPTURE_LANES; l++)
+		{
+			const uint8_t *a = p + l * HEARTBEAT_LEN + i;
+			reg[l] = engine::row3[a[0] ^ (uint8_t)(reg[l] >> 8)] ^ engine::row2[a[1] ^ (uint8_t)reg[l]] ^
+					 engine::row1[a[2]] ^ engine::row0[a[3]];
+		}
+	}
+
+	for (; i < HEARTBEAT_PAYLOAD_LEN; i++)
+	{
+		for (uint8_t l = 0; l < CAPTURE_LANES; l++)
+			reg[l] = (uint16_t)(reg[l] << 8) ^ engine::row0[(uint8_t)(reg[l] >> 8) ^ p[l * HEARTBEAT_LEN + i]];
+	}
+
+	uint8_t run = 0;
+	while (run < lanes)
+	{
+		const uint8_t *crc = p + run * HEARTBEAT_LEN + HEARTBEAT_PAYLOAD_LEN;
+		if (reg[run] != (crc[0] | ((uint16_t)crc[1] << 8)))
+			break;
+		run++;
+	}
+
+	return run;
+}
+
+/**
+ * @brief      Check for a batch frame at p
+ *
+ * @return     Length of the frame, 0 if there is none
+ */
+inline uint8_t isSampleBatch(const uint8_t *p, size_t avail)
+{
+	if (avail < BATCH_HEADER_LEN + BATCH_CRC_LEN || p[0] != BATCH_FRAME_ID)
+		return 0;
+
+	uint8_t len = p[1];
+	if (len < BATCH_HEADER_LEN + BATCH_CRC_LEN || len > avail)
+		return 0;
+
+	if (capture_crc::calculate(p, len - BATCH_CRC_LEN) != (p[len - 2] | ((uint16_t)p[len - 1] << 8)))
+		return 0;
+
+	return len;
+}
+
+/**
+ * @brief      Scan part of a capture for frames
+ *
+ * @param[in]  data     The whole capture
+ * @param[in]  len      Length of the capture
+ * @param[in]  begin    First byte of the chunk
+ * @param[in]  end      Byte after the chunk. Frames that start before end
+ *                      are reported even if they run past it.
+ * @param[in]  status   Status codes a heartbeat may start with
+ * @param      visitor  Gets heartbeat(offset, frame) and
+ *                      batch(offset, frame, frame_len) for every frame
+ *                      starting in the chunk, in capture order
+ *
+ * @return     Counts for the chunk
+ */
+template <typename Visitor>
+CaptureStats scanCapture(const uint8_t *data, size_t len, size_t begin, size_t end,
+						 const StatusSet &status, Visitor &visitor)
+{
+	CaptureStats stats = {0, 0, 0};
+
+	if (end > len)
+		end = len;
+
+	size_t pos = (begin > CAPTURE_SYNC_LEN) ? begin - CAPTURE_SYNC_LEN : 0;
+
+	while (pos < end)
+	{
+		const uint8_t *p = data + pos;
+		size_t avail = len - pos;
+		bool report = pos >= begin;
+		uint8_t run, batch_len;
+
+		if ((run = heartbeatRun(p, avail, status)) != 0)
+		{
+			for (uint8_t i = 0; i < run; i++, pos += HEARTBEAT_LEN)
+			{
+				if (pos >= begin && pos < end)
+				{
+					visitor.heartbeat((uint64_t)pos, data + pos);
+					stats.heartbeats++;
+				}
+			}
+		}
+		else if ((batch_len = isSampleBatch(p, avail)) != 0)
+		{
+			if (report)
+			{
+				visitor.batch((uint64_t)pos, p, batch_len);
+				stats.batches++;
+			}
+			pos += batch_len;
+		}
+		else
+		{
+			if (report)
+				stats.bad_bytes++;
+			pos++;
+		}
+	}
+
+	return stats;
+}
+
+#endif
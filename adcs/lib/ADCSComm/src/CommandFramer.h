@@ -0,0 +1,165 @@
+/**
+ * @brief      Self-resynchronizing framer for fixed length command frames.
+ * @details    The UART receive interrupt delivers bytes one at a time. The
+ *             framer keeps the last LEN bytes in a sliding window and accepts
+ *             the window as a frame only when the CRC16 in its last two bytes
+ *             matches the bytes before it (same check as TEScommand::checkCRC).
+ *             When a byte is dropped, inserted or corrupted the window slides
+ *             forward one byte at a time until a valid frame lines up again,
+ *             so alignment is recovered within one frame instead of every
+ *             later command being misaligned.
+ */
+#ifndef COMMAND_FRAMER_H
+#define COMMAND_FRAMER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <CRC16.h>
+
+/**
+ * @brief      Result of adding a byte to the framer
+ */
+enum FramerResult : uint8_t
+{
+	FRAMER_PENDING = 0,	  // frame not complete yet, or still searching for sync
+	FRAMER_FRAME = 1,	  // a valid frame is available through frame()
+	FRAMER_CRC_ERROR = 2, // the frame expected at this point failed its CRC, sync lost
+};
+
+/**
+ * @brief      Framing statistics, counted since construction or clearStats()
+ */
+typedef struct
+{
+	uint32_t frames;		  // valid frames delivered
+	uint32_t crc_failures;	  // frames expected in sync that failed the CRC
+	uint32_t resyncs;		  // times alignment was regained after being lost
+	uint32_t bytes_discarded; // bytes dropped while searching or on reset()
+} FramerStats;
+
+template <uint8_t LEN>
+class CommandFramer
+{
+	static_assert(LEN > 2, "frame must hold a payload and a 2 byte CRC");
+
+private:
+	// last LEN bytes received, oldest first
+	uint8_t _window[LEN];
+
+	// Counts the number of bytes currently in the window
+	uint8_t _count;
+
+	// True while frames are arriving back to back at the expected boundaries
+	bool _synced;
+
+	FramerStats _stats;
+
+	/**
+	 * @brief      Check the CRC of the full window. The CRC is stored little
+	 *             endian after the payload, matching the TEScommand layout.
+	 */
+	bool windowValid() const
+	{
+		CRC16 crcGen;
+		crcGen.add(_window, LEN - 2);
+
+		uint16_t crc = _window[LEN - 2] | ((uint16_t)_window[LEN - 1] << 8);
+		return crcGen.getCRC() == crc;
+	}
+
+public:
+	CommandFramer() : _count(0), _synced(true)
+	{
+		clearStats();
+	}
+
+	/**
+	 * @brief      Add a received byte to the sliding window
+	 *
+	 * @param[in]  b     The received byte
+	 *
+	 * @return     FRAMER_FRAME if b completed a valid frame, which can then be
+	 *             read with frame(). FRAMER_CRC_ERROR the first time a frame
+	 *             fails after being in sync. FRAMER_PENDING otherwise.
+	 */
+	FramerResult push(uint8_t b)
+	{
+		_window[_count++] = b;
+
+		if (_count < LEN)
+			return FRAMER_PENDING;
+
+		if (windowValid())
+		{
+			_stats.frames++;
+			if (!_synced)
+			{
+				_stats.resyncs++;
+				_synced = true;
+			}
+
+			_count = 0;
+			return FRAMER_FRAME;
+		}
+
+		// drop the oldest byte and keep searching for the next frame boundary
+		memmove(_window, _window + 1, LEN - 1);
+		_count = LEN - 1;
+		_stats.bytes_discarded++;
+
+		if (_synced)
+		{
+			_stats.crc_failures++;
+			_synced = false;
+			return FRAMER_CRC_ERROR;
+		}
+
+		return FRAMER_PENDING;
+	}
+
+	/**
+	 * @brief      The last valid frame. Only valid directly after push()
+	 *             returned FRAMER_FRAME.
+	 */
+	const uint8_t *frame() const { return _window; }
+
+	/**
+	 * @brief      Check if part of a frame has been received
+	 */
+	bool partial() const { return _count != 0; }
+
+	/**
+	 * @brief      Check if the framer is aligned to the frame boundaries
+	 */
+	bool synced() const { return _synced; }
+
+	/**
+	 * @brief      Discard any partially received frame, e.g. after an inter-byte
+	 *             timeout. The next byte is treated as the start of a frame.
+	 *
+	 * @return     True if the discarded bytes were a frame that was never
+	 *             reported. False if there were none, or they are what is left
+	 *             of a frame push() already reported with FRAMER_CRC_ERROR.
+	 */
+	bool reset()
+	{
+		bool unreported = _count != 0 && _synced;
+
+		_stats.bytes_discarded += _count;
+		_count = 0;
+
+		if (!_synced)
+		{
+			_stats.resyncs++;
+			_synced = true;
+		}
+
+		return unreported;
+	}
+
+	const FramerStats &stats() const { return _stats; }
+
+	void clearStats() { memset(&_stats, 0, sizeof(_stats)); }
+};
+
+#endif
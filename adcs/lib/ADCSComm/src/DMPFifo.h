@@ -0,0 +1,331 @@
+/**
+ * @brief      Burst reads of the packets the ICM-20948 DMP writes to its FIFO.
+ * @details    With the Digital Motion Processor running, the FIFO holds
+ *             packets instead of the 12 byte frames of ICMFifo.h. A packet
+ *             starts with a big endian header whose bits say which outputs
+ *             follow, in the order of the bits from the top, then a second
+ *             header for the accuracy outputs when DMP_HEADER_HEADER2 is set,
+ *             and ends with a two byte footer. The outputs are big endian.
+ *             This is the layout readDMPdataFromFIFO of the SparkFun driver
+ *             parses (util/ICM_20948_DMP.h), one transfer per output.
+ *
+ *             DMPFifoReader reads the FIFO count and then everything in the
+ *             FIFO in one transfer, up to DMP_FIFO_MAX_BURST bytes, through
+ *             the same bus as ICMFifoReader. It parses the whole packets and
+ *             keeps the start of a packet that is not all there yet for the
+ *             next read.
+ *
+ *             The quaternions are the x, y and z parts scaled by 2^30, w
+ *             follows from the unit norm, see dmpQuaternion.
+ */
+#ifndef DMP_FIFO_H
+#define DMP_FIFO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "ICMFifo.h"
+
+// header bits, an output is in the packet when its bit is set
+#define DMP_HEADER_ACCEL 0x8000
+#define DMP_HEADER_GYRO 0x4000
+#define DMP_HEADER_COMPASS 0x2000
+#define DMP_HEADER_ALS 0x1000
+#define DMP_HEADER_QUAT6 0x0800
+#define DMP_HEADER_QUAT9 0x0400
+#define DMP_HEADER_PQUAT6 0x0200
+#define DMP_HEADER_GEOMAG 0x0100
+#define DMP_HEADER_PRESSURE 0x0080
+#define DMP_HEADER_GYRO_CALIBR 0x0040
+#define DMP_HEADER_COMPASS_CALIBR 0x0020
+#define DMP_HEADER_STEP_DETECTOR 0x0010
+#define DMP_HEADER_HEADER2 0x0008
+
+// second header bits
+#define DMP_HEADER2_ACCEL_ACCURACY 0x4000
+#define DMP_HEADER2_GYRO_ACCURACY 0x2000
+#define DMP_HEADER2_COMPASS_ACCURACY 0x1000
+#define DMP_HEADER2_FSYNC 0x0800
+#define DMP_HEADER2_PICKUP 0x0400
+#define DMP_HEADER2_ACTIVITY 0x0080
+#define DMP_HEADER2_SECONDARY_ON_OFF 0x0040
+
+#define DMP_FOOTER_LEN 2
+
+// a packet with every output
+#define DMP_PACKET_MAX_LEN 122
+
+// bytes read at once, the SparkFun driver reads at most 255 bytes
+#define DMP_FIFO_MAX_BURST 255
+
+/**
+ * @brief      Bytes each output takes, in the order the outputs follow the
+ *             headers. Like the driver, the calibrated gyroscope and Fsync bits
+ *             carry no bytes: the calibrated rate is the raw one less the bias
+ *             that comes with it.
+ */
+typedef struct
+{
+	bool header2; // bit of the second header
+	uint16_t bit;
+	uint8_t len;
+} DMPOutput;
+
+static const DMPOutput dmp_outputs[] = {
+	{false, DMP_HEADER_ACCEL, 6},
+	{false, DMP_HEADER_GYRO, 12}, // rate, then bias
+	{false, DMP_HEADER_COMPASS, 6},
+	{false, DMP_HEADER_ALS, 8},
+	{false, DMP_HEADER_QUAT6, 12},
+	{false, DMP_HEADER_QUAT9, 14}, // quaternion, then heading accuracy
+	{false, DMP_HEADER_PQUAT6, 6},
+	{false, DMP_HEADER_GEOMAG, 14},
+	{false, DMP_HEADER_PRESSURE, 6},
+	{false, DMP_HEADER_GYRO_CALIBR, 0},
+	{false, DMP_HEADER_COMPASS_CALIBR, 12},
+	{false, DMP_HEADER_STEP_DETECTOR, 4},
+	{true, DMP_HEADER2_ACCEL_ACCURACY, 2},
+	{true, DMP_HEADER2_GYRO_ACCURACY, 2},
+	{true, DMP_HEADER2_COMPASS_ACCURACY, 2},
+	{true, DMP_HEADER2_FSYNC, 0},
+	{true, DMP_HEADER2_PICKUP, 2},
+	{true, DMP_HEADER2_ACTIVITY, 6},
+	{true, DMP_HEADER2_SECONDARY_ON_OFF, 2},
+};
+
+/**
+ * @brief      The outputs of a packet the ADCS uses, the others are skipped.
+ *             Outputs not in the packet are zero.
+ */
+typedef struct
+{
+	uint16_t header;
+	uint16_t header2;
+	int16_t gyro[3];		// raw rate, counts of the full scale range
+	int16_t gyro_bias[3];	// same counts, the calibrated rate is gyro - gyro_bias
+	int32_t compass[3];		// calibrated magnetic field, uT scaled by 2^16
+	int32_t quat6[3];		// x, y, z of the 6 axis quaternion, scaled by 2^30
+	int32_t quat9[3];		// x, y, z of the 9 axis quaternion, scaled by 2^30
+	int16_t quat9_accuracy; // heading accuracy of quat9
+	uint16_t accuracy[3];	// calibration of accelerometer, gyroscope and magnetometer, 0 to 3
+} DMPPacket;
+
+inline int16_t dmpRead16(const uint8_t *data)
+{
+	return (int16_t)((data[0] << 8) | data[1]);
+}
+
+inline int32_t dmpRead32(const uint8_t *data)
+{
+	return (int32_t)(((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3]);
+}
+
+/**
+ * @brief      Parse the packet at the start of data
+ *
+ * @param[in]  data  The bytes read from the FIFO
+ * @param[in]  len   Number of bytes
+ * @param      p     Filled with the packet
+ *
+ * @return     Length of the packet, 0 if it is not all in data yet
+ */
+inline uint16_t parseDMPPacket(const uint8_t *data, uint16_t len, DMPPacket *p)
+{
+	uint16_t header;
+	uint16_t header2 = 0;
+	uint16_t pos = 2;
+
+	if (len < 2)
+		return 0;
+	header = (uint16_t)dmpRead16(data);
+
+	if (header & DMP_HEADER_HEADER2)
+	{
+		if (len < 4)
+			return 0;
+		header2 = (uint16_t)dmpRead16(data + 2);
+		pos = 4;
+	}
+
+	// the whole packet has to be there before any of it is taken
+	uint16_t end = pos + DMP_FOOTER_LEN;
+	for (uint8_t i = 0; i < sizeof(dmp_outputs) / sizeof(dmp_outputs[0]); i++)
+	{
+		if ((dmp_outputs[i].header2 ? header2 : header) & dmp_outputs[i].bit)
+			end += dmp_outputs[i].len;
+	}
+	if (len < end)
+		return 0;
+
+	memset(p, 0, sizeof(*p));
+	p->header = header;
+	p->header2 = header2;
+
+	for (uint8_t i = 0; i < sizeof(dmp_outputs) / sizeof(dmp_outputs[0]); i++)
+	{
+		const DMPOutput &out = dmp_outputs[i];
+		const uint8_t *field = data + pos;
+
+		if (!((out.header2 ? header2 : header) & out.bit))
+			continue;
+		pos += out.len;
+
+		if (!out.header2)
+		{
+			switch (out.bit)
+			{
+			case DMP_HEADER_GYRO:
+				for (uint8_t axis = 0; axis < 3; axis++)
+				{
+					p->gyro[axis] = dmpRead16(field + 2 * axis);
+					p->gyro_bias[axis] = dmpRead16(field + 6 + 2 * axis);
+				}
+				break;
+			case DMP_HEADER_QUAT6:
+				for (uint8_t axis = 0; axis < 3; axis++)
+					p->quat6[axis] = dmpRead32(field + 4 * axis);
+				break;
+			case DMP_HEADER_QUAT9:
+				for (uint8_t axis = 0; axis < 3; axis++)
+					p->quat9[axis] = dmpRead32(field + 4 * axis);
+				p->quat9_accuracy = dmpRead16(field + 12);
+				break;
+			case DMP_HEADER_COMPASS_CALIBR:
+				for (uint8_t axis = 0; axis < 3; axis++)
+					p->compass[axis] = dmpRead32(field + 4 * axis);
+				break;
+			default:
+				break;
+			}
+		}
+		else
+		{
+			switch (out.bit)
+			{
+			case DMP_HEADER2_ACCEL_ACCURACY: p->accuracy[0] = (uint16_t)dmpRead16(field); break;
+			case DMP_HEADER2_GYRO_ACCURACY: p->accuracy[1] = (uint16_t)dmpRead16(field); break;
+			case DMP_HEADER2_COMPASS_ACCURACY: p->accuracy[2] = (uint16_t)dmpRead16(field); break;
+			default: break;
+			}
+		}
+	}
+
+	return end;
+}
+
+/**
+ * @brief      Unit quaternion from the three parts the DMP sends
+ *
+ * @param[in]  q30   x, y, z scaled by 2^30
+ * @param      q     w, x, y, z, with w not negative
+ */
+inline void dmpQuaternion(const int32_t q30[3], float q[4])
+{
+	float sum = 0.0f;
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		q[i + 1] = q30[i] / 1073741824.0f;
+		sum += q[i + 1] * q[i + 1];
+	}
+
+	// rounding can take the sum of the squares just past 1
+	q[0] = sum < 1.0f ? sqrtf(1.0f - sum) : 0.0f;
+}
+
+/**
+ * @brief      Reads the packets in the FIFO in bursts
+ *
+ * @tparam     Bus   Register access to the IMU, see ICMFifo.h
+ */
+template <class Bus>
+class DMPFifoReader
+{
+private:
+	Bus &_bus;
+	uint8_t _buf[DMP_PACKET_MAX_LEN + DMP_FIFO_MAX_BURST];
+	uint16_t _len; // bytes in _buf, the start of a packet from the last read
+	uint32_t _overflows;
+
+public:
+	DMPFifoReader(Bus &bus) : _bus(bus), _len(0), _overflows(0) {}
+
+	/**
+	 * @brief      Empty the FIFO and drop a packet carried over. Call when the
+	 *             DMP starts writing packets again.
+	 */
+	void reset()
+	{
+		const uint8_t assert_rst = 0x1f;
+		const uint8_t release_rst = 0x1e;
+
+		_bus.write(ICM_FIFO_RST, &assert_rst, 1);
+		_bus.write(ICM_FIFO_RST, &release_rst, 1);
+		_len = 0;
+	}
+
+	/**
+	 * @brief      Read the FIFO, two transfers, and parse the whole packets
+	 *
+	 * @param      packets  Filled with the packets, oldest first
+	 * @param[in]  max      Room in packets, the packets after it are kept for
+	 *                      the next read
+	 *
+	 * @return     Number of packets, 0 when none was complete, the FIFO was
+	 *             full or a transfer failed
+	 */
+	uint8_t read(DMPPacket *packets, uint8_t max)
+	{
+		uint8_t count_regs[2];
+
+		if (!_bus.read(ICM_FIFO_COUNTH, count_regs, 2))
+			return 0;
+
+		// a full FIFO stopped taking bytes, maybe in the middle of a packet
+		uint16_t count = ((count_regs[0] & 0x1f) << 8) | count_regs[1];
+		if (count > ICM_FIFO_SIZE - DMP_PACKET_MAX_LEN)
+		{
+			_overflows++;
+			reset();
+			return 0;
+		}
+
+		uint16_t n = sizeof(_buf) - _len;
+		if (n > count)
+			n = count;
+		if (n > DMP_FIFO_MAX_BURST)
+			n = DMP_FIFO_MAX_BURST;
+
+		if (n > 0)
+		{
+			if (!_bus.read(ICM_FIFO_R_W, _buf + _len, n))
+			{
+				// the packets after the lost bytes would be misaligned
+				reset();
+				return 0;
+			}
+			_len += n;
+		}
+
+		uint16_t pos = 0;
+		uint16_t used;
+		uint8_t packets_read = 0;
+
+		while (packets_read < max && (used = parseDMPPacket(_buf + pos, _len - pos, &packets[packets_read])) > 0)
+		{
+			pos += used;
+			packets_read++;
+		}
+
+		memmove(_buf, _buf + pos, _len - pos);
+		_len -= pos;
+		return packets_read;
+	}
+
+	/**
+	 * @brief      Times the FIFO filled up and packets were lost
+	 */
+	uint32_t overflows() const { return _overflows; }
+};
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @brief      Saturating signed or unsigned Q format fixed point numbers.
+ * @details    Fixed<I, F, Storage> keeps a number as an integer count of
+ *             2^-F steps in Storage, I + F bits wide. The I integer bits
+ *             include the sign bit when Storage is signed, so Fixed<5, 3>
+ *             covers -16 .. 15.875 in steps of 0.125.
+ *
+ *             Every conversion and operation saturates: a result outside the
+ *             range becomes the closest end of the range instead of wrapping
+ *             around. Arithmetic is integer only, products and quotients are
+ *             computed in a wider integer, so control code can stay in fixed
+ *             point without float round trips. Conversions from float are
+ *             constexpr so constants cost nothing at run time.
+ */
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+#include <limits>
+#include <type_traits>
+
+/**
+ * @brief      How a value between two steps is rounded
+ */
+enum FixedRounding : uint8_t
+{
+	FIXED_ROUND_NEAREST = 0, // to the nearest step, halfway away from zero
+	FIXED_ROUND_TRUNCATE = 1, // toward zero
+	FIXED_ROUND_FLOOR = 2,	  // toward minus infinity
+};
+
+template <uint8_t IntBits, uint8_t FracBits, typename Storage = int8_t>
+class Fixed
+{
+	static_assert(std::numeric_limits<Storage>::is_integer, "storage must be an integer type");
+	static_assert(IntBits + FracBits == 8 * sizeof(Storage), "integer and fraction bits must fill the storage");
+	static_assert(sizeof(Storage) <= 4, "storage is at most 32 bits");
+
+public:
+	// holds any product or shifted quotient of two values without overflow
+	typedef typename std::conditional<(sizeof(Storage) == 1 || (sizeof(Storage) == 2 && std::numeric_limits<Storage>::is_signed)),
+									  int32_t, int64_t>::type wide_t;
+
+	static constexpr wide_t RAW_MIN = std::numeric_limits<Storage>::min();
+	static constexpr wide_t RAW_MAX = std::numeric_limits<Storage>::max();
+	static constexpr wide_t ONE = (wide_t)1 << FracBits;
+
+private:
+	Storage _raw;
+
+	struct RawTag
+	{
+	};
+
+	constexpr Fixed(Storage raw, RawTag) : _raw(raw) {}
+
+	static constexpr Storage saturate(wide_t raw)
+	{
+		return (Storage)(raw < RAW_MIN ? RAW_MIN : raw > RAW_MAX ? RAW_MAX : raw);
+	}
+
+	// float already clamped well inside wide_t, so the casts are defined
+	static constexpr wide_t roundFloat(float x, FixedRounding mode)
+	{
+		return mode == FIXED_ROUND_TRUNCATE ? (wide_t)x
+			 : mode == FIXED_ROUND_FLOOR	? ((float)(wide_t)x > x ? (wide_t)x - 1 : (wide_t)x)
+											: (wide_t)(x < 0 ? x - 0.5f : x + 0.5f);
+	}
+
+	static constexpr float clampFloat(float x)
+	{
+		// powers of two are exact floats, and beyond any storage range
+		return x != x ? 0.0f
+			 : x < -(float)((uint64_t)1 << (8 * sizeof(Storage))) ? -(float)((uint64_t)1 << (8 * sizeof(Storage)))
+			 : x > (float)((uint64_t)1 << (8 * sizeof(Storage)))	 ? (float)((uint64_t)1 << (8 * sizeof(Storage)))
+																	 : x;
+	}
+
+	static constexpr wide_t clampInt(int64_t v)
+	{
+		return v < RAW_MIN ? RAW_MIN : v > RAW_MAX ? RAW_MAX : (wide_t)v;
+	}
+
+	// divide by 2^shift with the given rounding, shift > 0
+	template <typename T>
+	static constexpr T shiftRound(T v, uint8_t shift, FixedRounding mode)
+	{
+		return mode == FIXED_ROUND_FLOOR	  ? floorDiv(v, (T)1 << shift)
+			 : mode == FIXED_ROUND_TRUNCATE ? v / ((T)1 << shift)
+											: (v < 0 ? -((-v + ((T)1 << (shift - 1))) >> shift)
+													 : (v + ((T)1 << (shift - 1))) >> shift);
+	}
+
+	template <typename T>
+	static constexpr T floorDiv(T a, T b)
+	{
+		return (a % b != 0 && ((a < 0) != (b < 0))) ? a / b - 1 : a / b;
+	}
+
+	template <uint8_t, uint8_t, typename>
+	friend class Fixed;
+
+public:
+	constexpr Fixed() : _raw(0) {}
+
+	/**
+	 * @brief      Value from its raw step count, no scaling
+	 */
+	static constexpr Fixed fromRaw(Storage raw) { return Fixed(raw, RawTag()); }
+
+	/**
+	 * @brief      Convert a float, NaN becomes zero
+	 *
+	 * @param[in]  f     The value
+	 * @param[in]  mode  Rounding of values between two steps
+	 */
+	static constexpr Fixed fromFloat(float f, FixedRounding mode = FIXED_ROUND_NEAREST)
+	{
+		return Fixed(saturate(roundFloat(clampFloat(f * (float)ONE), mode)), RawTag());
+	}
+
+	/**
+	 * @brief      Convert an integer
+	 */
+	static constexpr Fixed fromInt(int32_t i)
+	{
+		return Fixed(saturate(i < RAW_MIN / ONE ? RAW_MIN : i > RAW_MAX / ONE ? RAW_MAX : (wide_t)i * ONE), RawTag());
+	}
+
+	/**
+	 * @brief      Convert from another Q format
+	 *
+	 * @param[in]  other  The value
+	 * @param[in]  mode   Rounding when other has more fraction bits
+	 */
+	template <uint8_t I2, uint8_t F2, typename S2>
+	static constexpr Fixed from(Fixed<I2, F2, S2> other, FixedRounding mode = FIXED_ROUND_NEAREST)
+	{
+		return Fixed(saturate(clampInt(F2 > FracBits	? shiftRound((int64_t)other.raw(), F2 - FracBits, mode)
+									   : F2 < FracBits ? (int64_t)other.raw() * ((int64_t)1 << (F2 < FracBits ? FracBits - F2 : 0))
+													   : (int64_t)other.raw())),
+					 RawTag());
+	}
+
+	static constexpr Fixed min() { return Fixed((Storage)RAW_MIN, RawTag()); }
+	static constexpr Fixed max() { return Fixed((Storage)RAW_MAX, RawTag()); }
+
+	/**
+	 * @brief      Size of one step
+	 */
+	static constexpr float lsb() { return 1.0f / ONE; }
+
+	constexpr Storage raw() const { return _raw; }
+	constexpr float toFloat() const { return _raw * lsb(); }
+
+	/**
+	 * @brief      Integer part, rounded toward minus infinity
+	 */
+	constexpr int32_t toInt() const { return (int32_t)floorDiv((wide_t)_raw, ONE); }
+
+	/* ARITHMETIC =========================================================== */
+
+	constexpr Fixed operator+(Fixed b) const { return Fixed(saturate((wide_t)_raw + b._raw), RawTag()); }
+	constexpr Fixed operator-(Fixed b) const { return Fixed(saturate((wide_t)_raw - b._raw), RawTag()); }
+	constexpr Fixed operator-() const { return Fixed(saturate(-(wide_t)_raw), RawTag()); }
+
+	/**
+	 * @brief      Product, rounded to the nearest step
+	 */
+	constexpr Fixed operator*(Fixed b) const { return mul(b, FIXED_ROUND_NEAREST); }
+
+	constexpr Fixed mul(Fixed b, FixedRounding mode) const
+	{
+		return Fixed(saturate(FracBits == 0 ? (wide_t)_raw * b._raw : shiftRound((wide_t)_raw * b._raw, FracBits, mode)), RawTag());
+	}
+
+	/**
+	 * @brief      Quotient, rounded toward zero. Dividing by zero gives the
+	 *             end of the range with the sign of the dividend.
+	 */
+	constexpr Fixed operator/(Fixed b) const
+	{
+		return b._raw == 0 ? (_raw < 0 ? min() : max())
+						   : Fixed(saturate((wide_t)_raw * ONE / b._raw), RawTag());
+	}
+
+	Fixed &operator+=(Fixed b) { return *this = *this + b; }
+	Fixed &operator-=(Fixed b) { return *this = *this - b; }
+	Fixed &operator*=(Fixed b) { return *this = *this * b; }
+	Fixed &operator/=(Fixed b) { return *this = *this / b; }
+
+	constexpr bool operator==(Fixed b) const { return _raw == b._raw; }
+	constexpr bool operator!=(Fixed b) const { return _raw != b._raw; }
+	constexpr bool operator<(Fixed b) const { return _raw < b._raw; }
+	constexpr bool operator<=(Fixed b) const { return _raw <= b._raw; }
+	constexpr bool operator>(Fixed b) const { return _raw > b._raw; }
+	constexpr bool operator>=(Fixed b) const { return _raw >= b._raw; }
+};
+
+template <uint8_t IntBits, uint8_t FracBits, typename Storage>
+constexpr typename Fixed<IntBits, FracBits, Storage>::wide_t Fixed<IntBits, FracBits, Storage>::RAW_MIN;
+template <uint8_t IntBits, uint8_t FracBits, typename Storage>
+constexpr typename Fixed<IntBits, FracBits, Storage>::wide_t Fixed<IntBits, FracBits, Storage>::RAW_MAX;
+template <uint8_t IntBits, uint8_t FracBits, typename Storage>
+constexpr typename Fixed<IntBits, FracBits, Storage>::wide_t Fixed<IntBits, FracBits, Storage>::ONE;
+
+#endif
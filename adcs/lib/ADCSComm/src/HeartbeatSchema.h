@@ -0,0 +1,139 @@
+/**
+ * @brief      Field table of the heartbeat packet sent to the satellite.
+ * @details    HEARTBEAT_FIELDS is the only description of the packet. The
+ *             firmware packs ADCSdata fields with it and the host decodes
+ *             captured packets with it. Fields are bit packed in table order,
+ *             see BitPack.h, followed by the CRC16 of all bytes before it,
+ *             little endian, same as the commands.
+ *
+ *             Widths only hold what the data needs: the enable pins are 1 bit,
+ *             the magnetorquer states (0x0, 0x1, 0x2, 0xa, 0xb) 4 bits and the
+ *             photodiodes 12 bits from the 12 bit ADC. Status stays the first
+ *             byte so batch frames (BATCH_FRAME_ID) can still be told apart.
+ *             HEARTBEAT_STATUS lists the codes it may hold, the Status enum
+ *             of the firmware is generated from it.
+ */
+#ifndef HEARTBEAT_SCHEMA_H
+#define HEARTBEAT_SCHEMA_H
+
+#include <stdint.h>
+#include <BitPack.h>
+#include <CRC16.h>
+
+/*   X(id,           code)                                                    */
+#define HEARTBEAT_STATUS(X)                                                    \
+	X(OK,            0xaa) /* "Heartbeat"                                  */ \
+	X(HELLO,         0xaf) /* Sent upon system init                        */ \
+	X(ADCS_ERROR,    0xf0) /* Sent upon runtime error                      */ \
+	X(COMM_ERROR,    0x99) /* Sent upon invalid communication              */ \
+	X(FUDGED,        0x00) /* Data is not real, just test output           */ \
+	X(TEST_START,    0xb0) /* starting test                                */ \
+	X(TEST_END,      0xb1) /* test finished                                */ \
+	X(MOTOR_TEST,    0xb2) /* middle of the motor test                     */ \
+	X(MTX_TEST,      0xb3) /* middle of the Mtx test                       */
+
+#define HEARTBEAT_STATUS_CODE(id, code) code,
+static const uint8_t heartbeat_status_codes[] = {HEARTBEAT_STATUS(HEARTBEAT_STATUS_CODE)};
+#undef HEARTBEAT_STATUS_CODE
+
+/*   X(id,       bits, signed, scale)                                         */
+#define HEARTBEAT_FIELDS(X)                                                    \
+	X(STATUS,    8,    false,  1.0f)   /* Status code                      */ \
+	X(VOLTAGE,   8,    true,   0.125f) /* V, fixed5_3                      */ \
+	X(CURRENT,   8,    true,   1.0f)   /* mA                               */ \
+	X(FREQ,      8,    false,  1.0f)   /* flywheel revolutions per second  */ \
+	X(MOTOR_EN,  1,    false,  1.0f)                                           \
+	X(BUCK_EN,   1,    false,  1.0f)                                           \
+	X(MTX1,      4,    false,  1.0f)   /* magnetorquer state, see ADCSdata */ \
+	X(MTX2,      4,    false,  1.0f)                                           \
+	X(MAG_X,     8,    true,   1.0f)   /* uT                               */ \
+	X(MAG_Y,     8,    true,   1.0f)                                           \
+	X(MAG_Z,     8,    true,   1.0f)                                           \
+	X(GYRO_X,    8,    true,   0.125f) /* dps, fixed5_3                    */ \
+	X(GYRO_Y,    8,    true,   0.125f)                                         \
+	X(GYRO_Z,    8,    true,   0.125f)                                         \
+	X(PD_XPOS,   12,   false,  1.0f)   /* ADC counts                       */ \
+	X(PD_XNEG,   12,   false,  1.0f)                                           \
+	X(PD_YPOS,   12,   false,  1.0f)                                           \
+	X(PD_YNEG,   12,   false,  1.0f)                                           \
+	X(PD_ZPOS,   12,   false,  1.0f)                                           \
+	X(PD_ZNEG,   12,   false,  1.0f)
+
+/**
+ * @brief      Index of each heartbeat field
+ */
+enum HeartbeatField : uint8_t
+{
+#define HEARTBEAT_ENUM(id, bits, is_signed, scale) HB_##id,
+	HEARTBEAT_FIELDS(HEARTBEAT_ENUM)
+#undef HEARTBEAT_ENUM
+	HB_NUM_FIELDS
+};
+
+#define HEARTBEAT_SPEC(id, bits, is_signed, scale) {#id, bits, is_signed, scale},
+static const FieldSpec heartbeat_schema[HB_NUM_FIELDS] = {HEARTBEAT_FIELDS(HEARTBEAT_SPEC)};
+#undef HEARTBEAT_SPEC
+
+#define HEARTBEAT_WIDTH(id, bits, is_signed, scale) bits,
+constexpr uint8_t heartbeat_bits[HB_NUM_FIELDS] = {HEARTBEAT_FIELDS(HEARTBEAT_WIDTH)};
+#undef HEARTBEAT_WIDTH
+
+/**
+ * @brief      Bit offset of a field, HB_NUM_FIELDS gives the payload size
+ */
+constexpr uint16_t heartbeatOffset(uint8_t field)
+{
+	return field == 0 ? 0 : heartbeatOffset(field - 1) + heartbeat_bits[field - 1];
+}
+
+#define HEARTBEAT_OFFSET(id, bits, is_signed, scale) heartbeatOffset(HB_##id),
+constexpr uint16_t heartbeat_offsets[HB_NUM_FIELDS] = {HEARTBEAT_FIELDS(HEARTBEAT_OFFSET)};
+#undef HEARTBEAT_OFFSET
+
+// packed payload and CRC, in bytes
+#define HEARTBEAT_PAYLOAD_LEN ((heartbeatOffset(HB_NUM_FIELDS) + 7) / 8)
+#define HEARTBEAT_LEN (HEARTBEAT_PAYLOAD_LEN + 2)
+
+static_assert(heartbeatOffset(HB_STATUS) == 0 && heartbeat_bits[HB_STATUS] == 8, "status must be the first byte");
+
+/**
+ * @brief      Unpack every field of a heartbeat, same as unpackFields with
+ *             heartbeat_schema but with the offsets fixed at compile time
+ *
+ * @param[in]  packet  Packed fields
+ * @param[out] values  Receives HB_NUM_FIELDS raw values
+ */
+inline void unpackHeartbeat(const uint8_t *packet, int32_t *values)
+{
+#define HEARTBEAT_UNPACK(id, bits, is_signed, scale) \
+	values[HB_##id] = unpackFieldAt<heartbeat_offsets[HB_##id], bits, is_signed>(packet);
+	HEARTBEAT_FIELDS(HEARTBEAT_UNPACK)
+#undef HEARTBEAT_UNPACK
+}
+
+/**
+ * @brief      Check the CRC of a heartbeat and unpack its fields
+ *
+ * @param[in]  packet  HEARTBEAT_LEN bytes
+ * @param[out] values  Receives HB_NUM_FIELDS raw values
+ *
+ * @return     False if the CRC does not match, values are unpacked anyway
+ */
+inline bool decodeHeartbeat(const uint8_t *packet, int32_t *values)
+{
+	unpackHeartbeat(packet, values);
+
+	CRC16 crcGen;
+	crcGen.add(packet, HEARTBEAT_PAYLOAD_LEN);
+	return crcGen.getCRC() == (packet[HEARTBEAT_PAYLOAD_LEN] | ((uint16_t)packet[HEARTBEAT_PAYLOAD_LEN + 1] << 8));
+}
+
+/**
+ * @brief      Raw field value in physical units
+ */
+inline float heartbeatValue(const int32_t *values, HeartbeatField field)
+{
+	return values[field] * heartbeat_schema[field].scale;
+}
+
+#endif
@@ -0,0 +1,255 @@
+/**
+ * @brief      Queue of I2C transfers run from the interrupts of the bus master.
+ * @details    A task describes a transfer, an optional write followed by an
+ *             optional read after a repeated start, and submits it. The bus
+ *             runs the queued transfers one after the other in the order they
+ *             were submitted, so devices of several tasks share one master
+ *             without a lock, and nobody waits on the bus while a transfer of
+ *             another device is on it. Each interrupt of the master moves the
+ *             transfer on by one byte through event(), which returns the
+ *             transfer once it is finished so the interrupt handler can wake
+ *             whoever waits for it. The CPU is free while the bytes are on the
+ *             bus.
+ *
+ *             The master works through
+ *
+ *               void start(uint8_t addr, bool read);   start or repeated start
+ *                                                      and the address byte
+ *               void write(uint8_t data);              next byte of a write
+ *               uint8_t read(bool last);               the byte received, then
+ *                                                      ack for another or nack
+ *                                                      and stop after the last
+ *               void stop(void);                       stop after a write
+ *               void reset(void);                      abandon the transfer
+ *
+ *             and reports I2C_EVENT_ACK or I2C_EVENT_NACK once the address or
+ *             a written byte is on the bus, I2C_EVENT_DATA once a byte was
+ *             received, and I2C_EVENT_ERROR for a bus error or lost
+ *             arbitration.
+ *
+ *             submit(), cancel() and event() must not interrupt each other:
+ *             call the first two with the interrupts of the master masked.
+ */
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief      What the master reports from its interrupt
+ */
+enum I2CEvent : uint8_t
+{
+	I2C_EVENT_NONE = 0,	 // nothing for the bus, e.g. a spurious interrupt
+	I2C_EVENT_ACK = 1,	 // address or written byte acknowledged
+	I2C_EVENT_NACK = 2,	 // address or written byte not acknowledged
+	I2C_EVENT_DATA = 3,	 // a byte was received
+	I2C_EVENT_ERROR = 4, // bus error or arbitration lost
+};
+
+/**
+ * @brief      Outcome of a transfer
+ */
+enum I2CStatus : uint8_t
+{
+	I2C_PENDING = 0,   // queued or on the bus
+	I2C_OK = 1,		   // every byte written and read
+	I2C_NACK = 2,	   // the device did not acknowledge, no such device or busy
+	I2C_ERROR = 3,	   // bus error, the master was reset
+	I2C_CANCELLED = 4, // taken off the queue by cancel()
+};
+
+/**
+ * @brief      One transfer, owned by the submitter until it is finished
+ */
+typedef struct I2CTransfer
+{
+	uint8_t addr;		// 7 bit address
+	const uint8_t *tx;	// written first, e.g. the register address
+	uint16_t tx_len;
+	uint8_t *rx;		// then read after a repeated start
+	uint16_t rx_len;
+	void *context;		// for the submitter, e.g. what to wake when finished
+	volatile I2CStatus status;
+	struct I2CTransfer *next;
+} I2CTransfer;
+
+/**
+ * @brief      The transfer queue of one bus master
+ *
+ * @tparam     Master  The master, see above
+ */
+template <class Master>
+class I2CBus
+{
+private:
+	Master &_master;
+
+	// _head is on the bus, the others wait behind it
+	I2CTransfer *_head;
+	I2CTransfer *_tail;
+
+	uint16_t _pos;	// next byte of the head
+	bool _reading;	// the head is past its repeated start
+
+	uint32_t _completed;
+	uint32_t _failed;
+
+	void begin(void)
+	{
+		_pos = 0;
+		_reading = _head->tx_len == 0 && _head->rx_len > 0;
+		_master.start(_head->addr, _reading);
+	}
+
+	/**
+	 * @brief      Take the head off the queue and start the next one
+	 */
+	I2CTransfer *finish(I2CStatus status)
+	{
+		I2CTransfer *t = _head;
+
+		_head = t->next;
+		if (_head == NULL)
+			_tail = NULL;
+		t->next = NULL;
+
+		if (status == I2C_OK)
+			_completed++;
+		else
+			_failed++;
+		t->status = status;
+
+		if (_head != NULL)
+			begin();
+		return t;
+	}
+
+public:
+	I2CBus(Master &master) : _master(master), _head(NULL), _tail(NULL), _pos(0), _reading(false),
+							 _completed(0), _failed(0) {}
+
+	/**
+	 * @brief      Queue a transfer, it starts right away if the bus is idle
+	 *
+	 * @param      t     The transfer, left alone by the caller until its
+	 *                   status is no longer I2C_PENDING
+	 */
+	void submit(I2CTransfer *t)
+	{
+		t->status = I2C_PENDING;
+		t->next = NULL;
+
+		if (_tail != NULL)
+			_tail->next = t;
+		else
+			_head = t;
+		_tail = t;
+
+		if (_head == t)
+			begin();
+	}
+
+	/**
+	 * @brief      Take a transfer off the queue before it finished, e.g. after
+	 *             a timeout. Resets the master if it is on the bus.
+	 *
+	 * @param      t     The transfer
+	 *
+	 * @return     True if it was still queued, False if it had finished
+	 */
+	bool cancel(I2CTransfer *t)
+	{
+		if (t == _head)
+		{
+			_master.reset();
+			finish(I2C_CANCELLED);
+			return true;
+		}
+
+		for (I2CTransfer *prev = _head; prev != NULL; prev = prev->next)
+		{
+			if (prev->next == t)
+			{
+				prev->next = t->next;
+				if (_tail == t)
+					_tail = prev;
+				t->next = NULL;
+				t->status = I2C_CANCELLED;
+				_failed++;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * @brief      Move the transfer on the bus along, from the interrupt of the
+	 *             master
+	 *
+	 * @param[in]  e     What the master reported
+	 *
+	 * @return     The transfer that finished with this event, NULL if none did
+	 */
+	I2CTransfer *event(I2CEvent e)
+	{
+		I2CTransfer *t = _head;
+
+		if (t == NULL || e == I2C_EVENT_NONE)
+			return NULL;
+
+		switch (e)
+		{
+		case I2C_EVENT_ACK:
+			if (_reading)
+				break; // the master reports a read address with its first byte
+
+			if (_pos < t->tx_len)
+			{
+				_master.write(t->tx[_pos++]);
+				return NULL;
+			}
+			if (t->rx_len > 0)
+			{
+				_pos = 0;
+				_reading = true;
+				_master.start(t->addr, true);
+				return NULL;
+			}
+
+			_master.stop();
+			return finish(I2C_OK);
+
+		case I2C_EVENT_NACK:
+			_master.stop();
+			return finish(I2C_NACK);
+
+		case I2C_EVENT_DATA:
+			if (!_reading || _pos >= t->rx_len)
+				break;
+
+			t->rx[_pos] = _master.read(_pos + 1 == t->rx_len);
+			_pos++;
+			return _pos == t->rx_len ? finish(I2C_OK) : NULL;
+
+		default:
+			break;
+		}
+
+		// an error, or an event that does not fit the transfer
+		_master.reset();
+		return finish(I2C_ERROR);
+	}
+
+	/**
+	 * @brief      True while a transfer is queued or on the bus
+	 */
+	bool busy(void) const { return _head != NULL; }
+
+	uint32_t completed(void) const { return _completed; }
+	uint32_t failed(void) const { return _failed; }
+};
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ * @brief      Burst reads of the ICM-20948 FIFO.
+ * @details    With the accelerometer and gyroscope enabled in FIFO_EN_2, the
+ *             IMU writes every sample to its FIFO as a 12 byte frame:
+ *             accelerometer X, Y, Z then gyroscope X, Y, Z, each big endian.
+ *             ICMFifoReader reads the FIFO count and then every whole frame in
+ *             it in one transfer, up to ICM_FIFO_MAX_BURST, so the bus cost of
+ *             a sample shrinks with the number of samples per burst.
+ *
+ *             The reader works through any bus with
+ *
+ *               bool read(uint8_t reg, uint8_t *data, uint16_t len);
+ *               bool write(uint8_t reg, const uint8_t *data, uint16_t len);
+ *
+ *             each call one transfer to the IMU with register bank 0 selected.
+ *             The FIFO is expected in snapshot mode, which stops writing when
+ *             it is full instead of overwriting part of a frame. A full FIFO
+ *             has lost samples, the reader resets it and starts over.
+ *
+ *             The IMU does not timestamp the samples. ICMFifoClock spaces the
+ *             samples of a burst by the sample period and keeps the newest
+ *             one within the period before the read, so the times are evenly
+ *             spaced and at most one period off although the clocks of the
+ *             IMU and the MCU drift apart.
+ */
+#ifndef ICM_FIFO_H
+#define ICM_FIFO_H
+
+#include <stdint.h>
+
+// bank 0 registers
+#define ICM_FIFO_EN_2 0x67
+#define ICM_FIFO_RST 0x68
+#define ICM_FIFO_COUNTH 0x70
+#define ICM_FIFO_R_W 0x72
+
+// FIFO_EN_2 with the accelerometer and the three gyroscope axes
+#define ICM_FIFO_EN_2_ACCEL_GYRO 0x1e
+
+#define ICM_FIFO_SIZE 512
+#define ICM_FIFO_FRAME_LEN 12
+
+// frames read at once, the SparkFun driver reads at most 255 bytes
+#define ICM_FIFO_MAX_BURST (255 / ICM_FIFO_FRAME_LEN)
+
+/**
+ * @brief      One sample from the FIFO, raw counts
+ */
+typedef struct
+{
+	int16_t accel[3];
+	int16_t gyro[3];
+	uint32_t t_us; // when the IMU took it, on the clock given to the reader
+} ICMFifoSample;
+
+/**
+ * @brief      Splits frames read from the FIFO into samples
+ *
+ * @param[in]  data     The frames
+ * @param[in]  frames   Number of frames
+ * @param      samples  Filled with frames samples, timestamps untouched
+ */
+inline void parseICMFifo(const uint8_t *data, uint8_t frames, ICMFifoSample *samples)
+{
+	for (uint8_t i = 0; i < frames; i++, data += ICM_FIFO_FRAME_LEN)
+	{
+		for (uint8_t axis = 0; axis < 3; axis++)
+		{
+			samples[i].accel[axis] = (int16_t)((data[2 * axis] << 8) | data[2 * axis + 1]);
+			samples[i].gyro[axis] = (int16_t)((data[6 + 2 * axis] << 8) | data[7 + 2 * axis]);
+		}
+	}
+}
+
+/**
+ * @brief      Timestamps of the samples in a burst
+ */
+class ICMFifoClock
+{
+private:
+	uint32_t _period_us;
+	uint32_t _last_us; // time of the newest sample stamped so far
+	bool _valid;
+
+public:
+	ICMFifoClock(uint32_t period_us) : _period_us(period_us), _last_us(0), _valid(false) {}
+
+	/**
+	 * @brief      Forget the previous samples, after samples were lost
+	 */
+	void reset() { _valid = false; }
+
+	/**
+	 * @brief      Timestamp the samples of a burst, oldest first
+	 *
+	 * @param      samples  The samples
+	 * @param[in]  n        Number of samples
+	 * @param[in]  now_us   Time just before the FIFO count was read
+	 * @param[in]  behind   Samples left in the FIFO after these, taken later
+	 */
+	void stamp(ICMFifoSample *samples, uint8_t n, uint32_t now_us, uint16_t behind)
+	{
+		if (n == 0)
+			return;
+
+		// the newest sample was taken in the period before the latest time it
+		// can have been taken
+		uint32_t latest = now_us - behind * _period_us;
+		uint32_t newest = _valid ? _last_us + n * _period_us : latest;
+
+		if ((int32_t)(newest - latest) > 0)
+			newest = latest;
+		else if (latest - newest >= _period_us)
+			newest = latest - _period_us + 1;
+
+		for (uint8_t i = 0; i < n; i++)
+			samples[i].t_us = newest - (uint32_t)(n - 1 - i) * _period_us;
+
+		_last_us = newest;
+		_valid = true;
+	}
+};
+
+/**
+ * @brief      Reads the samples in the FIFO in bursts
+ *
+ * @tparam     Bus   Register access to the IMU, see above
+ */
+template <class Bus>
+class ICMFifoReader
+{
+private:
+	Bus &_bus;
+	ICMFifoClock _clock;
+	uint32_t _overflows;
+
+public:
+	/**
+	 * @param      bus        The bus
+	 * @param[in]  period_us  Sample period set by the sample rate divider
+	 */
+	ICMFifoReader(Bus &bus, uint32_t period_us) : _bus(bus), _clock(period_us), _overflows(0) {}
+
+	/**
+	 * @brief      Empty the FIFO, the samples after it are not related to the
+	 *             ones before. Call when the IMU starts sampling again.
+	 */
+	void reset()
+	{
+		// the InvenSense examples assert the reset and release it again
+		const uint8_t assert_rst = 0x1f;
+		const uint8_t release_rst = 0x1e;
+
+		_bus.write(ICM_FIFO_RST, &assert_rst, 1);
+		_bus.write(ICM_FIFO_RST, &release_rst, 1);
+		_clock.reset();
+	}
+
+	/**
+	 * @brief      Read the whole frames in the FIFO, two transfers
+	 *
+	 * @param      samples  Filled with the samples, oldest first
+	 * @param[in]  max      Room in samples
+	 * @param[in]  now_us   Time just before the call
+	 *
+	 * @return     Number of samples read, 0 when the FIFO was empty, full or a
+	 *             transfer failed
+	 */
+	uint8_t read(ICMFifoSample *samples, uint8_t max, uint32_t now_us)
+	{
+		uint8_t count_regs[2];
+
+		if (!_bus.read(ICM_FIFO_COUNTH, count_regs, 2))
+			return 0;
+
+		uint16_t count = ((count_regs[0] & 0x1f) << 8) | count_regs[1];
+		if (count > ICM_FIFO_SIZE - ICM_FIFO_FRAME_LEN)
+		{
+			_overflows++;
+			reset();
+			return 0;
+		}
+
+		uint16_t frames = count / ICM_FIFO_FRAME_LEN;
+		uint8_t n = frames < max ? frames : max;
+		if (n > ICM_FIFO_MAX_BURST)
+			n = ICM_FIFO_MAX_BURST;
+		if (n == 0)
+			return 0;
+
+		uint8_t data[ICM_FIFO_MAX_BURST * ICM_FIFO_FRAME_LEN];
+		if (!_bus.read(ICM_FIFO_R_W, data, n * ICM_FIFO_FRAME_LEN))
+		{
+			// part of a frame may be gone, the rest would be misaligned
+			reset();
+			return 0;
+		}
+
+		parseICMFifo(data, n, samples);
+		_clock.stamp(samples, n, now_us, frames - n);
+		return n;
+	}
+
+	/**
+	 * @brief      Times the FIFO filled up and samples were lost
+	 */
+	uint32_t overflows() const { return _overflows; }
+};
+
+#endif
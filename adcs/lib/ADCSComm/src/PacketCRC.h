@@ -0,0 +1,189 @@
+/**
+ * @brief      CRC16 of a fixed length packet, maintained incrementally.
+ * @details    The packet CRC is linear: for two packets of equal length
+ *             crc(A) ^ crc(B) = crc0(A ^ B), where crc0 is the same CRC with a
+ *             zero start value. When a field changes, the CRC is patched with
+ *             crc0 of the changed bytes shifted to their position, instead of
+ *             running the whole packet through CRC16 again. The shift over the
+ *             trailing bytes is a multiplication by x^(8 * bytes) modulo the
+ *             polynome, so a patch costs a few table lookups plus one 16 step
+ *             multiply no matter where the field sits. A packet that has not
+ *             changed since the last update costs no CRC work at all.
+ *
+ *             The caller marks the byte ranges it writes with markDirty().
+ *             Writes that are not marked are not seen by update().
+ */
+#ifndef PACKET_CRC_H
+#define PACKET_CRC_H
+
+#include <stdint.h>
+#include <string.h>
+#include <CRC16.h>
+#include <CRCTemplate.h>
+
+template <uint8_t LEN>
+class PacketCRC
+{
+	static_assert(LEN > 0 && LEN <= 32, "dirty mask covers at most 32 bytes");
+
+private:
+	// same parameters as the CRC16 class defaults, see TEScommand::checkCRC
+	typedef Crc<16, CRC16_DEFAULT_POLYNOME> crc_type;
+	typedef crc_type::engine engine;
+
+	// x^(8 * m) mod polynome, m = 0 .. LEN
+	template <typename = typename crc_detail::MakeIndices<LEN + 1>::type>
+	struct Powers;
+
+	template <uint16_t... M>
+	struct Powers<crc_detail::Indices<M...> >
+	{
+		static constexpr uint16_t power(uint16_t m)
+		{
+			return m == 0 ? 1 : (uint16_t)crc_detail::zeroByte(power(m - 1), engine::POLY, 16, false);
+		}
+
+		static constexpr uint16_t table[LEN + 1] = {power(M)...};
+	};
+
+	// bytes the current CRC was computed over
+	uint8_t _shadow[LEN];
+
+	// one bit per byte written since the last update
+	uint32_t _dirty;
+
+	// CRC16 of _shadow
+	uint16_t _crc;
+
+	// bytes run through the CRC engine since construction
+	uint32_t _work;
+
+	/**
+	 * @brief      Multiply a by b modulo the polynome, bit by bit
+	 */
+	static uint16_t multiply(uint16_t a, uint16_t b)
+	{
+		uint16_t r = 0;
+
+		for (uint16_t bit = 0x8000; bit != 0; bit >>= 1)
+		{
+			r = (r & 0x8000) ? (uint16_t)((r << 1) ^ engine::POLY) : (uint16_t)(r << 1);
+			if (a & bit)
+				r ^= b;
+		}
+
+		return r;
+	}
+
+public:
+	/**
+	 * @brief      Starts out as the CRC of LEN zero bytes
+	 */
+	PacketCRC()
+	{
+		memset(_shadow, 0, LEN);
+		_dirty = 0;
+		_crc = crc_type::calculate(_shadow, LEN);
+		_work = LEN;
+	}
+
+	/**
+	 * @brief      Mark bytes as written. Bytes at or beyond LEN are ignored.
+	 *
+	 * @param[in]  offset  First byte written
+	 * @param[in]  size    Number of bytes written
+	 */
+	void markDirty(uint8_t offset, uint8_t size)
+	{
+		if (offset >= LEN)
+			return;
+		if (size > LEN - offset)
+			size = LEN - offset;
+
+		uint32_t bits = (size >= 32) ? 0xFFFFFFFF : ((1UL << size) - 1);
+		_dirty |= bits << offset;
+	}
+
+	/**
+	 * @brief      Bring the CRC up to date with the marked bytes of data
+	 *
+	 * @param[in]  data  The packet, LEN bytes covered by the CRC
+	 *
+	 * @return     CRC16 of the first LEN bytes of data
+	 */
+	uint16_t update(const uint8_t *data)
+	{
+		while (_dirty != 0)
+		{
+			// next run of consecutive dirty bytes [first, last)
+			uint8_t first = __builtin_ctz(_dirty);
+			uint32_t rest = ~(_dirty >> first);
+			uint8_t last = (rest == 0) ? 32 : first + __builtin_ctz(rest);
+			if (last > LEN)
+				last = LEN;
+
+			_dirty &= (last >= 32) ? 0 : (0xFFFFFFFF << last);
+
+			uint8_t delta[LEN];
+			for (uint8_t i = first; i < last; i++)
+			{
+				delta[i] = data[i] ^ _shadow[i];
+				_shadow[i] = data[i];
+			}
+
+			// only the span that actually changed, e.g. after a clear() most of
+			// the packet is marked but rewritten with the same values
+			while (first < last && delta[first] == 0)
+				first++;
+			while (last > first && delta[last - 1] == 0)
+				last--;
+
+			if (first == last)
+				continue;
+
+			uint16_t patch = engine::update(0, delta + first, last - first);
+			_crc ^= multiply(patch, Powers<>::table[LEN - last]);
+			_work += last - first;
+		}
+
+		return _crc;
+	}
+
+	/**
+	 * @brief      Forget the marked bytes and recompute the CRC over all of data
+	 *
+	 * @param[in]  data  The packet, LEN bytes covered by the CRC
+	 *
+	 * @return     CRC16 of the first LEN bytes of data
+	 */
+	uint16_t recompute(const uint8_t *data)
+	{
+		memcpy(_shadow, data, LEN);
+		_dirty = 0;
+		_crc = crc_type::calculate(_shadow, LEN);
+		_work += LEN;
+		return _crc;
+	}
+
+	/**
+	 * @brief      CRC as of the last update, marked bytes are not included
+	 */
+	uint16_t crc() const { return _crc; }
+
+	/**
+	 * @brief      Check if bytes were marked since the last update
+	 */
+	bool dirty() const { return _dirty != 0; }
+
+	/**
+	 * @brief      Bytes run through the CRC engine since construction, to
+	 *             measure how much work the incremental updates save
+	 */
+	uint32_t work() const { return _work; }
+};
+
+template <uint8_t LEN>
+template <uint16_t... M>
+constexpr uint16_t PacketCRC<LEN>::Powers<crc_detail::Indices<M...> >::table[LEN + 1];
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * @brief      Fixed pool of transmit buffers shared by several producer tasks
+ *             and one transmitter.
+ * @details    A producer acquires a free buffer, fills it in place and commits
+ *             it. The transmitter, typically the UART interrupt, takes committed
+ *             buffers in commit order and hands each back with complete() once
+ *             its last byte is on the wire. No call ever waits: acquire()
+ *             returns NULL when every buffer is in use and the caller decides
+ *             whether to drop the packet.
+ *
+ *             Every buffer has its own state, changed with atomic operations,
+ *             so producers do not need a mutex and the transmitter can run in
+ *             an interrupt handler. Packets committed by one producer are sent
+ *             in order; packets of different producers are ordered by the time
+ *             they were committed.
+ */
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief      Life cycle of a buffer in the pool
+ */
+enum BufferState : uint8_t
+{
+	BUFFER_FREE = 0,	// available to acquire()
+	BUFFER_FILLING = 1, // owned by a producer
+	BUFFER_QUEUED = 2,	// committed, waiting for the transmitter
+	BUFFER_SENDING = 3, // being transmitted
+};
+
+template <uint8_t N, uint8_t LEN>
+class PacketPool
+{
+	static_assert(N > 0, "pool needs at least one buffer");
+
+private:
+	typedef struct
+	{
+		uint8_t data[LEN];
+		uint8_t len;
+		uint32_t seq;	   // commit order
+		void *owner;	   // handed back by complete(), e.g. a task to notify
+		std::atomic<uint8_t> state;
+	} Buffer;
+
+	Buffer _buffers[N];
+
+	// next commit sequence number
+	std::atomic<uint32_t> _seq;
+
+	// buffer being transmitted, N when idle. Transmitter only.
+	uint8_t _sending;
+
+	std::atomic<uint32_t> _sent;
+	std::atomic<uint32_t> _dropped;
+
+	Buffer *find(const uint8_t *data)
+	{
+		for (uint8_t i = 0; i < N; i++)
+		{
+			if (_buffers[i].data == data)
+				return &_buffers[i];
+		}
+
+		return NULL;
+	}
+
+public:
+	PacketPool() : _seq(0), _sending(N), _sent(0), _dropped(0)
+	{
+		for (uint8_t i = 0; i < N; i++)
+			_buffers[i].state.store(BUFFER_FREE, std::memory_order_relaxed);
+	}
+
+	/* PRODUCER SIDE ======================================================== */
+
+	/**
+	 * @brief      Take a free buffer to fill in place
+	 *
+	 * @return     LEN bytes to fill, NULL if all buffers are in use. A NULL
+	 *             return is counted in dropped().
+	 */
+	uint8_t *acquire()
+	{
+		for (uint8_t i = 0; i < N; i++)
+		{
+			uint8_t expected = BUFFER_FREE;
+			if (_buffers[i].state.compare_exchange_strong(expected, BUFFER_FILLING, std::memory_order_acquire))
+				return _buffers[i].data;
+		}
+
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	/**
+	 * @brief      Queue a filled buffer for transmission
+	 *
+	 * @param      data   Buffer returned by acquire()
+	 * @param[in]  len    Number of bytes to send, at most LEN
+	 * @param      owner  Handed back by complete() when the buffer is sent
+	 */
+	void commit(uint8_t *data, uint8_t len, void *owner = NULL)
+	{
+		Buffer *b = find(data);
+		if (b == NULL)
+			return;
+
+		b->len = len > LEN ? LEN : len;
+		b->owner = owner;
+		b->seq = _seq.fetch_add(1, std::memory_order_relaxed);
+		b->state.store(BUFFER_QUEUED, std::memory_order_release);
+	}
+
+	/**
+	 * @brief      Give back a buffer without sending it
+	 *
+	 * @param      data  Buffer returned by acquire()
+	 */
+	void release(uint8_t *data)
+	{
+		Buffer *b = find(data);
+		if (b != NULL)
+			b->state.store(BUFFER_FREE, std::memory_order_release);
+	}
+
+	/* TRANSMITTER SIDE ===================================================== */
+
+	/**
+	 * @brief      Start sending the oldest committed buffer. Only call from the
+	 *             transmitter, and only after the previous buffer completed.
+	 *
+	 * @param[out] len   Number of bytes to send
+	 *
+	 * @return     The bytes to send, NULL if nothing is queued
+	 */
+	const uint8_t *next(uint8_t &len)
+	{
+		uint8_t oldest = N;
+
+		for (uint8_t i = 0; i < N; i++)
+		{
+			if (_buffers[i].state.load(std::memory_order_acquire) != BUFFER_QUEUED)
+				continue;
+
+			if (oldest == N || (int32_t)(_buffers[i].seq - _buffers[oldest].seq) < 0)
+				oldest = i;
+		}
+
+		if (oldest == N)
+			return NULL;
+
+		_sending = oldest;
+		_buffers[oldest].state.store(BUFFER_SENDING, std::memory_order_relaxed);
+		len = _buffers[oldest].len;
+		return _buffers[oldest].data;
+	}
+
+	/**
+	 * @brief      Free the buffer returned by the last next() call. Only call
+	 *             from the transmitter.
+	 *
+	 * @return     The owner given to commit(), NULL if there is none
+	 */
+	void *complete()
+	{
+		if (_sending == N)
+			return NULL;
+
+		Buffer *b = &_buffers[_sending];
+		void *owner = b->owner;
+
+		_sending = N;
+		_sent.fetch_add(1, std::memory_order_relaxed);
+		b->state.store(BUFFER_FREE, std::memory_order_release);
+		return owner;
+	}
+
+	/* STATISTICS =========================================================== */
+
+	/**
+	 * @brief      Number of buffers acquired, queued or being sent
+	 */
+	uint8_t busy() const
+	{
+		uint8_t n = 0;
+
+		for (uint8_t i = 0; i < N; i++)
+		{
+			if (_buffers[i].state.load(std::memory_order_relaxed) != BUFFER_FREE)
+				n++;
+		}
+
+		return n;
+	}
+
+	uint32_t sent() const { return _sent.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief      Number of acquire() calls that found no free buffer
+	 */
+	uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,264 @@
+/**
+ * @brief      Timing statistics of a periodic task.
+ * @details    A periodic task is released once per period on a fixed schedule
+ *             and has to finish its work within its deadline. For every period
+ *             PeriodStats records the release jitter, how long after the ideal
+ *             release time the task actually started, and the execution time,
+ *             from the release to the end of the work. Both go into
+ *             histograms with power of two bins, and a period that ends later
+ *             than the deadline after its ideal release counts as a miss.
+ *
+ *             Times are in microseconds from a free running counter, so
+ *             wrapping around is harmless.
+ *
+ *             The statistics of one task are sent in a report frame, multi-byte
+ *             values little endian:
+ *
+ *               0       PERIOD_FRAME_ID
+ *               1       frame length in bytes, including the CRC
+ *               2       task id
+ *               3..6    period in us
+ *               7..10   deadline in us
+ *               11..14  number of periods
+ *               15..18  number of deadline misses
+ *               19..22  largest release jitter in us
+ *               23..26  largest execution time in us
+ *               27..    PERIOD_HIST_BINS uint16 jitter counts, then
+ *                       PERIOD_HIST_BINS uint16 execution time counts
+ *               last 2  CRC16 of all bytes before it, same as the commands
+ */
+#ifndef PERIOD_STATS_H
+#define PERIOD_STATS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <CRC16.h>
+
+// first byte of a timing report frame, never used as a heartbeat status code
+#define PERIOD_FRAME_ID 0x5c
+
+// bin 0 counts times below PERIOD_HIST_MIN_US, bin i times from
+// PERIOD_HIST_MIN_US << (i - 1) up to twice that, the last bin everything above
+#define PERIOD_HIST_BINS 12
+#define PERIOD_HIST_MIN_US 16
+
+#define PERIOD_HEADER_LEN 27
+#define PERIOD_FRAME_LEN (PERIOD_HEADER_LEN + 4 * PERIOD_HIST_BINS + 2)
+
+/**
+ * @brief      Histogram bin of a time
+ */
+inline uint8_t periodBin(uint32_t us)
+{
+	uint8_t bin = 0;
+
+	for (uint32_t limit = PERIOD_HIST_MIN_US; us >= limit && bin < PERIOD_HIST_BINS - 1; limit <<= 1)
+		bin++;
+
+	return bin;
+}
+
+class PeriodStats
+{
+private:
+	uint32_t _period_us;
+	uint32_t _deadline_us;
+
+	uint32_t _ideal;   // ideal release time of the current period
+	uint32_t _release; // actual release time of the current period
+	bool _anchored;	   // _ideal follows a schedule started with restart
+	bool _running;	   // released and not yet completed
+
+	uint32_t _periods;
+	uint32_t _misses;
+	uint32_t _max_jitter;
+	uint32_t _max_exec;
+	uint16_t _jitter_hist[PERIOD_HIST_BINS];
+	uint16_t _exec_hist[PERIOD_HIST_BINS];
+
+	static void count(uint16_t *hist, uint32_t us)
+	{
+		uint16_t &n = hist[periodBin(us)];
+		if (n != 0xffff)
+			n++;
+	}
+
+	static void put32(uint8_t *p, uint32_t v)
+	{
+		p[0] = v & 0xff;
+		p[1] = (v >> 8) & 0xff;
+		p[2] = (v >> 16) & 0xff;
+		p[3] = v >> 24;
+	}
+
+	static uint32_t get32(const uint8_t *p)
+	{
+		return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+public:
+	/**
+	 * @param[in]  period_us    Release period
+	 * @param[in]  deadline_us  Time after the ideal release by which the work
+	 *                          of a period must be done
+	 */
+	PeriodStats(uint32_t period_us = 0, uint32_t deadline_us = 0)
+		: _period_us(period_us), _deadline_us(deadline_us), _ideal(0), _release(0), _anchored(false), _running(false)
+	{
+		reset();
+	}
+
+	/**
+	 * @brief      Clear the statistics, the schedule is kept
+	 */
+	void reset()
+	{
+		_periods = 0;
+		_misses = 0;
+		_max_jitter = 0;
+		_max_exec = 0;
+		memset(_jitter_hist, 0, sizeof(_jitter_hist));
+		memset(_exec_hist, 0, sizeof(_exec_hist));
+	}
+
+	/**
+	 * @brief      Start a new schedule, the next period is ideally released one
+	 *             period after now
+	 */
+	void restart(uint32_t now_us)
+	{
+		_ideal = now_us;
+		_anchored = true;
+		_running = false;
+	}
+
+	/**
+	 * @brief      The task was released for its next period
+	 */
+	void release(uint32_t now_us)
+	{
+		if (!_anchored)
+			restart(now_us - _period_us);
+
+		_ideal += _period_us;
+		_release = now_us;
+		_running = true;
+
+		// a release a little early only means the two clocks disagree
+		int32_t late = (int32_t)(now_us - _ideal);
+		uint32_t jitter = late > 0 ? (uint32_t)late : 0;
+
+		count(_jitter_hist, jitter);
+		if (jitter > _max_jitter)
+			_max_jitter = jitter;
+	}
+
+	/**
+	 * @brief      The task finished the work of the current period
+	 */
+	void complete(uint32_t now_us)
+	{
+		if (!_running)
+			return;
+		_running = false;
+
+		uint32_t exec = now_us - _release;
+		count(_exec_hist, exec);
+		if (exec > _max_exec)
+			_max_exec = exec;
+
+		if (now_us - _ideal > _deadline_us)
+			_misses++;
+		_periods++;
+	}
+
+	uint32_t period() const { return _period_us; }
+	uint32_t deadline() const { return _deadline_us; }
+	uint32_t periods() const { return _periods; }
+	uint32_t misses() const { return _misses; }
+	uint32_t maxJitter() const { return _max_jitter; }
+	uint32_t maxExec() const { return _max_exec; }
+	const uint16_t *jitterHist() const { return _jitter_hist; }
+	const uint16_t *execHist() const { return _exec_hist; }
+
+	/**
+	 * @brief      Write the report frame
+	 *
+	 * @param[in]  id     Task id put in the frame
+	 * @param      frame  PERIOD_FRAME_LEN bytes
+	 *
+	 * @return     Length of the frame
+	 */
+	uint8_t encode(uint8_t id, uint8_t *frame) const
+	{
+		frame[0] = PERIOD_FRAME_ID;
+		frame[1] = PERIOD_FRAME_LEN;
+		frame[2] = id;
+		put32(frame + 3, _period_us);
+		put32(frame + 7, _deadline_us);
+		put32(frame + 11, _periods);
+		put32(frame + 15, _misses);
+		put32(frame + 19, _max_jitter);
+		put32(frame + 23, _max_exec);
+
+		uint8_t *p = frame + PERIOD_HEADER_LEN;
+		for (uint8_t i = 0; i < PERIOD_HIST_BINS; i++, p += 2)
+		{
+			p[0] = _jitter_hist[i] & 0xff;
+			p[1] = _jitter_hist[i] >> 8;
+		}
+		for (uint8_t i = 0; i < PERIOD_HIST_BINS; i++, p += 2)
+		{
+			p[0] = _exec_hist[i] & 0xff;
+			p[1] = _exec_hist[i] >> 8;
+		}
+
+		CRC16 crcGen;
+		crcGen.add(frame, PERIOD_FRAME_LEN - 2);
+		uint16_t crc = crcGen.getCRC();
+		p[0] = crc & 0xff;
+		p[1] = crc >> 8;
+
+		return PERIOD_FRAME_LEN;
+	}
+
+	/**
+	 * @brief      Read a report frame
+	 *
+	 * @param[in]  frame  The frame
+	 * @param[in]  len    Bytes available
+	 * @param[out] id     Task id in the frame
+	 *
+	 * @return     false if the frame is too short, malformed or fails its CRC
+	 */
+	bool decode(const uint8_t *frame, uint8_t len, uint8_t &id)
+	{
+		if (len < PERIOD_FRAME_LEN || frame[0] != PERIOD_FRAME_ID || frame[1] != PERIOD_FRAME_LEN)
+			return false;
+
+		CRC16 crcGen;
+		crcGen.add(frame, PERIOD_FRAME_LEN - 2);
+		if (crcGen.getCRC() != (frame[PERIOD_FRAME_LEN - 2] | ((uint16_t)frame[PERIOD_FRAME_LEN - 1] << 8)))
+			return false;
+
+		id = frame[2];
+		_period_us = get32(frame + 3);
+		_deadline_us = get32(frame + 7);
+		_periods = get32(frame + 11);
+		_misses = get32(frame + 15);
+		_max_jitter = get32(frame + 19);
+		_max_exec = get32(frame + 23);
+
+		const uint8_t *p = frame + PERIOD_HEADER_LEN;
+		for (uint8_t i = 0; i < PERIOD_HIST_BINS; i++, p += 2)
+			_jitter_hist[i] = p[0] | ((uint16_t)p[1] << 8);
+		for (uint8_t i = 0; i < PERIOD_HIST_BINS; i++, p += 2)
+			_exec_hist[i] = p[0] | ((uint16_t)p[1] << 8);
+
+		_anchored = false;
+		_running = false;
+		return true;
+	}
+};
+
+#endif
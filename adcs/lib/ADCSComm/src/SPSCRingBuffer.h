@@ -0,0 +1,93 @@
+/**
+ * @brief      Lock-free single producer, single consumer ring buffer.
+ * @details    Intended for handing data from an interrupt handler (producer) to
+ *             exactly one RTOS task (consumer) without disabling interrupts or
+ *             taking a mutex. The head index is only ever written by the
+ *             producer and the tail index only by the consumer, so each side
+ *             only needs acquire/release ordering on the other side's index.
+ */
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, uint16_t SIZE>
+class SPSCRingBuffer
+{
+	static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "SPSCRingBuffer size must be a power of two");
+
+private:
+	T _buf[SIZE];
+
+	// free running indices, wrapped with a mask when the buffer is accessed
+	std::atomic<uint16_t> _head; // next slot to write, owned by the producer
+	std::atomic<uint16_t> _tail; // next slot to read, owned by the consumer
+
+	// number of elements rejected because the buffer was full, producer only
+	std::atomic<uint32_t> _dropped;
+
+public:
+	SPSCRingBuffer() : _head(0), _tail(0), _dropped(0) {}
+
+	/**
+	 * @brief      Add an element to the buffer. Only call from the producer.
+	 *
+	 * @param[in]  v     Element to add
+	 *
+	 * @return     True if stored, False if the buffer was full and v was dropped
+	 */
+	bool push(const T &v)
+	{
+		uint16_t head = _head.load(std::memory_order_relaxed);
+
+		if ((uint16_t)(head - _tail.load(std::memory_order_acquire)) >= SIZE)
+		{
+			_dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		_buf[head & (SIZE - 1)] = v;
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief      Remove the oldest element from the buffer. Only call from the consumer.
+	 *
+	 * @param[out] v     Receives the element if one was available
+	 *
+	 * @return     True if an element was read, False if the buffer was empty
+	 */
+	bool pop(T &v)
+	{
+		uint16_t tail = _tail.load(std::memory_order_relaxed);
+
+		if (tail == _head.load(std::memory_order_acquire))
+			return false;
+
+		v = _buf[tail & (SIZE - 1)];
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief      Number of elements waiting to be read. Exact when called from
+	 *             the consumer, a lower bound otherwise.
+	 */
+	uint16_t available() const
+	{
+		return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+	}
+
+	bool empty() const { return available() == 0; }
+
+	uint16_t capacity() const { return SIZE; }
+
+	/**
+	 * @brief      Number of elements dropped by push() because the buffer was full
+	 */
+	uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,284 @@
+/**
+ * @brief      Batched multi-sample IMU telemetry frame.
+ * @details    The heartbeat carries one gyro/magnetometer snapshot every
+ *             500 ms. A batch frame carries every sample taken by readIMU in
+ *             between, sent next to the heartbeat. Consecutive samples differ
+ *             very little, so each channel is sent as the change from the
+ *             previous sample, zigzag encoded into a 1 to 3 byte varint.
+ *             Samples share one timestamp base and a nominal period, so a
+ *             sample taken on time costs a single byte of timing information.
+ *
+ *             Frame layout, multi-byte values little endian:
+ *
+ *               0       BATCH_FRAME_ID
+ *               1       frame length in bytes, including the CRC
+ *               2       number of samples
+ *               3       nominal sample period in ms
+ *               4..7    timestamp of the first sample in ms
+ *               8..19   first sample, BATCH_CHANNELS int16 values
+ *               ...     each later sample: varint (dt - period), then one
+ *                       varint delta per channel
+ *               last 2  CRC16 of all bytes before it, same as the commands
+ *
+ *             Values are int16 in BATCH_GYRO_LSB and BATCH_MAG_LSB units, see
+ *             batchQuantize.
+ */
+#ifndef SAMPLE_BATCH_H
+#define SAMPLE_BATCH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <CRC16.h>
+
+// first byte of a batch frame, never used as a heartbeat status code
+#define BATCH_FRAME_ID 0x5b
+
+#define BATCH_HEADER_LEN 8
+#define BATCH_CRC_LEN 2
+
+// gyro x, y, z followed by magnetometer x, y, z
+#define BATCH_CHANNELS 6
+
+// channel resolution, 1/16 dps covers the +-2000 dps range, 0.15 uT is the
+// magnetometer resolution
+#define BATCH_GYRO_LSB 0.0625f
+#define BATCH_MAG_LSB 0.15f
+
+// worst case encoded size of a sample
+#define BATCH_MAX_SAMPLE_LEN (5 + 3 * BATCH_CHANNELS)
+
+/**
+ * @brief      One gyro/magnetometer sample in BATCH_xxx_LSB units
+ */
+typedef struct
+{
+	int16_t v[BATCH_CHANNELS];
+} BatchSample;
+
+/**
+ * @brief      Round a float to the nearest multiple of lsb, saturated to int16
+ */
+inline int16_t batchQuantize(float value, float lsb)
+{
+	float q = value / lsb;
+	q += (q < 0) ? -0.5f : 0.5f;
+
+	if (q >= 32767.0f)
+		return 32767;
+	if (q <= -32768.0f)
+		return -32768;
+	return (int16_t)q;
+}
+
+inline uint32_t batchZigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline int32_t batchUnzigzag(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+template <uint8_t MAX_LEN>
+class SampleBatchEncoder
+{
+	static_assert(MAX_LEN >= BATCH_HEADER_LEN + 2 * BATCH_CHANNELS + BATCH_CRC_LEN, "frame must hold at least one sample");
+
+private:
+	uint8_t _frame[MAX_LEN];
+
+	// next free byte in _frame
+	uint8_t _len;
+
+	uint8_t _max_samples;
+
+	BatchSample _last;
+	uint32_t _last_ms;
+
+	static uint8_t putVarint(uint8_t *out, uint32_t v)
+	{
+		uint8_t n = 0;
+
+		while (v >= 0x80)
+		{
+			out[n++] = (uint8_t)(v | 0x80);
+			v >>= 7;
+		}
+		out[n++] = (uint8_t)v;
+
+		return n;
+	}
+
+public:
+	/**
+	 * @param[in]  max_samples  Close the frame after this many samples, even
+	 *                          if more would fit
+	 */
+	SampleBatchEncoder(uint8_t max_samples = 255) : _max_samples(max_samples)
+	{
+		begin(0);
+	}
+
+	/**
+	 * @brief      Start a new, empty frame
+	 *
+	 * @param[in]  period_ms  Nominal time between samples
+	 */
+	void begin(uint8_t period_ms)
+	{
+		_frame[0] = BATCH_FRAME_ID;
+		_frame[2] = 0;
+		_frame[3] = period_ms;
+		_len = BATCH_HEADER_LEN;
+	}
+
+	/**
+	 * @brief      Add a sample to the frame
+	 *
+	 * @param[in]  s     The sample
+	 * @param[in]  t_ms  Time the sample was taken
+	 *
+	 * @return     False if the sample does not fit, finish() the frame and
+	 *             begin() a new one
+	 */
+	bool add(const BatchSample &s, uint32_t t_ms)
+	{
+		if (_frame[2] >= _max_samples)
+			return false;
+
+		uint8_t sample[BATCH_MAX_SAMPLE_LEN];
+		uint8_t n = 0;
+
+		if (_frame[2] == 0)
+		{
+			for (uint8_t c = 0; c < BATCH_CHANNELS; c++)
+			{
+				sample[n++] = (uint8_t)s.v[c];
+				sample[n++] = (uint8_t)((uint16_t)s.v[c] >> 8);
+			}
+		}
+		else
+		{
+			n += putVarint(sample + n, batchZigzag((int32_t)(t_ms - _last_ms) - _frame[3]));
+			for (uint8_t c = 0; c < BATCH_CHANNELS; c++)
+				n += putVarint(sample + n, batchZigzag((int32_t)s.v[c] - _last.v[c]));
+		}
+
+		if (_len + n + BATCH_CRC_LEN > MAX_LEN)
+			return false;
+
+		if (_frame[2] == 0)
+			memcpy(_frame + 4, &t_ms, 4);
+
+		memcpy(_frame + _len, sample, n);
+		_len += n;
+		_frame[2]++;
+		_last = s;
+		_last_ms = t_ms;
+		return true;
+	}
+
+	/**
+	 * @brief      Check if no further sample can fit, not even one that
+	 *             is identical to the last
+	 */
+	bool full() const
+	{
+		return _frame[2] >= _max_samples || _len + 1 + BATCH_CHANNELS + BATCH_CRC_LEN > MAX_LEN;
+	}
+
+	uint8_t count() const { return _frame[2]; }
+
+	/**
+	 * @brief      Close the frame by adding its length and CRC
+	 *
+	 * @param[out] len   Length of the frame
+	 *
+	 * @return     The frame, valid until the next begin() or add()
+	 */
+	const uint8_t *finish(uint8_t &len)
+	{
+		_frame[1] = _len + BATCH_CRC_LEN;
+
+		CRC16 crcGen;
+		crcGen.add(_frame, _len);
+		uint16_t crc = crcGen.getCRC();
+		_frame[_len] = crc & 0xff;
+		_frame[_len + 1] = crc >> 8;
+
+		len = _frame[1];
+		return _frame;
+	}
+};
+
+/**
+ * @brief      Decode a batch frame
+ *
+ * @param[in]  frame        The frame
+ * @param[in]  len          Number of bytes available at frame
+ * @param[out] samples      Receives the samples
+ * @param[out] t_ms         Receives the timestamp of each sample
+ * @param[in]  max_samples  Size of samples and t_ms
+ *
+ * @return     Number of samples decoded, -1 if the frame is truncated, does not
+ *             match its CRC or holds more than max_samples samples
+ */
+inline int decodeSampleBatch(const uint8_t *frame, uint8_t len, BatchSample *samples, uint32_t *t_ms, uint8_t max_samples)
+{
+	if (len < BATCH_HEADER_LEN + BATCH_CRC_LEN || frame[0] != BATCH_FRAME_ID)
+		return -1;
+	if (frame[1] < BATCH_HEADER_LEN + BATCH_CRC_LEN || frame[1] > len)
+		return -1;
+
+	len = frame[1];
+	uint8_t n = frame[2];
+
+	CRC16 crcGen;
+	crcGen.add(frame, len - BATCH_CRC_LEN);
+	if (crcGen.getCRC() != (frame[len - 2] | ((uint16_t)frame[len - 1] << 8)))
+		return -1;
+
+	if (n > max_samples)
+		return -1;
+	if (n == 0)
+		return 0;
+
+	const uint8_t *p = frame + BATCH_HEADER_LEN;
+	const uint8_t *end = frame + len - BATCH_CRC_LEN;
+	if (end - p < 2 * BATCH_CHANNELS)
+		return -1;
+
+	memcpy(&t_ms[0], frame + 4, 4);
+	for (uint8_t c = 0; c < BATCH_CHANNELS; c++, p += 2)
+		samples[0].v[c] = (int16_t)(p[0] | ((uint16_t)p[1] << 8));
+
+	for (uint8_t i = 1; i < n; i++)
+	{
+		int32_t d[1 + BATCH_CHANNELS];
+
+		for (uint8_t k = 0; k < 1 + BATCH_CHANNELS; k++)
+		{
+			uint32_t v = 0;
+			uint8_t shift = 0;
+
+			do
+			{
+				if (p >= end || shift > 28)
+					return -1;
+				v |= (uint32_t)(*p & 0x7f) << shift;
+				shift += 7;
+			} while (*p++ & 0x80);
+
+			d[k] = batchUnzigzag(v);
+		}
+
+		t_ms[i] = t_ms[i - 1] + frame[3] + d[0];
+		for (uint8_t c = 0; c < BATCH_CHANNELS; c++)
+			samples[i].v[c] = (int16_t)(samples[i - 1].v[c] + d[1 + c]);
+	}
+
+	return (p == end) ? n : -1;
+}
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @brief      Latest value channel with one writer and any number of readers.
+ * @details    The writer publishes a new value whenever it has one, readers
+ *             copy out the latest value whenever they need it, and neither
+ *             ever blocks or takes a lock. Every value comes with its sequence
+ *             number, the count of values published so far, so a reader can
+ *             tell a fresh value from one it has already seen.
+ *
+ *             This is a seqlock over two copies of the value. The writer bumps
+ *             the sequence before updating each copy, and readers always read
+ *             the copy that is not being written, picked by the low bit of the
+ *             sequence. A read is retried only if a write completed while it
+ *             was copying. A reader that preempts the writer in the middle of
+ *             a write reads the other, complete copy and never waits for it,
+ *             which a plain seqlock cannot offer on a single core with
+ *             priority scheduling.
+ *
+ *             The value is stored as relaxed atomic words, so T must be
+ *             trivially copyable.
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+template <typename T>
+class Snapshot
+{
+	static_assert(std::is_trivially_copyable<T>::value, "snapshot values are copied word by word");
+
+private:
+	static const uint16_t WORDS = (sizeof(T) + 3) / 4;
+
+	std::atomic<uint32_t> _seq; // twice the number of published values, plus one while a write is half done
+	std::atomic<uint32_t> _copies[2][WORDS];
+
+	void store(uint8_t copy, const uint32_t *words)
+	{
+		for (uint16_t i = 0; i < WORDS; i++)
+			_copies[copy][i].store(words[i], std::memory_order_relaxed);
+	}
+
+public:
+	Snapshot() : _seq(0)
+	{
+		for (uint16_t i = 0; i < WORDS; i++)
+		{
+			_copies[0][i].store(0, std::memory_order_relaxed);
+			_copies[1][i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @brief      Make v the latest value. Only call from the single writer.
+	 */
+	void publish(const T &v)
+	{
+		uint32_t words[WORDS];
+		words[WORDS - 1] = 0;
+		memcpy(words, &v, sizeof(T));
+
+		uint32_t seq = _seq.load(std::memory_order_relaxed);
+
+		// odd: readers move to copy 1 while copy 0 is written
+		_seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		store(0, words);
+
+		// even: readers move back to copy 0 while copy 1 is written
+		_seq.store(seq + 2, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_release);
+		store(1, words);
+	}
+
+	/**
+	 * @brief      Copy out the latest value, from any task or interrupt
+	 *
+	 * @param[out] v     The value, all zero if nothing was published yet
+	 *
+	 * @return     Sequence number of the value, 0 if nothing was published yet
+	 */
+	uint32_t read(T &v) const
+	{
+		uint32_t words[WORDS];
+		uint32_t seq;
+
+		do
+		{
+			seq = _seq.load(std::memory_order_acquire);
+			for (uint16_t i = 0; i < WORDS; i++)
+				words[i] = _copies[seq & 1][i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while (_seq.load(std::memory_order_relaxed) != seq);
+
+		memcpy(&v, words, sizeof(T));
+		return seq / 2;
+	}
+
+	/**
+	 * @brief      Copy out the latest value if it is newer than the last one the
+	 *             caller has seen
+	 *
+	 * @param[out]    v     The value, unchanged if there is nothing new
+	 * @param[in,out] last  Sequence number of the last value seen, updated
+	 *
+	 * @return     True if v holds a new value
+	 */
+	bool readIfNewer(T &v, uint32_t &last) const
+	{
+		if (sequence() == last)
+			return false;
+
+		last = read(v);
+		return true;
+	}
+
+	/**
+	 * @brief      Sequence number of the latest value, 0 if nothing was published
+	 */
+	uint32_t sequence() const { return _seq.load(std::memory_order_acquire) / 2; }
+};
+
+#endif
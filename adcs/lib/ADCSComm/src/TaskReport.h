@@ -0,0 +1,329 @@
+/**
+ * @brief      Task and memory diagnostics sent to the satellite on
+ *             CMD_DBG_TASKS.
+ * @details    One system frame is followed by one task frame per task. They
+ *             report the CPU share of every task, its stack use, the heap and
+ *             the queue fill levels, so stacks can be sized from flight data
+ *             and a task hogging the CPU shows up. CPU shares are over the
+ *             interval since the previous report, or since boot for the first
+ *             one. Multi-byte values are little endian.
+ *
+ *             System frame:
+ *
+ *               0       SYSTEM_FRAME_ID
+ *               1       frame length in bytes, including the CRC
+ *               2..5    run time clock now in us, wraps around
+ *               6..9    interval the CPU shares are over, in us
+ *               10..13  free heap in bytes
+ *               14..17  least free heap since boot in bytes
+ *               18      number of task frames that follow
+ *               19      number of queues q
+ *               20..    q times: items waiting, queue length
+ *               last 2  CRC16 of all bytes before it, same as the commands
+ *
+ *             Task frame:
+ *
+ *               0       TASK_FRAME_ID
+ *               1       frame length in bytes, including the CRC
+ *               2       task number, unique for every task created
+ *               3       state, eTaskState
+ *               4       current priority
+ *               5..8    run time since the task was created in us, wraps
+ *               9..10   CPU share over the interval in 1/100 %
+ *               11..12  stack depth in words
+ *               13..14  stack high water mark, fewest free words ever
+ *               15..30  name, zero padded
+ *               last 2  CRC16
+ */
+#ifndef TASK_REPORT_H
+#define TASK_REPORT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <CRC16.h>
+
+// first bytes of the frames, never used as a heartbeat status code
+#define SYSTEM_FRAME_ID 0x5d
+#define TASK_FRAME_ID 0x5e
+
+#define TASK_REPORT_NAME_LEN 16 // configMAX_TASK_NAME_LEN
+#define TASK_REPORT_MAX_QUEUES 8
+
+#define SYSTEM_HEADER_LEN 20
+#define SYSTEM_FRAME_LEN(queues) (SYSTEM_HEADER_LEN + 2 * (queues) + 2)
+#define TASK_FRAME_LEN (15 + TASK_REPORT_NAME_LEN + 2)
+
+// CPU share of 100 %
+#define TASK_SHARE_FULL 10000
+
+/**
+ * @brief      Heap and queues of the whole system
+ */
+typedef struct
+{
+	uint32_t run_time_us;
+	uint32_t interval_us;
+	uint32_t heap_free;
+	uint32_t heap_min_free;
+	uint8_t tasks;
+	uint8_t queues;
+	uint8_t queue_waiting[TASK_REPORT_MAX_QUEUES];
+	uint8_t queue_length[TASK_REPORT_MAX_QUEUES];
+} SystemReport;
+
+/**
+ * @brief      One task
+ */
+typedef struct
+{
+	uint8_t number;
+	uint8_t state;
+	uint8_t priority;
+	uint32_t run_time_us;
+	uint16_t share; // 1/100 %
+	uint16_t stack_words;
+	uint16_t stack_free_words;
+	char name[TASK_REPORT_NAME_LEN + 1];
+} TaskReport;
+
+/* FRAMES =================================================================== */
+
+inline void putReport32(uint8_t *p, uint32_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = v >> 24;
+}
+
+inline uint32_t getReport32(const uint8_t *p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief      Append the CRC16 of the first len - 2 bytes
+ */
+inline void sealReportFrame(uint8_t *frame, uint8_t len)
+{
+	CRC16 crcGen;
+	crcGen.add(frame, len - 2);
+	uint16_t crc = crcGen.getCRC();
+	frame[len - 2] = crc & 0xff;
+	frame[len - 1] = crc >> 8;
+}
+
+/**
+ * @brief      Check the id, length and CRC of a received frame
+ *
+ * @return     Length of the frame, 0 if it is not a valid id frame
+ */
+inline uint8_t checkReportFrame(const uint8_t *frame, uint8_t len, uint8_t id)
+{
+	if (len < 4 || frame[0] != id || frame[1] < 4 || frame[1] > len)
+		return 0;
+
+	uint8_t n = frame[1];
+	CRC16 crcGen;
+	crcGen.add(frame, n - 2);
+	if (crcGen.getCRC() != (frame[n - 2] | ((uint16_t)frame[n - 1] << 8)))
+		return 0;
+
+	return n;
+}
+
+/**
+ * @brief      Write a system frame
+ *
+ * @param      frame  SYSTEM_FRAME_LEN(r.queues) bytes
+ *
+ * @return     Length of the frame
+ */
+inline uint8_t encodeSystemReport(const SystemReport &r, uint8_t *frame)
+{
+	uint8_t queues = r.queues < TASK_REPORT_MAX_QUEUES ? r.queues : TASK_REPORT_MAX_QUEUES;
+	uint8_t len = SYSTEM_FRAME_LEN(queues);
+
+	frame[0] = SYSTEM_FRAME_ID;
+	frame[1] = len;
+	putReport32(frame + 2, r.run_time_us);
+	putReport32(frame + 6, r.interval_us);
+	putReport32(frame + 10, r.heap_free);
+	putReport32(frame + 14, r.heap_min_free);
+	frame[18] = r.tasks;
+	frame[19] = queues;
+
+	for (uint8_t i = 0; i < queues; i++)
+	{
+		frame[SYSTEM_HEADER_LEN + 2 * i] = r.queue_waiting[i];
+		frame[SYSTEM_HEADER_LEN + 2 * i + 1] = r.queue_length[i];
+	}
+
+	sealReportFrame(frame, len);
+	return len;
+}
+
+/**
+ * @brief      Read a system frame
+ *
+ * @return     false if the frame is too short, malformed or fails its CRC
+ */
+inline bool decodeSystemReport(const uint8_t *frame, uint8_t len, SystemReport &r)
+{
+	uint8_t n = checkReportFrame(frame, len, SYSTEM_FRAME_ID);
+	if (n < SYSTEM_HEADER_LEN + 2 || frame[19] > TASK_REPORT_MAX_QUEUES || n != SYSTEM_FRAME_LEN(frame[19]))
+		return false;
+
+	r.run_time_us = getReport32(frame + 2);
+	r.interval_us = getReport32(frame + 6);
+	r.heap_free = getReport32(frame + 10);
+	r.heap_min_free = getReport32(frame + 14);
+	r.tasks = frame[18];
+	r.queues = frame[19];
+
+	for (uint8_t i = 0; i < r.queues; i++)
+	{
+		r.queue_waiting[i] = frame[SYSTEM_HEADER_LEN + 2 * i];
+		r.queue_length[i] = frame[SYSTEM_HEADER_LEN + 2 * i + 1];
+	}
+
+	return true;
+}
+
+/**
+ * @brief      Write a task frame
+ *
+ * @param      frame  TASK_FRAME_LEN bytes
+ *
+ * @return     Length of the frame
+ */
+inline uint8_t encodeTaskReport(const TaskReport &r, uint8_t *frame)
+{
+	frame[0] = TASK_FRAME_ID;
+	frame[1] = TASK_FRAME_LEN;
+	frame[2] = r.number;
+	frame[3] = r.state;
+	frame[4] = r.priority;
+	putReport32(frame + 5, r.run_time_us);
+	frame[9] = r.share & 0xff;
+	frame[10] = r.share >> 8;
+	frame[11] = r.stack_words & 0xff;
+	frame[12] = r.stack_words >> 8;
+	frame[13] = r.stack_free_words & 0xff;
+	frame[14] = r.stack_free_words >> 8;
+	memset(frame + 15, 0, TASK_REPORT_NAME_LEN);
+	memcpy(frame + 15, r.name, strnlen(r.name, TASK_REPORT_NAME_LEN));
+
+	sealReportFrame(frame, TASK_FRAME_LEN);
+	return TASK_FRAME_LEN;
+}
+
+/**
+ * @brief      Read a task frame
+ *
+ * @return     false if the frame is too short, malformed or fails its CRC
+ */
+inline bool decodeTaskReport(const uint8_t *frame, uint8_t len, TaskReport &r)
+{
+	if (checkReportFrame(frame, len, TASK_FRAME_ID) != TASK_FRAME_LEN)
+		return false;
+
+	r.number = frame[2];
+	r.state = frame[3];
+	r.priority = frame[4];
+	r.run_time_us = getReport32(frame + 5);
+	r.share = frame[9] | ((uint16_t)frame[10] << 8);
+	r.stack_words = frame[11] | ((uint16_t)frame[12] << 8);
+	r.stack_free_words = frame[13] | ((uint16_t)frame[14] << 8);
+	memcpy(r.name, frame + 15, TASK_REPORT_NAME_LEN);
+	r.name[TASK_REPORT_NAME_LEN] = '\0';
+
+	return true;
+}
+
+/* CPU SHARE ================================================================ */
+
+/**
+ * @brief      CPU share of each task over the interval between two reports,
+ *             from the run time counters that only ever count up. Keeps the
+ *             counters of up to MAX_TASKS tasks from the previous report,
+ *             tasks that are gone are forgotten.
+ */
+template <uint8_t MAX_TASKS>
+class RunTimeShares
+{
+private:
+	typedef struct
+	{
+		uint32_t number;
+		uint32_t run_time;
+	} Entry;
+
+	Entry _prev[MAX_TASKS];
+	Entry _next[MAX_TASKS];
+	uint8_t _num_prev;
+	uint8_t _num_next;
+
+	uint32_t _prev_total;
+	uint32_t _interval;
+
+public:
+	RunTimeShares() : _num_prev(0), _num_next(0), _prev_total(0), _interval(0) {}
+
+	/**
+	 * @brief      Start a report
+	 *
+	 * @param[in]  total  Run time clock now
+	 */
+	void begin(uint32_t total)
+	{
+		_interval = total - _prev_total;
+		_prev_total = total;
+		_num_next = 0;
+	}
+
+	/**
+	 * @brief      Share of one task, call once per task after begin
+	 *
+	 * @param[in]  number    Task number
+	 * @param[in]  run_time  Its run time counter now
+	 *
+	 * @return     Share of the interval in 1/100 %
+	 */
+	uint16_t share(uint32_t number, uint32_t run_time)
+	{
+		uint32_t since = 0; // a new task ran only in this interval
+
+		for (uint8_t i = 0; i < _num_prev; i++)
+		{
+			if (_prev[i].number == number)
+				since = _prev[i].run_time;
+		}
+
+		if (_num_next < MAX_TASKS)
+		{
+			_next[_num_next].number = number;
+			_next[_num_next].run_time = run_time;
+			_num_next++;
+		}
+
+		if (_interval == 0)
+			return 0;
+
+		uint64_t share = (uint64_t)(uint32_t)(run_time - since) * TASK_SHARE_FULL / _interval;
+		return share > TASK_SHARE_FULL ? TASK_SHARE_FULL : (uint16_t)share;
+	}
+
+	/**
+	 * @brief      End the report, its counters are the base of the next one
+	 */
+	void end()
+	{
+		memcpy(_prev, _next, sizeof(Entry) * _num_next);
+		_num_prev = _num_next;
+	}
+
+	uint32_t interval() const { return _interval; }
+};
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * @brief      Topic based publish/subscribe for sensor samples.
+ * @details    A sensor task acquires each sample once and publishes it to its
+ *             topic. Everything that needs the sample subscribes to the topic
+ *             instead of reading the sensor itself, so bus traffic does not
+ *             grow with the number of consumers.
+ *
+ *             Subscribers come in two kinds:
+ *               - callbacks, run by the publisher for every decimation-th
+ *                 sample with a reference to the publisher's own sample, so
+ *                 fanning out costs no copies. They run in the publisher's
+ *                 task and must be short, e.g. encode the sample or notify a
+ *                 task.
+ *               - readers, which copy the latest sample whenever they run, and
+ *                 can tell from its sequence number whether it is new, see
+ *                 Snapshot.h.
+ *
+ *             Callbacks are registered at init, before the publisher starts.
+ */
+#ifndef TELEMETRY_HUB_H
+#define TELEMETRY_HUB_H
+
+#include <stdint.h>
+#include <Snapshot.h>
+
+template <typename T, uint8_t MAX_SUBSCRIBERS = 4>
+class Topic
+{
+public:
+	/**
+	 * @brief      Called with the sample, its sequence number and the context
+	 *             given to subscribe
+	 */
+	typedef void (*Callback)(const T &sample, uint32_t seq, void *context);
+
+private:
+	typedef struct
+	{
+		Callback callback;
+		void *context;
+		uint16_t decimation; // called for every decimation-th sample
+		uint16_t count;		 // samples since the last call
+	} Subscriber;
+
+	Snapshot<T> _latest;
+	Subscriber _subs[MAX_SUBSCRIBERS];
+	uint8_t _num_subs;
+
+public:
+	Topic() : _num_subs(0) {}
+
+	/**
+	 * @brief      Register a callback
+	 *
+	 * @param[in]  decimation  Call for every decimation-th sample, 1 for all
+	 * @param[in]  callback    The callback
+	 * @param      context     Passed to the callback
+	 *
+	 * @return     False if MAX_SUBSCRIBERS callbacks are registered already
+	 */
+	bool subscribe(uint16_t decimation, Callback callback, void *context = NULL)
+	{
+		if (_num_subs >= MAX_SUBSCRIBERS || callback == NULL)
+			return false;
+
+		Subscriber &s = _subs[_num_subs++];
+		s.callback = callback;
+		s.context = context;
+		s.decimation = decimation == 0 ? 1 : decimation;
+		s.count = 0;
+		return true;
+	}
+
+	/**
+	 * @brief      Publish a sample, only call from the single publisher
+	 */
+	void publish(const T &sample)
+	{
+		_latest.publish(sample);
+		uint32_t seq = _latest.sequence();
+
+		for (uint8_t i = 0; i < _num_subs; i++)
+		{
+			Subscriber &s = _subs[i];
+			if (++s.count >= s.decimation)
+			{
+				s.count = 0;
+				s.callback(sample, seq, s.context);
+			}
+		}
+	}
+
+	/**
+	 * @brief      Copy out the latest sample, never blocks
+	 *
+	 * @return     Its sequence number, 0 if nothing was published yet
+	 */
+	uint32_t read(T &sample) const { return _latest.read(sample); }
+
+	/**
+	 * @brief      Copy out the latest sample if it is newer than last
+	 */
+	bool readIfNewer(T &sample, uint32_t &last) const { return _latest.readIfNewer(sample, last); }
+
+	uint32_t sequence() const { return _latest.sequence(); }
+	uint8_t subscribers() const { return _num_subs; }
+};
+
+#endif
@@ -0,0 +1,315 @@
+/**
+ * @brief      Latency trace of the hot paths, from a sensor sample to the
+ *             actuator it drives.
+ * @details    A trace point records an 8 byte event into a ring buffer in RAM
+ *             that keeps the latest events. Events of one pass through a path
+ *             carry the same tag, e.g. the sequence number of the IMU sample,
+ *             so the host can follow each sample from the bus to the flywheel
+ *             even when tasks interleave.
+ *
+ *             TRACE_POINTS and trace_paths are the only description of the
+ *             trace, used by the firmware to record and by
+ *             tools/trace_analyzer to rebuild the paths. An event, little
+ *             endian:
+ *
+ *               0..3    timestamp in clock cycles, wraps around
+ *               4       trace point
+ *               5       task number as in uxTaskGetSystemState, or
+ *                       TRACE_TASK_ISR
+ *               6..7    tag
+ *
+ *             The firmware dumps the buffer as text lines on SERCOM_USB, so
+ *             the dump can be cut from an ordinary debug log:
+ *
+ *               [trace]  begin <clock Hz> <events> <overwritten>
+ *               [trace]  task <number> <name>
+ *               [trace]  <16 hex digits per event, up to 8 events per line>
+ *               [trace]  end
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*   X(id)                                                                    */
+#define TRACE_POINTS(X)                                                        \
+	X(IMU_READ)       /* readIMU starts the bus transfer, tag: IMU sample */   \
+	X(IMU_SAMPLE)     /* getAGMT returned                                 */   \
+	X(IMU_PUBLISH)    /* averaged sample published to imu_topic           */   \
+	X(DETUMBLE_INPUT) /* simple_detumble picked the sample up             */   \
+	X(WHEEL_OUTPUT)   /* flywheel set from the sample                     */   \
+	X(COMMAND_FRAME)  /* command passed its CRC, tag: command             */   \
+	X(MODE_ENTERED)   /* state_machine_transition done, tag: mode         */   \
+	X(IMU_INT)        /* IMU data ready interrupt, tag: IMU sample        */
+
+/**
+ * @brief      Index of each trace point
+ */
+enum TracePoint : uint8_t
+{
+#define TRACE_ENUM(id) TP_##id,
+	TRACE_POINTS(TRACE_ENUM)
+#undef TRACE_ENUM
+	TP_NUM_POINTS
+};
+
+#define TRACE_NAME(id) #id,
+static const char *const trace_point_names[TP_NUM_POINTS] = {TRACE_POINTS(TRACE_NAME)};
+#undef TRACE_NAME
+
+#define TRACE_EVENT_LEN 8
+#define TRACE_TASK_ISR 0 // FreeRTOS numbers tasks from 1
+#define TRACE_LINE_TAG "[trace]\t"
+
+/**
+ * @brief      One recorded trace point
+ */
+typedef struct
+{
+	uint32_t cycles;
+	uint8_t point;
+	uint8_t task;
+	uint16_t tag;
+} TraceEvent;
+
+inline void encodeTraceEvent(const TraceEvent &e, uint8_t *buf)
+{
+	for (uint8_t i = 0; i < 4; i++)
+		buf[i] = (uint8_t)(e.cycles >> (8 * i));
+	buf[4] = e.point;
+	buf[5] = e.task;
+	buf[6] = (uint8_t)e.tag;
+	buf[7] = (uint8_t)(e.tag >> 8);
+}
+
+inline TraceEvent decodeTraceEvent(const uint8_t *buf)
+{
+	TraceEvent e;
+	e.cycles = (uint32_t)buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+	e.point = buf[4];
+	e.task = buf[5];
+	e.tag = (uint16_t)(buf[6] | buf[7] << 8);
+	return e;
+}
+
+/* PATHS ==================================================================== */
+
+#define TRACE_PATH_MAX_POINTS 4
+
+/**
+ * @brief      Trace points a pass through a path hits in order, all with the
+ *             same tag
+ */
+typedef struct
+{
+	const char *name;
+	uint8_t len;
+	uint8_t points[TRACE_PATH_MAX_POINTS];
+} TracePath;
+
+static const TracePath trace_paths[] = {
+	{"imu_read", 2, {TP_IMU_READ, TP_IMU_SAMPLE}},
+	{"imu_to_wheel", 4, {TP_IMU_READ, TP_IMU_PUBLISH, TP_DETUMBLE_INPUT, TP_WHEEL_OUTPUT}},
+	{"command", 2, {TP_COMMAND_FRAME, TP_MODE_ENTERED}},
+	{"imu_int", 2, {TP_IMU_INT, TP_IMU_READ}},
+};
+
+#define TRACE_NUM_PATHS (sizeof(trace_paths) / sizeof(trace_paths[0]))
+
+/* RECORDING ================================================================ */
+
+/**
+ * @brief      Ring buffer of the latest SIZE events. Not thread safe, the
+ *             firmware records with interrupts masked.
+ */
+template <uint16_t SIZE>
+class TraceBuffer
+{
+	static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "TraceBuffer size must be a power of two");
+
+private:
+	TraceEvent _events[SIZE];
+	uint32_t _count; // events recorded since the last clear
+
+public:
+	TraceBuffer() : _count(0) {}
+
+	void record(uint32_t cycles, uint8_t point, uint8_t task, uint16_t tag)
+	{
+		TraceEvent &e = _events[_count & (SIZE - 1)];
+		e.cycles = cycles;
+		e.point = point;
+		e.task = task;
+		e.tag = tag;
+		_count++;
+	}
+
+	/**
+	 * @brief      Number of events held, at most SIZE
+	 */
+	uint16_t size() const { return _count < SIZE ? (uint16_t)_count : SIZE; }
+
+	/**
+	 * @brief      Events recorded since the last clear that were overwritten by
+	 *             newer ones
+	 */
+	uint32_t overwritten() const { return _count - size(); }
+
+	/**
+	 * @brief      Held event, 0 is the oldest
+	 */
+	const TraceEvent &operator[](uint16_t i) const { return _events[(_count - size() + i) & (SIZE - 1)]; }
+
+	void clear() { _count = 0; }
+};
+
+/* ANALYSIS ================================================================= */
+
+/**
+ * @brief      Extends the wrapping 32 bit timestamps of consecutive events to
+ *             64 bits. Events must be less than one wrap apart, 35 s at
+ *             120 MHz.
+ */
+class TraceClock
+{
+private:
+	uint64_t _time;
+	uint32_t _last;
+	bool _started;
+
+public:
+	TraceClock() : _time(0), _last(0), _started(false) {}
+
+	uint64_t unwrap(uint32_t cycles)
+	{
+		if (_started)
+			_time += (uint32_t)(cycles - _last);
+		_started = true;
+		_last = cycles;
+		return _time;
+	}
+};
+
+// passes of one path followed at once, e.g. IMU samples the detumble loop
+// has not picked up yet
+#define TRACE_PATH_IN_FLIGHT 8
+
+/**
+ * @brief      A completed pass through a path
+ */
+typedef struct
+{
+	uint8_t path;
+	uint16_t tag;
+	uint64_t times[TRACE_PATH_MAX_POINTS]; // time of each point of the path
+} TracePass;
+
+/**
+ * @brief      Follows the passes through every path in a stream of events in
+ *             time order
+ */
+class TracePathMatcher
+{
+private:
+	typedef struct
+	{
+		uint64_t times[TRACE_PATH_MAX_POINTS];
+		uint16_t tag;
+		uint8_t next; // index of the next point in the path, 0 if unused
+	} InFlight;
+
+	InFlight _flights[TRACE_NUM_PATHS][TRACE_PATH_IN_FLIGHT];
+	uint8_t _evict[TRACE_NUM_PATHS]; // next slot to reuse when all are taken
+
+	void start(uint8_t p, uint64_t time, uint16_t tag)
+	{
+		InFlight *slot = NULL;
+
+		// a pass with the same tag that never finished is started over
+		for (uint8_t i = 0; i < TRACE_PATH_IN_FLIGHT && slot == NULL; i++)
+		{
+			if (_flights[p][i].next != 0 && _flights[p][i].tag == tag)
+				slot = &_flights[p][i];
+		}
+
+		for (uint8_t i = 0; i < TRACE_PATH_IN_FLIGHT && slot == NULL; i++)
+		{
+			if (_flights[p][i].next == 0)
+				slot = &_flights[p][i];
+		}
+
+		// every slot busy, drop one of the passes in flight
+		if (slot == NULL)
+		{
+			slot = &_flights[p][_evict[p]];
+			_evict[p] = (_evict[p] + 1) % TRACE_PATH_IN_FLIGHT;
+		}
+
+		slot->times[0] = time;
+		slot->tag = tag;
+		slot->next = 1;
+	}
+
+public:
+	TracePathMatcher() { reset(); }
+
+	void reset()
+	{
+		for (uint8_t p = 0; p < TRACE_NUM_PATHS; p++)
+		{
+			_evict[p] = 0;
+			for (uint8_t i = 0; i < TRACE_PATH_IN_FLIGHT; i++)
+				_flights[p][i].next = 0;
+		}
+	}
+
+	/**
+	 * @brief      Feed the next event
+	 *
+	 * @param[in]  time  Its unwrapped time, see TraceClock
+	 * @param[in]  e     The event
+	 * @param[out] done  Receives the passes it completed, room for one per path
+	 *
+	 * @return     Number of passes written to done
+	 */
+	uint8_t push(uint64_t time, const TraceEvent &e, TracePass *done)
+	{
+		uint8_t n = 0;
+
+		for (uint8_t p = 0; p < TRACE_NUM_PATHS; p++)
+		{
+			const TracePath &path = trace_paths[p];
+
+			if (path.points[0] == e.point)
+			{
+				start(p, time, e.tag);
+				continue;
+			}
+
+			for (uint8_t i = 0; i < TRACE_PATH_IN_FLIGHT; i++)
+			{
+				InFlight &f = _flights[p][i];
+
+				if (f.next == 0 || f.tag != e.tag || path.points[f.next] != e.point)
+					continue;
+
+				f.times[f.next++] = time;
+				if (f.next == path.len)
+				{
+					done[n].path = p;
+					done[n].tag = f.tag;
+					for (uint8_t k = 0; k < path.len; k++)
+						done[n].times[k] = f.times[k];
+					n++;
+					f.next = 0;
+				}
+				break;
+			}
+		}
+
+		return n;
+	}
+};
+
+#endif
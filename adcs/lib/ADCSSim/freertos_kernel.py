@@ -0,0 +1,68 @@
+"""
+Builds the FreeRTOS kernel of lib/FreeRTOS-SAMD51 for the sim environment.
+
+The SAMD51 library keeps its Cortex-M port and FreeRTOSConfig.h next to the
+kernel sources, where the kernel's own #include "..." finds them before the
+simulated ones in lib/ADCSSim. The portable kernel files are copied to the
+build folder and compiled from there instead, so both builds always run the
+same kernel.
+"""
+import os
+import shutil
+
+Import("env")
+
+KERNEL_DIR = os.path.join(env.subst("$PROJECT_DIR"), "lib", "FreeRTOS-SAMD51", "src")
+PORT_DIR = os.path.join(env.subst("$PROJECT_DIR"), "lib", "ADCSSim", "src")
+COPY_DIR = os.path.join(env.subst("$BUILD_DIR"), "FreeRTOS-kernel")
+
+SOURCES = [
+    "tasks.c",
+    "queue.c",
+    "list.c",
+    "timers.c",
+    "event_groups.c",
+    "stream_buffer.c",
+]
+
+HEADERS = [
+    "FreeRTOS.h",
+    "croutine.h",
+    "deprecated_definitions.h",
+    "event_groups.h",
+    "list.h",
+    "message_buffer.h",
+    "mpu_prototypes.h",
+    "mpu_wrappers.h",
+    "portable.h",
+    "projdefs.h",
+    "queue.h",
+    "semphr.h",
+    "stack_macros.h",
+    "stream_buffer.h",
+    "task.h",
+    "timers.h",
+]
+
+if not os.path.isdir(COPY_DIR):
+    os.makedirs(COPY_DIR)
+
+for name in SOURCES + HEADERS:
+    src = os.path.join(KERNEL_DIR, name)
+    dst = os.path.join(COPY_DIR, name)
+    if not os.path.exists(dst) or os.path.getmtime(src) > os.path.getmtime(dst):
+        shutil.copy2(src, dst)
+
+env.Append(
+    CPPPATH=[COPY_DIR, PORT_DIR],  # FreeRTOSConfig.h and portmacro.h
+    CXXFLAGS=["-std=gnu++11"],  # C++ only, kept off the kernel sources
+    CCFLAGS=["-pthread"],
+    LINKFLAGS=["-pthread"],
+    LIBS=["m"],
+)
+
+env.BuildSources(
+    os.path.join("$BUILD_DIR", "FreeRTOS"),
+    COPY_DIR,
+    src_filter=["-<*>"] + ["+<%s>" % name for name in SOURCES],
+)
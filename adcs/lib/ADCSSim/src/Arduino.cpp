@@ -0,0 +1,138 @@
+/**
+ * @brief      Time, printing and the USB serial port of the simulated Arduino
+ *             core. Pins, the ADC and the UART are wired up in SimBoard.cpp.
+ */
+#include "Arduino.h"
+#include "SPI.h"
+
+#include <FreeRTOS_SAMD51.h>
+
+SimSerial Serial(true);
+SimSerial Serial1(false);
+SPIClass SPI;
+
+DWT_Type sim_dwt;
+CoreDebug_Type sim_core_debug;
+
+/* TIME ===================================================================== */
+
+unsigned long millis(void)
+{
+	simBusy(SIM_GPIO_US);
+	return (unsigned long)(simMicros() / 1000);
+}
+
+unsigned long micros(void)
+{
+	simBusy(SIM_GPIO_US);
+	return (unsigned long)simMicros();
+}
+
+/**
+ * @brief      Busy wait like the Arduino core, tasks of higher priority still
+ *             preempt it on every tick
+ */
+void delayMicroseconds(unsigned int us)
+{
+	uint64_t end = simMicros() + us;
+	uint64_t now;
+
+	while ((now = simMicros()) < end)
+		simBusy(end - now < 100 ? (uint32_t)(end - now) : 100);
+}
+
+void delay(unsigned long ms)
+{
+	while (ms-- > 0)
+		delayMicroseconds(1000);
+}
+
+void yield(void)
+{
+}
+
+extern "C" void vNopDelayMS(unsigned long millis)
+{
+	delay(millis);
+}
+
+/* PRINT ==================================================================== */
+
+size_t Print::write(const uint8_t *buf, size_t len)
+{
+	size_t n = 0;
+
+	while (len-- > 0)
+		n += write(*buf++);
+	return n;
+}
+
+size_t Print::print(long n, int base)
+{
+	if (base == DEC)
+	{
+		char str[24];
+		snprintf(str, sizeof(str), "%ld", n);
+		return write(str);
+	}
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+	char str[8 * sizeof(long) + 1];
+	char *p = &str[sizeof(str) - 1];
+
+	if (base < 2)
+		base = DEC;
+
+	*p = '\0';
+	do
+	{
+		int digit = n % base;
+		*--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+		n /= base;
+	} while (n > 0);
+
+	return write(p);
+}
+
+size_t Print::print(double n, int digits)
+{
+	// same special cases as the Arduino core
+	if (isnan(n))
+		return write("nan");
+	if (isinf(n))
+		return write("inf");
+	if (n > 4294967040.0 || n < -4294967040.0)
+		return write("ovf");
+
+	char str[48];
+	snprintf(str, sizeof(str), "%.*f", digits, n);
+	return write(str);
+}
+
+/* SERIAL =================================================================== */
+
+size_t SimSerial::write(uint8_t b)
+{
+	return write(&b, 1);
+}
+
+/**
+ * @brief      Serial goes to stdout unless --quiet, Serial1 is the UART to
+ *             the satellite
+ */
+size_t SimSerial::write(const uint8_t *buf, size_t len)
+{
+	if (!_usb)
+	{
+		for (size_t i = 0; i < len; i++)
+			simUARTWrite(buf[i]);
+	}
+	else if (!sim_options.quiet)
+	{
+		fwrite(buf, 1, len, stdout);
+	}
+	return len;
+}
@@ -0,0 +1,255 @@
+/**
+ * @brief      Arduino core of the simulated SAMD51, the subset the firmware
+ *             and its libraries use.
+ * @details    Pins, the ADC and PWM are wired to the simulated sensors and
+ *             actuators in SimBoard.cpp. Serial is the USB debug output,
+ *             printed to stdout. Serial1 and sercom5 are the UART to the
+ *             satellite, see SimBoard.cpp.
+ */
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sim.h"
+#include "portmacro.h"
+
+#define F_CPU 120000000UL
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+
+// pin numbers of the SparkFun SAMD51 Thing Plus variant
+#define LED_BUILTIN 13
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define SIM_NUM_PINS 32
+
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define lowByte(w) ((uint8_t)((w)&0xff))
+
+inline word makeWord(uint8_t h, uint8_t l) { return (h << 8) | l; }
+#define word(...) makeWord(__VA_ARGS__)
+
+/* TIME ===================================================================== */
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+/* PINS ===================================================================== */
+
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+int analogRead(uint32_t pin);
+void analogWrite(uint32_t pin, int value);
+void analogReadResolution(int bits);
+void analogWriteResolution(int bits);
+
+/* INTERRUPTS =============================================================== */
+
+// SAMD51 interrupt numbers of the peripherals the firmware uses directly
+typedef enum
+{
+	EIC_0_IRQn = 12,
+	SERCOM2_0_IRQn = 54,
+	SERCOM2_1_IRQn = 55,
+	SERCOM2_2_IRQn = 56,
+	SERCOM2_3_IRQn = 57,
+	SERCOM5_0_IRQn = 70,
+	SERCOM5_1_IRQn = 71,
+	SERCOM5_2_IRQn = 72,
+	SERCOM5_3_IRQn = 73,
+} IRQn_Type;
+
+inline void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {}
+inline void NVIC_EnableIRQ(IRQn_Type irq) { simEnableIRQ(irq, true); }
+inline void NVIC_DisableIRQ(IRQn_Type irq) { simEnableIRQ(irq, false); }
+inline void __disable_irq(void) { vPortDisableInterrupts(); }
+inline void __enable_irq(void) { vPortEnableInterrupts(); }
+inline void __DSB(void) {}
+
+typedef void (*voidFuncPtr)(void);
+
+// the EIC line of a pin is the pin number
+#define digitalPinToInterrupt(pin) (pin)
+
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode);
+void detachInterrupt(uint32_t pin);
+
+/* DEBUG UNIT =============================================================== */
+
+/**
+ * @brief      DWT cycle counter, counts the simulated clock at F_CPU
+ */
+class SimCycleCounter
+{
+private:
+	uint32_t _zero;
+
+	static uint32_t now(void) { return (uint32_t)(simMicros() * (F_CPU / 1000000)); }
+
+public:
+	SimCycleCounter(void) : _zero(0) {}
+
+	operator uint32_t() const { return now() - _zero; }
+	SimCycleCounter &operator=(uint32_t value)
+	{
+		_zero = now() - value;
+		return *this;
+	}
+};
+
+typedef struct
+{
+	uint32_t CTRL;
+	SimCycleCounter CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+	uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+/* SERIAL =================================================================== */
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+#define PROGMEM
+#define pgm_read_byte_near(addr) (*(const uint8_t *)(addr))
+
+class Print
+{
+public:
+	virtual size_t write(uint8_t b) = 0;
+	virtual size_t write(const uint8_t *buf, size_t len);
+	size_t write(const char *s) { return s == NULL ? 0 : write((const uint8_t *)s, strlen(s)); }
+
+	size_t print(const __FlashStringHelper *s) { return print((const char *)s); }
+	size_t print(const char *s) { return write(s); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t print(int n, int base = DEC) { return print((long)n, base); }
+	size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2);
+
+	size_t println(void) { return write("\r\n"); }
+	template <typename T>
+	size_t println(T value)
+	{
+		size_t n = print(value);
+		return n + println();
+	}
+	template <typename T>
+	size_t println(T value, int format)
+	{
+		size_t n = print(value, format);
+		return n + println();
+	}
+};
+
+class Stream : public Print
+{
+public:
+	virtual int available(void) = 0;
+	virtual int read(void) = 0;
+	virtual int peek(void) = 0;
+	virtual void flush(void) {}
+	void setTimeout(unsigned long ms) {}
+};
+
+#define SERIAL_8N1 0x0
+#define SERIAL_8O1 0x1
+#define SERIAL_8E1 0x2
+
+/**
+ * @brief      Serial port of the simulated board, USB or UART
+ */
+class SimSerial : public Stream
+{
+private:
+	bool _usb;
+
+public:
+	SimSerial(bool usb) : _usb(usb) {}
+
+	void begin(unsigned long baud, uint16_t config = SERIAL_8N1) {}
+	void end(void) {}
+	operator bool() { return true; }
+
+	using Print::write;
+	size_t write(uint8_t b);
+	size_t write(const uint8_t *buf, size_t len);
+
+	int available(void) { return 0; }
+	int read(void) { return -1; }
+	int peek(void) { return -1; }
+};
+
+extern SimSerial Serial;
+extern SimSerial Serial1;
+
+/**
+ * @brief      USART registers of SERCOM5, which drives Serial1, as seen by the
+ *             interrupt handlers in comm.cpp
+ */
+class SERCOM
+{
+public:
+	bool isFrameErrorUART(void) { return false; }
+	void clearFrameErrorUART(void) {}
+	bool isUARTError(void) { return false; }
+	void acknowledgeUARTError(void) {}
+	void clearStatusUART(void) {}
+
+	bool availableDataUART(void);
+	uint8_t readDataUART(void);
+	int writeDataUART(uint8_t data);
+	bool isDataRegisterEmptyUART(void);
+	void enableDataRegisterEmptyInterruptUART(void);
+	void disableDataRegisterEmptyInterruptUART(void);
+};
+
+extern SERCOM sercom5;
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @brief      FreeRTOS configuration of the simulated SAMD51.
+ * @details    Mirrors lib/FreeRTOS-SAMD51/src/FreeRTOSConfig.h so the kernel
+ *             schedules the firmware the same way as on the board. Only the
+ *             Cortex-M interrupt priorities and the Arduino error hooks are
+ *             replaced by their simulated counterparts.
+ */
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#define configUSE_PREEMPTION 1
+#define configUSE_IDLE_HOOK 1 // the idle task advances the simulated clock
+#define configUSE_TICK_HOOK 0
+#define configUSE_TICKLESS_IDLE 1 // port.cpp sleeps in simulated time, src/power.cpp is the board's
+#define configCPU_CLOCK_HZ ((unsigned long)120000000)
+#define configTICK_RATE_HZ ((TickType_t)1000)
+#define configMAX_PRIORITIES (9)
+#define configMINIMAL_STACK_SIZE ((unsigned short)150)
+#define configTOTAL_HEAP_SIZE ((size_t)(20 * 1024))
+#define configMAX_TASK_NAME_LEN (16)
+#define configUSE_TRACE_FACILITY 1
+#define configUSE_16_BIT_TICKS 0
+#define configIDLE_SHOULD_YIELD 1
+#define configUSE_MUTEXES 1
+#define configQUEUE_REGISTRY_SIZE 8
+#define configCHECK_FOR_STACK_OVERFLOW 2
+#define configUSE_RECURSIVE_MUTEXES 1
+#define configUSE_MALLOC_FAILED_HOOK 1
+#define configUSE_APPLICATION_TASK_TAG 0
+#define configUSE_COUNTING_SEMAPHORES 1
+#define configUSE_QUEUE_SETS 1
+#define configSUPPORT_STATIC_ALLOCATION 1
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+
+// run time stats count simulated microseconds, like micros() on the board
+#define configGENERATE_RUN_TIME_STATS 1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE() ulSimRunTimeCounter()
+#define configUSE_STATS_FORMATTING_FUNCTIONS 1
+
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
+#define INCLUDE_xTaskGetIdleTaskHandle 1
+
+#define configUSE_CO_ROUTINES 0
+#define configMAX_CO_ROUTINE_PRIORITIES (2)
+
+#define configUSE_TIMERS 1
+#define configTIMER_TASK_PRIORITY (2)
+#define configTIMER_QUEUE_LENGTH 10
+#define configTIMER_TASK_STACK_DEPTH (configMINIMAL_STACK_SIZE)
+
+#define INCLUDE_xTaskGetCurrentTaskHandle 1
+#define INCLUDE_vTaskPrioritySet 1
+#define INCLUDE_uxTaskPriorityGet 1
+#define INCLUDE_vTaskDelete 1
+#define INCLUDE_vTaskCleanUpResources 1
+#define INCLUDE_vTaskSuspend 1
+#define INCLUDE_vTaskDelayUntil 1
+#define INCLUDE_vTaskDelay 1
+#define INCLUDE_eTaskGetState 1
+
+// same values as the SAMD51, NVIC_SetPriority only records them
+#define configPRIO_BITS 3
+#define configLIBRARY_LOWEST_INTERRUPT_PRIORITY 0x07
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY 0x05
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+	unsigned long ulSimRunTimeCounter(void);
+	void vSimAssert(const char *file, int line);
+#ifdef __cplusplus
+}
+#endif
+
+#define configASSERT(x)                   \
+	if ((x) == 0)                         \
+	{                                     \
+		vSimAssert(__FILE__, __LINE__); \
+	}
+
+#endif /* FREERTOS_CONFIG_H */
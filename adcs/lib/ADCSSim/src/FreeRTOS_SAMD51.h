@@ -0,0 +1,27 @@
+/**
+ * @brief      Stands in for lib/FreeRTOS-SAMD51 in the sim environment: the
+ *             same kernel, on the port in port.cpp.
+ */
+#ifndef FREE_RTOS_SAMD51_SIM_H
+#define FREE_RTOS_SAMD51_SIM_H
+
+#include <Arduino.h>
+
+#include <FreeRTOS.h>
+#include <event_groups.h>
+#include <message_buffer.h>
+#include <queue.h>
+#include <semphr.h>
+#include <stream_buffer.h>
+#include <task.h>
+#include <timers.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+	void vNopDelayMS(unsigned long millis);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * @brief      SPI of the simulated SAMD51. Nothing is connected, it only lets
+ *             the ICM-20948 library build, the IMU is on I2C.
+ */
+#ifndef SPI_H
+#define SPI_H
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x02
+#define SPI_MODE1 0x00
+#define SPI_MODE2 0x03
+#define SPI_MODE3 0x01
+
+class SPISettings
+{
+public:
+	SPISettings(void) {}
+	SPISettings(uint32_t clock, uint8_t order, uint8_t mode) {}
+};
+
+class SPIClass
+{
+public:
+	void begin(void) {}
+	void end(void) {}
+	void beginTransaction(SPISettings settings) {}
+	void endTransaction(void) {}
+	uint8_t transfer(uint8_t data) { return 0xff; }
+};
+
+extern SPIClass SPI;
+
+#endif
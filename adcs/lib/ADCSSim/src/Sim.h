@@ -0,0 +1,92 @@
+/**
+ * @brief      Simulated SAMD51 board that runs the ADCS firmware on a PC.
+ * @details    The firmware in src/ is compiled unchanged against a simulated
+ *             Arduino core (Arduino.h, Wire.h), simulated sensors and
+ *             actuators wired to a rigid body model, and FreeRTOS on a
+ *             simulated clock (port.cpp).
+ *
+ *             Simulated time only moves when the firmware does something that
+ *             takes time on the MCU: a bus transfer, a GPIO access, an ADC
+ *             conversion, or waiting in the idle task. When every task is
+ *             blocked the clock jumps straight to the next tick, so the ADCS
+ *             runs many times faster than real time and every run with the
+ *             same options is identical.
+ *
+ *             Each task is a thread, but only the one the kernel picked runs.
+ *             The tick and peripheral interrupts run in whichever thread
+ *             moves the clock past a millisecond, outside critical sections.
+ *             A peripheral can also raise an interrupt between two ticks with
+ *             simIRQAt, e.g. the I2C master once a byte is on the bus.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+// simulated time taken by operations of the SAMD51 at 120 MHz
+#define SIM_GPIO_US 1 // digitalRead/digitalWrite, micros, millis
+#define SIM_ADC_US 10 // one analogRead conversion
+#define SIM_I2C_ISR_US 1 // one SERCOM_I2C interrupt of the transfer queue
+
+/* OPTIONS ================================================================== */
+
+typedef struct
+{
+	double seconds;		  // simulated run time, the program exits after it
+	uint32_t seed;		  // sensor noise
+	double rate_dps[3];	  // initial body rate
+	const char *uart_out; // capture of the bytes sent on SERCOM_UART, or NULL
+	bool quiet;			  // drop the SERCOM_USB debug output
+	double cpu_scale;	  // host CPU time is multiplied by this and added to the clock, 0 for none
+	bool tickless;		  // the idle task sleeps with the tick suppressed, as on the board
+} SimOptions;
+
+extern SimOptions sim_options;
+
+/* CLOCK ==================================================================== */
+
+uint64_t simMicros(void);
+void simBusy(uint32_t us);
+void simIdle(void);
+bool simSchedulerRunning(void);
+
+/* POWER ==================================================================== */
+
+/**
+ * @brief      Wakeups of the MCU since the scheduler started. It wakes up for
+ *             every tick interrupt, for other interrupts while it sleeps with
+ *             the tick suppressed, and for the interrupt of a peripheral it
+ *             waits for with the tick running.
+ */
+typedef struct
+{
+	uint32_t ticks;		  // tick interrupts
+	uint32_t sleeps;	  // sleeps with the tick suppressed
+	uint32_t interrupted; // sleeps ended by another interrupt before the tick
+	uint64_t asleep_us;	  // time spent in those sleeps
+	uint32_t waits;		  // waits for a timed interrupt due before the tick
+	uint64_t waiting_us;  // time spent in those waits
+	uint64_t run_us;	  // time since the scheduler started
+} SimPowerStats;
+
+SimPowerStats simPowerStats(void);
+
+/* INTERRUPTS =============================================================== */
+
+typedef void (*SimHandler)(void);
+
+void simSetVector(int irq, SimHandler handler);
+void simEnableIRQ(int irq, bool enable);
+void simIRQ(int irq);
+void simIRQAt(int irq, uint64_t at_us);
+void simCancelIRQ(int irq);
+
+/* BOARD ==================================================================== */
+
+void simBoardInit(void);
+void simBoardTick(uint64_t now_us);
+void simCommand(uint32_t t_ms, uint8_t command);
+void simUARTWrite(uint8_t b);
+void simReport(void);
+
+#endif
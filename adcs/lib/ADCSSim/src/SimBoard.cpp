@@ -0,0 +1,619 @@
+/**
+ * @brief      The simulated ADCS board: pins, ADC and UART of the SAMD51 wired
+ *             to the sensor models and the dynamics, the scenario and main().
+ * @details    Run from the adcs folder after `pio run -e sim`:
+ *
+ *               .pio/build/sim/program --seconds 60 --rate 0,0,20 \
+ *                   --cmd 2000:a4 --uart detumble.bin --quiet
+ *
+ *             --seconds S    simulated run time, default 10
+ *             --cmd T:HEX    the satellite sends command byte HEX at T ms,
+ *                            repeat for a sequence
+ *             --rate X,Y,Z   initial body rate in deg/s
+ *             --seed N       sensor noise seed, default 1
+ *             --uart FILE    capture of the UART to the satellite, for
+ *                            tools/capture_decoder
+ *             --quiet        drop the SERCOM_USB debug output
+ *             --cpu-scale K  add host CPU time times K to the clock, see
+ *                            README.md
+ *             --no-tickless  run the tick every millisecond even when idle,
+ *                            to compare the wakeups
+ */
+#include "Sim.h"
+#include "SimDevices.h"
+#include "SimDynamics.h"
+
+#include <Arduino.h>
+#include <CRC16.h>
+#include <FreeRTOS_SAMD51.h>
+#include <Wire.h>
+#include <global_definitions.h>
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// photodiode multiplexer, see sunSensors in src/sensors.cpp
+#define SIM_SUN_PIN A0
+#define SIM_SUN_MUX_A 13
+#define SIM_SUN_MUX_B 12
+#define SIM_SUN_MUX_C 11
+
+// I2C addresses, see src/sensors.cpp
+#define SIM_ICM_ADDR (0x68 | AD0_VAL)
+#define SIM_INA_ADDR (1000000 & 0xff)
+
+// COMMAND_LEN in include/comm.h
+#define SIM_COMMAND_LEN 4
+#define SIM_MAX_COMMANDS 32
+
+// SERCOM_UART at 115200 baud, 8 data bits, parity and stop bit
+#define SIM_UART_BYTES_PER_MS (115200.0 / 11 / 1000)
+#define SIM_UART_RX_FIFO_LEN 64
+
+// sensor noise, one standard deviation
+#define SIM_GYRO_NOISE_DPS 0.05
+#define SIM_ACCEL_NOISE_G 0.002
+#define SIM_MAG_NOISE_UT 0.3
+#define SIM_SUN_NOISE_LSB 5.0
+#define SIM_INA_NOISE_MA 1.0
+
+// flywheel frequency generator output, edges per revolution
+#define SIM_FG_EDGES_PER_REV 6
+
+SimOptions sim_options = {10.0, 1, {0.0, 0.0, 0.0}, NULL, false, 0.0, true};
+
+SERCOM sercom5;
+
+static SimDynamics dynamics;
+static SimAK09916 ak09916;
+static SimICM20948 icm20948(SIM_ICM_ADDR, ak09916);
+static SimINA209 ina209_sim(SIM_INA_ADDR);
+
+static uint8_t pin_level[SIM_NUM_PINS];
+static int pwm_value[SIM_NUM_PINS];
+static int adc_bits = 10;
+
+// external interrupts of attachInterrupt, all behind EIC_0_IRQn
+static voidFuncPtr eic_callback[SIM_NUM_PINS];
+static uint32_t eic_mode[SIM_NUM_PINS];
+static bool eic_flag[SIM_NUM_PINS];
+static uint32_t eic_interrupts = 0;
+
+static double wheel_angle = 0.0; // rad, for the FG pin
+static uint64_t last_tick_us = 0;
+
+typedef struct
+{
+	uint32_t t_ms;
+	uint8_t command;
+} SimScheduledCommand;
+
+static SimScheduledCommand commands[SIM_MAX_COMMANDS];
+static uint8_t num_commands = 0;
+static uint8_t next_command = 0;
+
+static uint8_t rx_fifo[SIM_UART_RX_FIFO_LEN];
+static uint8_t rx_head = 0;
+static uint8_t rx_tail = 0;
+static bool dre_enabled = false;
+static double tx_credit = 0.0;
+
+static FILE *uart_file = NULL;
+static uint32_t uart_bytes = 0;
+
+static uint64_t prng_state;
+static struct timespec wall_start;
+
+/* NOISE ==================================================================== */
+
+static double uniform(void)
+{
+	// xorshift64*
+	prng_state ^= prng_state >> 12;
+	prng_state ^= prng_state << 25;
+	prng_state ^= prng_state >> 27;
+	return ((prng_state * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian(double sigma)
+{
+	double u = uniform();
+	double v = uniform();
+	return sigma * sqrt(-2.0 * log(u + 1e-300)) * cos(2.0 * M_PI * v);
+}
+
+/* PINS ===================================================================== */
+
+void pinMode(uint32_t pin, uint32_t mode)
+{
+	simBusy(SIM_GPIO_US);
+}
+
+void digitalWrite(uint32_t pin, uint32_t value)
+{
+	simBusy(SIM_GPIO_US);
+	if (pin < SIM_NUM_PINS)
+		pin_level[pin] = value ? HIGH : LOW;
+}
+
+/**
+ * @brief      Reads a pin, FG toggles with the wheel angle and RD reports the
+ *             spindle as free
+ */
+int digitalRead(uint32_t pin)
+{
+	simBusy(SIM_GPIO_US);
+
+	if (pin == FG_PIN)
+	{
+		double t = (simMicros() - last_tick_us) / 1e6;
+		double revs = (wheel_angle + fabs(dynamics.wheel_speed) * t) / (2.0 * M_PI);
+		return (int)floor(revs * SIM_FG_EDGES_PER_REV) & 1;
+	}
+	if (pin == RD_PIN)
+		return HIGH;
+
+	return pin < SIM_NUM_PINS ? pin_level[pin] : LOW;
+}
+
+void analogWrite(uint32_t pin, int value)
+{
+	simBusy(SIM_GPIO_US);
+	if (pin < SIM_NUM_PINS)
+		pwm_value[pin] = value;
+}
+
+void analogReadResolution(int bits)
+{
+	adc_bits = bits;
+}
+
+void analogWriteResolution(int bits)
+{
+}
+
+/**
+ * @brief      Converts the photodiode selected by the multiplexer, faces X+,
+ *             X-, Y+, Y-, Z+, Z- on channels 0 to 5
+ */
+int analogRead(uint32_t pin)
+{
+	simBusy(SIM_ADC_US);
+
+	if (pin != SIM_SUN_PIN)
+		return 0;
+
+	int channel = pin_level[SIM_SUN_MUX_A] | pin_level[SIM_SUN_MUX_B] << 1 | pin_level[SIM_SUN_MUX_C] << 2;
+	if (channel > 5)
+		return 0;
+
+	double sun[3];
+	dynamics.sunDir(sun);
+
+	double cosine = (channel % 2 == 0 ? 1.0 : -1.0) * sun[channel / 2];
+	double counts = 40.0 + 3300.0 * (cosine > 0.0 ? cosine : 0.0) + gaussian(SIM_SUN_NOISE_LSB);
+
+	if (counts < 0.0)
+		counts = 0.0;
+	if (counts > 4095.0)
+		counts = 4095.0;
+	return (int)counts >> (12 - adc_bits);
+}
+
+/* EXTERNAL INTERRUPTS ====================================================== */
+
+static void eicHandler(void)
+{
+	for (uint32_t pin = 0; pin < SIM_NUM_PINS; pin++)
+	{
+		if (!eic_flag[pin])
+			continue;
+
+		eic_flag[pin] = false;
+		eic_interrupts++;
+		if (eic_callback[pin] != NULL)
+			eic_callback[pin]();
+	}
+}
+
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode)
+{
+	if (pin >= SIM_NUM_PINS)
+		return;
+
+	eic_callback[pin] = callback;
+	eic_mode[pin] = mode;
+	eic_flag[pin] = false;
+
+	simSetVector(EIC_0_IRQn, eicHandler);
+	simEnableIRQ(EIC_0_IRQn, true);
+}
+
+void detachInterrupt(uint32_t pin)
+{
+	if (pin < SIM_NUM_PINS)
+		eic_callback[pin] = NULL;
+}
+
+/**
+ * @brief      Flags the interrupt of pin if the edge is the one it waits for
+ */
+static void eicEdge(uint32_t pin, bool rising)
+{
+	if (eic_callback[pin] == NULL)
+		return;
+
+	uint32_t mode = eic_mode[pin];
+	if (mode == CHANGE || (mode == RISING && rising) || (mode == FALLING && !rising))
+		eic_flag[pin] = true;
+}
+
+/**
+ * @brief      Drives IMU_INT_PIN from the ICM-20948. A 50 us pulse has both
+ *             edges within the step.
+ *
+ * @param[in]  pulse  INT pulsed for a new sample
+ */
+static void imuIntTick(bool pulse)
+{
+	bool level = icm20948.intLevel();
+
+	if (pulse)
+	{
+		eicEdge(IMU_INT_PIN, true);
+		eicEdge(IMU_INT_PIN, false);
+	}
+	else if (level != pin_level[IMU_INT_PIN])
+	{
+		eicEdge(IMU_INT_PIN, level);
+	}
+	pin_level[IMU_INT_PIN] = level;
+
+	// the interrupt would end a sleep, only raise it for an edge
+	if (eic_flag[IMU_INT_PIN])
+		simIRQ(EIC_0_IRQn);
+}
+
+/* UART ===================================================================== */
+
+bool SERCOM::availableDataUART(void)
+{
+	return rx_head != rx_tail;
+}
+
+uint8_t SERCOM::readDataUART(void)
+{
+	if (rx_head == rx_tail)
+		return 0;
+
+	uint8_t b = rx_fifo[rx_tail];
+	rx_tail = (rx_tail + 1) % SIM_UART_RX_FIFO_LEN;
+	return b;
+}
+
+int SERCOM::writeDataUART(uint8_t data)
+{
+	simUARTWrite(data);
+	return 1;
+}
+
+/**
+ * @brief      Polled transmit, see sendFramePolled. The wait for the previous
+ *             byte to leave is taken here, so the register is always empty.
+ */
+bool SERCOM::isDataRegisterEmptyUART(void)
+{
+	simBusy((uint32_t)(1000.0 / SIM_UART_BYTES_PER_MS));
+	return true;
+}
+
+void SERCOM::enableDataRegisterEmptyInterruptUART(void)
+{
+	dre_enabled = true;
+}
+
+void SERCOM::disableDataRegisterEmptyInterruptUART(void)
+{
+	dre_enabled = false;
+}
+
+/**
+ * @brief      A byte leaves the ADCS for the satellite
+ */
+void simUARTWrite(uint8_t b)
+{
+	uart_bytes++;
+	if (uart_file != NULL)
+		fputc(b, uart_file);
+}
+
+static void uartReceive(uint8_t b)
+{
+	uint8_t head = (rx_head + 1) % SIM_UART_RX_FIFO_LEN;
+
+	if (head != rx_tail) // overrun drops the byte
+	{
+		rx_fifo[rx_head] = b;
+		rx_head = head;
+	}
+}
+
+/**
+ * @brief      Schedules a command frame from the satellite, in order of time
+ */
+void simCommand(uint32_t t_ms, uint8_t command)
+{
+	if (num_commands >= SIM_MAX_COMMANDS)
+		return;
+
+	uint8_t i = num_commands++;
+	while (i > 0 && commands[i - 1].t_ms > t_ms)
+	{
+		commands[i] = commands[i - 1];
+		i--;
+	}
+	commands[i].t_ms = t_ms;
+	commands[i].command = command;
+}
+
+/**
+ * @brief      Sends the commands that are due, frames built like the ones
+ *             TEScommand checks
+ */
+static void uartTick(uint64_t now_us)
+{
+	while (next_command < num_commands && commands[next_command].t_ms * 1000ULL <= now_us)
+	{
+		uint8_t frame[SIM_COMMAND_LEN] = {commands[next_command++].command, 0x00};
+		CRC16 crc;
+		crc.add(frame, SIM_COMMAND_LEN - 2);
+		frame[2] = crc.getCRC() & 0xff;
+		frame[3] = crc.getCRC() >> 8;
+
+		for (int i = 0; i < SIM_COMMAND_LEN; i++)
+			uartReceive(frame[i]);
+	}
+
+	// receive complete stays asserted while the FIFO holds data
+	if (rx_head != rx_tail)
+		simIRQ(SERCOM_UART_RX_IRQn);
+
+	// data register empty, once per byte time on the wire
+	tx_credit += SIM_UART_BYTES_PER_MS;
+	while (dre_enabled && tx_credit >= 1.0)
+	{
+		tx_credit -= 1.0;
+		simIRQ(SERCOM_UART_TX_IRQn);
+	}
+	if (tx_credit > 1.0)
+		tx_credit = 1.0;
+}
+
+/* BOARD ==================================================================== */
+
+/**
+ * @brief      Drives the dynamics model from the actuator pins
+ */
+static void actuatorTick(void)
+{
+	bool buck = pin_level[BEN_PIN];
+	uint8_t mtx[2][2] = {{MTX1_F_PIN, MTX1_R_PIN}, {MTX2_F_PIN, MTX2_R_PIN}};
+
+	for (int i = 0; i < 2; i++)
+	{
+		bool f = pin_level[mtx[i][0]];
+		bool r = pin_level[mtx[i][1]];
+		dynamics.mtx_on[i] = (buck && f != r) ? (f ? 1.0 : -1.0) : 0.0;
+	}
+
+	// FR low is CW in DRV10970.h, taken as +z
+	dynamics.wheel_enabled = pin_level[MEN_PIN];
+	dynamics.wheel_duty = (pin_level[FR_PIN] ? -1.0 : 1.0) * pwm_value[PWM_PIN] / 255.0;
+}
+
+static void sensorTick(uint64_t now_us)
+{
+	SimSensorInputs in;
+
+	dynamics.attitude(in.attitude);
+	dynamics.rateDPS(in.rate_dps);
+	dynamics.gravityG(in.accel_g);
+	dynamics.fieldUT(in.mag_uT);
+	for (int i = 0; i < 3; i++)
+	{
+		in.rate_dps[i] += gaussian(SIM_GYRO_NOISE_DPS);
+		in.accel_g[i] += gaussian(SIM_ACCEL_NOISE_G);
+		in.mag_uT[i] += gaussian(SIM_MAG_NOISE_UT);
+	}
+	in.temp_C = 25.0;
+	in.bus_mA = dynamics.busCurrentMA() + gaussian(SIM_INA_NOISE_MA);
+	in.bus_V = dynamics.busVoltageV();
+
+	bool pulse = icm20948.update(now_us, in);
+	ina209_sim.update(now_us, in);
+
+	imuIntTick(pulse);
+}
+
+/**
+ * @brief      Connects the sensors and applies the options, before setup()
+ */
+void simBoardInit(void)
+{
+	prng_state = 0x9e3779b97f4a7c15ULL ^ sim_options.seed;
+	if (prng_state == 0)
+		prng_state = 1;
+
+	dynamics.setRate(sim_options.rate_dps);
+
+	Wire.attach(&icm20948);
+	Wire.attach(&ina209_sim);
+
+	if (sim_options.uart_out != NULL)
+	{
+		uart_file = fopen(sim_options.uart_out, "wb");
+		if (uart_file == NULL)
+		{
+			perror(sim_options.uart_out);
+			exit(1);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &wall_start);
+}
+
+/**
+ * @brief      Runs every simulated millisecond from the SysTick handler, before
+ *             the kernel tick
+ */
+void simBoardTick(uint64_t now_us)
+{
+	actuatorTick();
+	dynamics.step((now_us - last_tick_us) / 1e6);
+
+	wheel_angle = fmod(wheel_angle + fabs(dynamics.wheel_speed) * (now_us - last_tick_us) / 1e6, 2.0 * M_PI);
+	last_tick_us = now_us;
+
+	sensorTick(now_us);
+	uartTick(now_us);
+
+	if (now_us >= (uint64_t)(sim_options.seconds * 1e6))
+	{
+		simReport();
+		exit(0);
+	}
+}
+
+/**
+ * @brief      Prints the run summary and the CPU time of every task to stderr
+ */
+void simReport(void)
+{
+	struct timespec wall_end;
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+	double wall = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+	double sim = simMicros() / 1e6;
+
+	fflush(stdout);
+	if (uart_file != NULL)
+		fclose(uart_file);
+
+	double rate[3];
+	dynamics.rateDPS(rate);
+
+	fprintf(stderr, "[sim]\t\t%.3f s simulated in %.3f s, %.1fx real time\n", sim, wall, wall > 0 ? sim / wall : 0.0);
+	fprintf(stderr, "[sim]\t\tuart %lu bytes, i2c %lu transactions, imu %lu samples, %lu dmp packets, %lu pin interrupts\n",
+			(unsigned long)uart_bytes, (unsigned long)Wire.transactions(), (unsigned long)icm20948.samples,
+			(unsigned long)icm20948.dmp_packets, (unsigned long)eic_interrupts);
+	fprintf(stderr, "[sim]\t\tbody rate %.2f %.2f %.2f deg/s, wheel %.1f rad/s\n",
+			rate[0], rate[1], rate[2], dynamics.wheel_speed);
+
+	if (!simSchedulerRunning())
+		return;
+
+	SimPowerStats power = simPowerStats();
+	double run_s = power.run_us / 1e6;
+	uint32_t wakeups = power.ticks + power.interrupted + power.waits;
+
+	fprintf(stderr, "[sim]\t\twakeups %lu, %.1f/s: %lu ticks, %lu sleeps ended by an interrupt, %lu waits\n",
+			(unsigned long)wakeups, run_s > 0 ? wakeups / run_s : 0.0, (unsigned long)power.ticks,
+			(unsigned long)power.interrupted, (unsigned long)power.waits);
+	fprintf(stderr, "[sim]\t\tasleep %.1f%% of the time in %lu sleeps with the tick suppressed\n",
+			power.run_us > 0 ? 100.0 * power.asleep_us / power.run_us : 0.0, (unsigned long)power.sleeps);
+	fprintf(stderr, "[sim]\t\twaiting %.1f%% of the time for a peripheral interrupt with the tick running\n",
+			power.run_us > 0 ? 100.0 * power.waiting_us / power.run_us : 0.0);
+
+	TaskStatus_t status[24];
+	uint32_t total;
+	UBaseType_t n = uxTaskGetSystemState(status, 24, &total);
+
+	for (UBaseType_t i = 0; i < n; i++)
+	{
+		fprintf(stderr, "[sim]\t\t%-16s %10lu us %6.2f%%\n", status[i].pcTaskName,
+				(unsigned long)status[i].ulRunTimeCounter,
+				total > 0 ? 100.0 * status[i].ulRunTimeCounter / total : 0.0);
+	}
+}
+
+/* MAIN ===================================================================== */
+
+void setup(void);
+void loop(void);
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+			"usage: %s [--seconds S] [--cmd T:HEX]... [--rate X,Y,Z] [--seed N]\n"
+			"          [--uart FILE] [--quiet] [--cpu-scale K] [--no-tickless]\n",
+			name);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_options[] = {
+		{"seconds", required_argument, NULL, 's'},
+		{"cmd", required_argument, NULL, 'c'},
+		{"rate", required_argument, NULL, 'r'},
+		{"seed", required_argument, NULL, 'n'},
+		{"uart", required_argument, NULL, 'u'},
+		{"quiet", no_argument, NULL, 'q'},
+		{"cpu-scale", required_argument, NULL, 'k'},
+		{"no-tickless", no_argument, NULL, 't'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "s:c:r:n:u:qk:th", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			sim_options.seconds = atof(optarg);
+			break;
+		case 'c':
+		{
+			unsigned long t_ms;
+			unsigned int command;
+			if (sscanf(optarg, "%lu:%x", &t_ms, &command) != 2 || command > 0xff)
+				usage(argv[0]);
+			simCommand(t_ms, command);
+			break;
+		}
+		case 'r':
+			if (sscanf(optarg, "%lf,%lf,%lf", &sim_options.rate_dps[0], &sim_options.rate_dps[1],
+					   &sim_options.rate_dps[2]) != 3)
+				usage(argv[0]);
+			break;
+		case 'n':
+			sim_options.seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			sim_options.uart_out = optarg;
+			break;
+		case 'q':
+			sim_options.quiet = true;
+			break;
+		case 'k':
+			sim_options.cpu_scale = atof(optarg);
+			break;
+		case 't':
+			sim_options.tickless = false;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	simBoardInit();
+
+	// as the Arduino core does, setup() starts the scheduler and never returns
+	setup();
+	while (1)
+		loop();
+}
@@ -0,0 +1,656 @@
+/**
+ * @brief      Register level models of the ICM-20948, AK09916 and INA209.
+ */
+#include "SimDevices.h"
+
+#include <math.h>
+#include <string.h>
+
+// ICM-20948 registers, bank 0 unless noted, see util/ICM_20948_REGISTERS.h
+#define ICM_WHO_AM_I 0x00
+#define ICM_USER_CTRL 0x03
+#define ICM_LP_CONFIG 0x05
+#define ICM_PWR_MGMT_1 0x06
+#define ICM_INT_PIN_CFG 0x0f
+#define ICM_INT_ENABLE_1 0x11
+#define ICM_I2C_MST_STATUS 0x17
+#define ICM_INT_STATUS_1 0x1a
+#define ICM_ACCEL_XOUT_H 0x2d
+#define ICM_GYRO_XOUT_H 0x33
+#define ICM_TEMP_OUT_H 0x39
+#define ICM_EXT_SENS_DATA_00 0x3b
+#define ICM_FIFO_EN_2 0x67
+#define ICM_FIFO_RST 0x68
+#define ICM_FIFO_MODE 0x69
+#define ICM_FIFO_COUNTH 0x70
+#define ICM_FIFO_COUNTL 0x71
+#define ICM_FIFO_R_W 0x72
+#define ICM_MEM_START_ADDR 0x7c
+#define ICM_MEM_R_W 0x7d
+#define ICM_MEM_BANK_SEL 0x7e
+#define ICM_BANK_SEL 0x7f
+#define ICM_B2_GYRO_SMPLRT_DIV 0x00
+#define ICM_B2_GYRO_CONFIG_1 0x01
+#define ICM_B2_ACCEL_CONFIG 0x14
+#define ICM_B3_PERIPH0_ADDR 0x03 // PERIPHn at 0x03 + 4n: ADDR, REG, CTRL, DO
+#define ICM_B3_PERIPH4_ADDR 0x13
+#define ICM_B3_PERIPH4_REG 0x14
+#define ICM_B3_PERIPH4_CTRL 0x15
+#define ICM_B3_PERIPH4_DO 0x16
+#define ICM_B3_PERIPH4_DI 0x17
+
+#define ICM_WHO_AM_I_VAL 0xea
+#define ICM_PWR_MGMT_1_RESET 0x80
+#define ICM_PWR_MGMT_1_SLEEP 0x40
+#define ICM_USER_CTRL_DMP_EN 0x80
+#define ICM_USER_CTRL_FIFO_EN 0x40
+#define ICM_USER_CTRL_I2C_MST_EN 0x20
+#define ICM_USER_CTRL_DMP_RST 0x08
+#define ICM_USER_CTRL_I2C_MST_RST 0x02
+#define ICM_MST_STATUS_PERIPH4_NACK 0x10
+#define ICM_MST_STATUS_PERIPH4_DONE 0x40
+#define ICM_PERIPH_EN 0x80
+#define ICM_PERIPH_RNW 0x80
+#define ICM_PERIPH_LENG 0x0f
+#define ICM_RAW_DATA_0_RDY 0x01
+#define ICM_RAW_DATA_0_RDY_EN 0x01
+#define ICM_INT1_ACTL 0x80
+#define ICM_INT1_LATCH_EN 0x20
+#define ICM_INT_ANYRD_2CLEAR 0x10
+#define ICM_GYRO_FCHOICE 0x01
+#define ICM_ACCEL_FIFO_EN 0x10
+#define ICM_GYRO_X_FIFO_EN 0x02 // Y and Z in the next two bits
+
+#define ICM_GYRO_ODR_HZ 1125.0
+#define ICM_GYRO_ODR_NO_DLPF_HZ 9000.0
+#define ICM_TEMP_LSB_PER_C 333.87
+#define ICM_TEMP_OFFSET_C 21.0
+
+// DMP memory and packets, see util/ICM_20948_DMP.h
+#define DMP_DATA_OUT_CTL1 0x40
+#define DMP_DATA_OUT_CTL2 0x42
+#define DMP_OUT_GYRO 0x4000
+#define DMP_OUT_QUAT6 0x0800
+#define DMP_OUT_QUAT9 0x0400
+#define DMP_OUT_GYRO_CALIBR 0x0040
+#define DMP_OUT_COMPASS_CALIBR 0x0020
+#define DMP_OUT_HEADER2 0x0008
+#define DMP_OUT2_ACCEL_ACCURACY 0x4000
+#define DMP_OUT2_GYRO_ACCURACY 0x2000
+#define DMP_OUT2_COMPASS_ACCURACY 0x1000
+#define DMP_ACCURACY_HIGH 3
+
+// AK09916 registers, see util/AK09916_REGISTERS.h
+#define AK_I2C_ADDR 0x0c
+#define AK_WIA1 0x00
+#define AK_WIA2 0x01
+#define AK_ST1 0x10
+#define AK_HXL 0x11
+#define AK_ST2 0x18
+#define AK_CNTL2 0x31
+#define AK_CNTL3 0x32
+
+#define AK_ST1_DRDY 0x01
+#define AK_ST1_DOR 0x02
+#define AK_CNTL3_SRST 0x01
+#define AK_MODE_SINGLE 0x01
+#define AK_UT_PER_LSB 0.15
+
+// INA209 registers
+#define INA_CONFIG 0x00
+#define INA_SHUNT_V 0x03
+#define INA_BUS_V 0x04
+#define INA_CURRENT 0x06
+#define INA_CONFIG_DEFAULT 0x399f
+#define INA_BUS_CNVR 0x0002
+#define INA_SHUNT_OHM 0.1
+
+static int16_t saturate16(double value)
+{
+	if (value >= 32767.0)
+		return 32767;
+	if (value <= -32768.0)
+		return -32768;
+	return (int16_t)lround(value);
+}
+
+static uint8_t *putBE16(uint8_t *p, uint16_t value)
+{
+	p[0] = (uint8_t)(value >> 8);
+	p[1] = (uint8_t)value;
+	return p + 2;
+}
+
+static uint8_t *putBE32(uint8_t *p, int32_t value)
+{
+	p = putBE16(p, (uint16_t)((uint32_t)value >> 16));
+	return putBE16(p, (uint16_t)value);
+}
+
+/* AK09916 ================================================================== */
+
+SimAK09916::SimAK09916(void)
+{
+	memset(_regs, 0, sizeof(_regs));
+	_regs[AK_WIA1] = 0x48;
+	_regs[AK_WIA2] = 0x09;
+	_next_us = 0;
+}
+
+uint8_t SimAK09916::read(uint8_t reg)
+{
+	if (reg >= sizeof(_regs))
+		return 0;
+
+	uint8_t value = _regs[reg];
+
+	// reading ST2 ends the data read, ready for the next measurement
+	if (reg == AK_ST2)
+		_regs[AK_ST1] &= ~(AK_ST1_DRDY | AK_ST1_DOR);
+	return value;
+}
+
+void SimAK09916::write(uint8_t reg, uint8_t data)
+{
+	if (reg == AK_CNTL3 && (data & AK_CNTL3_SRST))
+	{
+		memset(&_regs[AK_ST1], 0, AK_ST2 - AK_ST1 + 1);
+		_regs[AK_CNTL2] = 0;
+	}
+	else if (reg == AK_CNTL2)
+	{
+		_regs[AK_CNTL2] = data & 0x1f;
+		_next_us = 0; // first measurement right away
+	}
+}
+
+/**
+ * @brief      Takes a measurement when one is due in the mode set in CNTL2
+ */
+void SimAK09916::update(uint64_t now_us, const SimSensorInputs &in)
+{
+	uint8_t mode = _regs[AK_CNTL2];
+	uint32_t period_us;
+
+	switch (mode)
+	{
+	case AK_MODE_SINGLE: period_us = 0; break;
+	case 0x02: period_us = 100000; break; // 10 Hz
+	case 0x04: period_us = 50000; break;  // 20 Hz
+	case 0x06: period_us = 20000; break;  // 50 Hz
+	case 0x08: period_us = 10000; break;  // 100 Hz
+	default: return;					  // power down
+	}
+
+	if (now_us < _next_us)
+		return;
+
+	// the AK09916 Y and Z axes point opposite to those of the ICM-20948
+	int16_t hx = saturate16(in.mag_uT[0] / AK_UT_PER_LSB);
+	int16_t hy = saturate16(-in.mag_uT[1] / AK_UT_PER_LSB);
+	int16_t hz = saturate16(-in.mag_uT[2] / AK_UT_PER_LSB);
+	int16_t h[3] = {hx, hy, hz};
+
+	for (int i = 0; i < 3; i++)
+	{
+		_regs[AK_HXL + 2 * i] = (uint8_t)h[i];
+		_regs[AK_HXL + 2 * i + 1] = (uint8_t)((uint16_t)h[i] >> 8);
+	}
+
+	if (_regs[AK_ST1] & AK_ST1_DRDY)
+		_regs[AK_ST1] |= AK_ST1_DOR; // previous measurement never read
+	_regs[AK_ST1] |= AK_ST1_DRDY;
+
+	if (mode == AK_MODE_SINGLE)
+		_regs[AK_CNTL2] = 0;
+	else
+		_next_us = (_next_us == 0 ? now_us : _next_us) + period_us;
+}
+
+/* ICM-20948 ================================================================ */
+
+SimICM20948::SimICM20948(uint8_t addr, SimAK09916 &mag) : SimI2CDevice(addr), _mag(mag)
+{
+	samples = 0;
+	dmp_packets = 0;
+	memset(_dmp_mem, 0, sizeof(_dmp_mem));
+	reset();
+}
+
+/**
+ * @brief      Power on values of the registers the library reads back
+ */
+void SimICM20948::reset(void)
+{
+	memset(_regs, 0, sizeof(_regs));
+	reg(0, ICM_WHO_AM_I) = ICM_WHO_AM_I_VAL;
+	reg(0, ICM_USER_CTRL) = 0x00;
+	reg(0, ICM_LP_CONFIG) = 0x70;
+	reg(0, ICM_PWR_MGMT_1) = 0x41; // asleep
+	reg(2, ICM_B2_GYRO_CONFIG_1) = 0x01;
+	reg(2, ICM_B2_ACCEL_CONFIG) = 0x01;
+
+	_reg = 0;
+	_first = false;
+	_next_us = 0;
+	_int_latched = false;
+	_fifo_len = 0;
+	_fifo_countl = 0;
+}
+
+void SimICM20948::start(bool read)
+{
+	// a write starts with the register address, a read continues from it
+	_first = !read;
+}
+
+bool SimICM20948::write(uint8_t data)
+{
+	if (_first)
+	{
+		_reg = data & 0x7f;
+		_first = false;
+		return true;
+	}
+
+	writeReg(_reg, data);
+
+	// a burst to MEM_R_W keeps writing the DMP memory
+	if (!(bank() == 0 && _reg == ICM_MEM_R_W))
+		_reg = (_reg + 1) & 0x7f;
+	return true;
+}
+
+uint8_t SimICM20948::read(void)
+{
+	uint8_t value = readReg(_reg);
+
+	// a burst from FIFO_R_W or MEM_R_W keeps reading the FIFO or the memory
+	if (!(bank() == 0 && (_reg == ICM_FIFO_R_W || _reg == ICM_MEM_R_W)))
+		_reg = (_reg + 1) & 0x7f;
+	return value;
+}
+
+void SimICM20948::writeReg(uint8_t addr, uint8_t data)
+{
+	uint8_t b = bank();
+
+	if (addr == ICM_BANK_SEL)
+	{
+		reg(0, ICM_BANK_SEL) = data & 0x30;
+		return;
+	}
+
+	if (b == 0 && addr == ICM_PWR_MGMT_1 && (data & ICM_PWR_MGMT_1_RESET))
+	{
+		reset();
+		return;
+	}
+
+	if (b == 0 && addr == ICM_USER_CTRL)
+		data &= ~(ICM_USER_CTRL_I2C_MST_RST | ICM_USER_CTRL_DMP_RST); // self clearing
+
+	if (b == 0 && addr == ICM_MEM_R_W)
+	{
+		mem() = data;
+		return;
+	}
+
+	if (b == 0 && addr == ICM_FIFO_RST && (data & 0x1f))
+		_fifo_len = 0;
+
+	reg(b, addr) = data;
+
+	if (b == 3 && addr == ICM_B3_PERIPH4_CTRL && (data & ICM_PERIPH_EN))
+		periph4();
+}
+
+uint8_t SimICM20948::readReg(uint8_t addr)
+{
+	uint8_t b = addr == ICM_BANK_SEL ? 0 : bank();
+	uint8_t value = reg(b, addr);
+
+	// the count is latched when its high byte is read, reads of FIFO_R_W
+	// take the oldest byte
+	if (b == 0 && addr == ICM_FIFO_COUNTH)
+	{
+		value = (_fifo_len >> 8) & 0x1f;
+		_fifo_countl = _fifo_len & 0xff;
+	}
+	else if (b == 0 && addr == ICM_FIFO_COUNTL)
+		value = _fifo_countl;
+	else if (b == 0 && addr == ICM_FIFO_R_W)
+	{
+		value = 0xff;
+		if (_fifo_len > 0)
+		{
+			value = _fifo[0];
+			memmove(_fifo, _fifo + 1, --_fifo_len);
+		}
+	}
+	else if (b == 0 && addr == ICM_MEM_R_W)
+		value = mem();
+
+	// status registers clear when read
+	if (b == 0 && (addr == ICM_I2C_MST_STATUS || addr == ICM_INT_STATUS_1))
+		reg(b, addr) = 0;
+
+	// so does a latched INT, with INT_ANYRD_2CLEAR on any read
+	if ((b == 0 && addr == ICM_INT_STATUS_1) || (reg(0, ICM_INT_PIN_CFG) & ICM_INT_ANYRD_2CLEAR))
+		_int_latched = false;
+
+	return value;
+}
+
+/**
+ * @brief      Single byte transfer of the auxiliary I2C master, started by
+ *             setting EN in I2C_PERIPH4_CTRL
+ */
+void SimICM20948::periph4(void)
+{
+	uint8_t addr = reg(3, ICM_B3_PERIPH4_ADDR);
+	uint8_t mag_reg = reg(3, ICM_B3_PERIPH4_REG);
+	bool master = reg(0, ICM_USER_CTRL) & ICM_USER_CTRL_I2C_MST_EN;
+
+	reg(3, ICM_B3_PERIPH4_CTRL) &= ~ICM_PERIPH_EN;
+
+	if (!master || (addr & 0x7f) != AK_I2C_ADDR)
+	{
+		reg(0, ICM_I2C_MST_STATUS) |= ICM_MST_STATUS_PERIPH4_NACK | ICM_MST_STATUS_PERIPH4_DONE;
+		return;
+	}
+
+	if (addr & ICM_PERIPH_RNW)
+		reg(3, ICM_B3_PERIPH4_DI) = _mag.read(mag_reg);
+	else
+		_mag.write(mag_reg, reg(3, ICM_B3_PERIPH4_DO));
+
+	reg(0, ICM_I2C_MST_STATUS) |= ICM_MST_STATUS_PERIPH4_DONE;
+}
+
+/**
+ * @brief      Transfers of peripherals 0 to 3, run by the auxiliary I2C
+ *             master every sample. Bytes read go to EXT_SLV_SENS_DATA in
+ *             peripheral order.
+ */
+void SimICM20948::peripherals(void)
+{
+	if (!(reg(0, ICM_USER_CTRL) & ICM_USER_CTRL_I2C_MST_EN))
+		return;
+
+	uint8_t out = ICM_EXT_SENS_DATA_00;
+
+	for (uint8_t n = 0; n < 4; n++)
+	{
+		uint8_t addr = reg(3, ICM_B3_PERIPH0_ADDR + 4 * n);
+		uint8_t mag_reg = reg(3, ICM_B3_PERIPH0_ADDR + 4 * n + 1);
+		uint8_t ctrl = reg(3, ICM_B3_PERIPH0_ADDR + 4 * n + 2);
+		uint8_t data = reg(3, ICM_B3_PERIPH0_ADDR + 4 * n + 3);
+
+		if (!(ctrl & ICM_PERIPH_EN) || (addr & 0x7f) != AK_I2C_ADDR)
+			continue;
+
+		for (uint8_t i = 0; i < (ctrl & ICM_PERIPH_LENG); i++)
+		{
+			if (addr & ICM_PERIPH_RNW)
+			{
+				if (out < ICM_EXT_SENS_DATA_00 + 24)
+					reg(0, out++) = _mag.read(mag_reg + i);
+			}
+			else
+			{
+				_mag.write(mag_reg + i, data);
+			}
+		}
+	}
+}
+
+void SimICM20948::put16(uint8_t addr, int16_t value)
+{
+	reg(0, addr) = (uint8_t)((uint16_t)value >> 8);
+	reg(0, addr + 1) = (uint8_t)value;
+}
+
+/**
+ * @brief      Byte of the DMP memory at MEM_BANK_SEL and MEM_START_ADDR, which
+ *             moves on to the next one
+ */
+uint8_t &SimICM20948::mem(void)
+{
+	uint8_t &start = reg(0, ICM_MEM_START_ADDR);
+	uint16_t addr = (uint16_t)(reg(0, ICM_MEM_BANK_SEL) << 8) | start;
+
+	start++;
+	return _dmp_mem[addr];
+}
+
+/**
+ * @brief      Appends to the FIFO. A full FIFO drops the bytes in snapshot
+ *             mode and the oldest ones otherwise.
+ */
+void SimICM20948::fifoPut(const uint8_t *data, uint16_t len)
+{
+	if (_fifo_len + len > sizeof(_fifo))
+	{
+		if (reg(0, ICM_FIFO_MODE) & 0x1f)
+			return;
+
+		uint16_t drop = _fifo_len + len - sizeof(_fifo);
+		memmove(_fifo, _fifo + drop, _fifo_len - drop);
+		_fifo_len -= drop;
+	}
+
+	memcpy(_fifo + _fifo_len, data, len);
+	_fifo_len += len;
+}
+
+/**
+ * @brief      Appends the new sample to the FIFO for the sensors enabled in
+ *             FIFO_EN_2
+ */
+void SimICM20948::pushFifo(void)
+{
+	uint8_t en = reg(0, ICM_FIFO_EN_2);
+	uint8_t frame[12];
+	uint8_t len = 0;
+
+	if (!(reg(0, ICM_USER_CTRL) & ICM_USER_CTRL_FIFO_EN))
+		return;
+
+	if (en & ICM_ACCEL_FIFO_EN)
+	{
+		memcpy(frame, &reg(0, ICM_ACCEL_XOUT_H), 6);
+		len = 6;
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		if (en & (ICM_GYRO_X_FIFO_EN << i))
+		{
+			memcpy(frame + len, &reg(0, ICM_GYRO_XOUT_H + 2 * i), 2);
+			len += 2;
+		}
+	}
+
+	fifoPut(frame, len);
+}
+
+/**
+ * @brief      Appends the packet of the DMP for the new sample, with the
+ *             outputs of DATA_OUT_CTL1 and DATA_OUT_CTL2 the model makes: the
+ *             raw gyroscope and a zero bias, both quaternions from the true
+ *             attitude as nothing drifts here, the magnetic field as the
+ *             calibrated one, and the highest accuracies. The calibrated
+ *             gyroscope bit carries no bytes.
+ */
+void SimICM20948::pushDMP(const SimSensorInputs &in)
+{
+	const uint8_t on = ICM_USER_CTRL_DMP_EN | ICM_USER_CTRL_FIFO_EN;
+	uint8_t packet[64];
+	uint8_t *p = packet;
+
+	if ((reg(0, ICM_USER_CTRL) & on) != on)
+		return;
+
+	uint16_t ctl1 = (_dmp_mem[DMP_DATA_OUT_CTL1] << 8) | _dmp_mem[DMP_DATA_OUT_CTL1 + 1];
+	uint16_t ctl2 = (_dmp_mem[DMP_DATA_OUT_CTL2] << 8) | _dmp_mem[DMP_DATA_OUT_CTL2 + 1];
+	uint16_t header = ctl1 & (DMP_OUT_GYRO | DMP_OUT_QUAT6 | DMP_OUT_QUAT9 | DMP_OUT_GYRO_CALIBR | DMP_OUT_COMPASS_CALIBR);
+	uint16_t header2 = ctl2 & (DMP_OUT2_ACCEL_ACCURACY | DMP_OUT2_GYRO_ACCURACY | DMP_OUT2_COMPASS_ACCURACY);
+
+	if (header == 0)
+		return;
+	if (header2 != 0)
+		header |= DMP_OUT_HEADER2;
+
+	p = putBE16(p, header);
+	if (header2 != 0)
+		p = putBE16(p, header2);
+
+	if (header & DMP_OUT_GYRO)
+	{
+		memcpy(p, &reg(0, ICM_GYRO_XOUT_H), 6);
+		memset(p + 6, 0, 6);
+		p += 12;
+	}
+
+	// x, y and z scaled by 2^30, of the quaternion with w not negative
+	double sign = in.attitude[0] < 0 ? -1.0 : 1.0;
+	for (uint16_t quat = DMP_OUT_QUAT6; quat >= DMP_OUT_QUAT9; quat >>= 1)
+	{
+		if (!(header & quat))
+			continue;
+		for (int i = 1; i < 4; i++)
+			p = putBE32(p, (int32_t)lround(sign * in.attitude[i] * 1073741824.0));
+		if (quat == DMP_OUT_QUAT9)
+			p = putBE16(p, 0); // heading accuracy
+	}
+
+	if (header & DMP_OUT_COMPASS_CALIBR)
+	{
+		for (int i = 0; i < 3; i++)
+			p = putBE32(p, (int32_t)lround(in.mag_uT[i] * 65536.0));
+	}
+
+	for (uint16_t bit = DMP_OUT2_ACCEL_ACCURACY; bit >= DMP_OUT2_COMPASS_ACCURACY; bit >>= 1)
+	{
+		if (header2 & bit)
+			p = putBE16(p, DMP_ACCURACY_HIGH);
+	}
+
+	p = putBE16(p, 0); // footer
+	fifoPut(packet, p - packet);
+	dmp_packets++;
+}
+
+/**
+ * @brief      Updates the output registers at the gyroscope data rate while the
+ *             part is awake. The divider only applies with the DLPF on.
+ *
+ * @return     True if INT pulsed for the new sample, not in latch mode
+ */
+bool SimICM20948::update(uint64_t now_us, const SimSensorInputs &in)
+{
+	_mag.update(now_us, in);
+
+	if (reg(0, ICM_PWR_MGMT_1) & ICM_PWR_MGMT_1_SLEEP)
+		return false;
+
+	if (now_us < _next_us)
+		return false;
+
+	double period_us = 1e6 / ICM_GYRO_ODR_NO_DLPF_HZ;
+	if (reg(2, ICM_B2_GYRO_CONFIG_1) & ICM_GYRO_FCHOICE)
+		period_us = 1e6 * (1 + reg(2, ICM_B2_GYRO_SMPLRT_DIV)) / ICM_GYRO_ODR_HZ;
+	_next_us = (_next_us == 0 || now_us - _next_us > 100000) ? now_us : _next_us;
+	_next_us += (uint64_t)period_us;
+
+	// full scale select in bits 2:1 halves the sensitivity each step
+	uint8_t gyro_fs = (reg(2, ICM_B2_GYRO_CONFIG_1) >> 1) & 0x03;
+	uint8_t accel_fs = (reg(2, ICM_B2_ACCEL_CONFIG) >> 1) & 0x03;
+	double gyro_lsb = 131.0 / (1 << gyro_fs);
+	double accel_lsb = 16384.0 / (1 << accel_fs);
+
+	for (int i = 0; i < 3; i++)
+	{
+		put16(ICM_ACCEL_XOUT_H + 2 * i, saturate16(in.accel_g[i] * accel_lsb));
+		put16(ICM_GYRO_XOUT_H + 2 * i, saturate16(in.rate_dps[i] * gyro_lsb));
+	}
+	put16(ICM_TEMP_OUT_H, saturate16((in.temp_C - ICM_TEMP_OFFSET_C) * ICM_TEMP_LSB_PER_C));
+
+	peripherals();
+	pushFifo();
+	pushDMP(in);
+
+	reg(0, ICM_INT_STATUS_1) |= ICM_RAW_DATA_0_RDY;
+	samples++;
+
+	if (!(reg(0, ICM_INT_ENABLE_1) & ICM_RAW_DATA_0_RDY_EN))
+		return false;
+
+	if (reg(0, ICM_INT_PIN_CFG) & ICM_INT1_LATCH_EN)
+	{
+		_int_latched = true;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief      Level of the INT pin between pulses, active while latched
+ */
+bool SimICM20948::intLevel(void)
+{
+	bool active_low = reg(0, ICM_INT_PIN_CFG) & ICM_INT1_ACTL;
+	return _int_latched != active_low;
+}
+
+/* INA209 =================================================================== */
+
+SimINA209::SimINA209(uint8_t addr) : SimI2CDevice(addr)
+{
+	memset(_regs, 0, sizeof(_regs));
+	_regs[INA_CONFIG] = INA_CONFIG_DEFAULT;
+	_ptr = 0;
+	_count = 0;
+	_reading = false;
+}
+
+void SimINA209::start(bool read)
+{
+	_reading = read;
+	_count = 0;
+}
+
+/**
+ * @brief      First byte sets the register pointer, the next two are written
+ *             to the register MSB first
+ */
+bool SimINA209::write(uint8_t data)
+{
+	if (_count == 0)
+		_ptr = data % 0x20;
+	else if (_count == 1)
+		_regs[_ptr] = (uint16_t)data << 8;
+	else if (_count == 2)
+		_regs[_ptr] |= data;
+
+	_count++;
+	return true;
+}
+
+uint8_t SimINA209::read(void)
+{
+	uint16_t value = _regs[_ptr];
+	return (_count++ % 2 == 0) ? (uint8_t)(value >> 8) : (uint8_t)value;
+}
+
+/**
+ * @brief      Converts the bus voltage, 4 mV per LSB from bit 3, and the current
+ *             with the 100 uA LSB set up by initINA
+ */
+void SimINA209::update(uint64_t now_us, const SimSensorInputs &in)
+{
+	uint16_t bus = (uint16_t)(in.bus_V * 1000.0 / 4.0);
+	_regs[INA_BUS_V] = (uint16_t)(bus << 3) | INA_BUS_CNVR;
+	_regs[INA_SHUNT_V] = (uint16_t)saturate16(in.bus_mA * INA_SHUNT_OHM * 100.0); // 10 uV LSB
+	_regs[INA_CURRENT] = (uint16_t)saturate16(in.bus_mA * 10.0);
+}
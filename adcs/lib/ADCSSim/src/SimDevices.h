@@ -0,0 +1,149 @@
+/**
+ * @brief      Register level models of the I2C sensors on the ADCS board, the
+ *             ICM-20948 IMU with its AK09916 magnetometer and the INA209 power
+ *             monitor.
+ * @details    The models answer the unmodified SparkFun and INA209 libraries
+ *             the way the parts do: bank switching, the auxiliary I2C master
+ *             that fetches the magnetometer, data ready flags cleared on read,
+ *             the data ready interrupt on the INT pin, the accelerometer and
+ *             gyroscope FIFO, and big endian output registers. New readings come from
+ *             SimDynamics through update(), at the output data rate of the
+ *             part.
+ *
+ *             The DMP of the ICM-20948 is modelled by its outputs only: the
+ *             firmware written to its memory is kept for the driver to read
+ *             back, and while it is enabled every sample puts a packet in the
+ *             FIFO with the outputs set in DATA_OUT_CTL1, made from the true
+ *             attitude and the sensor inputs instead of by running the
+ *             firmware.
+ */
+#ifndef SIM_DEVICES_H
+#define SIM_DEVICES_H
+
+#include <stdint.h>
+
+/**
+ * @brief      Device on the simulated I2C bus
+ */
+class SimI2CDevice
+{
+public:
+	const uint8_t address;
+
+	SimI2CDevice(uint8_t addr) : address(addr) {}
+
+	// start condition addressed to this device, to write or to read
+	virtual void start(bool read) = 0;
+	// byte written by the master, false to NACK it
+	virtual bool write(uint8_t data) = 0;
+	// byte read by the master
+	virtual uint8_t read(void) = 0;
+};
+
+/**
+ * @brief      Physical quantities sampled by the sensors
+ */
+typedef struct
+{
+	double rate_dps[3]; // body rate
+	double accel_g[3];	// specific force
+	double mag_uT[3];	// magnetic field
+	double attitude[4]; // body to inertial quaternion, w x y z
+	double temp_C;
+	double bus_V;
+	double bus_mA;
+} SimSensorInputs;
+
+/* AK09916 ================================================================== */
+
+/**
+ * @brief      Magnetometer behind the ICM-20948, reached only through its
+ *             auxiliary I2C master
+ */
+class SimAK09916
+{
+private:
+	uint8_t _regs[0x40];
+	uint64_t _next_us;
+
+public:
+	SimAK09916(void);
+
+	uint8_t read(uint8_t reg);
+	void write(uint8_t reg, uint8_t data);
+	void update(uint64_t now_us, const SimSensorInputs &in);
+};
+
+/* ICM-20948 ================================================================ */
+
+/**
+ * @brief      ICM-20948 accelerometer and gyroscope with four register banks
+ */
+class SimICM20948 : public SimI2CDevice
+{
+private:
+	uint8_t _regs[4][128];
+	uint8_t _reg; // register pointer
+	bool _first;  // next written byte is the register address
+	uint64_t _next_us;
+	bool _int_latched; // INT held active until cleared, in latch mode
+	uint8_t _fifo[512];
+	uint16_t _fifo_len;
+	uint8_t _fifo_countl; // FIFO_COUNTL latched by reading FIFO_COUNTH
+	uint8_t _dmp_mem[0x10000]; // DMP memory, MEM_BANK_SEL selects 256 bytes
+
+	SimAK09916 &_mag;
+
+	uint8_t &reg(uint8_t bank, uint8_t addr) { return _regs[bank][addr & 0x7f]; }
+	uint8_t bank(void) { return (_regs[0][0x7f] >> 4) & 0x03; }
+
+	void reset(void);
+	void writeReg(uint8_t addr, uint8_t data);
+	uint8_t readReg(uint8_t addr);
+	void periph4(void);
+	void peripherals(void);
+	void put16(uint8_t addr, int16_t value);
+	uint8_t &mem(void);
+	void fifoPut(const uint8_t *data, uint16_t len);
+	void pushFifo(void);
+	void pushDMP(const SimSensorInputs &in);
+
+public:
+	uint32_t samples;	  // times the output registers were updated
+	uint32_t dmp_packets; // packets the DMP put in the FIFO
+
+	SimICM20948(uint8_t addr, SimAK09916 &mag);
+
+	void start(bool read);
+	bool write(uint8_t data);
+	uint8_t read(void);
+
+	bool update(uint64_t now_us, const SimSensorInputs &in);
+	bool intLevel(void);
+};
+
+/* INA209 =================================================================== */
+
+/**
+ * @brief      INA209 with a register pointer and 16 bit registers, measures
+ *             the bus voltage and current of the ADCS
+ */
+class SimINA209 : public SimI2CDevice
+{
+private:
+	uint16_t _regs[0x20];
+	uint8_t _ptr;
+	uint8_t _count; // bytes since start
+	bool _reading;
+
+public:
+	SimINA209(uint8_t addr);
+
+	void start(bool read);
+	bool write(uint8_t data);
+	uint8_t read(void);
+
+	void update(uint64_t now_us, const SimSensorInputs &in);
+};
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * @brief      Rigid body model of the ADCS test article.
+ */
+#include "SimDynamics.h"
+
+#include <math.h>
+#include <string.h>
+
+static const double field_uT[3] = SIM_FIELD_UT;
+static const double sun_dir[3] = SIM_SUN_DIR;
+static const double gravity_dir[3] = SIM_GRAVITY_DIR;
+
+SimDynamics::SimDynamics(void)
+{
+	_q[0] = 1.0;
+	_q[1] = _q[2] = _q[3] = 0.0;
+	_w[0] = _w[1] = _w[2] = 0.0;
+	wheel_speed = 0.0;
+	wheel_enabled = false;
+	wheel_duty = 0.0;
+	mtx_on[0] = mtx_on[1] = 0.0;
+}
+
+void SimDynamics::setRate(const double rate_dps[3])
+{
+	for (int i = 0; i < 3; i++)
+		_w[i] = rate_dps[i] * M_PI / 180.0;
+}
+
+/**
+ * @brief      Rotates an inertial vector into the body frame
+ */
+void SimDynamics::toBody(const double v[3], double b[3]) const
+{
+	double w = _q[0], x = _q[1], y = _q[2], z = _q[3];
+
+	// transpose of the rotation matrix of q
+	b[0] = (1 - 2 * (y * y + z * z)) * v[0] + 2 * (x * y + w * z) * v[1] + 2 * (x * z - w * y) * v[2];
+	b[1] = 2 * (x * y - w * z) * v[0] + (1 - 2 * (x * x + z * z)) * v[1] + 2 * (y * z + w * x) * v[2];
+	b[2] = 2 * (x * z + w * y) * v[0] + 2 * (y * z - w * x) * v[1] + (1 - 2 * (x * x + y * y)) * v[2];
+}
+
+/**
+ * @brief      Advances the state by dt seconds
+ * @details    The wheel follows its commanded speed with a first order lag,
+ *             the reaction torque and the magnetorquer torque m x B act on the
+ *             body, whose rate obeys Euler's equation with the wheel momentum.
+ */
+void SimDynamics::step(double dt)
+{
+	// wheel
+	double wheel_target = wheel_enabled ? wheel_duty * SIM_WHEEL_MAX_SPEED : 0.0;
+	double tau = wheel_enabled ? SIM_WHEEL_TIME_CONSTANT : SIM_WHEEL_COAST_TIME;
+	double wheel_accel = (wheel_target - wheel_speed) / tau;
+	wheel_speed += wheel_accel * dt;
+
+	// external torque of the magnetorquers, field in tesla
+	double b[3];
+	fieldUT(b);
+	for (int i = 0; i < 3; i++)
+		b[i] *= 1e-6;
+
+	double m[3] = {mtx_on[0] * SIM_MTX_DIPOLE, mtx_on[1] * SIM_MTX_DIPOLE, 0.0};
+	double torque[3] = {
+		m[1] * b[2] - m[2] * b[1],
+		m[2] * b[0] - m[0] * b[2],
+		m[0] * b[1] - m[1] * b[0],
+	};
+
+	// motor torque spins the wheel up and the body the other way
+	torque[2] -= SIM_WHEEL_INERTIA * wheel_accel;
+
+	// J dw/dt = torque - w x (J w + h_wheel)
+	double h[3] = {
+		SIM_BODY_INERTIA * _w[0],
+		SIM_BODY_INERTIA * _w[1],
+		SIM_BODY_INERTIA * _w[2] + SIM_WHEEL_INERTIA * wheel_speed,
+	};
+	double gyro[3] = {
+		_w[1] * h[2] - _w[2] * h[1],
+		_w[2] * h[0] - _w[0] * h[2],
+		_w[0] * h[1] - _w[1] * h[0],
+	};
+	for (int i = 0; i < 3; i++)
+		_w[i] += (torque[i] - gyro[i]) / SIM_BODY_INERTIA * dt;
+
+	// dq/dt = q * (0, w) / 2
+	double dq[4] = {
+		-_q[1] * _w[0] - _q[2] * _w[1] - _q[3] * _w[2],
+		_q[0] * _w[0] + _q[2] * _w[2] - _q[3] * _w[1],
+		_q[0] * _w[1] - _q[1] * _w[2] + _q[3] * _w[0],
+		_q[0] * _w[2] + _q[1] * _w[1] - _q[2] * _w[0],
+	};
+	double norm = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		_q[i] += 0.5 * dq[i] * dt;
+		norm += _q[i] * _q[i];
+	}
+	norm = sqrt(norm);
+	for (int i = 0; i < 4; i++)
+		_q[i] /= norm;
+}
+
+void SimDynamics::attitude(double q[4]) const
+{
+	for (int i = 0; i < 4; i++)
+		q[i] = _q[i];
+}
+
+void SimDynamics::rateDPS(double rate[3]) const
+{
+	for (int i = 0; i < 3; i++)
+		rate[i] = _w[i] * 180.0 / M_PI;
+}
+
+void SimDynamics::fieldUT(double field[3]) const
+{
+	toBody(field_uT, field);
+}
+
+void SimDynamics::sunDir(double sun[3]) const
+{
+	toBody(sun_dir, sun);
+}
+
+void SimDynamics::gravityG(double accel[3]) const
+{
+	toBody(gravity_dir, accel);
+}
+
+double SimDynamics::busCurrentMA(void) const
+{
+	double ma = SIM_IDLE_MA + SIM_MTX_MA * (fabs(mtx_on[0]) + fabs(mtx_on[1]));
+
+	if (wheel_enabled)
+		ma += SIM_WHEEL_MA * fabs(wheel_duty);
+	return ma;
+}
+
+double SimDynamics::busVoltageV(void) const
+{
+	return SIM_BATTERY_V - SIM_BATTERY_OHM * busCurrentMA() / 1000.0;
+}
@@ -0,0 +1,63 @@
+/**
+ * @brief      Rigid body model of the ADCS test article: attitude and body
+ *             rate, the reaction wheel driven by the DRV10970 and the two
+ *             magnetorquers, in a constant magnetic field and sun direction.
+ */
+#ifndef SIM_DYNAMICS_H
+#define SIM_DYNAMICS_H
+
+// body inertia about each axis, kg m^2
+#define SIM_BODY_INERTIA 0.0021
+
+// reaction wheel about body z
+#define SIM_WHEEL_INERTIA 1.0e-5	// kg m^2
+#define SIM_WHEEL_MAX_SPEED 800.0	// rad/s at 100% duty
+#define SIM_WHEEL_TIME_CONSTANT 0.5 // s, speed loop of the DRV10970
+#define SIM_WHEEL_COAST_TIME 5.0	// s, spin down with the motor disabled
+
+// magnetorquers along body x (MTx1) and y (MTx2)
+#define SIM_MTX_DIPOLE 0.05 // A m^2
+
+// environment, inertial frame
+#define SIM_FIELD_UT {20.0, 5.0, -40.0}
+#define SIM_SUN_DIR {1.0, 0.0, 0.0}
+#define SIM_GRAVITY_DIR {0.0, 0.0, 1.0}
+
+// power draw of the ADCS
+#define SIM_BATTERY_V 7.4
+#define SIM_BATTERY_OHM 0.1
+#define SIM_IDLE_MA 60.0
+#define SIM_WHEEL_MA 300.0 // at 100% duty
+#define SIM_MTX_MA 100.0   // each magnetorquer
+
+class SimDynamics
+{
+private:
+	double _q[4]; // body to inertial quaternion, w x y z
+	double _w[3]; // body rate, rad/s
+
+	void toBody(const double inertial[3], double body[3]) const;
+
+public:
+	double wheel_speed; // rad/s
+
+	// actuator commands, set from the pins every tick
+	bool wheel_enabled;
+	double wheel_duty;	 // -1 to 1, sign is the direction
+	double mtx_on[2];	 // -1, 0 or 1 for MTx1 and MTx2
+
+	SimDynamics(void);
+
+	void setRate(const double rate_dps[3]);
+	void step(double dt);
+
+	void attitude(double q[4]) const;
+	void rateDPS(double rate[3]) const;
+	void fieldUT(double field[3]) const;
+	void sunDir(double sun[3]) const;
+	void gravityG(double accel[3]) const;
+	double busCurrentMA(void) const;
+	double busVoltageV(void) const;
+};
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @brief      I2C master of the simulated SAMD51.
+ */
+#include "Wire.h"
+#include "SimDevices.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire(void)
+{
+	_clock = 100000;
+	_transactions = 0;
+	_num_devices = 0;
+	_address = 0;
+	_tx_len = 0;
+	_rx_len = 0;
+	_rx_pos = 0;
+}
+
+/**
+ * @brief      Connect a simulated device to the bus
+ */
+void TwoWire::attach(SimI2CDevice *device)
+{
+	if (_num_devices < sizeof(_devices) / sizeof(_devices[0]))
+		_devices[_num_devices++] = device;
+}
+
+SimI2CDevice *TwoWire::find(uint8_t address)
+{
+	for (uint8_t i = 0; i < _num_devices; i++)
+		if (_devices[i]->address == address)
+			return _devices[i];
+	return NULL;
+}
+
+/**
+ * @brief      Time on the bus of a transfer: address byte and data bytes at 9
+ *             clocks each, plus start and stop
+ */
+void TwoWire::busTime(size_t bytes)
+{
+	uint64_t clocks = 9 * (bytes + 1) + 2;
+	simBusy((uint32_t)((clocks * 1000000 + _clock - 1) / _clock));
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+	_address = address;
+	_tx_len = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+	if (_tx_len >= WIRE_BUFFER_LEN)
+		return 0;
+
+	_tx[_tx_len++] = data;
+	return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t len)
+{
+	size_t n = 0;
+
+	while (n < len && write(data[n]))
+		n++;
+	return n;
+}
+
+/**
+ * @brief      Sends the bytes written since beginTransmission
+ *
+ * @return     0 on success, 2 if the address was not acknowledged, 3 if a
+ *             data byte was not
+ */
+uint8_t TwoWire::endTransmission(bool stop)
+{
+	SimI2CDevice *device = find(_address);
+	uint8_t result = 0;
+
+	_transactions++;
+
+	if (device == NULL)
+	{
+		result = 2;
+	}
+	else
+	{
+		device->start(false);
+		for (size_t i = 0; i < _tx_len; i++)
+		{
+			if (!device->write(_tx[i]))
+			{
+				result = 3;
+				break;
+			}
+		}
+	}
+
+	busTime(device == NULL ? 0 : _tx_len);
+	_tx_len = 0;
+	return result;
+}
+
+/**
+ * @brief      Reads quantity bytes from the device into the receive buffer
+ *
+ * @return     Number of bytes received, 0 if the address was not acknowledged
+ */
+uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool stop)
+{
+	SimI2CDevice *device = find(address);
+
+	_transactions++;
+	_rx_len = 0;
+	_rx_pos = 0;
+
+	if (quantity > WIRE_BUFFER_LEN)
+		quantity = WIRE_BUFFER_LEN;
+
+	if (device != NULL)
+	{
+		device->start(true);
+		while (_rx_len < quantity)
+			_rx[_rx_len++] = device->read();
+	}
+
+	busTime(_rx_len);
+	return (uint8_t)_rx_len;
+}
+
+/* INTERRUPT DRIVEN MASTER ================================================== */
+
+/**
+ * @brief      Raise the interrupt of event once clocks more are on the bus
+ */
+void SimI2CMaster::raise(I2CEvent event, uint32_t clocks)
+{
+	IRQn_Type irq = event == I2C_EVENT_DATA ? SERCOM2_1_IRQn : SERCOM2_0_IRQn;
+	uint64_t us = ((uint64_t)clocks * 1000000 + _wire._clock - 1) / _wire._clock;
+
+	_event = event;
+	simIRQAt(irq, simMicros() + us);
+}
+
+/**
+ * @brief      Start or repeated start, then the address byte. A read raises
+ *             the first byte received, a write the acknowledge.
+ */
+void SimI2CMaster::start(uint8_t addr, bool read)
+{
+	_wire._transactions++;
+	_device = _wire.find(addr);
+
+	if (_device == NULL)
+	{
+		raise(I2C_EVENT_NACK, 10);
+		return;
+	}
+
+	_device->start(read);
+	if (read)
+		raise(I2C_EVENT_DATA, 10 + 9);
+	else
+		raise(I2C_EVENT_ACK, 10);
+}
+
+void SimI2CMaster::write(uint8_t data)
+{
+	raise(_device->write(data) ? I2C_EVENT_ACK : I2C_EVENT_NACK, 9);
+}
+
+/**
+ * @brief      The byte received, then acknowledge it for the next one or end
+ *             the read with a nack and a stop
+ */
+uint8_t SimI2CMaster::read(bool last)
+{
+	uint8_t data = _device->read();
+
+	if (!last)
+		raise(I2C_EVENT_DATA, 9);
+	return data;
+}
+
+void SimI2CMaster::stop(void)
+{
+	_event = I2C_EVENT_NONE;
+}
+
+void SimI2CMaster::reset(void)
+{
+	simCancelIRQ(SERCOM2_0_IRQn);
+	simCancelIRQ(SERCOM2_1_IRQn);
+	_event = I2C_EVENT_NONE;
+	_device = NULL;
+}
+
+I2CEvent SimI2CMaster::event(void)
+{
+	I2CEvent event = _event;
+
+	simBusy(SIM_I2C_ISR_US);
+	_event = I2C_EVENT_NONE;
+	return event;
+}
@@ -0,0 +1,105 @@
+/**
+ * @brief      I2C master of the simulated SAMD51, connected to the simulated
+ *             IMU and INA209 in SimDevices.h.
+ * @details    A transfer is carried out at once and then takes its time on the
+ *             bus, 9 clocks per byte plus start and stop, so code waiting for
+ *             the bus costs the same simulated time as on the board.
+ *
+ *             SimI2CMaster drives the same bus a byte at a time from its
+ *             interrupts instead, like the SERCOM in I2C master mode, for the
+ *             transfer queue of I2CBus.h.
+ */
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "Arduino.h"
+
+#include <I2CBus.h>
+
+#define WIRE_BUFFER_LEN 256
+
+class SimI2CDevice;
+
+class TwoWire : public Stream
+{
+	friend class SimI2CMaster;
+
+private:
+	uint32_t _clock;
+	uint32_t _transactions;
+
+	SimI2CDevice *_devices[8];
+	uint8_t _num_devices;
+
+	uint8_t _address;
+	uint8_t _tx[WIRE_BUFFER_LEN];
+	size_t _tx_len;
+
+	uint8_t _rx[WIRE_BUFFER_LEN];
+	size_t _rx_len;
+	size_t _rx_pos;
+
+	SimI2CDevice *find(uint8_t address);
+	void busTime(size_t bytes);
+
+public:
+	TwoWire(void);
+
+	void begin(void) {}
+	void end(void) {}
+	void setClock(uint32_t clock) { _clock = clock; }
+
+	void beginTransmission(uint8_t address);
+	uint8_t endTransmission(bool stop = true);
+	uint8_t requestFrom(uint8_t address, size_t quantity, bool stop = true);
+
+	size_t write(uint8_t data);
+	size_t write(const uint8_t *data, size_t len);
+	size_t write(unsigned long n) { return write((uint8_t)n); }
+	size_t write(long n) { return write((uint8_t)n); }
+	size_t write(unsigned int n) { return write((uint8_t)n); }
+	size_t write(int n) { return write((uint8_t)n); }
+
+	int available(void) { return (int)(_rx_len - _rx_pos); }
+	int read(void) { return _rx_pos < _rx_len ? _rx[_rx_pos++] : -1; }
+	int peek(void) { return _rx_pos < _rx_len ? _rx[_rx_pos] : -1; }
+
+	/* simulation only */
+	void attach(SimI2CDevice *device);
+	uint32_t transactions(void) const { return _transactions; }
+};
+
+extern TwoWire Wire;
+
+/**
+ * @brief      The SERCOM behind Wire as an interrupt driven master, see
+ *             I2CBus.h. On the board Wire is SERCOM2: its interrupt 0 is
+ *             raised once the address or a written byte is on the bus, 1 once
+ *             a byte was received. The bus waits for the interrupt to be
+ *             handled before it moves on, as the SERCOM stretches the clock.
+ */
+class SimI2CMaster
+{
+private:
+	TwoWire &_wire;
+	SimI2CDevice *_device;
+	I2CEvent _event;
+
+	void raise(I2CEvent event, uint32_t clocks);
+
+public:
+	SimI2CMaster(TwoWire &wire = Wire) : _wire(wire), _device(NULL), _event(I2C_EVENT_NONE) {}
+
+	void start(uint8_t addr, bool read);
+	void write(uint8_t data);
+	uint8_t read(bool last);
+	void stop(void);
+	void reset(void);
+
+	/**
+	 * @brief      What the interrupt that runs now was raised for
+	 */
+	I2CEvent event(void);
+};
+
+#endif
@@ -0,0 +1,714 @@
+/**
+ * @brief      FreeRTOS port for the simulated SAMD51, see Sim.h.
+ * @details    Every task runs in its own thread, and a baton lets exactly one
+ *             of them run at a time: the one the kernel made pxCurrentTCB. A
+ *             context switch hands the baton to the next task's thread and
+ *             parks the current one until it is picked again.
+ *
+ *             The clock is a microsecond counter moved by simBusy and by the
+ *             idle task. Whenever it passes a millisecond the SysTick handler
+ *             runs: the board and its interrupts are stepped, then the kernel
+ *             tick. Interrupts a peripheral raised for a time in between with
+ *             simIRQAt run when the clock passes that time, in order with the
+ *             ticks. Like interrupts on the MCU they wait while a critical
+ *             section is open, and a switch they request happens once they
+ *             return.
+ *
+ *             With tickless idle the idle task skips the kernel ticks until
+ *             the next task is due, the board is still stepped every
+ *             millisecond, and an interrupt ends the sleep early. A timed
+ *             interrupt due before the next tick is waited for with the tick
+ *             running instead, as the board's power.cpp does while an I2C
+ *             transfer is on the bus: only a peripheral with a transfer under
+ *             way raises one.
+ */
+#include "Sim.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_NUM_IRQ 160
+#define SIM_MAX_TIMED_IRQS 4
+
+// the 24 bit SysTick of the SAMD51 counts at most this many ticks
+#define SIM_MAX_SUPPRESSED_TICKS (0xffffffUL / (configCPU_CLOCK_HZ / configTICK_RATE_HZ))
+
+/**
+ * @brief      Thread of one task, kept at the top of the task's stack
+ */
+typedef struct
+{
+	pthread_t thread;
+	pthread_cond_t wake;
+	TaskFunction_t code;
+	void *params;
+	bool dying; // task deleted, the thread exits when woken
+} SimThread;
+
+static pthread_mutex_t baton = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t main_wake = PTHREAD_COND_INITIALIZER;
+static SimThread *running = NULL; // NULL until the scheduler starts
+
+static bool scheduler_running = false;
+static uint32_t critical_nesting = 0;
+static bool interrupts_masked = false;
+static bool in_isr = false;
+static bool yield_pending = false;
+
+static uint64_t now_us = 0;
+static uint64_t next_tick_us = 1000;
+static uint64_t scheduler_start_us = 0;
+
+static SimHandler vectors[SIM_NUM_IRQ];
+static bool irq_enabled[SIM_NUM_IRQ];
+static uint32_t irq_count = 0; // handlers run, a change ends a sleep
+
+/**
+ * @brief      Interrupt a peripheral raises at a given time rather than at a
+ *             tick, e.g. the I2C master once a byte is on the bus
+ */
+typedef struct
+{
+	int irq;
+	uint64_t at_us;
+} SimTimedIRQ;
+
+static SimTimedIRQ timed_irqs[SIM_MAX_TIMED_IRQS];
+static uint8_t num_timed_irqs = 0;
+static uint64_t timed_irq_us = 0; // when the last timed interrupt was due
+
+static SimPowerStats power;
+static bool idle_spun = false; // the idle loop went round once without sleeping
+
+// host CPU time of the running thread already added to the clock
+static __thread uint64_t cpu_accounted_ns = 0;
+
+static void deliverTicks(void);
+static int nextTimedIRQ(void);
+static bool runTimedIRQ(uint64_t before_us);
+extern "C" void vApplicationMallocFailedHook(void);
+
+/* HOST CPU TIME ============================================================ */
+
+static uint64_t threadCPUns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief      Add the host CPU time used since the last call, scaled by
+ *             --cpu-scale, to the clock
+ */
+static void accountCPU(void)
+{
+	if (sim_options.cpu_scale <= 0.0)
+		return;
+
+	uint64_t ns = threadCPUns();
+	now_us += (uint64_t)((ns - cpu_accounted_ns) * sim_options.cpu_scale / 1000.0);
+	cpu_accounted_ns = ns;
+}
+
+static void resumeCPU(void)
+{
+	if (sim_options.cpu_scale > 0.0)
+		cpu_accounted_ns = threadCPUns();
+}
+
+/* THREADS ================================================================== */
+
+static SimThread *threadOf(void *tcb)
+{
+	// pxTopOfStack is the first member of the TCB, it points at the SimThread
+	return (SimThread *)*(StackType_t *volatile *)tcb;
+}
+
+/**
+ * @brief      Hand the baton from prev to next and wait until prev gets it back
+ */
+static void switchThreads(SimThread *prev, SimThread *next)
+{
+	pthread_mutex_lock(&baton);
+	running = next;
+	pthread_cond_signal(&next->wake);
+	while (running != prev && !prev->dying)
+		pthread_cond_wait(&prev->wake, &baton);
+	bool dying = prev->dying;
+	pthread_mutex_unlock(&baton);
+
+	if (dying)
+		pthread_exit(NULL);
+	resumeCPU();
+}
+
+static void *threadMain(void *arg)
+{
+	SimThread *t = (SimThread *)arg;
+
+	pthread_mutex_lock(&baton);
+	while (running != t && !t->dying)
+		pthread_cond_wait(&t->wake, &baton);
+	bool dying = t->dying;
+	pthread_mutex_unlock(&baton);
+
+	if (dying)
+		return NULL;
+
+	resumeCPU();
+	t->code(t->params);
+
+	// tasks must never return
+	vSimAssert(__FILE__, __LINE__);
+	return NULL;
+}
+
+/**
+ * @brief      Start the task's thread, parked until the kernel first switches
+ *             to the task
+ */
+extern "C" StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters)
+{
+	uintptr_t top = (uintptr_t)pxTopOfStack - sizeof(SimThread);
+	SimThread *t = (SimThread *)(top & ~(uintptr_t)15);
+
+	t->code = pxCode;
+	t->params = pvParameters;
+	t->dying = false;
+	pthread_cond_init(&t->wake, NULL);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, 256 * 1024);
+	if (pthread_create(&t->thread, &attr, threadMain, t) != 0)
+	{
+		fprintf(stderr, "[sim]\t\tcannot create a thread\n");
+		exit(1);
+	}
+	pthread_attr_destroy(&attr);
+
+	return (StackType_t *)t;
+}
+
+/**
+ * @brief      Stop the thread of a deleted task before its stack is freed or
+ *             reused
+ */
+extern "C" void vPortCleanUpTCB(void *tcb)
+{
+	SimThread *t = threadOf(tcb);
+
+	pthread_mutex_lock(&baton);
+	t->dying = true;
+	pthread_cond_signal(&t->wake);
+	pthread_mutex_unlock(&baton);
+
+	pthread_join(t->thread, NULL);
+	pthread_cond_destroy(&t->wake);
+}
+
+/* SCHEDULER ================================================================ */
+
+extern "C" BaseType_t xPortStartScheduler(void)
+{
+	scheduler_running = true;
+	critical_nesting = 0;
+	interrupts_masked = false;
+	next_tick_us = (now_us / 1000 + 1) * 1000;
+	scheduler_start_us = now_us;
+
+	SimThread *first = threadOf(xTaskGetCurrentTaskHandle());
+
+	pthread_mutex_lock(&baton);
+	running = first;
+	pthread_cond_signal(&first->wake);
+
+	// setup() never continues, the program ends in simReport
+	while (1)
+		pthread_cond_wait(&main_wake, &baton);
+
+	return pdFALSE;
+}
+
+extern "C" void vPortEndScheduler(void)
+{
+}
+
+/**
+ * @brief      Switch to the task the kernel picks. Held back until the end of
+ *             the critical section or interrupt it is called from.
+ */
+extern "C" void vPortYield(void)
+{
+	if (!scheduler_running)
+		return;
+
+	if (critical_nesting > 0 || interrupts_masked || in_isr)
+	{
+		yield_pending = true;
+		return;
+	}
+
+	yield_pending = false;
+	accountCPU();
+
+	SimThread *prev = running;
+	critical_nesting++;
+	vTaskSwitchContext();
+	critical_nesting--;
+	SimThread *next = threadOf(xTaskGetCurrentTaskHandle());
+
+	if (next != prev)
+		switchThreads(prev, next);
+}
+
+extern "C" BaseType_t xPortIsInsideInterrupt(void)
+{
+	return in_isr ? pdTRUE : pdFALSE;
+}
+
+/* CRITICAL SECTIONS ======================================================== */
+
+/**
+ * @brief      Run what interrupts and switches waited for the critical section
+ *             or masked interrupts to end
+ */
+static void interruptsEnabled(void)
+{
+	if (critical_nesting > 0 || interrupts_masked || in_isr)
+		return;
+
+	deliverTicks();
+	if (yield_pending)
+		vPortYield();
+}
+
+extern "C" void vPortEnterCritical(void)
+{
+	critical_nesting++;
+}
+
+extern "C" void vPortExitCritical(void)
+{
+	configASSERT(critical_nesting > 0);
+	critical_nesting--;
+	interruptsEnabled();
+}
+
+extern "C" void vPortDisableInterrupts(void)
+{
+	interrupts_masked = true;
+}
+
+extern "C" void vPortEnableInterrupts(void)
+{
+	interrupts_masked = false;
+	interruptsEnabled();
+}
+
+extern "C" uint32_t ulPortSetInterruptMask(void)
+{
+	uint32_t was = interrupts_masked ? 1 : 0;
+	interrupts_masked = true;
+	return was;
+}
+
+extern "C" void vPortClearInterruptMask(uint32_t mask)
+{
+	interrupts_masked = mask != 0;
+	interruptsEnabled();
+}
+
+/* CLOCK ==================================================================== */
+
+/**
+ * @brief      SysTick handler, steps the board then the kernel
+ */
+static void tick(void)
+{
+	if (scheduler_running)
+		power.ticks++;
+
+	in_isr = true;
+	simBoardTick(next_tick_us);
+	if (scheduler_running && xTaskIncrementTick() != pdFALSE)
+		yield_pending = true;
+	in_isr = false;
+
+	next_tick_us += 1000;
+}
+
+/**
+ * @brief      Run the tick for every millisecond the clock has passed, and the
+ *             timed interrupts that fell due, in the order they were due.
+ *             Unless interrupts are masked.
+ */
+static void deliverTicks(void)
+{
+	while (1)
+	{
+		int next = nextTimedIRQ();
+		bool timed = next >= 0 && timed_irqs[next].at_us <= next_tick_us;
+
+		if (now_us < (timed ? timed_irqs[next].at_us : next_tick_us))
+			return;
+		if (critical_nesting > 0 || interrupts_masked || in_isr)
+			return;
+
+		if (timed)
+			runTimedIRQ(now_us + 1);
+		else
+			tick();
+		if (yield_pending)
+			vPortYield();
+	}
+}
+
+/**
+ * @brief      Current simulated time in microseconds
+ */
+uint64_t simMicros(void)
+{
+	accountCPU();
+	return now_us;
+}
+
+/**
+ * @brief      The code running now takes us microseconds, e.g. waiting for a
+ *             bus transfer. Interrupts that fall due meanwhile run, and may
+ *             switch to another task.
+ */
+void simBusy(uint32_t us)
+{
+	accountCPU();
+	now_us += us;
+	if (!in_isr)
+		deliverTicks();
+}
+
+/**
+ * @brief      Called by the idle task: nothing is ready to run, so skip to the
+ *             next tick. With tickless idle the hook runs before the kernel
+ *             decides whether to sleep, so the first pass only skips if the
+ *             idle loop comes back without having slept: the next task is due
+ *             at the next tick.
+ */
+void simIdle(void)
+{
+	accountCPU();
+
+	if (sim_options.tickless && !idle_spun)
+	{
+		idle_spun = true;
+		return;
+	}
+
+	idle_spun = false;
+
+	uint64_t wake_us = next_tick_us;
+	int next = nextTimedIRQ();
+	if (next >= 0 && timed_irqs[next].at_us < wake_us)
+		wake_us = timed_irqs[next].at_us;
+
+	if (now_us < wake_us)
+		now_us = wake_us;
+	deliverTicks();
+}
+
+bool simSchedulerRunning(void)
+{
+	return scheduler_running;
+}
+
+/**
+ * @brief      Run time stats clock, counts from the start of the scheduler so
+ *             setup() is not charged to the first task
+ */
+extern "C" unsigned long ulSimRunTimeCounter(void)
+{
+	return (unsigned long)(uint32_t)(now_us - scheduler_start_us);
+}
+
+extern "C" void vApplicationIdleHook(void)
+{
+	simIdle();
+}
+
+/* TICKLESS IDLE ============================================================ */
+
+/**
+ * @brief      Sleep with the tick suppressed until the next task is due or an
+ *             interrupt arrives, like the board's in src/power.cpp. The board
+ *             is stepped every millisecond meanwhile, the kernel tick only
+ *             runs for the last one. Called by the idle task with the
+ *             scheduler suspended.
+ *
+ * @param[in]  idle_ticks  Ticks until the next task is due
+ */
+extern "C" void vPortSuppressTicksAndSleep(TickType_t idle_ticks)
+{
+	idle_spun = false;
+
+	if (!sim_options.tickless || eTaskConfirmSleepModeStatus() == eAbortSleep)
+		return;
+
+	if (idle_ticks > SIM_MAX_SUPPRESSED_TICKS)
+		idle_ticks = SIM_MAX_SUPPRESSED_TICKS;
+
+	accountCPU();
+	uint64_t start_us = now_us;
+
+	// too soon to stop the tick for
+	if (runTimedIRQ(next_tick_us))
+	{
+		power.waits++;
+		power.waiting_us += timed_irq_us - start_us;
+		return;
+	}
+
+	uint32_t irqs = irq_count;
+	uint64_t woke_us = 0;
+	TickType_t slept = 0;
+
+	while (irq_count == irqs)
+	{
+		// a peripheral interrupt between two ticks
+		woke_us = 0;
+		if (runTimedIRQ(next_tick_us))
+		{
+			woke_us = timed_irq_us;
+			continue;
+		}
+		if (slept >= idle_ticks - 1)
+			break;
+
+		now_us = next_tick_us;
+		in_isr = true;
+		simBoardTick(next_tick_us);
+		in_isr = false;
+		next_tick_us += 1000;
+		slept++;
+	}
+
+	power.sleeps++;
+	power.asleep_us += (woke_us != 0 ? woke_us : now_us) - start_us;
+	vTaskStepTick(slept);
+
+	if (irq_count != irqs)
+	{
+		power.interrupted++;
+		return;
+	}
+
+	// slept the whole time, the tick interrupt ends the sleep. The kernel
+	// holds it back until the scheduler is resumed.
+	now_us = next_tick_us;
+	tick();
+}
+
+/**
+ * @brief      Wakeups since the scheduler started
+ */
+SimPowerStats simPowerStats(void)
+{
+	SimPowerStats stats = power;
+	stats.run_us = now_us - scheduler_start_us;
+	return stats;
+}
+
+/* INTERRUPTS =============================================================== */
+
+void simSetVector(int irq, SimHandler handler)
+{
+	if (irq >= 0 && irq < SIM_NUM_IRQ)
+		vectors[irq] = handler;
+}
+
+void simEnableIRQ(int irq, bool enable)
+{
+	if (irq >= 0 && irq < SIM_NUM_IRQ)
+		irq_enabled[irq] = enable;
+}
+
+/**
+ * @brief      Run the handler of irq if it is enabled, from simulated
+ *             peripherals during the tick or from a timed interrupt
+ */
+void simIRQ(int irq)
+{
+	if (irq < 0 || irq >= SIM_NUM_IRQ || !irq_enabled[irq] || vectors[irq] == NULL)
+		return;
+
+	bool was_in_isr = in_isr;
+	in_isr = true;
+	vectors[irq]();
+	in_isr = was_in_isr;
+	irq_count++;
+}
+
+/**
+ * @brief      Raise irq at a time, replacing the time it was raised at before
+ *             if it is still pending
+ *
+ * @param[in]  irq    The irq
+ * @param[in]  at_us  Simulated time, the handler runs once the clock gets there
+ */
+void simIRQAt(int irq, uint64_t at_us)
+{
+	uint8_t i = 0;
+
+	while (i < num_timed_irqs && timed_irqs[i].irq != irq)
+		i++;
+
+	if (i == num_timed_irqs)
+	{
+		if (num_timed_irqs == SIM_MAX_TIMED_IRQS)
+		{
+			fprintf(stderr, "[sim]\t\ttoo many timed interrupts\n");
+			exit(1);
+		}
+		num_timed_irqs++;
+	}
+
+	timed_irqs[i].irq = irq;
+	timed_irqs[i].at_us = at_us;
+}
+
+/**
+ * @brief      Take back an interrupt raised with simIRQAt that did not run yet
+ */
+void simCancelIRQ(int irq)
+{
+	for (uint8_t i = 0; i < num_timed_irqs; i++)
+	{
+		if (timed_irqs[i].irq == irq)
+		{
+			timed_irqs[i] = timed_irqs[--num_timed_irqs];
+			return;
+		}
+	}
+}
+
+/**
+ * @brief      Index of the timed interrupt due first, -1 if none is pending
+ */
+static int nextTimedIRQ(void)
+{
+	int next = -1;
+
+	for (uint8_t i = 0; i < num_timed_irqs; i++)
+		if (next < 0 || timed_irqs[i].at_us < timed_irqs[next].at_us)
+			next = i;
+	return next;
+}
+
+/**
+ * @brief      Run the timed interrupt due first if it is due before before_us,
+ *             moving the clock up to it
+ *
+ * @return     True if one was due
+ */
+static bool runTimedIRQ(uint64_t before_us)
+{
+	int next = nextTimedIRQ();
+
+	if (next < 0 || timed_irqs[next].at_us >= before_us)
+		return false;
+
+	SimTimedIRQ irq = timed_irqs[next];
+	timed_irqs[next] = timed_irqs[--num_timed_irqs];
+
+	if (now_us < irq.at_us)
+		now_us = irq.at_us;
+	timed_irq_us = now_us;
+	simIRQ(irq.irq);
+	return true;
+}
+
+/* HEAP ===================================================================== */
+
+// the FreeRTOS heap is limited to configTOTAL_HEAP_SIZE as on the board
+static size_t heap_used = 0;
+static size_t heap_max_used = 0;
+
+typedef union
+{
+	size_t size;
+	max_align_t align;
+} HeapHeader;
+
+extern "C" void *pvPortMalloc(size_t size)
+{
+	HeapHeader *block = NULL;
+
+	vTaskSuspendAll();
+	if (heap_used + size <= configTOTAL_HEAP_SIZE)
+	{
+		block = (HeapHeader *)malloc(sizeof(HeapHeader) + size);
+		if (block != NULL)
+		{
+			block->size = size;
+			heap_used += size;
+			if (heap_used > heap_max_used)
+				heap_max_used = heap_used;
+		}
+	}
+	(void)xTaskResumeAll();
+
+	if (block == NULL)
+	{
+		vApplicationMallocFailedHook();
+		return NULL;
+	}
+	return block + 1;
+}
+
+extern "C" void vPortFree(void *p)
+{
+	if (p == NULL)
+		return;
+
+	HeapHeader *block = (HeapHeader *)p - 1;
+	vTaskSuspendAll();
+	heap_used -= block->size;
+	free(block);
+	(void)xTaskResumeAll();
+}
+
+extern "C" size_t xPortGetFreeHeapSize(void)
+{
+	return configTOTAL_HEAP_SIZE - heap_used;
+}
+
+extern "C" size_t xPortGetMinimumEverFreeHeapSize(void)
+{
+	return configTOTAL_HEAP_SIZE - heap_max_used;
+}
+
+/* HOOKS ==================================================================== */
+
+extern "C" void vSimAssert(const char *file, int line)
+{
+	fprintf(stderr, "[sim]\t\tassert failed at %s:%d, t = %.3f s\n", file, line, now_us / 1e6);
+	fflush(stdout);
+	abort();
+}
+
+extern "C" void vApplicationMallocFailedHook(void)
+{
+	fprintf(stderr, "[sim]\t\tFreeRTOS heap exhausted, t = %.3f s\n", now_us / 1e6);
+}
+
+extern "C" void vApplicationStackOverflowHook(TaskHandle_t task, char *name)
+{
+	fprintf(stderr, "[sim]\t\tstack overflow in %s, t = %.3f s\n", name, now_us / 1e6);
+	fflush(stdout);
+	abort();
+}
@@ -0,0 +1,103 @@
+/**
+ * @brief      FreeRTOS port macros of the simulated SAMD51, see port.cpp.
+ * @details    Same types and tick as the Cortex-M4F port in FreeRTOS-SAMD51,
+ *             so the firmware sees the same kernel. A yield requested inside a
+ *             critical section or an interrupt is held back until it ends,
+ *             the way PendSV waits for BASEPRI to drop on the MCU.
+ */
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* TYPES ==================================================================== */
+
+#define portCHAR char
+#define portFLOAT float
+#define portDOUBLE double
+#define portLONG long
+#define portSHORT short
+#define portSTACK_TYPE uint32_t
+#define portBASE_TYPE long
+#define portPOINTER_SIZE_TYPE uintptr_t
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#if (configUSE_16_BIT_TICKS == 1)
+	typedef uint16_t TickType_t;
+	#define portMAX_DELAY (TickType_t)0xffff
+#else
+	typedef uint32_t TickType_t;
+	#define portMAX_DELAY (TickType_t)0xffffffffUL
+	#define portTICK_TYPE_IS_ATOMIC 1
+#endif
+
+/* ARCHITECTURE ============================================================= */
+
+#define portSTACK_GROWTH (-1)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portTICK_PERIOD_US ((TickType_t)1000000 / configTICK_RATE_HZ)
+#define portBYTE_ALIGNMENT 16
+
+/* SCHEDULER ================================================================ */
+
+void vPortYield(void);
+void vPortCleanUpTCB(void *tcb);
+
+#define portYIELD() vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired) \
+	if (xSwitchRequired != pdFALSE)            \
+	portYIELD()
+#define portYIELD_FROM_ISR(x) portEND_SWITCHING_ISR(x)
+
+// the task's thread is stopped before the kernel frees or reuses its stack
+#define portCLEAN_UP_TCB(pxTCB) vPortCleanUpTCB(pxTCB)
+
+/* TICKLESS IDLE ============================================================ */
+
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime);
+
+#define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) vPortSuppressTicksAndSleep(xExpectedIdleTime)
+
+/* CRITICAL SECTIONS ======================================================== */
+
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+void vPortDisableInterrupts(void);
+void vPortEnableInterrupts(void);
+uint32_t ulPortSetInterruptMask(void);
+void vPortClearInterruptMask(uint32_t mask);
+
+#define portSET_INTERRUPT_MASK_FROM_ISR() ulPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x) vPortClearInterruptMask(x)
+#define portDISABLE_INTERRUPTS() vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS() vPortEnableInterrupts()
+#define portENTER_CRITICAL() vPortEnterCritical()
+#define portEXIT_CRITICAL() vPortExitCritical()
+
+/* TASK FUNCTIONS =========================================================== */
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction(void *pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters) void vFunction(void *pvParameters)
+
+#define portNOP()
+#define portINLINE __inline
+#ifndef portFORCE_INLINE
+	#define portFORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+BaseType_t xPortIsInsideInterrupt(void);
+
+#define portMEMORY_BARRIER() __asm volatile("" ::: "memory")
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORTMACRO_H */
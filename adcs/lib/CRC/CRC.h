@@ -2,16 +2,17 @@
 //
 //    FILE: CRC.h
 //  AUTHOR: Rob Tillaart
-// VERSION: 0.2.0
+// VERSION: 0.2.0-adcs
 // PURPOSE: Arduino library fir CRC8, CRC12, CRC16, CRC16-CCITT, CRC32
 //     URL: https://github.com/RobTillaart/CRC
 //
 
 
 #include "Arduino.h"
+#include "CRCClass.h"
 
 
-#define CRC_LIB_VERSION       (F("0.2.0"))
+#define CRC_LIB_VERSION       (F("0.2.0-adcs"))
 
 
 ////////////////////////////////////////////////////////////////
@@ -81,19 +82,7 @@ uint8_t crc8(const uint8_t *array, uint8_t length, const uint8_t polynome = 0xD5
   {
     uint8_t data = *array++;
     if (reverseIn) data = reverse8(data);
-    crc ^= data;
-    for (uint8_t i = 8; i; i--) 
-    {
-      if (crc & 0x80)
-      {
-        crc <<= 1;
-        crc ^= polynome;
-      }
-      else
-      {
-        crc <<= 1;
-      }
-    }
+    crc = crc_detail::updateBits<uint8_t>(crc, polynome, 8, data);
   }
   crc ^= endmask;
   if (reverseOut) crc = reverse8(crc);
@@ -109,20 +98,7 @@ uint16_t crc12(const uint8_t *array, uint8_t length, const uint16_t polynome = 0
   {
     uint8_t data = *array++;
     if (reverseIn) data = reverse8(data);
-
-    crc ^= ((uint16_t)data) << 4;
-    for (uint8_t i = 8; i; i--) 
-    {
-      if (crc & (1 << 11) )
-      {
-        crc <<= 1;
-        crc ^= polynome;
-      }
-      else
-      {
-        crc <<= 1;
-      }
-    }
+    crc = crc_detail::updateBits<uint16_t>(crc, polynome, 12, data);
   }
 
   if (reverseOut) crc = reverse12(crc);
@@ -139,19 +115,7 @@ uint16_t crc16(const uint8_t *array, uint8_t length, const uint16_t polynome = 0
   {
     uint8_t data = *array++;
     if (reverseIn) data = reverse8(data);
-    crc ^= ((uint16_t)data) << 8;
-    for (uint8_t i = 8; i; i--) 
-    {
-      if (crc & (1 << 15))
-      {
-        crc <<= 1;
-        crc ^= polynome;
-      }
-      else
-      {
-        crc <<= 1;
-      }
-    }
+    crc = crc_detail::updateBits<uint16_t>(crc, polynome, 16, data);
   }
   if (reverseOut) crc = reverse16(crc);
   crc ^= endmask;
@@ -174,19 +138,7 @@ uint32_t crc32(const uint8_t *array, uint8_t length, const uint32_t polynome = 0
   {
     uint8_t data = *array++;
     if (reverseIn) data = reverse8(data);
-    crc ^= ((uint32_t) data) << 24;
-    for (uint8_t i = 8; i; i--) 
-    {
-      if (crc & (1UL << 31))
-      {
-        crc <<= 1;
-        crc ^= polynome;
-      }
-      else
-      {
-        crc <<= 1;
-      }
-    }
+    crc = crc_detail::updateBits<uint32_t>(crc, polynome, 32, data);
   }
   crc ^= endmask;
   if (reverseOut) crc = reverse32(crc);
@@ -202,19 +154,7 @@ uint64_t crc64(const uint8_t *array, uint8_t length, const uint64_t polynome, co
   {
     uint8_t data = *array++;
     if (reverseIn) data = reverse8(data);
-    crc ^= ((uint64_t) data) << 56;
-    for (uint8_t i = 8; i; i--) 
-    {
-      if (crc & (1ULL << 63))
-      {
-        crc <<= 1;
-        crc ^= polynome;
-      }
-      else
-      {
-        crc <<= 1;
-      }
-    }
+    crc = crc_detail::updateBits<uint64_t>(crc, polynome, 64, data);
   }
   crc ^= endmask;
   if (reverseOut) crc = reverse64(crc);
@@ -0,0 +1,184 @@
+#pragma once
+//
+//    FILE: CRCClass.h
+//  AUTHOR: ADCS firmware contributors
+// PURPOSE: Arduino class template behind CRC8, CRC12, CRC16, CRC32 and CRC64
+//   BASED: CRC8.cpp .. CRC64.cpp of https://github.com/RobTillaart/CRC 0.2.0
+//          by Rob Tillaart, (c) 2021-2022, MIT, see LICENSE
+//
+// Parameters are set at runtime. For the default polynome the compile time
+// tables of CRCTemplate.h are used, other polynomes are calculated bitwise.
+// When all parameters are known at compile time Crc<> is faster still.
+
+
+#if defined(ARDUINO)
+#include "Arduino.h"
+#else
+#include <stdint.h>   // host builds, e.g. pio test -e native
+#endif
+
+#include "CRCTemplate.h"
+
+
+// calculation modes, table modes only apply to the default polynome,
+// other polynomes always use the bitwise calculation.
+#define CRC_MODE_BITWISE            0     // 8 shift/xor steps per byte, no table
+#define CRC_MODE_TABLE              1     // 1 lookup per byte
+#define CRC_MODE_SLICING4           2     // 4 lookups per 4 bytes
+
+#if defined(__AVR__)
+// constexpr tables would be copied to RAM on AVR
+#define CRC_DEFAULT_MODE            CRC_MODE_BITWISE
+#else
+#define CRC_DEFAULT_MODE            CRC_MODE_TABLE
+#endif
+
+
+namespace crc_detail
+{
+
+// bitwise update of a normal (MSB first) register, for runtime polynomes
+template <typename T>
+inline T updateBits(T crc, T polynome, uint8_t width, uint8_t value)
+{
+  crc ^= ((T)value) << (width - 8);
+  for (uint8_t i = 8; i; i--)
+  {
+    if (crc & ((T)1 << (width - 1)))
+    {
+      crc <<= 1;
+      crc ^= polynome;
+    }
+    else
+    {
+      crc <<= 1;
+    }
+  }
+  return crc;
+}
+
+}  // namespace crc_detail
+
+
+template <typename T, uint8_t WIDTH, uint64_t DEFAULT_POLYNOME>
+class CRCClass
+{
+public:
+  CRCClass()               { reset(); };
+
+  // set parameters to default
+  void     reset()        // set all to constructor defaults
+  {
+    _polynome   = DEFAULT_POLYNOME;
+    _startMask  = 0;
+    _endMask    = 0;
+    _crc        = 0;
+    _reverseIn  = false;
+    _reverseOut = false;
+    _started    = false;
+    _count      = 0;
+    _mode       = CRC_DEFAULT_MODE;
+  };
+
+  void     restart()      // reset crc with same parameters.
+  {
+    _started = true;
+    _crc     = _startMask;
+    _count   = 0;
+  };
+
+  // set parameters
+  void     setPolynome(T polynome)        { _polynome = polynome; };
+  void     setStartXOR(T start)           { _startMask = start; };
+  void     setEndXOR(T end)               { _endMask = end; };
+  void     setReverseIn(bool reverseIn)   { _reverseIn = reverseIn; };
+  void     setReverseOut(bool reverseOut) { _reverseOut = reverseOut; };
+  void     setMode(uint8_t mode)          { _mode = mode; };
+
+  // get parameters
+  T        getPolynome()   { return _polynome; };
+  T        getStartXOR()   { return _startMask; };
+  T        getEndXOR()     { return _endMask; };
+  bool     getReverseIn()  { return _reverseIn; };
+  bool     getReverseOut() { return _reverseOut; };
+  uint8_t  getMode()       { return _mode; };
+
+  void     add(uint8_t value)
+  {
+    add(&value, 1);
+  };
+
+  void     add(const uint8_t * array, uint32_t length)
+  {
+    if (length == 0) return;
+    if (!_started) restart();
+    _count += length;
+
+    if (_useTable())
+    {
+      if (_reverseIn)
+      {
+        // reflected input runs on the reflected tables with the register reversed
+        T r = crc_detail::reverse(_crc, WIDTH);
+        if (_mode == CRC_MODE_SLICING4) r = _reflected::updateSlicing4(r, array, length);
+        else                            r = _reflected::update(r, array, length);
+        _crc = crc_detail::reverse(r, WIDTH);
+      }
+      else
+      {
+        T r = _crc << _normal::SHIFT;
+        if (_mode == CRC_MODE_SLICING4) r = _normal::updateSlicing4(r, array, length);
+        else                            r = _normal::update(r, array, length);
+        _crc = r >> _normal::SHIFT;
+      }
+      return;
+    }
+
+#if defined(ARDUINO)
+    uint32_t n = 0;
+#endif
+    while (length--)
+    {
+#if defined(ARDUINO)
+      // reduce yield() calls
+      if ((++n & 0xFF) == 0) yield();
+#endif
+      uint8_t value = *array++;
+      if (_reverseIn) value = crc_detail::reverse(value, 8);
+      _crc = crc_detail::updateBits(_crc, _polynome, WIDTH, value);
+    }
+  };
+
+  T        getCRC()        // returns CRC
+  {
+    T rv = _crc;
+    if (_reverseOut) rv = crc_detail::reverse(rv, WIDTH);
+    rv ^= _endMask;
+    return rv & (T)crc_detail::mask(WIDTH);
+  };
+
+  uint32_t count()         { return _count; };
+
+private:
+  struct _normal : crc_detail::Engine<WIDTH, DEFAULT_POLYNOME, false>
+  {
+    static constexpr uint8_t SHIFT = crc_detail::engineBits(WIDTH) - WIDTH;
+  };
+  typedef crc_detail::Engine<WIDTH, DEFAULT_POLYNOME, true> _reflected;
+
+  bool     _useTable()     { return _mode != CRC_MODE_BITWISE && _polynome == (T)DEFAULT_POLYNOME; };
+
+  T        _polynome;
+  T        _startMask;
+  T        _endMask;
+  T        _crc;
+  bool     _reverseIn;
+  bool     _reverseOut;
+  bool     _started;
+  uint8_t  _mode;
+  uint32_t _count;
+};
+
+
+// -- END OF FILE --
+
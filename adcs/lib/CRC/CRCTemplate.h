@@ -0,0 +1,328 @@
+#pragma once
+//
+//    FILE: CRCTemplate.h
+//  AUTHOR: ADCS firmware contributors, local addition to RobTillaart/CRC 0.2.0
+// PURPOSE: compile time configured CRC for any width from 8 to 64 bits
+//    (c) : MIT, see LICENSE
+//
+// Crc<WIDTH, POLYNOME, START, END, REVERSE_IN, REVERSE_OUT> fixes all
+// parameters at compile time, the lookup tables are generated by the
+// compiler with constexpr functions (no RAM, no start up time).
+// Parameters have the same meaning as for the CRC8 .. CRC64 classes,
+// REVERSE_OUT reverses the register before the END mask is applied.
+//
+// C++11 constexpr functions may not contain loops, hence the recursion.
+//
+// Internally the register is kept in "engine form":
+// - normal (MSB first) the register is left aligned to a multiple of 8 bits,
+//   so CRC12 runs on a 16 bit register with the polynome shifted by 4.
+// - reflected (LSB first) the register is reversed and the reversed
+//   polynome is used, so input bytes do not need to be reversed.
+// Row K of a table holds the engine register after byte i followed by
+// K zero bytes, starting from a zero register.
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+namespace crc_detail
+{
+
+////////////////////////////////////////////////////////////////
+//
+// register type, smallest unsigned type that holds WIDTH bits
+//
+
+template <uint8_t WIDTH, bool = (WIDTH <= 8), bool = (WIDTH <= 16), bool = (WIDTH <= 32)>
+struct Register                            { typedef uint64_t type; };
+
+template <uint8_t WIDTH>
+struct Register<WIDTH, true, true, true>   { typedef uint8_t  type; };
+
+template <uint8_t WIDTH>
+struct Register<WIDTH, false, true, true>  { typedef uint16_t type; };
+
+template <uint8_t WIDTH>
+struct Register<WIDTH, false, false, true> { typedef uint32_t type; };
+
+
+////////////////////////////////////////////////////////////////
+//
+// generators, all math in 64 bit
+//
+
+constexpr uint64_t mask(uint8_t bits)
+{
+  return bits >= 64 ? ~0ULL : ((1ULL << bits) - 1);
+}
+
+
+constexpr uint64_t reflect(uint64_t x, uint8_t bits, uint64_t r = 0)
+{
+  return bits == 0 ? r : reflect(x >> 1, bits - 1, (r << 1) | (x & 1));
+}
+
+
+// storage width of the engine register
+constexpr uint8_t engineBits(uint8_t width)
+{
+  return ((width + 7) / 8) * 8;
+}
+
+
+// polynome as used by the engine
+constexpr uint64_t enginePolynome(uint8_t width, uint64_t polynome, bool reflected)
+{
+  return reflected ? reflect(polynome, width)
+                   : ((polynome << (engineBits(width) - width)) & mask(engineBits(width)));
+}
+
+
+// n CRC steps, one per bit
+constexpr uint64_t steps(uint64_t crc, uint64_t polynome, uint8_t bits, bool reflected, uint8_t n)
+{
+  return n == 0 ? crc
+    : steps(reflected
+        ? ((crc & 1) ? ((crc >> 1) ^ polynome) : (crc >> 1))
+        : ((((crc >> (bits - 1)) & 1) ? ((crc << 1) ^ polynome) : (crc << 1)) & mask(bits)),
+      polynome, bits, reflected, n - 1);
+}
+
+
+constexpr uint64_t entry(uint8_t i, uint64_t polynome, uint8_t bits, bool reflected)
+{
+  return reflected ? steps(i, polynome, bits, true, 8)
+                   : steps((uint64_t)i << (bits - 8), polynome, bits, false, 8);
+}
+
+
+// push value through one more zero byte
+constexpr uint64_t zeroByte(uint64_t v, uint64_t polynome, uint8_t bits, bool reflected)
+{
+  return reflected ? ((v >> 8) ^ entry(v & 0xFF, polynome, bits, true))
+                   : (((v << 8) & mask(bits)) ^ entry((v >> (bits - 8)) & 0xFF, polynome, bits, false));
+}
+
+
+constexpr uint64_t slice(uint8_t row, uint8_t i, uint64_t polynome, uint8_t bits, bool reflected)
+{
+  return row == 0 ? entry(i, polynome, bits, reflected)
+                  : zeroByte(slice(row - 1, i, polynome, bits, reflected), polynome, bits, reflected);
+}
+
+
+// engine register to CRC value
+constexpr uint64_t finish(uint64_t reg, uint8_t width, bool reverseIn, bool reverseOut, uint64_t end)
+{
+  return ((reverseIn == reverseOut
+            ? (reverseIn ? reg : reg >> (engineBits(width) - width))
+            : reflect(reverseIn ? reg : reg >> (engineBits(width) - width), width))
+          ^ end) & mask(width);
+}
+
+
+// start mask to engine register
+constexpr uint64_t start(uint64_t startMask, uint8_t width, bool reverseIn)
+{
+  return reverseIn ? reflect(startMask, width) : (startMask << (engineBits(width) - width));
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// runtime bit reverse, the constexpr version above is too slow for a hot path
+//
+
+inline uint32_t reverse32(uint32_t x)
+{
+  x = (((x & 0xAAAAAAAA) >> 1)  | ((x & 0x55555555) << 1));
+  x = (((x & 0xCCCCCCCC) >> 2)  | ((x & 0x33333333) << 2));
+  x = (((x & 0xF0F0F0F0) >> 4)  | ((x & 0x0F0F0F0F) << 4));
+  x = (((x & 0xFF00FF00) >> 8)  | ((x & 0x00FF00FF) << 8));
+  return (x >> 16) | (x << 16);
+}
+
+
+template <typename T>
+inline T reverse(T x, uint8_t width)
+{
+  if (sizeof(T) <= 4) return (T)(reverse32(x) >> (32 - width));
+  uint64_t r = ((uint64_t)reverse32((uint32_t)x) << 32) | reverse32((uint32_t)((uint64_t)x >> 32));
+  return (T)(r >> (64 - width));
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// index sequence (std::index_sequence is C++14)
+//
+
+template <uint16_t... I> struct Indices {};
+
+template <uint16_t N, uint16_t... I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+template <uint16_t... I>
+struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+
+////////////////////////////////////////////////////////////////
+//
+// table engine, shared by all CRC's with the same width, polynome and direction
+//
+
+template <uint8_t WIDTH, uint64_t POLYNOME, bool REFLECTED, typename = typename MakeIndices<256>::type>
+struct Engine;
+
+template <uint8_t WIDTH, uint64_t POLYNOME, bool REFLECTED, uint16_t... I>
+struct Engine<WIDTH, POLYNOME, REFLECTED, Indices<I...> >
+{
+  typedef typename Register<WIDTH>::type T;
+
+  static constexpr uint8_t  BITS  = engineBits(WIDTH);
+  static constexpr uint8_t  BYTES = BITS / 8;
+  static constexpr uint64_t POLY  = enginePolynome(WIDTH, POLYNOME, REFLECTED);
+
+  // separate rows, the one byte table only needs row0
+  static constexpr T row0[256] = { (T)slice(0, I, POLY, BITS, REFLECTED)... };
+  static constexpr T row1[256] = { (T)slice(1, I, POLY, BITS, REFLECTED)... };
+  static constexpr T row2[256] = { (T)slice(2, I, POLY, BITS, REFLECTED)... };
+  static constexpr T row3[256] = { (T)slice(3, I, POLY, BITS, REFLECTED)... };
+
+  // one table lookup per byte
+  static inline T update(T reg, const uint8_t * array, uint32_t length)
+  {
+    while (length--)
+    {
+      if (REFLECTED) reg = (T)(reg >> 8) ^ row0[(uint8_t)(reg ^ *array++)];
+      else           reg = (T)(reg << 8) ^ row0[(uint8_t)((reg >> (BITS - 8)) ^ *array++)];
+    }
+    return reg;
+  }
+
+  // four table lookups per four bytes
+  static inline T updateSlicing4(T reg, const uint8_t * array, uint32_t length)
+  {
+    while (length >= 4)
+    {
+      uint8_t b[4];
+      for (uint8_t k = 0; k < 4; k++)
+      {
+        b[k] = array[k];
+        if (k < BYTES) b[k] ^= (uint8_t)(reg >> (REFLECTED ? 8 * k : BITS - 8 * (k + 1)));
+      }
+      // register bytes beyond the first four just move along
+      T rest = 0;
+      if (BYTES > 4) rest = (T)(REFLECTED ? ((uint64_t)reg >> 32) : ((uint64_t)reg << 32));
+      reg = rest ^ row3[b[0]] ^ row2[b[1]] ^ row1[b[2]] ^ row0[b[3]];
+      array  += 4;
+      length -= 4;
+    }
+    return update(reg, array, length);
+  }
+
+  // compile time version of update()
+  static constexpr T check(T reg, const char * str, uint32_t length)
+  {
+    return length == 0 ? reg
+      : check(REFLECTED ? (T)((T)(reg >> 8) ^ row0[(uint8_t)(reg ^ (uint8_t)*str)])
+                        : (T)((T)(reg << 8) ^ row0[(uint8_t)((reg >> (BITS - 8)) ^ (uint8_t)*str)]),
+              str + 1, length - 1);
+  }
+};
+
+template <uint8_t WIDTH, uint64_t POLYNOME, bool REFLECTED, uint16_t... I>
+constexpr typename Register<WIDTH>::type Engine<WIDTH, POLYNOME, REFLECTED, Indices<I...> >::row0[256];
+template <uint8_t WIDTH, uint64_t POLYNOME, bool REFLECTED, uint16_t... I>
+constexpr typename Register<WIDTH>::type Engine<WIDTH, POLYNOME, REFLECTED, Indices<I...> >::row1[256];
+template <uint8_t WIDTH, uint64_t POLYNOME, bool REFLECTED, uint16_t... I>
+constexpr typename Register<WIDTH>::type Engine<WIDTH, POLYNOME, REFLECTED, Indices<I...> >::row2[256];
+template <uint8_t WIDTH, uint64_t POLYNOME, bool REFLECTED, uint16_t... I>
+constexpr typename Register<WIDTH>::type Engine<WIDTH, POLYNOME, REFLECTED, Indices<I...> >::row3[256];
+
+}  // namespace crc_detail
+
+
+////////////////////////////////////////////////////////////////
+//
+// Crc
+//
+
+template <uint8_t WIDTH, uint64_t POLYNOME, uint64_t START = 0, uint64_t END = 0,
+          bool REVERSE_IN = false, bool REVERSE_OUT = false>
+class Crc
+{
+  static_assert(WIDTH >= 8 && WIDTH <= 64, "Crc supports widths from 8 to 64 bits");
+
+public:
+  typedef typename crc_detail::Register<WIDTH>::type      value_type;
+  typedef crc_detail::Engine<WIDTH, POLYNOME, REVERSE_IN> engine;
+
+  Crc()                    { restart(); };
+
+  void     restart()       { _reg = initial(); _count = 0; };
+
+  void     add(uint8_t value)
+  {
+    _reg = engine::update(_reg, &value, 1);
+    _count++;
+  };
+
+  void     add(const uint8_t * array, uint32_t length)
+  {
+    _reg = engine::updateSlicing4(_reg, array, length);
+    _count += length;
+  };
+
+  value_type getCRC() const { return finish(_reg); };
+  uint32_t   count()  const { return _count; };
+
+  // one call per block of data
+  static value_type calculate(const uint8_t * array, uint32_t length)
+  {
+    return finish(engine::updateSlicing4(initial(), array, length));
+  };
+
+  // compile time calculation, e.g. static_assert(CRC::check("123456789", 9) == ...)
+  static constexpr value_type check(const char * str, uint32_t length)
+  {
+    return finish(engine::check(initial(), str, length));
+  };
+
+private:
+  static constexpr value_type initial()
+  {
+    return (value_type)crc_detail::start(START, WIDTH, REVERSE_IN);
+  };
+
+  static constexpr value_type finish(value_type reg)
+  {
+    return (value_type)crc_detail::finish(reg, WIDTH, REVERSE_IN, REVERSE_OUT, END);
+  };
+
+  value_type _reg;
+  uint32_t   _count;
+};
+
+
+////////////////////////////////////////////////////////////////
+//
+// known answers for "123456789" - see https://reveng.sourceforge.io/crc-catalogue/
+//
+
+static_assert(Crc<8,  0x07>::check("123456789", 9) == 0xF4,                                        "CRC-8/SMBUS");
+static_assert(Crc<8,  0x31, 0x00, 0x00, true, true>::check("123456789", 9) == 0xA1,                "CRC-8/MAXIM");
+static_assert(Crc<12, 0x80F>::check("123456789", 9) == 0xF5B,                                      "CRC-12/DECT");
+static_assert(Crc<12, 0x80F, 0x000, 0x000, false, true>::check("123456789", 9) == 0xDAF,           "CRC-12/UMTS");
+static_assert(Crc<16, 0x1021>::check("123456789", 9) == 0x31C3,                                    "CRC-16/XMODEM");
+static_assert(Crc<16, 0x1021, 0xFFFF>::check("123456789", 9) == 0x29B1,                            "CRC-16/CCITT-FALSE");
+static_assert(Crc<16, 0x8005, 0x0000, 0x0000, true, true>::check("123456789", 9) == 0xBB3D,        "CRC-16/ARC");
+static_assert(Crc<32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF>::check("123456789", 9) == 0xFC891918,    "CRC-32/BZIP2");
+static_assert(Crc<32, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF, true, true>::check("123456789", 9) == 0xCBF43926, "CRC-32");
+static_assert(Crc<64, 0x42F0E1EBA9EA3693>::check("123456789", 9) == 0x6C40DF5F0B497347,           "CRC-64/ECMA-182");
+static_assert(Crc<64, 0x42F0E1EBA9EA3693, 0xFFFFFFFFFFFFFFFF, 0xFFFFFFFFFFFFFFFF, true, true>::check("123456789", 9) == 0x995DC9BBDF1939FA, "CRC-64/XZ");
+
+
+// -- END OF FILE --
+
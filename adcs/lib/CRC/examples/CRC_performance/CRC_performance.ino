@@ -8,6 +8,7 @@
 
 
 #include "CRC.h"
+#include "CRC16.h"
 
 char str[122] =  "123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890";
 
@@ -105,6 +106,26 @@ void setup()
   Serial.println("=============================");
   delay(100);
 
+  // CRC16 class calculation modes, see host/CRC_benchmark.cpp for a PC version
+  const char * modeName[3] = { "BITWISE", "TABLE", "SLICING4" };
+  for (uint8_t mode = CRC16_MODE_BITWISE; mode <= CRC16_MODE_SLICING4; mode++)
+  {
+    CRC16 crc;
+    crc.setMode(mode);
+    crc.setStartXOR(0xFFFF);
+    start = micros();
+    crc.add(data, len);
+    x16 = crc.getCRC();
+    stop = micros();
+    Serial.print(modeName[mode]);
+    Serial.print(":\t");
+    Serial.println(x16, HEX);
+    Serial.print("TIME:\t");
+    Serial.println(stop - start);
+    delay(100);
+  }
+  Serial.println("=============================");
+
   Serial.println("\n\nDone...");
 }
 
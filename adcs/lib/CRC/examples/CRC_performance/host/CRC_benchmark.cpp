@@ -0,0 +1,123 @@
+//
+//    FILE: CRC_benchmark.cpp
+//  AUTHOR: ADCS firmware contributors, local addition to RobTillaart/CRC 0.2.0
+// PURPOSE: host benchmark of the CRC classes and the Crc<> template
+//    (c) : MIT, see LICENSE
+//
+// Compares bitwise, table and slicing-by-4 throughput of the CRC8 .. CRC64
+// classes with the compile time Crc<> template, on a 30 byte buffer (one
+// ADCS telemetry packet) and a 4 KB buffer.
+// Build and run on a PC from the library folder:
+//
+//   g++ -O2 -std=gnu++11 -I. examples/CRC_performance/host/CRC_benchmark.cpp -o crc_benchmark
+//   ./crc_benchmark
+//
+
+
+#include "CRC8.h"
+#include "CRC12.h"
+#include "CRC16.h"
+#include "CRC32.h"
+#include "CRC64.h"
+
+#include <chrono>
+#include <stdio.h>
+
+
+static uint8_t buffer[4096];
+
+
+// class with default parameters in the given mode
+template <typename CLASS>
+struct ClassCrc
+{
+  uint8_t mode;
+
+  uint64_t operator()(const uint8_t * array, uint32_t length) const
+  {
+    CLASS crc;
+    crc.setMode(mode);
+    crc.add(array, length);
+    return crc.getCRC();
+  }
+};
+
+
+// same parameters fixed at compile time
+template <typename CRC>
+struct TemplateCrc
+{
+  uint64_t operator()(const uint8_t * array, uint32_t length) const
+  {
+    return CRC::calculate(array, length);
+  }
+};
+
+
+template <typename F>
+static void benchmark(const char * name, F crcOf, uint32_t length)
+{
+  // aim for roughly 32 MB of data per measurement
+  uint32_t rounds = (32UL << 20) / length;
+  volatile uint64_t sink = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++)
+  {
+    buffer[0] = r;
+    sink ^= crcOf(buffer, length);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  double mbps = (double)rounds * length / elapsed.count() / 1e6;
+  double ns   = elapsed.count() * 1e9 / rounds;
+  printf("%-18s %6u bytes\t%9.1f MB/s\t%10.1f ns/buffer\n", name, (unsigned)length, mbps, ns);
+}
+
+
+template <typename CLASS, typename CRC>
+static bool benchmarkWidth(const char * name)
+{
+  ClassCrc<CLASS> bitwise  = { CRC_MODE_BITWISE };
+  ClassCrc<CLASS> table    = { CRC_MODE_TABLE };
+  ClassCrc<CLASS> slicing4 = { CRC_MODE_SLICING4 };
+  TemplateCrc<CRC> fixed;
+
+  // all versions must agree before timing them
+  uint64_t expect = bitwise(buffer, sizeof(buffer));
+  if (table(buffer, sizeof(buffer)) != expect ||
+      slicing4(buffer, sizeof(buffer)) != expect ||
+      fixed(buffer, sizeof(buffer)) != expect)
+  {
+    printf("%s versions disagree\n", name);
+    return false;
+  }
+
+  printf("%s\n", name);
+  const uint32_t lengths[2] = { 30, sizeof(buffer) };
+  for (int i = 0; i < 2; i++)
+  {
+    benchmark("  class bitwise",  bitwise,  lengths[i]);
+    benchmark("  class table",    table,    lengths[i]);
+    benchmark("  class slicing4", slicing4, lengths[i]);
+    benchmark("  Crc<>",          fixed,    lengths[i]);
+  }
+  return true;
+}
+
+
+int main()
+{
+  for (uint32_t i = 0; i < sizeof(buffer); i++) buffer[i] = i * 31 + 7;
+
+  bool ok = true;
+  ok &= benchmarkWidth<CRC8,  Crc<8,  CRC8_DEFAULT_POLYNOME> >("CRC8");
+  ok &= benchmarkWidth<CRC12, Crc<12, CRC12_DEFAULT_POLYNOME> >("CRC12");
+  ok &= benchmarkWidth<CRC16, Crc<16, CRC16_DEFAULT_POLYNOME> >("CRC16");
+  ok &= benchmarkWidth<CRC32, Crc<32, CRC32_DEFAULT_POLYNOME> >("CRC32");
+  ok &= benchmarkWidth<CRC64, Crc<64, CRC64_DEFAULT_POLYNOME> >("CRC64");
+  return ok ? 0 : 1;
+}
+
+
+// -- END OF FILE --
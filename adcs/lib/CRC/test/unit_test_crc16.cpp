@@ -304,6 +304,35 @@ unittest(test_crc16)
 }
 
 
+unittest(test_crc16_modes)
+{
+  fprintf(stderr, "TEST CRC16 MODES\n");
+
+  uint8_t buffer[200];
+  for (int i = 0; i < 200; i++) buffer[i] = i * 7 + 3;
+
+  for (int flags = 0; flags < 4; flags++)
+  {
+    uint16_t expect = 0;
+    for (uint8_t mode = CRC16_MODE_BITWISE; mode <= CRC16_MODE_SLICING4; mode++)
+    {
+      CRC16 crc;
+      crc.setMode(mode);
+      crc.setStartXOR(0xB2AA);
+      crc.setEndXOR(0x0F0F);
+      crc.setReverseIn(flags & 1);
+      crc.setReverseOut(flags & 2);
+      // odd lengths and single values exercise the slicing tail handling
+      crc.add(buffer, 101);
+      crc.add(buffer[101]);
+      crc.add(buffer + 102, 98);
+      if (mode == CRC16_MODE_BITWISE) expect = crc.getCRC();
+      assertEqual(expect, crc.getCRC());
+    }
+  }
+}
+
+
 unittest_main()
 
 // --------
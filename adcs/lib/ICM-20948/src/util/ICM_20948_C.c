@@ -120,6 +120,8 @@ const ICM_20948_Serif_t NullSerif = {
 };
 
 // Private function prototypes
+static void ICM_20948_shadow_accel_config(ICM_20948_Device_t *pdev, ICM_20948_ACCEL_CONFIG_t reg, ICM_20948_Status_e retval);
+static void ICM_20948_shadow_gyro_config_1(ICM_20948_Device_t *pdev, ICM_20948_GYRO_CONFIG_1_t reg, ICM_20948_Status_e retval);
 
 // Function definitions
 ICM_20948_Status_e ICM_20948_init_struct(ICM_20948_Device_t *pdev)
@@ -292,6 +294,7 @@ ICM_20948_Status_e ICM_20948_sw_reset(ICM_20948_Device_t *pdev)
   }
 
   reg.DEVICE_RESET = 1;
+  pdev->_config_shadowed = false; // The configuration returns to its reset values
 
   retval = ICM_20948_execute_w(pdev, AGB0_REG_PWR_MGMT_1, (uint8_t *)&reg, sizeof(ICM_20948_PWR_MGMT_1_t));
   if (retval != ICM_20948_Stat_Ok)
@@ -630,6 +633,24 @@ ICM_20948_Status_e ICM_20948_set_sample_mode(ICM_20948_Device_t *pdev, ICM_20948
   return retval;
 }
 
+// Keep the shadows read by ICM_20948_get_agmt in step with a register just written. After a failed
+// transfer the register is unknown and get_agmt reads it again
+static void ICM_20948_shadow_accel_config(ICM_20948_Device_t *pdev, ICM_20948_ACCEL_CONFIG_t reg, ICM_20948_Status_e retval)
+{
+  if (retval == ICM_20948_Stat_Ok)
+    pdev->_accel_config = reg;
+  else
+    pdev->_config_shadowed = false;
+}
+
+static void ICM_20948_shadow_gyro_config_1(ICM_20948_Device_t *pdev, ICM_20948_GYRO_CONFIG_1_t reg, ICM_20948_Status_e retval)
+{
+  if (retval == ICM_20948_Stat_Ok)
+    pdev->_gyro_config_1 = reg;
+  else
+    pdev->_config_shadowed = false;
+}
+
 ICM_20948_Status_e ICM_20948_set_full_scale(ICM_20948_Device_t *pdev, ICM_20948_InternalSensorID_bm sensors, ICM_20948_fss_t fss)
 {
   ICM_20948_Status_e retval = ICM_20948_Stat_Ok;
@@ -646,6 +667,7 @@ ICM_20948_Status_e ICM_20948_set_full_scale(ICM_20948_Device_t *pdev, ICM_20948_
     retval |= ICM_20948_execute_r(pdev, AGB2_REG_ACCEL_CONFIG, (uint8_t *)&reg, sizeof(ICM_20948_ACCEL_CONFIG_t));
     reg.ACCEL_FS_SEL = fss.a;
     retval |= ICM_20948_execute_w(pdev, AGB2_REG_ACCEL_CONFIG, (uint8_t *)&reg, sizeof(ICM_20948_ACCEL_CONFIG_t));
+    ICM_20948_shadow_accel_config(pdev, reg, retval);
   }
   if (sensors & ICM_20948_Internal_Gyr)
   {
@@ -654,6 +676,7 @@ ICM_20948_Status_e ICM_20948_set_full_scale(ICM_20948_Device_t *pdev, ICM_20948_
     retval |= ICM_20948_execute_r(pdev, AGB2_REG_GYRO_CONFIG_1, (uint8_t *)&reg, sizeof(ICM_20948_GYRO_CONFIG_1_t));
     reg.GYRO_FS_SEL = fss.g;
     retval |= ICM_20948_execute_w(pdev, AGB2_REG_GYRO_CONFIG_1, (uint8_t *)&reg, sizeof(ICM_20948_GYRO_CONFIG_1_t));
+    ICM_20948_shadow_gyro_config_1(pdev, reg, retval);
   }
   return retval;
 }
@@ -674,6 +697,7 @@ ICM_20948_Status_e ICM_20948_set_dlpf_cfg(ICM_20948_Device_t *pdev, ICM_20948_In
     retval |= ICM_20948_execute_r(pdev, AGB2_REG_ACCEL_CONFIG, (uint8_t *)&reg, sizeof(ICM_20948_ACCEL_CONFIG_t));
     reg.ACCEL_DLPFCFG = cfg.a;
     retval |= ICM_20948_execute_w(pdev, AGB2_REG_ACCEL_CONFIG, (uint8_t *)&reg, sizeof(ICM_20948_ACCEL_CONFIG_t));
+    ICM_20948_shadow_accel_config(pdev, reg, retval);
   }
   if (sensors & ICM_20948_Internal_Gyr)
   {
@@ -682,6 +706,7 @@ ICM_20948_Status_e ICM_20948_set_dlpf_cfg(ICM_20948_Device_t *pdev, ICM_20948_In
     retval |= ICM_20948_execute_r(pdev, AGB2_REG_GYRO_CONFIG_1, (uint8_t *)&reg, sizeof(ICM_20948_GYRO_CONFIG_1_t));
     reg.GYRO_DLPFCFG = cfg.g;
     retval |= ICM_20948_execute_w(pdev, AGB2_REG_GYRO_CONFIG_1, (uint8_t *)&reg, sizeof(ICM_20948_GYRO_CONFIG_1_t));
+    ICM_20948_shadow_gyro_config_1(pdev, reg, retval);
   }
   return retval;
 }
@@ -709,6 +734,7 @@ ICM_20948_Status_e ICM_20948_enable_dlpf(ICM_20948_Device_t *pdev, ICM_20948_Int
       reg.ACCEL_FCHOICE = 0;
     }
     retval |= ICM_20948_execute_w(pdev, AGB2_REG_ACCEL_CONFIG, (uint8_t *)&reg, sizeof(ICM_20948_ACCEL_CONFIG_t));
+    ICM_20948_shadow_accel_config(pdev, reg, retval);
   }
   if (sensors & ICM_20948_Internal_Gyr)
   {
@@ -724,6 +750,7 @@ ICM_20948_Status_e ICM_20948_enable_dlpf(ICM_20948_Device_t *pdev, ICM_20948_Int
       reg.GYRO_FCHOICE = 0;
     }
     retval |= ICM_20948_execute_w(pdev, AGB2_REG_GYRO_CONFIG_1, (uint8_t *)&reg, sizeof(ICM_20948_GYRO_CONFIG_1_t));
+    ICM_20948_shadow_gyro_config_1(pdev, reg, retval);
   }
   return retval;
 }
@@ -996,18 +1023,20 @@ ICM_20948_Status_e ICM_20948_get_agmt(ICM_20948_Device_t *pdev, ICM_20948_AGMT_t
   pagmt->mag.axes.z = ((buff[20] << 8) | (buff[19] & 0xFF));
   pagmt->magStat2 = buff[22];
 
-  // Get settings to be able to compute scaled values
-  retval |= ICM_20948_set_bank(pdev, 2);
-  ICM_20948_ACCEL_CONFIG_t acfg;
-  retval |= ICM_20948_execute_r(pdev, (uint8_t)AGB2_REG_ACCEL_CONFIG, (uint8_t *)&acfg, 1 * sizeof(acfg));
-  pagmt->fss.a = acfg.ACCEL_FS_SEL; // Worth noting that without explicitly setting the FS range of the accelerometer it was showing the register value for +/- 2g but the reported values were actually scaled to the +/- 16g range
-                                    // Wait a minute... now it seems like this problem actually comes from the digital low-pass filter. When enabled the value is 1/8 what it should be...
-  retval |= ICM_20948_set_bank(pdev, 2);
-  ICM_20948_GYRO_CONFIG_1_t gcfg1;
-  retval |= ICM_20948_execute_r(pdev, (uint8_t)AGB2_REG_GYRO_CONFIG_1, (uint8_t *)&gcfg1, 1 * sizeof(gcfg1));
-  pagmt->fss.g = gcfg1.GYRO_FS_SEL;
-  ICM_20948_ACCEL_CONFIG_2_t acfg2;
-  retval |= ICM_20948_execute_r(pdev, (uint8_t)AGB2_REG_ACCEL_CONFIG_2, (uint8_t *)&acfg2, 1 * sizeof(acfg2));
+  // Get settings to be able to compute scaled values. They only change through the functions that keep
+  // the shadows, so the registers are read once and every later sample is a single bank 0 burst
+  if (!pdev->_config_shadowed)
+  {
+    ICM_20948_Status_e cfg_retval = ICM_20948_Stat_Ok;
+    cfg_retval |= ICM_20948_set_bank(pdev, 2);
+    cfg_retval |= ICM_20948_execute_r(pdev, (uint8_t)AGB2_REG_ACCEL_CONFIG, (uint8_t *)&pdev->_accel_config, sizeof(ICM_20948_ACCEL_CONFIG_t));
+    cfg_retval |= ICM_20948_execute_r(pdev, (uint8_t)AGB2_REG_GYRO_CONFIG_1, (uint8_t *)&pdev->_gyro_config_1, sizeof(ICM_20948_GYRO_CONFIG_1_t));
+    pdev->_config_shadowed = (cfg_retval == ICM_20948_Stat_Ok);
+    retval |= cfg_retval;
+  }
+  pagmt->fss.a = pdev->_accel_config.ACCEL_FS_SEL; // Worth noting that without explicitly setting the FS range of the accelerometer it was showing the register value for +/- 2g but the reported values were actually scaled to the +/- 16g range
+                                                   // Wait a minute... now it seems like this problem actually comes from the digital low-pass filter. When enabled the value is 1/8 what it should be...
+  pagmt->fss.g = pdev->_gyro_config_1.GYRO_FS_SEL;
 
   return retval;
 }
@@ -182,6 +182,9 @@ extern int memcmp(const void *, const void *, size_t); // Avoid compiler warning
     uint16_t _dataRdyStatus;          // Diagnostics: record the setting of DATA_RDY_STATUS
     uint16_t _motionEventCtl;         // Diagnostics: record the setting of MOTION_EVENT_CTL
     uint16_t _dataIntrCtl;            // Diagnostics: record the setting of DATA_INTR_CTL
+    ICM_20948_ACCEL_CONFIG_t _accel_config;   // Shadow of ACCEL_CONFIG, kept by the functions that write it. Raw writes through execute_w bypass it
+    ICM_20948_GYRO_CONFIG_1_t _gyro_config_1; // Shadow of GYRO_CONFIG_1, likewise
+    bool _config_shadowed;                    // The shadows match the registers, so get_agmt does not read them. Cleared by a reset or a failed write
   } ICM_20948_Device_t;               // Definition of device struct type
 
   ICM_20948_Status_e ICM_20948_init_struct(ICM_20948_Device_t *pdev); // Initialize ICM_20948_Device_t
@@ -19,18 +19,36 @@
 //<<constructor>> 
 INA209::INA209(int address){
 	i2c_addr = address;	
+	_transfer = NULL;
+	_context = NULL;
 }
 //<<destructor>>
 INA209::~INA209(){/*nothing to destruct*/}
 
+// send the transfers through transfer instead of Wire, NULL for Wire again
+void INA209::setTransfer(INA209Transfer transfer, void *context) {
+	_transfer = transfer;
+	_context = context;
+}
+
 // positioning on register pointer address
 void INA209::pointReg(int p_address) {			
+	if (_transfer != NULL) {
+		uint8_t reg = p_address;
+		_transfer(i2c_addr, &reg, 1, NULL, 0, _context);
+		return;
+	}
 	Wire.beginTransmission(i2c_addr);      
 	Wire.write(p_address);                  
 	Wire.endTransmission();
 }
 // read a word from the register pointed
 word INA209::readWord() {			
+	if (_transfer != NULL) {
+		uint8_t data[2] = {0, 0};
+		_transfer(i2c_addr, NULL, 0, data, 2, _context);
+		return word(data[0], data[1]);
+	}
 	Wire.requestFrom(i2c_addr, 2);    // read 2 bytes from register	
 	byte MSB = Wire.read();    
 	byte LSB = Wire.read();    
@@ -38,6 +56,11 @@ word INA209::readWord() {
 }
 // write a word into the register pointed
 void INA209::writeWord(int p_address, word wordToW) {	
+	if (_transfer != NULL) {
+		uint8_t data[3] = {(uint8_t)p_address, highByte(wordToW), lowByte(wordToW)};
+		_transfer(i2c_addr, data, 3, NULL, 0, _context);
+		return;
+	}
 	Wire.beginTransmission(i2c_addr);	
 	Wire.write(p_address);
 	Wire.write(highByte(wordToW)); 
@@ -53,7 +76,7 @@ word INA209::readCfgReg(){
 }
 void INA209::writeCfgReg(word CfgReg){
 	writeWord(0x00,CfgReg);
-}
+}
 // read Status Register (Status flags for warnings,over-/under-limits, conversion ready,math overflow, and SMBus Alert).).
 word INA209::statusReg(){
 	pointReg(0x01);
@@ -20,17 +20,24 @@
 #include <Arduino.h>
 #include <Wire.h>
 
+// transfer on the bus in place of Wire: write tx_len bytes, then read rx_len
+// bytes, true if all were acknowledged
+typedef bool (*INA209Transfer)(uint8_t addr, const uint8_t *tx, uint8_t tx_len, uint8_t *rx, uint8_t rx_len, void *context);
+
 class INA209 {
 	int i2c_addr;
 	int p_addr;
+	INA209Transfer _transfer;
+	void *_context;
 private:
 	word readWord();
 	void writeWord(int p_address, word wordToW);
 	void pointReg(int p_address);
 public:
-	INA209(void){}
+	INA209(void) : _transfer(NULL), _context(NULL) {}
 	INA209(int address);
 	~INA209();
+	void setTransfer(INA209Transfer transfer, void *context);
 	word readCfgReg();
 	void writeCfgReg(word CfgReg);
 	word statusReg();
@@ -74,4 +81,4 @@ public:
 	void writeCal(word cal);
 };
 
-#endif
+#endif
@@ -1,5 +1,133 @@
 #include "comm.h"
 
+#include <I2CBus.h>
+#include <string.h>
+
+SPSCRingBuffer<uint8_t, UART_RX_BUF_LEN> uart_rx_buf;
+
+// task woken by the UART receive interrupt, NULL until attachUARTrx is called
+static TaskHandle_t uart_rx_task = NULL;
+
+PacketPool<TX_POOL_LEN, TX_FRAME_LEN> uart_tx_pool;
+
+// packet being shifted out by the UART transmit interrupt, NULL when idle
+static const uint8_t *tx_packet = NULL;
+static uint8_t tx_len;
+static uint8_t tx_pos;
+
+#if !ADCS_SIM
+// RAM copy of the interrupt vector table. The Arduino variant owns the SERCOM
+// handlers in flash, so the UART and I2C vectors are redirected here. VTOR
+// requires the table to be aligned to its size rounded up to a power of two.
+static DeviceVectors ram_vectors __attribute__((aligned(1024)));
+static bool ram_vectors_active = false;
+
+/**
+ * @brief      SERCOM_I2C_HW in I2C master mode driven from its interrupts, for
+ *             the transfer queue of I2CBus.h. Smart mode is off: every byte
+ *             received is acknowledged by a command.
+ */
+class I2CMaster
+{
+private:
+	static void sync(void)
+	{
+		while (SERCOM_I2C_HW->I2CM.SYNCBUSY.bit.SYSOP)
+			;
+	}
+
+	static void command(uint8_t cmd, bool nack)
+	{
+		uint32_t ctrlb = SERCOM_I2C_HW->I2CM.CTRLB.reg & ~(SERCOM_I2CM_CTRLB_CMD_Msk | SERCOM_I2CM_CTRLB_ACKACT);
+
+		SERCOM_I2C_HW->I2CM.CTRLB.reg = ctrlb | SERCOM_I2CM_CTRLB_CMD(cmd) | (nack ? SERCOM_I2CM_CTRLB_ACKACT : 0);
+		sync();
+	}
+
+	static void disable(void)
+	{
+		SERCOM_I2C_HW->I2CM.INTENCLR.reg = SERCOM_I2CM_INTENCLR_MB | SERCOM_I2CM_INTENCLR_SB | SERCOM_I2CM_INTENCLR_ERROR;
+	}
+
+public:
+	void start(uint8_t addr, bool read)
+	{
+		SERCOM_I2C_HW->I2CM.INTENSET.reg = SERCOM_I2CM_INTENSET_MB | SERCOM_I2CM_INTENSET_SB | SERCOM_I2CM_INTENSET_ERROR;
+		SERCOM_I2C_HW->I2CM.CTRLB.bit.ACKACT = 0;
+		sync();
+
+		// a repeated start if the bus is still ours
+		SERCOM_I2C_HW->I2CM.ADDR.reg = SERCOM_I2CM_ADDR_ADDR((addr << 1) | (read ? 1 : 0));
+		sync();
+	}
+
+	void write(uint8_t data)
+	{
+		SERCOM_I2C_HW->I2CM.DATA.reg = data;
+		sync();
+	}
+
+	uint8_t read(bool last)
+	{
+		uint8_t data = SERCOM_I2C_HW->I2CM.DATA.reg;
+
+		if (last)
+		{
+			disable();
+			command(3, true); // nack and stop
+		}
+		else
+			command(2, false); // ack and read the next byte
+		return data;
+	}
+
+	void stop(void)
+	{
+		disable();
+		command(3, false);
+	}
+
+	void reset(void)
+	{
+		disable();
+		command(3, false);
+
+		// clear the errors and force the bus state back to idle
+		SERCOM_I2C_HW->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_MB | SERCOM_I2CM_INTFLAG_SB | SERCOM_I2CM_INTFLAG_ERROR;
+		SERCOM_I2C_HW->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST | SERCOM_I2CM_STATUS_BUSSTATE(1);
+		sync();
+	}
+
+	I2CEvent event(void)
+	{
+		uint8_t flags = SERCOM_I2C_HW->I2CM.INTFLAG.reg;
+		uint16_t status = SERCOM_I2C_HW->I2CM.STATUS.reg;
+
+		if (flags & SERCOM_I2CM_INTFLAG_ERROR)
+		{
+			SERCOM_I2C_HW->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_ERROR;
+			return I2C_EVENT_ERROR;
+		}
+		if (flags & SERCOM_I2CM_INTFLAG_MB)
+		{
+			if (status & (SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST))
+				return I2C_EVENT_ERROR;
+			return (status & SERCOM_I2CM_STATUS_RXNACK) ? I2C_EVENT_NACK : I2C_EVENT_ACK;
+		}
+		if (flags & SERCOM_I2CM_INTFLAG_SB)
+			return I2C_EVENT_DATA;
+		return I2C_EVENT_NONE;
+	}
+};
+#else
+// the simulated SERCOM_I2C, see Wire.h
+typedef SimI2CMaster I2CMaster;
+#endif
+
+// transfers of the IMU and INA209 tasks, run by the SERCOM_I2C interrupts
+static I2CMaster i2c_master;
+static I2CBus<I2CMaster> i2c_bus(i2c_master);
+
 /* TEScommand METHODS ======================================================= */
 
 /**
@@ -89,6 +217,7 @@ void TEScommand::clear()
 		_data[i] = 0;
 
 	_bytes_received = 0;
+	_full = false;
 }
 
 /* ADCSdata METHODS ========================================================= */
@@ -108,7 +237,7 @@ ADCSdata::ADCSdata()
  */
 void ADCSdata::setStatus(uint8_t s)
 {
-	_status = s;
+	setField(HB_STATUS, s);
 }
 
 /**
@@ -118,8 +247,8 @@ void ADCSdata::setStatus(uint8_t s)
  */
 void ADCSdata::setINAdata(INAdata data)
 {
-	_voltage = floatToFixed(data.voltage);
-	_current = (int8_t)data.current;
+	setField(HB_VOLTAGE, fixed5_3_t::fromFloat(data.voltage).raw());
+	setField(HB_CURRENT, (int32_t)data.current);
 }
 
 /**
@@ -129,38 +258,39 @@ void ADCSdata::setINAdata(INAdata data)
  */
 void ADCSdata::setIMUdata(IMUdata data)
 {
-	_magX = (int8_t)data.magX;
-	_magY = (int8_t)data.magY;
-	_magZ = (int8_t)data.magZ;
+	setField(HB_MAG_X, (int32_t)data.magX);
+	setField(HB_MAG_Y, (int32_t)data.magY);
+	setField(HB_MAG_Z, (int32_t)data.magZ);
 
-	_gyroX = floatToFixed(data.gyrX);
-	_gyroY = floatToFixed(data.gyrY);
-	_gyroZ = floatToFixed(data.gyrZ);
+	setField(HB_GYRO_X, fixed5_3_t::fromFloat(data.gyrX).raw());
+	setField(HB_GYRO_Y, fixed5_3_t::fromFloat(data.gyrY).raw());
+	setField(HB_GYRO_Z, fixed5_3_t::fromFloat(data.gyrZ).raw());
 }
 /**
  * @brief      Add sunsensor data to packet as an integer 
  */
 void ADCSdata::setPDdata(PDdata_int data)
 {
-	_pd_xpos = data.x_pos;
-	_pd_xneg = data.x_neg;
-	_pd_ypos = data.y_pos;
-	_pd_yneg = data.y_neg;
-	_pd_zpos = data.z_pos;
-	_pd_zneg = data.z_neg;
-
+	setField(HB_PD_XPOS, data.x_pos);
+	setField(HB_PD_XNEG, data.x_neg);
+	setField(HB_PD_YPOS, data.y_pos);
+	setField(HB_PD_YNEG, data.y_neg);
+	setField(HB_PD_ZPOS, data.z_pos);
+	setField(HB_PD_ZNEG, data.z_neg);
 }
 /**
  * @brief      Add frequency pin measurement to the ADCS data packet
  */
 void ADCSdata::setFreqData(int rps)
 {
-	_freq = rps; 
+	setField(HB_FREQ, rps);
 }
 
 void ADCSdata::setActStatus()
 {
 
+	uint8_t mtx1, mtx2;
+
 	uint8_t F1 =0;
 	uint8_t R1 =0;
 	uint8_t F2 =0;
@@ -174,53 +304,76 @@ void ADCSdata::setActStatus()
 	// Check the status of MTx1 Pins 
 	if ( F1 &&  R1)
 	{
-		_mtx1 = 0xb; 
+		mtx1 = 0xb; 
 	} else if (!F1 && !R1)
 	{
-		_mtx1 = 0xa;
+		mtx1 = 0xa;
 	}else if (F1 == 1 && R1 ==0 )
 	{
-		_mtx1 = 0x1;
+		mtx1 = 0x1;
 	}else if (F1 == 0 && R1 == 1 )
 	{
-		_mtx1 = 0x2;
+		mtx1 = 0x2;
 	} else {
-		_mtx1 = 0x0;
+		mtx1 = 0x0;
 	}
 	// Check the Status of the Mtx2 Pins 
 	if ( F2 &&  R2)
 	{
-		_mtx2 = 0xb; 
+		mtx2 = 0xb; 
 	} else if (!F2 && !R2)
 	{
-		_mtx2 = 0xa;
+		mtx2 = 0xa;
 	}else if (F2 == 1 && R2 ==0 )
 	{
-		_mtx2 = 0x1;
+		mtx2 = 0x1;
 	}else if (F2 == 0 && R2 == 1 )
 	{
-		_mtx2 = 0x2;
+		mtx2 = 0x2;
 	} else {
-		_mtx2 = 0x0;
+		mtx2 = 0x0;
 	}
-	_buck_en = digitalRead(BEN_PIN);
-	_motor_en = digitalRead(MEN_PIN);
-	
+	setField(HB_MTX1, mtx1);
+	setField(HB_MTX2, mtx2);
+	setField(HB_BUCK_EN, digitalRead(BEN_PIN));
+	setField(HB_MOTOR_EN, digitalRead(MEN_PIN));
 }
 
 
 /**
- * @brief      Compute CRC for validation of the packet
+ * @brief      Pack a field into the packet, see HeartbeatSchema.h. Values that
+ *             do not fit the field saturate. The bytes the field spans are
+ *             marked so computeCRC patches them in.
+ *
+ * @param[in]  field  The field to set
+ * @param[in]  value  Raw field value
+ */
+void ADCSdata::setField(HeartbeatField field, int32_t value)
+{
+	uint16_t offset = heartbeat_offsets[field];
+	uint8_t first = offset >> 3;
+	uint8_t last = (offset + heartbeat_bits[field] - 1) >> 3;
+
+	packField(_data, offset, heartbeat_schema[field], value);
+	_crc_state.markDirty(first, last - first + 1);
+}
+
+/**
+ * @brief      Compute CRC for validation of the packet. Only fields written
+ *             since the last call are run through the CRC, an unchanged packet
+ *             costs nothing.
  */
 void ADCSdata::computeCRC()
 {
-	CRC16 crcGen;
-	crcGen.add(_data, PACKET_LEN-2);
-	_crc = crcGen.getCRC();
+	uint16_t crc = _crc_state.update(_data);
+
+	_data[HEARTBEAT_PAYLOAD_LEN] = crc & 0xff;
+	_data[HEARTBEAT_PAYLOAD_LEN + 1] = crc >> 8;
 }
 
 /**
- * @brief      Get the data field
+ * @brief      Get the data field. Read only, bytes written through the pointer
+ *             are not tracked by the incremental CRC.
  *
  * @return     Pointer to the data field
  */
@@ -236,15 +389,87 @@ void ADCSdata::clear()
 {
 	for (int i = 0; i < PACKET_LEN; i++)
 		_data[i] = 0;
+
+	_crc_state.markDirty(0, HEARTBEAT_PAYLOAD_LEN);
 }
 
 /**
- * @brief      Send packet over UART connection
+ * @brief      Queue the packet for the UART transmit interrupt. Returns as soon
+ *             as the packet is copied into a pool buffer, it never waits for
+ *             the wire.
+ *
+ * @param[in]  notify  Task to notify with vTaskNotifyGive once the packet has
+ *                     been transmitted, NULL for none
+ *
+ * @return     True if queued, False if every pool buffer was in use and the
+ *             packet was dropped
  */
-void ADCSdata::send()
+bool ADCSdata::send(TaskHandle_t notify)
 {
 	computeCRC();
-	SERCOM_UART.write((char*)_data, PACKET_LEN);
+	return sendFrame(_data, PACKET_LEN, notify);
+}
+
+/**
+ * @brief      Send the packet right away, waiting on the UART, where the
+ *             transmit interrupt cannot run, see sendFramePolled
+ */
+void ADCSdata::sendPolled()
+{
+	computeCRC();
+	sendFramePolled(_data, PACKET_LEN);
+}
+
+/* IMUbatch METHODS ========================================================= */
+
+/**
+ * @brief      Constructs a new instance with an empty frame
+ */
+IMUbatch::IMUbatch() : _encoder(IMU_BATCH_SAMPLES)
+{
+	_encoder.begin(IMU_BATCH_PERIOD_MS);
+}
+
+/**
+ * @brief      Add a sample to the frame. A full frame is sent first.
+ *
+ * @param[in]  data  Magnetometer and gyroscope values of one IMU read
+ * @param[in]  t_ms  Time of the read in milliseconds
+ */
+void IMUbatch::add(IMUdata data, uint32_t t_ms)
+{
+	BatchSample s;
+
+	s.v[0] = batchQuantize(data.gyrX, BATCH_GYRO_LSB);
+	s.v[1] = batchQuantize(data.gyrY, BATCH_GYRO_LSB);
+	s.v[2] = batchQuantize(data.gyrZ, BATCH_GYRO_LSB);
+	s.v[3] = batchQuantize(data.magX, BATCH_MAG_LSB);
+	s.v[4] = batchQuantize(data.magY, BATCH_MAG_LSB);
+	s.v[5] = batchQuantize(data.magZ, BATCH_MAG_LSB);
+
+	if (!_encoder.add(s, t_ms))
+	{
+		send();
+		_encoder.add(s, t_ms);
+	}
+}
+
+/**
+ * @brief      Queue the frame for transmission and start a new one
+ *
+ * @return     True if queued or empty, False if dropped for lack of buffers
+ */
+bool IMUbatch::send()
+{
+	if (_encoder.count() == 0)
+		return true;
+
+	uint8_t len;
+	const uint8_t *frame = _encoder.finish(len);
+	bool queued = sendFrame(frame, len);
+
+	_encoder.begin(IMU_BATCH_PERIOD_MS);
+	return queued;
 }
 
 /* HARDWARE INIT FUNCTIONS ================================================== */
@@ -279,6 +504,7 @@ void initUART(void)
     SERCOM_UART.begin(115200, SERIAL_8O1);
     while (!SERCOM_UART);  // wait for initialization to complete
 	SERCOM_UART.setTimeout(10);
+	attachUARTtx();
 	#if DEBUG
 	    SERCOM_USB.print("[system init]\tUART interface initialized\r\n");
 	#endif
@@ -295,43 +521,372 @@ void initI2C(void)
      */
     SERCOM_I2C.begin();
     SERCOM_I2C.setClock(400000);
+	attachI2C();
 	#if DEBUG
 		SERCOM_USB.print("[system init]\tI2C interface initialized\r\n");
 	#endif
 }
 
-/* HELPER FUNCTIONS ========================================================= */
+#if !ADCS_SIM
+/**
+ * @brief
+ * Switch to the RAM copy of the vector table so single SERCOM vectors can
+ * be replaced. Copies the table the first time only.
+ */
+static void useRAMvectors(void)
+{
+	if (ram_vectors_active)
+		return;
+
+	__disable_irq();
+	memcpy(&ram_vectors, (void *)SCB->VTOR, sizeof(DeviceVectors));
+	SCB->VTOR = ((uint32_t)&ram_vectors & SCB_VTOR_TBLOFF_Msk);
+	__DSB();
+	__enable_irq();
+
+	ram_vectors_active = true;
+}
+#endif
+
+/* UART RECEIVE PATH ======================================================== */
 
 /**
  * @brief
- * Converts a floating-point number to a fixed-point number with 5 bits for the
- * integer part and 3 bits for the fraction part. Resulting data cannot be
- * properly interpreted until converted back into a float.
- * 
- * @param[in] f  Float to convert
- * 
- * @return Fixed-point conversion
+ * Receive complete interrupt for SERCOM_UART. Moves every received byte into
+ * uart_rx_buf and wakes the command task. Replaces the Arduino Uart handler for
+ * this vector only, transmit goes through uartTxHandler.
  */
-fixed5_3_t floatToFixed(float f)
+static void uartRxHandler(void)
 {
-    fixed5_3_t fix;
-    fix = (uint8_t)(f * (1 << 3));
-    return fix;
+	BaseType_t task_woken = pdFALSE;
+
+	if (SERCOM_UART_HW.isFrameErrorUART())
+	{
+		// frame error, byte is invalid so read and discard it
+		SERCOM_UART_HW.readDataUART();
+		SERCOM_UART_HW.clearFrameErrorUART();
+	}
+
+	while (SERCOM_UART_HW.availableDataUART())
+		uart_rx_buf.push(SERCOM_UART_HW.readDataUART()); // dropped if task falls behind
+
+	if (SERCOM_UART_HW.isUARTError())
+	{
+		SERCOM_UART_HW.acknowledgeUARTError();
+		SERCOM_UART_HW.clearStatusUART();
+	}
+
+	if (uart_rx_task != NULL)
+		vTaskNotifyGiveFromISR(uart_rx_task, &task_woken);
+
+	portYIELD_FROM_ISR(task_woken);
 }
 
 /**
  * @brief
- * Converts a fixed-point number with 5 integer bits and 3 fraction bits to a
- * floating-point number. Resulting data can be properly interpreted with no
- * extra conversions.
- * 
- * @param[in] fix  Fixed-point number to convert
- * 
- * @return Float conversion
- */
-float fixedToFloat(fixed5_3_t fix)
-{
-    float f;
-    f = ((float)fix) / (1 << 3);
-    return f;
-}
\ No newline at end of file
+ * Route the SERCOM_UART receive interrupt to uartRxHandler and notify task each
+ * time bytes arrive. Must be called after initUART, typically by the command
+ * task itself once it is running.
+ *
+ * @param[in]  task  Task to notify, it should block in ulTaskNotifyTake
+ */
+void attachUARTrx(TaskHandle_t task)
+{
+	uart_rx_task = task;
+
+	#if ADCS_SIM
+		simSetVector(SERCOM_UART_RX_IRQn, uartRxHandler);
+	#else
+		useRAMvectors();
+		ram_vectors.SERCOM_UART_RX_VECTOR = (void *)uartRxHandler;
+	#endif
+
+	// must not be above the max syscall priority to use FreeRTOS FromISR calls
+	NVIC_SetPriority(SERCOM_UART_RX_IRQn, configLIBRARY_LOWEST_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(SERCOM_UART_RX_IRQn);
+
+	#if DEBUG
+		SERCOM_USB.print("[system init]\tUART receive interrupt attached\r\n");
+	#endif
+}
+
+/* UART TRANSMIT PATH ======================================================= */
+
+/**
+ * @brief
+ * Data register empty interrupt for SERCOM_UART. Writes the next byte of the
+ * packet being sent, takes the oldest queued packet from uart_tx_pool when the
+ * previous one is done and notifies its sender. Disables itself when the pool
+ * is empty, ADCSdata::send enables it again.
+ */
+static void uartTxHandler(void)
+{
+	BaseType_t task_woken = pdFALSE;
+
+	if (tx_packet == NULL)
+	{
+		tx_packet = uart_tx_pool.next(tx_len);
+
+		if (tx_packet == NULL)
+		{
+			SERCOM_UART_HW.disableDataRegisterEmptyInterruptUART();
+
+			// a packet queued before the interrupt was disabled would wait
+			// for the next send, so look once more
+			tx_packet = uart_tx_pool.next(tx_len);
+			if (tx_packet == NULL)
+				return;
+
+			SERCOM_UART_HW.enableDataRegisterEmptyInterruptUART();
+		}
+
+		tx_pos = 0;
+	}
+
+	SERCOM_UART_HW.writeDataUART(tx_packet[tx_pos++]);
+
+	if (tx_pos >= tx_len)
+	{
+		// last byte is in the shift register, the buffer can be reused
+		tx_packet = NULL;
+		TaskHandle_t sender = (TaskHandle_t)uart_tx_pool.complete();
+
+		if (sender != NULL)
+			vTaskNotifyGiveFromISR(sender, &task_woken);
+	}
+
+	portYIELD_FROM_ISR(task_woken);
+}
+
+/**
+ * @brief      Queue a frame for the UART transmit interrupt, never waits for the
+ *             wire
+ *
+ * @param[in]  frame   Bytes to send, copied before returning
+ * @param[in]  len     Number of bytes, at most TX_FRAME_LEN
+ * @param[in]  notify  Task to notify with vTaskNotifyGive once the frame has
+ *                     been transmitted, NULL for none
+ *
+ * @return     True if queued, False if every pool buffer was in use and the
+ *             frame was dropped
+ */
+bool sendFrame(const uint8_t *frame, uint8_t len, TaskHandle_t notify)
+{
+	if (len > TX_FRAME_LEN)
+		len = TX_FRAME_LEN;
+
+	// a mode task deleted between acquire and commit would leave its buffer
+	// filling for good. The transmit interrupt still runs meanwhile.
+	vTaskSuspendAll();
+
+	uint8_t *buf = uart_tx_pool.acquire();
+	if (buf != NULL)
+	{
+		memcpy(buf, frame, len);
+		uart_tx_pool.commit(buf, len, notify);
+	}
+
+	xTaskResumeAll();
+
+	if (buf == NULL)
+		return false;
+
+	// data register empty fires right away if the transmitter is idle
+	SERCOM_UART_HW.enableDataRegisterEmptyInterruptUART();
+	return true;
+}
+
+/**
+ * @brief      Queue a frame like sendFrame, but wait for a free transmit
+ *             buffer instead of dropping it. For reports sent back to back,
+ *             tasks only.
+ *
+ * @param[in]  frame  Bytes to send, copied before returning
+ * @param[in]  len    Number of bytes, at most TX_FRAME_LEN
+ *
+ * @return     False if no buffer came free within TX_WAIT_TRIES waits of
+ *             TX_WAIT_MS and the frame was dropped
+ */
+bool sendFrameBlocking(const uint8_t *frame, uint8_t len)
+{
+	for (uint8_t tries = 0; tries < TX_WAIT_TRIES; tries++)
+	{
+		if (sendFrame(frame, len))
+			return true;
+		vTaskDelay(pdMS_TO_TICKS(TX_WAIT_MS));
+	}
+
+	return sendFrame(frame, len);
+}
+
+/**
+ * @brief      Send a frame by writing the UART data register directly, waiting
+ *             for it to empty before each byte. For the fatal paths, where the
+ *             transmit interrupt is masked: before the scheduler starts the
+ *             first critical section of the port leaves BASEPRI raised, and
+ *             an exception handler runs above it. Bypasses uart_tx_pool, so
+ *             the frame is on the wire when this returns.
+ *
+ * @param[in]  frame  Bytes to send
+ * @param[in]  len    Number of bytes
+ */
+void sendFramePolled(const uint8_t *frame, uint8_t len)
+{
+	for (uint8_t i = 0; i < len; i++)
+	{
+		while (!SERCOM_UART_HW.isDataRegisterEmptyUART())
+			;
+		SERCOM_UART_HW.writeDataUART(frame[i]);
+	}
+}
+
+/**
+ * @brief
+ * Route the SERCOM_UART data register empty interrupt to uartTxHandler. From
+ * here on all packets must go through sendFrame, writes to SERCOM_UART
+ * would sit in the Arduino transmit buffer forever. Called by initUART.
+ */
+void attachUARTtx(void)
+{
+	#if ADCS_SIM
+		simSetVector(SERCOM_UART_TX_IRQn, uartTxHandler);
+	#else
+		useRAMvectors();
+		ram_vectors.SERCOM_UART_TX_VECTOR = (void *)uartTxHandler;
+	#endif
+
+	// must not be above the max syscall priority to use FreeRTOS FromISR calls
+	NVIC_SetPriority(SERCOM_UART_TX_IRQn, configLIBRARY_LOWEST_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(SERCOM_UART_TX_IRQn);
+
+	#if DEBUG
+		SERCOM_USB.print("[system init]\tUART transmit interrupt attached\r\n");
+	#endif
+}
+
+/* I2C TRANSFER QUEUE ======================================================= */
+
+/**
+ * @brief
+ * Master on bus, slave on bus and error interrupts of SERCOM_I2C. Moves the
+ * transfer on the bus along by one byte, and when it is finished gives the
+ * semaphore its task waits on. The next queued transfer starts from here.
+ */
+static void i2cHandler(void)
+{
+	BaseType_t task_woken = pdFALSE;
+	I2CTransfer *t = i2c_bus.event(i2c_master.event());
+
+	if (t != NULL && t->context != NULL)
+		xSemaphoreGiveFromISR((SemaphoreHandle_t)t->context, &task_woken);
+
+	portYIELD_FROM_ISR(task_woken);
+}
+
+/**
+ * @brief
+ * Write tx_len bytes to the device at addr, then read rx_len bytes after a
+ * repeated start. Either may be empty. Once the scheduler runs the transfer is
+ * queued behind those of other tasks and the calling task blocks on done while
+ * the SERCOM_I2C interrupts move the bytes, the CPU is free meanwhile. Before
+ * that, during init, the Wire driver waits for each byte.
+ *
+ * @param[in]  addr     7 bit address
+ * @param[in]  tx       Bytes to write, e.g. the register address
+ * @param[in]  tx_len   Number of bytes to write
+ * @param      rx       Buffer for the bytes read
+ * @param[in]  rx_len   Number of bytes to read
+ * @param[in]  done     Binary semaphore of the calling task, given when the
+ *                      transfer finishes. One transfer per semaphore at a time.
+ *
+ * @return     True if every byte was acknowledged and transferred, False if
+ *             the device did not answer, the bus failed or I2C_TIMEOUT_MS passed
+ */
+bool i2cTransfer(uint8_t addr, const uint8_t *tx, uint16_t tx_len, uint8_t *rx, uint16_t rx_len,
+				 SemaphoreHandle_t done)
+{
+	if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+	{
+		if (tx_len > 0 || rx_len == 0)
+		{
+			SERCOM_I2C.beginTransmission(addr);
+			SERCOM_I2C.write(tx, tx_len);
+			if (SERCOM_I2C.endTransmission(rx_len == 0) != 0)
+				return false;
+		}
+		if (rx_len > 0 && SERCOM_I2C.requestFrom(addr, rx_len) != rx_len)
+			return false;
+		for (uint16_t i = 0; i < rx_len; i++)
+			rx[i] = SERCOM_I2C.read();
+		return true;
+	}
+
+	I2CTransfer t;
+	t.addr = addr;
+	t.tx = tx;
+	t.tx_len = tx_len;
+	t.rx = rx;
+	t.rx_len = rx_len;
+	t.context = (void *)done;
+
+	taskENTER_CRITICAL();
+	i2c_bus.submit(&t);
+	taskEXIT_CRITICAL();
+
+	if (xSemaphoreTake(done, pdMS_TO_TICKS(I2C_TIMEOUT_MS)) != pdTRUE)
+	{
+		taskENTER_CRITICAL();
+		i2c_bus.cancel(&t);
+		taskEXIT_CRITICAL();
+
+		// it may have finished after all, before it could be cancelled
+		xSemaphoreTake(done, 0);
+
+		#if DEBUG
+			SERCOM_USB.print("[i2c]\t\ttransfer timed out\r\n");
+		#endif
+	}
+
+	return t.status == I2C_OK;
+}
+
+/**
+ * @brief      True while a transfer is queued or on the bus, its next interrupt
+ *             is a byte time away at most
+ */
+bool i2cBusy(void)
+{
+	return i2c_bus.busy();
+}
+
+/**
+ * @brief
+ * Route the SERCOM_I2C interrupts to i2cHandler. The Wire driver does not use
+ * them in master mode, its polled transfers keep working until the scheduler
+ * starts. Called by initI2C.
+ */
+void attachI2C(void)
+{
+	#if ADCS_SIM
+		simSetVector(SERCOM_I2C_MB_IRQn, i2cHandler);
+		simSetVector(SERCOM_I2C_SB_IRQn, i2cHandler);
+		simSetVector(SERCOM_I2C_ERROR_IRQn, i2cHandler);
+	#else
+		useRAMvectors();
+		ram_vectors.SERCOM_I2C_MB_VECTOR = (void *)i2cHandler;
+		ram_vectors.SERCOM_I2C_SB_VECTOR = (void *)i2cHandler;
+		ram_vectors.SERCOM_I2C_ERROR_VECTOR = (void *)i2cHandler;
+	#endif
+
+	// must not be above the max syscall priority to use FreeRTOS FromISR calls
+	NVIC_SetPriority(SERCOM_I2C_MB_IRQn, configLIBRARY_LOWEST_INTERRUPT_PRIORITY);
+	NVIC_SetPriority(SERCOM_I2C_SB_IRQn, configLIBRARY_LOWEST_INTERRUPT_PRIORITY);
+	NVIC_SetPriority(SERCOM_I2C_ERROR_IRQn, configLIBRARY_LOWEST_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(SERCOM_I2C_MB_IRQn);
+	NVIC_EnableIRQ(SERCOM_I2C_SB_IRQn);
+	NVIC_EnableIRQ(SERCOM_I2C_ERROR_IRQn);
+
+	#if DEBUG
+		SERCOM_USB.print("[system init]\tI2C transfer interrupts attached\r\n");
+	#endif
+}
@@ -10,6 +10,9 @@
 #include "actuators.h"
 #include "sensors.h"
 #include "rtos_tasks.h"
+#include "rtos_objects.h"
+#include "trace.h"
+#include "power.h"
 
 // Standard C/C++ library headers
 #include <stdint.h>
@@ -20,13 +23,8 @@
 
 /* RTOS GLOBAL VARIABLES ==================================================== */
 
-/**
- * @brief      	FreeRTOS queue that stores the current mode of the ADCS.
- * Possible values:
- *   MODE_STANDBY (0)
- *   MODE_HEARTBEAT    (1)
- */
-QueueHandle_t modeQ;
+// every queue, semaphore and event group, modeQ among them, is declared in the
+// tables of rtos_objects.h
 
 /* HELPER FUNCTIONS ========================================================= */
 
@@ -45,11 +43,12 @@ void setup()
 
 	ADCSdata data_packet;
 
-	// Create a counting semaphore with a maximum value of 1 and an initial
-	// value of 0. Starts ADCS in standby mode.
-	modeQ = xQueueCreate(1, sizeof(uint8_t));
+	initRTOSObjects();
+
+	// Starts ADCS in standby mode.
 	uint8_t mode = CMD_STANDBY;
 	xQueueSend(modeQ, (void *)&mode, (TickType_t)0);
+	xEventGroupSetBits(modeEvents, modeBit(mode));
 
 	// enable LED
 	pinMode(LED_BUILTIN, OUTPUT);
@@ -62,6 +61,10 @@ void setup()
 		// blinkLED(1);
 	#endif
 
+	#if ADCS_TRACE
+		initTrace();
+	#endif
+
 	initUART();
 	// data_packet.setStatus(0x02);
 	// blinkLED(2);
@@ -83,6 +86,7 @@ void setup()
 	#endif
 
 	initSunSensors();
+	createTask(TASK_READ_SLOW);
 	initFlyWhl();
 	initMtx();
 
@@ -103,24 +107,29 @@ void setup()
 	// blinkLED(7);
 
 	// instantiate tasks and start scheduler
-	xTaskCreate(receiveCommand, "Read UART", 256, NULL, 3, NULL);
+	createTask(TASK_COMMAND_RX);
 	#if DEBUG
 		SERCOM_USB.print("[rtos]\t\tTask receiveCommand created\r\n");
 	#endif
 
-	xTaskCreate(heartbeat, "Write UART", 256, NULL, 2, NULL);
+	createTask(TASK_HEARTBEAT);
 	#if DEBUG
 		SERCOM_USB.print("[rtos]\t\tTask heartbeat created\r\n");
 	#endif
 
-	create_test_tasks();
+	init_mode_tasks();
+	initPower();
+
+	#if DEBUG
+		printRTOSMemory();
+	#endif
 	// data_packet.setStatus(0x08);
 	// blinkLED(8);
 
 	// initialization completed, notify satellite
 	// ADCSdata data_packet;
 	data_packet.setStatus(STATUS_HELLO);
-	data_packet.send();
+	data_packet.sendPolled(); // the transmit interrupt is masked until the scheduler starts
 	// blinkLED(9);
 
 	// delay(10);
@@ -138,7 +147,7 @@ void setup()
 			SERCOM_USB.println("ERROR");
 		#endif
 		data_packet.setStatus(STATUS_ADCS_ERROR);
-		data_packet.send();
+		data_packet.sendPolled();
 		delay(1000);
 	}
 }
@@ -149,12 +158,12 @@ void setup()
  * function. However, the project will fail to compile if loop is not defined.
  * Therefore, we define loop to do nothing.
  *
- * TODO: Eliminate this function entirely? Even though it does nothing, it will
- * still likely be called and consume clock cycles.
+ * FreeRTOS-SAMD51 calls it from the idle hook, right before the idle task
+ * sleeps with the tick suppressed, see power.cpp. It must never block.
  */
 void loop()
 {
-	// do nothing or enter low power mode
+	// do nothing, the idle task enters low power mode
 	// blinkLED(1);
 }
 
@@ -177,7 +186,7 @@ void _general_exception_handler(unsigned long ulCause, unsigned long ulStatus)
 		#if DEBUG
 			SERCOM_USB.println("ERROR");
 		#endif
-		error_msg.send();
+		error_msg.sendPolled();
 		digitalWrite(LED_BUILTIN, HIGH);
 		vNopDelayMS(1000);
 		digitalWrite(LED_BUILTIN, LOW);
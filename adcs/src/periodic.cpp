@@ -0,0 +1,114 @@
+#include "periodic.h"
+
+static_assert(PERIOD_FRAME_LEN <= TX_FRAME_LEN, "timing report must fit a transmit buffer");
+
+#define PERIODIC_INIT(id, period, deadline) Periodic(period, deadline),
+Periodic periodic[NUM_PERIODIC] = {
+	PERIODIC_TASKS(PERIODIC_INIT)
+};
+#undef PERIODIC_INIT
+
+/**
+ * @brief      Constructs a new instance
+ *
+ * @param[in]  period_ms    Release period
+ * @param[in]  deadline_ms  Time after the ideal release by which the work of a
+ *                          period must be done
+ */
+Periodic::Periodic(uint16_t period_ms, uint16_t deadline_ms)
+	: _period(pdMS_TO_TICKS(period_ms)), _last_wake(0),
+	  _stats((uint32_t)period_ms * 1000, (uint32_t)deadline_ms * 1000)
+{
+}
+
+/**
+ * @brief      Start the schedule now, the first release is one period later.
+ *             Call when the loop starts and whenever it resumes after a pause,
+ *             otherwise vTaskDelayUntil releases it back to back to catch up.
+ */
+void Periodic::start(void)
+{
+	taskENTER_CRITICAL();
+	_last_wake = xTaskGetTickCount();
+	_stats.restart(micros());
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief      Block until the next release of the loop
+ */
+void Periodic::wait(void)
+{
+	vTaskDelayUntil(&_last_wake, _period);
+
+	taskENTER_CRITICAL();
+	_stats.release(micros());
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief      The loop was released by an event instead of the schedule, the
+ *             event is taken as the ideal release
+ *
+ * @param[in]  event_us  micros() at the event, e.g. in its interrupt
+ */
+void Periodic::release(uint32_t event_us)
+{
+	taskENTER_CRITICAL();
+	_stats.restart(event_us - _stats.period());
+	_stats.release(micros());
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief      The work of the current period is done
+ */
+void Periodic::done(void)
+{
+	taskENTER_CRITICAL();
+	_stats.complete(micros());
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief      Copy of the statistics, consistent even while the loop runs
+ */
+PeriodStats Periodic::stats(void)
+{
+	taskENTER_CRITICAL();
+	PeriodStats copy = _stats;
+	taskEXIT_CRITICAL();
+
+	return copy;
+}
+
+/**
+ * @brief      Send one timing report frame per periodic loop to the satellite
+ */
+void sendPeriodicStats(void)
+{
+	uint8_t frame[PERIOD_FRAME_LEN];
+
+	#if DEBUG
+		char debug_str[96];
+	#endif
+
+	for (uint8_t id = 0; id < NUM_PERIODIC; id++)
+	{
+		PeriodStats stats = periodic[id].stats();
+		uint8_t len = stats.encode(id, frame);
+
+		// the reports go out back to back, wait for a free transmit buffer
+		// instead of dropping one
+		sendFrameBlocking(frame, len);
+
+		#if DEBUG
+			sprintf(debug_str, "loop %u: %lu periods, %lu misses, max jitter %lu us, max exec %lu us",
+					id, (unsigned long)stats.periods(), (unsigned long)stats.misses(),
+					(unsigned long)stats.maxJitter(), (unsigned long)stats.maxExec());
+			SERCOM_USB.print("[timing]\t");
+			SERCOM_USB.print(debug_str);
+			SERCOM_USB.print("\r\n");
+		#endif
+	}
+}
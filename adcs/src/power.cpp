@@ -0,0 +1,164 @@
+#include "power.h"
+#include "comm.h"
+#include "rtos_tasks.h"
+
+/**
+ * @brief      Select the sleep mode the idle task enters
+ */
+void initPower(void)
+{
+	#if !ADCS_SIM
+		// IDLE stops the CPU but keeps the SysTick, SERCOMs and EIC clocked, so
+		// the suppressed tick and every interrupt still wake it up. The write
+		// takes a few cycles to land, read it back before the first WFI.
+		PM->SLEEPCFG.reg = PM_SLEEPCFG_SLEEPMODE_IDLE;
+		while (PM->SLEEPCFG.bit.SLEEPMODE != PM_SLEEPCFG_SLEEPMODE_IDLE_Val);
+	#endif
+
+	#if DEBUG
+		SERCOM_USB.print("[system init]\tTickless idle enabled\r\n");
+	#endif
+}
+
+/**
+ * @brief      Modes in which the sensor tasks read their sensors, every one
+ *             but standby
+ */
+EventBits_t sensorModes(void)
+{
+	return MODE_BITS_ALL & ~modeBit(CMD_STANDBY);
+}
+
+/* TICKLESS IDLE ============================================================ */
+
+#if configUSE_TICKLESS_IDLE == 1 && !ADCS_SIM
+
+// SysTick counts of one tick, it runs from the CPU clock
+#define TICK_COUNTS (F_CPU / configTICK_RATE_HZ)
+
+// the SysTick reload value is 24 bits wide
+#define MAX_SUPPRESSED_TICKS (SysTick_LOAD_RELOAD_Msk / TICK_COUNTS)
+
+// counts lost while the SysTick is stopped, as in the port
+#define STOPPED_COMPENSATION 45UL
+
+// increments the millis() count of the Arduino core, SysTick_Handler calls it
+// after the kernel tick
+extern "C" void SysTick_DefaultHandler(void);
+
+/**
+ * @brief      Suppress the tick and sleep until the next task is due or an
+ *             interrupt arrives. Replaces the weak one of the FreeRTOS-SAMD51
+ *             port, which leaves millis() and micros() behind: the Arduino core
+ *             counts them in the same SysTick interrupt as the kernel tick.
+ *             Called by the idle task with the scheduler suspended.
+ *
+ * @param[in]  idle_ticks  Ticks until the next task is due
+ */
+extern "C" void vPortSuppressTicksAndSleep(TickType_t idle_ticks)
+{
+	uint32_t reload, slept_ticks, slept_counts;
+
+	// an I2C transfer interrupts again within a byte time, too soon to stop
+	// the tick for and account for it: wait for the interrupt with it running
+	if (i2cBusy())
+	{
+		__disable_irq();
+		__DSB();
+		__ISB();
+
+		if (eTaskConfirmSleepModeStatus() != eAbortSleep)
+		{
+			__DSB();
+			__WFI();
+			__ISB();
+		}
+
+		__enable_irq();
+		return;
+	}
+
+	if (idle_ticks > MAX_SUPPRESSED_TICKS)
+		idle_ticks = MAX_SUPPRESSED_TICKS;
+
+	// the time the SysTick is stopped for is accounted for as well as it can
+	// be, the kernel time drifts a little against calendar time
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+	// -1 as this runs part way through a tick
+	reload = SysTick->VAL + TICK_COUNTS * (idle_ticks - 1UL);
+	if (reload > STOPPED_COMPENSATION)
+		reload -= STOPPED_COMPENSATION;
+
+	// masks the interrupts, they still end the WFI
+	__disable_irq();
+	__DSB();
+	__ISB();
+
+	if (eTaskConfirmSleepModeStatus() == eAbortSleep)
+	{
+		// a task was readied meanwhile, finish the tick and do not sleep
+		SysTick->LOAD = SysTick->VAL;
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+		SysTick->LOAD = TICK_COUNTS - 1UL;
+		__enable_irq();
+		return;
+	}
+
+	SysTick->LOAD = reload;
+	SysTick->VAL = 0UL;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+	__DSB();
+	__WFI();
+	__ISB();
+
+	// the interrupt that ended the sleep stays pending until the clocks are
+	// brought up to date below, so it can take the time with micros(). Stop
+	// the SysTick without reading CTRL, which would clear COUNTFLAG.
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+
+	if (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk)
+	{
+		// slept the whole time, the tick interrupt is pending and counts the
+		// last tick. Reload with what is left of that tick.
+		uint32_t left = (TICK_COUNTS - 1UL) - (reload - SysTick->VAL);
+		if (left < STOPPED_COMPENSATION || left > TICK_COUNTS)
+			left = TICK_COUNTS - 1UL;
+
+		SysTick->LOAD = left;
+		slept_counts = reload + (reload - SysTick->VAL);
+		slept_ticks = idle_ticks - 1UL;
+	}
+	else
+	{
+		// another interrupt woke the MCU, count the whole ticks that passed
+		// and finish the one it woke up in
+		uint32_t passed = idle_ticks * TICK_COUNTS - SysTick->VAL;
+
+		slept_counts = reload - SysTick->VAL;
+		slept_ticks = passed / TICK_COUNTS;
+		SysTick->LOAD = (slept_ticks + 1UL) * TICK_COUNTS - passed;
+	}
+
+	SysTick->VAL = 0UL;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	vTaskStepTick(slept_ticks);
+	SysTick->LOAD = TICK_COUNTS - 1UL;
+
+	// millis() counts the suppressed ticks too
+	for (uint32_t i = 0; i < slept_ticks; i++)
+		SysTick_DefaultHandler();
+
+	#if ADCS_TRACE
+		// the cycle counter stops with the CPU clock, keep the trace on the
+		// same time line as the SysTick
+		DWT->CYCCNT += slept_counts;
+	#else
+		(void)slept_counts;
+	#endif
+
+	__enable_irq();
+}
+
+#endif
@@ -0,0 +1,373 @@
+#include "rtos_objects.h"
+#include "rtos_tasks.h"
+#include "sensors.h"
+
+/* HANDLES ================================================================== */
+
+#define RTOS_QUEUE_HANDLE(handle, len, size) QueueHandle_t handle;
+#define RTOS_SEMAPHORE_HANDLE(handle) SemaphoreHandle_t handle;
+#define RTOS_EVENT_GROUP_HANDLE(handle) EventGroupHandle_t handle;
+RTOS_QUEUES(RTOS_QUEUE_HANDLE)
+RTOS_BINARY_SEMAPHORES(RTOS_SEMAPHORE_HANDLE)
+RTOS_MUTEXES(RTOS_SEMAPHORE_HANDLE)
+RTOS_EVENT_GROUPS(RTOS_EVENT_GROUP_HANDLE)
+#undef RTOS_QUEUE_HANDLE
+#undef RTOS_SEMAPHORE_HANDLE
+#undef RTOS_EVENT_GROUP_HANDLE
+
+typedef struct
+{
+	TaskFunction_t task;
+	const char *name;
+	uint16_t stack_words;
+	UBaseType_t priority;
+} TaskSpec;
+
+#define RTOS_TASK_SPEC(id, fn, name, stack, prio) {fn, name, stack, prio},
+static const TaskSpec task_specs[RTOS_NUM_TASKS] = {
+	RTOS_TASKS(RTOS_TASK_SPEC)
+};
+#undef RTOS_TASK_SPEC
+
+/* MEMORY BUDGET ============================================================ */
+
+#define RTOS_TASK_BYTES(id, fn, name, stack, prio) + (stack) * sizeof(StackType_t) + sizeof(StaticTask_t)
+#define RTOS_QUEUE_BYTES(handle, len, size) + (len) * (size) + sizeof(StaticQueue_t)
+#define RTOS_SEMAPHORE_BYTES(handle) + sizeof(StaticSemaphore_t)
+#define RTOS_EVENT_GROUP_BYTES(handle) + sizeof(StaticEventGroup_t)
+
+static constexpr size_t rtos_task_bytes = 0 RTOS_TASKS(RTOS_TASK_BYTES)
+	+ MODE_TASK_SLOTS * (MODE_TASK_STACK_WORDS * sizeof(StackType_t) + sizeof(StaticTask_t))
+	+ configMINIMAL_STACK_SIZE * sizeof(StackType_t) + sizeof(StaticTask_t) // idle task
+	+ configTIMER_TASK_STACK_DEPTH * sizeof(StackType_t) + sizeof(StaticTask_t); // timer task
+static constexpr size_t rtos_queue_bytes = 0 RTOS_QUEUES(RTOS_QUEUE_BYTES)
+	+ configTIMER_QUEUE_LENGTH * sizeof(void *) * 4 + sizeof(StaticQueue_t); // timer command queue, in timers.c
+static constexpr size_t rtos_sync_bytes = 0 RTOS_BINARY_SEMAPHORES(RTOS_SEMAPHORE_BYTES)
+	RTOS_MUTEXES(RTOS_SEMAPHORE_BYTES) RTOS_EVENT_GROUPS(RTOS_EVENT_GROUP_BYTES);
+
+#undef RTOS_TASK_BYTES
+#undef RTOS_QUEUE_BYTES
+#undef RTOS_SEMAPHORE_BYTES
+#undef RTOS_EVENT_GROUP_BYTES
+
+static_assert(rtos_task_bytes + rtos_queue_bytes + rtos_sync_bytes <= RTOS_RAM_BUDGET,
+			  "RTOS stacks and control blocks exceed RTOS_RAM_BUDGET");
+static_assert(RTOS_RAM_BUDGET + configTOTAL_HEAP_SIZE <= SAMD51_RAM / 2,
+			  "RTOS budget and heap leave too little RAM for the Arduino core and libraries");
+
+/* STORAGE ================================================================== */
+
+#if STATIC_RTOS
+	#define RTOS_TASK_STORAGE(id, fn, name, stack, prio) \
+		static StackType_t id##_stack[stack];            \
+		static StaticTask_t id##_tcb;
+	#define RTOS_QUEUE_STORAGE(handle, len, size) \
+		static uint8_t handle##_storage[(len) * (size)]; \
+		static StaticQueue_t handle##_queue;
+	#define RTOS_SEMAPHORE_STORAGE(handle) static StaticSemaphore_t handle##_semaphore;
+	#define RTOS_EVENT_GROUP_STORAGE(handle) static StaticEventGroup_t handle##_events;
+
+	RTOS_TASKS(RTOS_TASK_STORAGE)
+	RTOS_QUEUES(RTOS_QUEUE_STORAGE)
+	RTOS_BINARY_SEMAPHORES(RTOS_SEMAPHORE_STORAGE)
+	RTOS_MUTEXES(RTOS_SEMAPHORE_STORAGE)
+	RTOS_EVENT_GROUPS(RTOS_EVENT_GROUP_STORAGE)
+
+	#undef RTOS_TASK_STORAGE
+	#undef RTOS_QUEUE_STORAGE
+	#undef RTOS_SEMAPHORE_STORAGE
+	#undef RTOS_EVENT_GROUP_STORAGE
+
+	#define RTOS_TASK_BUFFERS(id, fn, name, stack, prio) {id##_stack, &id##_tcb},
+	static const struct
+	{
+		StackType_t *stack;
+		StaticTask_t *tcb;
+	} task_buffers[RTOS_NUM_TASKS] = {
+		RTOS_TASKS(RTOS_TASK_BUFFERS)
+	};
+	#undef RTOS_TASK_BUFFERS
+
+	static StackType_t mode_task_stacks[MODE_TASK_SLOTS][MODE_TASK_STACK_WORDS];
+	static StaticTask_t mode_task_tcbs[MODE_TASK_SLOTS];
+	static TaskHandle_t mode_task_owners[MODE_TASK_SLOTS];
+#endif
+
+// handles of the RTOS_TASKS, to look up their stack depth
+static TaskHandle_t task_handles[RTOS_NUM_TASKS];
+
+// the kernel's own tasks are static whenever configSUPPORT_STATIC_ALLOCATION is
+static StackType_t idle_stack[configMINIMAL_STACK_SIZE];
+static StaticTask_t idle_tcb;
+static StackType_t timer_stack[configTIMER_TASK_STACK_DEPTH];
+static StaticTask_t timer_tcb;
+
+/* CREATE =================================================================== */
+
+/**
+ * @brief      Create every queue, semaphore and event group in the tables. Call
+ *             first thing in setup, before anything uses them.
+ */
+void initRTOSObjects(void)
+{
+	#if STATIC_RTOS
+		#define RTOS_QUEUE_CREATE(handle, len, size) \
+			handle = xQueueCreateStatic(len, size, handle##_storage, &handle##_queue);
+		#define RTOS_BINARY_CREATE(handle) handle = xSemaphoreCreateBinaryStatic(&handle##_semaphore);
+		#define RTOS_MUTEX_CREATE(handle) handle = xSemaphoreCreateMutexStatic(&handle##_semaphore);
+		#define RTOS_EVENT_GROUP_CREATE(handle) handle = xEventGroupCreateStatic(&handle##_events);
+	#else
+		#define RTOS_QUEUE_CREATE(handle, len, size) handle = xQueueCreate(len, size);
+		#define RTOS_BINARY_CREATE(handle) handle = xSemaphoreCreateBinary();
+		#define RTOS_MUTEX_CREATE(handle) handle = xSemaphoreCreateMutex();
+		#define RTOS_EVENT_GROUP_CREATE(handle) handle = xEventGroupCreate();
+	#endif
+
+	RTOS_QUEUES(RTOS_QUEUE_CREATE)
+	RTOS_BINARY_SEMAPHORES(RTOS_BINARY_CREATE)
+	RTOS_MUTEXES(RTOS_MUTEX_CREATE)
+	RTOS_EVENT_GROUPS(RTOS_EVENT_GROUP_CREATE)
+
+	#undef RTOS_QUEUE_CREATE
+	#undef RTOS_BINARY_CREATE
+	#undef RTOS_MUTEX_CREATE
+	#undef RTOS_EVENT_GROUP_CREATE
+}
+
+/**
+ * @brief      Create one of the tasks in RTOS_TASKS
+ *
+ * @param[in]  id    The task
+ *
+ * @return     Handle of the task
+ */
+TaskHandle_t createTask(RTOSTask id)
+{
+	const TaskSpec &spec = task_specs[id];
+
+	#if STATIC_RTOS
+		task_handles[id] = xTaskCreateStatic(spec.task, spec.name, spec.stack_words, NULL, spec.priority,
+											 task_buffers[id].stack, task_buffers[id].tcb);
+	#else
+		task_handles[id] = NULL;
+		xTaskCreate(spec.task, spec.name, spec.stack_words, NULL, spec.priority, &task_handles[id]);
+	#endif
+
+	return task_handles[id];
+}
+
+/**
+ * @brief      Create a test task in a free mode task slot
+ *
+ * @return     Handle of the task, NULL if every slot is taken
+ */
+TaskHandle_t createModeTask(TaskFunction_t task, const char *name, void *params, UBaseType_t priority)
+{
+	#if STATIC_RTOS
+		for (uint8_t i = 0; i < MODE_TASK_SLOTS; i++)
+		{
+			if (mode_task_owners[i] == NULL)
+			{
+				mode_task_owners[i] = xTaskCreateStatic(task, name, MODE_TASK_STACK_WORDS, params, priority,
+														mode_task_stacks[i], &mode_task_tcbs[i]);
+				return mode_task_owners[i];
+			}
+		}
+
+		return NULL;
+	#else
+		TaskHandle_t handle = NULL;
+		xTaskCreate(task, name, MODE_TASK_STACK_WORDS, params, priority, &handle);
+		return handle;
+	#endif
+}
+
+/**
+ * @brief      Delete a test task and free its slot. Must not be called by the
+ *             task itself: a task that deletes itself is only cleaned up later
+ *             by the idle task, so its slot could be reused too early.
+ *
+ * @param[in]  task  Handle from createModeTask
+ */
+void deleteModeTask(TaskHandle_t task)
+{
+	configASSERT(task != xTaskGetCurrentTaskHandle());
+	vTaskDelete(task);
+
+	#if STATIC_RTOS
+		for (uint8_t i = 0; i < MODE_TASK_SLOTS; i++)
+		{
+			if (mode_task_owners[i] == task)
+				mode_task_owners[i] = NULL;
+		}
+	#endif
+}
+
+/**
+ * @brief      Memory of the idle task, required by the kernel with static
+ *             allocation enabled
+ */
+extern "C" void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_words)
+{
+	*tcb = &idle_tcb;
+	*stack = idle_stack;
+	*stack_words = configMINIMAL_STACK_SIZE;
+}
+
+/**
+ * @brief      Memory of the timer service task
+ */
+extern "C" void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *stack_words)
+{
+	*tcb = &timer_tcb;
+	*stack = timer_stack;
+	*stack_words = configTIMER_TASK_STACK_DEPTH;
+}
+
+/* TASK REPORT ============================================================== */
+
+// every task there can be: the RTOS_TASKS, the mode task slots, idle and timers
+#define REPORT_MAX_TASKS (RTOS_NUM_TASKS + MODE_TASK_SLOTS + 2)
+
+#define RTOS_QUEUE_COUNT(handle, len, size) +1
+static_assert(0 RTOS_QUEUES(RTOS_QUEUE_COUNT) <= TASK_REPORT_MAX_QUEUES, "too many queues for the system frame");
+#undef RTOS_QUEUE_COUNT
+
+static_assert(TASK_FRAME_LEN <= TX_FRAME_LEN && SYSTEM_FRAME_LEN(TASK_REPORT_MAX_QUEUES) <= TX_FRAME_LEN,
+			  "task reports must fit a transmit buffer");
+
+/**
+ * @brief      Stack depth a task was created with
+ *
+ * @param[in]  task  The task
+ *
+ * @return     Depth in words
+ */
+static uint16_t stackDepth(TaskHandle_t task)
+{
+	for (uint8_t i = 0; i < RTOS_NUM_TASKS; i++)
+	{
+		if (task_handles[i] == task)
+			return task_specs[i].stack_words;
+	}
+
+	if (task == xTaskGetIdleTaskHandle())
+		return configMINIMAL_STACK_SIZE;
+	if (task == xTimerGetTimerDaemonTaskHandle())
+		return configTIMER_TASK_STACK_DEPTH;
+
+	// every other task is a test task from createModeTask
+	return MODE_TASK_STACK_WORDS;
+}
+
+/**
+ * @brief      Send the system frame and one frame per task to the satellite,
+ *             see TaskReport.h. The task states come from one
+ *             uxTaskGetSystemState call, without the string formatting of
+ *             vTaskGetRunTimeStats. CPU shares are over the time since the
+ *             previous report.
+ */
+void sendTaskReport(void)
+{
+	// only ever called from the command task
+	static TaskStatus_t status[REPORT_MAX_TASKS];
+	static RunTimeShares<REPORT_MAX_TASKS> shares;
+
+	uint8_t frame[TX_FRAME_LEN];
+	uint32_t total = 0;
+	SystemReport sys;
+	TaskReport task;
+
+	#if DEBUG
+		char debug_str[96];
+	#endif
+
+	UBaseType_t num_tasks = uxTaskGetSystemState(status, REPORT_MAX_TASKS, &total);
+
+	shares.begin(total);
+	sys.run_time_us = total;
+	sys.interval_us = shares.interval();
+	sys.heap_free = xPortGetFreeHeapSize();
+	sys.heap_min_free = xPortGetMinimumEverFreeHeapSize();
+	sys.tasks = num_tasks;
+	sys.queues = 0;
+
+	#define RTOS_QUEUE_REPORT(handle, len, size)                        \
+		sys.queue_waiting[sys.queues] = uxQueueMessagesWaiting(handle); \
+		sys.queue_length[sys.queues] = len;                             \
+		sys.queues++;
+	RTOS_QUEUES(RTOS_QUEUE_REPORT)
+	#undef RTOS_QUEUE_REPORT
+
+	sendFrameBlocking(frame, encodeSystemReport(sys, frame));
+
+	#if DEBUG
+		sprintf(debug_str, "%u tasks over %lu us, heap %lu bytes free, %lu minimum",
+				(unsigned)num_tasks, (unsigned long)sys.interval_us, (unsigned long)sys.heap_free,
+				(unsigned long)sys.heap_min_free);
+		SERCOM_USB.print("[tasks]\t\t");
+		SERCOM_USB.print(debug_str);
+		SERCOM_USB.print("\r\n");
+	#endif
+
+	for (UBaseType_t i = 0; i < num_tasks; i++)
+	{
+		const TaskStatus_t &s = status[i];
+
+		task.number = s.xTaskNumber;
+		task.state = s.eCurrentState;
+		task.priority = s.uxCurrentPriority;
+		task.run_time_us = s.ulRunTimeCounter;
+		task.share = shares.share(s.xTaskNumber, s.ulRunTimeCounter);
+		task.stack_words = stackDepth(s.xHandle);
+		task.stack_free_words = s.usStackHighWaterMark;
+		strncpy(task.name, s.pcTaskName, TASK_REPORT_NAME_LEN);
+		task.name[TASK_REPORT_NAME_LEN] = '\0';
+
+		sendFrameBlocking(frame, encodeTaskReport(task, frame));
+
+		#if DEBUG
+			sprintf(debug_str, "%-16s %3u.%02u%% CPU, stack %u of %u words free", task.name,
+					task.share / 100, task.share % 100, task.stack_free_words, task.stack_words);
+			SERCOM_USB.print("[tasks]\t\t");
+			SERCOM_USB.print(debug_str);
+			SERCOM_USB.print("\r\n");
+		#endif
+	}
+
+	shares.end();
+}
+
+/* MEMORY REPORT ============================================================ */
+
+#if DEBUG
+/**
+ * @brief      Print the RAM taken by the RTOS objects against the budget
+ */
+void printRTOSMemory(void)
+{
+	char debug_str[80];
+
+	SERCOM_USB.print("[rtos]\t\tMemory map\r\n");
+
+	for (uint8_t i = 0; i < RTOS_NUM_TASKS; i++)
+	{
+		sprintf(debug_str, "\t\t%-20s %5u bytes stack", task_specs[i].name,
+				(unsigned)(task_specs[i].stack_words * sizeof(StackType_t)));
+		SERCOM_USB.print(debug_str);
+		SERCOM_USB.print("\r\n");
+	}
+
+	sprintf(debug_str, "\t\t%-20s %5u bytes stack", "mode task slots",
+			(unsigned)(MODE_TASK_SLOTS * MODE_TASK_STACK_WORDS * sizeof(StackType_t)));
+	SERCOM_USB.print(debug_str);
+	SERCOM_USB.print("\r\n");
+
+	sprintf(debug_str, "\t\ttasks %u, queues %u, sync %u, total %u of %u bytes (%s)",
+			(unsigned)rtos_task_bytes, (unsigned)rtos_queue_bytes, (unsigned)rtos_sync_bytes,
+			(unsigned)(rtos_task_bytes + rtos_queue_bytes + rtos_sync_bytes), (unsigned)RTOS_RAM_BUDGET,
+			STATIC_RTOS ? ".bss" : "heap");
+	SERCOM_USB.print(debug_str);
+	SERCOM_USB.print("\r\n");
+}
+#endif
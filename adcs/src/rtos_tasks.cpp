@@ -1,6 +1,188 @@
 #include "rtos_tasks.h"
+#include "rtos_objects.h"
+#include "periodic.h"
+#include "trace.h"
+
+/* MODE DISPATCH ============================================================ */
+
+// modes with an event bit in modeEvents, bit n belongs to dispatch_modes[n]
+static const uint8_t dispatch_modes[] = {
+	CMD_STANDBY,
+	CMD_HEARTBEAT,
+	CMD_DESATURATE,
+	CMD_TST_BASIC_MOTION,
+	CMD_TST_BASIC_AD,
+	CMD_TST_BASIC_AC,
+	CMD_TST_SIMPLE_DETUMBLE,
+	CMD_TST_SIMPLE_ORIENT,
+	CMD_TST_PHOTODIODES,
+	CMD_TST_BLDC,
+	CMD_TST_MTX,
+	CMD_ORIENT_DEFAULT,
+	CMD_ORIENT_X_POS,
+	CMD_ORIENT_Y_POS,
+	CMD_ORIENT_X_NEG,
+	CMD_ORIENT_Y_NEG,
+};
+
+static_assert(sizeof(dispatch_modes) <= 24, "event groups hold 24 bits");
 
-extern QueueHandle_t modeQ;
+/**
+ * @brief      Event bit of a mode, set in modeEvents while the mode is active
+ *
+ * @param[in]  mode  A Command that selects a mode
+ *
+ * @return     The bit, 0 if the mode has none
+ */
+EventBits_t modeBit(uint8_t mode)
+{
+	for (uint8_t i = 0; i < sizeof(dispatch_modes); i++)
+	{
+		if (dispatch_modes[i] == mode)
+			return (EventBits_t)1 << i;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief      Block the calling task until one of the given modes is active.
+ *             Returns right away if one already is, so a task that calls this
+ *             at the top of its loop runs while its mode is active and sleeps
+ *             without any wakeups while it is not.
+ *
+ * @param[in]  modes  Event bits of the modes to wait for, see modeBit
+ *
+ * @return     The mode that is active now
+ */
+uint8_t waitForMode(EventBits_t modes)
+{
+	uint8_t mode = CMD_STANDBY;
+
+	xEventGroupWaitBits(modeEvents, modes, pdFALSE, pdFALSE, portMAX_DELAY);
+	xQueuePeek(modeQ, &mode, 0);
+
+	return mode;
+}
+
+#if DEBUG
+/**
+ * @brief      Print the free heap now and the least there has been since boot
+ */
+static void printHeapUsage(void)
+{
+	char debug_str[64];
+
+	sprintf(debug_str, "%u bytes free, %u bytes minimum ever free",
+			(unsigned)xPortGetFreeHeapSize(), (unsigned)xPortGetMinimumEverFreeHeapSize());
+	SERCOM_USB.print("[mode switch]\t");
+	SERCOM_USB.print(debug_str);
+	SERCOM_USB.print("\r\n");
+}
+#endif
+
+/* MODE TASK REGISTRY ======================================================= */
+
+/**
+ * @brief      A task that only exists while its mode is active
+ */
+typedef struct
+{
+	uint8_t mode;		   // Command that enters the mode
+	TaskFunction_t task;   // task function
+	const char *name;	   // task name, for debugging
+	UBaseType_t priority;  // task priority, stack depth is MODE_TASK_STACK_WORDS
+	void *params;		   // passed to the task as pvParameters
+} ModeTask;
+
+// basic attitude determination and control are not implemented yet, so their
+// modes have no task
+static const ModeTask mode_tasks[] = {
+	{CMD_TST_PHOTODIODES, photodiode_test, "PHOTODIODE TEST", 1, NULL},
+	{CMD_TST_BASIC_MOTION, basic_motion, "BASIC MOTION", 1, NULL},
+	{CMD_TST_BLDC, basic_bldc, "BLDC TEST", 1, NULL},
+	{CMD_TST_MTX, basic_mtx, "MAGNETORQUER TEST", 1, NULL},
+	{CMD_TST_SIMPLE_DETUMBLE, simple_detumble, "SIMPLE DETUMBLE", 1, NULL},
+	{CMD_TST_SIMPLE_ORIENT, simple_orient, "SIMPLE ORIENT", 1, NULL},
+};
+
+static TaskHandle_t mode_task = NULL;	 // task of the active mode, if it has one
+static TaskHandle_t retired_task = NULL; // test that ended itself, suspended until the next mode change
+
+/**
+ * @brief      Registry entry of a mode
+ *
+ * @return     The entry, NULL if the mode has no task
+ */
+static const ModeTask *findModeTask(uint8_t mode)
+{
+	for (uint8_t i = 0; i < sizeof(mode_tasks) / sizeof(mode_tasks[0]); i++)
+	{
+		if (mode_tasks[i].mode == mode)
+			return &mode_tasks[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief      Stop every actuator, a task deleted in the middle of a test may
+ *             have left any of them running
+ */
+static void safeActuators(void)
+{
+	flywhl.stop();
+	Mtx1.stop();
+	Mtx2.stop();
+}
+
+/**
+ * @brief      Answer commands that ask for information instead of changing the
+ *             mode
+ *
+ * @param[in]  cmd   The command received from TES
+ *
+ * @return     True if the command was a query and has been answered
+ */
+static bool handleQuery(uint8_t cmd)
+{
+	switch (cmd)
+	{
+		case CMD_DBG_TIMING:
+			#if DEBUG
+				SERCOM_USB.print("[command rx]\tSending timing reports\r\n");
+			#endif
+			sendPeriodicStats();
+			return true;
+
+		case CMD_DBG_TASKS:
+			#if DEBUG
+				SERCOM_USB.print("[command rx]\tSending task reports\r\n");
+			#endif
+			sendTaskReport();
+			return true;
+
+		#if ADCS_TRACE
+		case CMD_DBG_TRACE:
+			dumpTrace();
+			return true;
+		#endif
+
+		#if IMU_DMP
+		case CMD_IMU_RAW:
+		case CMD_IMU_DMP:
+			#if DEBUG
+				SERCOM_USB.print("[command rx]\tSwitching the IMU mode\r\n");
+			#endif
+			// readIMU switches at its next burst, it owns the IMU
+			requestIMUMode(cmd == CMD_IMU_DMP ? IMU_MODE_DMP : IMU_MODE_RAW);
+			return true;
+		#endif
+
+		default:
+			return false;
+	}
+}
 
 /**
  * @brief      Takes in a command from the satellite and updates the state of the ADCS system in RTOS queue.
@@ -10,20 +192,24 @@ extern QueueHandle_t modeQ;
 void state_machine_transition(uint8_t mode)
 {
 	uint8_t curr_mode = CMD_STANDBY; // standby by default
-	// get the current state to compare against
-	xQueuePeek(modeQ, &curr_mode, 0);
 
 	#if DEBUG
 		char debug_str[16];
 	#endif
 
+	// a test that ends itself switches modes from its own task, so the
+	// current mode is only read under modeLock
+	xSemaphoreTake(modeLock, portMAX_DELAY);
+
+	// get the current state to compare against
+	xQueuePeek(modeQ, &curr_mode, 0);
+
 	// make sure we are entering a new state
 	if (mode == curr_mode) // if not, exit
 	{
+		xSemaphoreGive(modeLock);
 		return;
 	}
-	// stop driving the flywhl any time system mode changes
-	flywhl.stop();
 	bool command_is_valid = true;
 	// change actuator state, set global state variables if needed
 	switch (mode)
@@ -34,8 +220,7 @@ void state_machine_transition(uint8_t mode)
 			#endif
 			break;
 
-		// WARNING: if you switch out of a test mode the test will still be on the stack
-		// 	on the plus side, the task won't run though
+		// test tasks are created on entry and deleted on exit, see mode_tasks
 		case CMD_TST_BLDC:				//ramped acceleration of bldc with diagnostic gyro, fg measurements
 		case CMD_TST_MTX:				//energize magnetorquers to make measurements of B-field perturbations
 		case CMD_TST_BASIC_MOTION: 		// loop flywhl PWM signal 0-100%
@@ -76,77 +261,89 @@ void state_machine_transition(uint8_t mode)
 			#endif
 	}
 	// if no valid command, return
-	if (command_is_valid)
+	if (!command_is_valid)
 	{
-		xQueueOverwrite(modeQ, (void *)&mode); // enter specified mode
+		xSemaphoreGive(modeLock);
+		return;
 	}
-}
 
-/**
- * @brief      Create test RTOS tasks on the stack but don't run any of them until requested.
- */
-void create_test_tasks(void)
-{
-	#if DEBUG
-		SERCOM_USB.print("[rtos]\t\tInitializing RTOS test suite\r\n");
-	#endif
+	if (retired_task != NULL)
+	{
+		deleteModeTask(retired_task);
+		retired_task = NULL;
+	}
 
-	xTaskCreate(photodiode_test, "PHOTODIODE TEST", 256, NULL, 1, NULL);
-	#if DEBUG
-		SERCOM_USB.print("[rtos]\t\tCreated photodiode test task\r\n");
-	#endif
+	// tear down the old mode's task. A test that ends itself calls this from
+	// its own task, which cannot free its own slot: it suspends itself after
+	// the new mode is entered and is deleted at the next mode change.
+	TaskHandle_t old_task = mode_task;
+	bool retire_self = old_task != NULL && old_task == xTaskGetCurrentTaskHandle();
+	mode_task = NULL;
 
-	xTaskCreate(basic_motion, "BASIC MOTION", 256, NULL, 1, NULL);
-	#if DEBUG
-		SERCOM_USB.print("[rtos]\t\tCreated basic motion task\r\n");
-	#endif
+	if (retire_self)
+	{
+		retired_task = old_task;
+	}
+	else if (old_task != NULL)
+	{
+		deleteModeTask(old_task);
+	}
 
-	// Actuator hardware unit testing
-	xTaskCreate(basic_bldc, "BLDC TEST", 256, NULL, 1, NULL);
-	#if DEBUG
-		SERCOM_USB.print("[rtos]\t\tCreated BLDC test task\r\n");
-	#endif
+	// stop driving the actuators any time system mode changes
+	safeActuators();
 
-	xTaskCreate(basic_mtx, "MAGNETORQUER TEST", 256, NULL, 1, NULL);
-	#if DEBUG
-		SERCOM_USB.print("[rtos]\t\tCreated Magnetorquer test task\r\n");
-	#endif
+	// tasks of the old mode block at their next waitForMode, then the new
+	// mode's tasks are released. The mode is written first so that they
+	// read it when they wake up. Exactly one mode bit is ever set.
+	xEventGroupClearBits(modeEvents, MODE_BITS_ALL);
+	xQueueOverwrite(modeQ, (void *)&mode); // enter specified mode
+	xEventGroupSetBits(modeEvents, modeBit(mode));
 
-	/*NOT IMPLEMENTED CURRENTLY*/
-	// 	xTaskCreate(basic_attitude_determination, "BASIC AD", 256, NULL, 1, NULL);
-	// #if DEBUG
-	// 	SERCOM_USB.print("[rtos]\t\tCreated basic attitude determination task\r\n");
-	// #endif
+	const ModeTask *entry = findModeTask(mode);
+	if (entry != NULL && (mode_task = createModeTask(entry->task, entry->name, entry->params, entry->priority)) == NULL)
+	{
+		#if DEBUG
+			SERCOM_USB.print("[mode switch]\tNo memory to create ");
+			SERCOM_USB.print(entry->name);
+			SERCOM_USB.print("\r\n");
+		#endif
+	}
 
-	// 	xTaskCreate(basic_attitude_control, "BASIC AC", 256, NULL, 1, NULL);
-	// #if DEBUG
-	// 	SERCOM_USB.print("[rtos]\t\tCreated basic attitude control task\r\n");
-	// #endif
+	xSemaphoreGive(modeLock);
+	TRACE(TP_MODE_ENTERED, mode);
 
-	xTaskCreate(simple_detumble, "SIMPLE DETUMBLE", 256, NULL, 1, NULL);
 	#if DEBUG
-		SERCOM_USB.print("[rtos]\t\tCreated simple detumble task\r\n");
+		printHeapUsage();
 	#endif
 
-	xTaskCreate(simple_orient, "SIMPLE ORIENT", 256, NULL, 1, NULL);
-	#if DEBUG
-		SERCOM_USB.print("[rtos]\t\tCreated simple orient task\r\n");
-	#endif
+	if (retire_self)
+	{
+		vTaskSuspend(NULL);
+	}
+}
 
+/**
+ * @brief      Set up the mode task registry. No test task exists until its mode
+ *             is entered, state_machine_transition creates it then and deletes
+ *             it again when the mode is left.
+ */
+void init_mode_tasks(void)
+{
 	#if DEBUG
 		SERCOM_USB.print("[rtos]\t\tInitialized RTOS test suite\r\n");
+		printHeapUsage();
 	#endif
 }
 
 // @brief get direction the adcs should turn to align X+ with the light source
 //
-// @param[in]  vals  The sensor values, unscaled
+// @param[in]  vals  Filtered photodiode counts, from pd_topic
 //
 // @return     The direction to turn the adcs (clockwise or counter-clockwise)
 //
-MotorDirection getDirection(PDdata vals){
+MotorDirection getDirection(PDdata_int vals){
 	uint8_t max=0; // channel receiving the most light
-	float max_val=-1;
+	int max_val=-1;
 	// calculate side/channel receiving most light, ignore +/-Z so only look at first 4 values
 	for(int i=0; i < 4; i++){
 		if(vals.data[i] >= max_val){
@@ -179,8 +376,12 @@ MotorDirection getDirection(PDdata vals){
 
 /**
  * @brief
- * Polls the UART module for data. Processes data one byte at a time if the
- * module reports that data is ready to be received.
+ * Waits for the UART receive interrupt to deliver bytes and runs them through a
+ * self-resynchronizing framer. Each frame that passes its CRC is loaded into a
+ * TEScommand and handed to state_machine_transition as soon as its last byte
+ * arrives. When a frame fails its CRC, or a partial frame is not completed
+ * within COMMAND_TIMEOUT_MS, the satellite is answered with STATUS_COMM_ERROR
+ * and the framer searches the following bytes for the next valid frame.
  *
  * @param[in] pvParameters  Unused but required by FreeRTOS. Program will not
  * compile without this parameter. When a task is instantiated from this
@@ -188,86 +389,96 @@ MotorDirection getDirection(PDdata vals){
  * pvParameters, so pvParameters must be declared even if it is not used.
  *
  * @return None
- *
- * TODO: Remove polling and invoke this task using an interrupt instead.
  */
 void receiveCommand(void *pvParameters)
 {
 	TEScommand cmd_packet;
 	ADCSdata response;
-	uint8_t mode;
+	CommandFramer<COMMAND_LEN> framer;
 
-	int rx_len;
-	int rx_bytes;
-	uint8_t rx_buf[COMMAND_LEN];
+	uint8_t rx_byte;
+	TickType_t timeout;
+	bool comm_error;
 
 	#if DEBUG
-		char debug_str[8]; // used to print command value to serial monitor
+		char debug_str[80]; // used to print command value and stats to serial monitor
 		SERCOM_USB.print("[command rx]\tTask started\r\n");
 	#endif
 
+	attachUARTrx(xTaskGetCurrentTaskHandle());
+
 	while (1)
 	{
-		rx_len = SERCOM_UART.available();
+		// only time out while waiting for the rest of a partial command
+		timeout = framer.partial() ? pdMS_TO_TICKS(COMMAND_TIMEOUT_MS) : portMAX_DELAY;
+		comm_error = false;
 
-		if (rx_len > 0) // at least one byte is in the UART
-		{				// receive buffer
+		// the rest of a frame that failed its CRC was already answered, it is
+		// only dropped
+		if (ulTaskNotifyTake(pdTRUE, timeout) == 0 && uart_rx_buf.empty() && framer.reset())
+		{
+			comm_error = true;
 			#if DEBUG
-				sprintf(debug_str, "%d", rx_len);
-				SERCOM_USB.print("[command rx]\tDetected ");
-				SERCOM_USB.print(debug_str);
-				SERCOM_USB.print(" bytes in UART rx buffer\r\n");
+				SERCOM_USB.print("[command rx]\tReceived incorrect number of bytes - transmitting error message\r\n");
 			#endif
+		}
 
-			rx_bytes = SERCOM_UART.readBytes(rx_buf, COMMAND_LEN);
+		while (uart_rx_buf.pop(rx_byte))
+		{
+			switch (framer.push(rx_byte))
+			{
+				case FRAMER_FRAME:
+					TRACE(TP_COMMAND_FRAME, framer.frame()[0]);
 
-			#if DEBUG
-				sprintf(debug_str, "%d", rx_bytes);
-				SERCOM_USB.print("[command rx]\tReceived ");
-				SERCOM_USB.print(debug_str);
-				SERCOM_USB.print(" bytes:  [");
+					for (int i = 0; i < COMMAND_LEN; i++)
+						cmd_packet.addByte(framer.frame()[i]);
 
-				for (int i = 0; i < rx_bytes; i++)
-				{
-					sprintf(debug_str, " %02x", rx_buf[i]);
-					SERCOM_USB.print(debug_str);
-				}
+					#if DEBUG
+						SERCOM_USB.print("[command rx]\tReceived command:  [");
 
-				SERCOM_USB.print(" ]\r\n");
-			#endif
+						for (int i = 0; i < COMMAND_LEN; i++)
+						{
+							sprintf(debug_str, " %02x", framer.frame()[i]);
+							SERCOM_USB.print(debug_str);
+						}
 
-			if (rx_bytes == COMMAND_LEN) // full command packet received
-			{
-				cmd_packet.loadBytes(rx_buf);
-
-				/*CRC checking removed because not functioning correctly*/
-				// if (cmd_packet.checkCRC())
-				// {
-				state_machine_transition(cmd_packet.getCommand());
-				// 				}
-				// 				else
-				// 				{
-				// 					// send error message if CRC is not valid
-				// 					response.setStatus(STATUS_COMM_ERROR);
-				// 					response.computeCRC();
-				// 					response.send();
-				// #if DEBUG
-				// 					SERCOM_USB.print("[command rx]\tCRC check failed - transmitting error message\r\n");
-				// #endif
-				// 				}
-			}
-			else
-			{
-				// send error message if data length is incorrect
-				response.setStatus(STATUS_COMM_ERROR);
-				response.send();
-				#if DEBUG
-					SERCOM_USB.print("[command rx]\tReceived incorrect number of bytes - transmitting error message\r\n");
-				#endif
+						SERCOM_USB.print(" ]\r\n");
+					#endif
+
+					if (cmd_packet.isFull() && !handleQuery(cmd_packet.getCommand()))
+						state_machine_transition(cmd_packet.getCommand());
+
+					cmd_packet.clear();
+					break;
+
+				case FRAMER_CRC_ERROR:
+					comm_error = true;
+					#if DEBUG
+						SERCOM_USB.print("[command rx]\tCRC check failed - resynchronizing\r\n");
+					#endif
+					break;
+
+				default:
+					break;
 			}
 		}
 
-		vTaskDelay(1000 / portTICK_PERIOD_MS);
+		if (comm_error)
+		{
+			// send error message if a command was lost
+			response.setStatus(STATUS_COMM_ERROR);
+			response.send();
+
+			#if DEBUG
+				sprintf(debug_str, "%lu resyncs, %lu CRC failures, %lu bytes discarded",
+						(unsigned long)framer.stats().resyncs,
+						(unsigned long)framer.stats().crc_failures,
+						(unsigned long)framer.stats().bytes_discarded);
+				SERCOM_USB.print("[command rx]\t");
+				SERCOM_USB.print(debug_str);
+				SERCOM_USB.print("\r\n");
+			#endif
+		}
 	}
 }
 
@@ -298,26 +509,39 @@ void heartbeat(void *pvParameters)
 		SERCOM_USB.print("[heartbeat]\tTask started\r\n");
 	#endif
 
+	// every mode but standby and the photodiode test sends heartbeats
+	const EventBits_t heartbeat_modes = MODE_BITS_ALL & ~(modeBit(CMD_STANDBY) | modeBit(CMD_TST_PHOTODIODES));
+	Periodic &period = periodic[PERIODIC_HEARTBEAT];
+
+	period.start();
+
 	while (1)
 	{
-		xSemaphoreTake(IMUsemphr, portMAX_DELAY);
+		if ((xEventGroupGetBits(modeEvents) & heartbeat_modes) == 0)
+		{
+			waitForMode(heartbeat_modes);
+			period.start(); // new schedule after the pause, no catching up
+		}
+
+		period.wait();
 		xQueuePeek(modeQ, (void *)&mode, (TickType_t)0);
 
 		if (mode != CMD_STANDBY && mode != CMD_TST_PHOTODIODES)
 		{
 			data_packet.setStatus(STATUS_OK);
 
+			// latest readings of the sensor tasks, never blocks
 			#if NUM_IMUS > 0
-				xQueuePeek(IMUq, (void *)&imu, (TickType_t)10);
+				imu_topic.read(imu);
 				data_packet.setIMUdata(imu);
 			#endif
 
 			#if INA
-				ina = readINA();
+				ina_topic.read(ina);
 				data_packet.setINAdata(ina);
 			#endif
 
-			pd = read_filtered_PD();
+			pd_topic.read(pd);
 			data_packet.setPDdata(pd);
 			data_packet.send(); // send to TES
 
@@ -340,7 +564,7 @@ void heartbeat(void *pvParameters)
 			data_packet.clear();
 		}
 
-		vTaskDelay(500 / portTICK_PERIOD_MS);
+		period.done();
 	}
 }
 
@@ -352,7 +576,8 @@ void heartbeat(void *pvParameters)
 void photodiode_test(void *pvParameters)
 {
 	uint8_t mode;
-	PDdata pd;
+	PDdata_int pd;
+	uint32_t pd_seq = 0;
 
 	#if DEBUG
 		SERCOM_USB.print("[sun test]\tTask started\r\n");
@@ -360,12 +585,11 @@ void photodiode_test(void *pvParameters)
 
 	while (1)
 	{
-		xQueuePeek(modeQ, (void *)&mode, (TickType_t)0);
+		mode = waitForMode(modeBit(CMD_TST_PHOTODIODES));
 
-		if (mode == CMD_TST_PHOTODIODES)
+		// readSlowSensors samples the photodiodes, print each sample once
+		if (mode == CMD_TST_PHOTODIODES && pd_topic.readIfNewer(pd, pd_seq))
 		{
-			pd = readPD();
-
 			for (int channel = 0; channel < 6; channel++)
 			{
 				#if DEBUG
@@ -418,7 +642,7 @@ void basic_motion(void *pvParameters)
 		// 		SERCOM_USB.print("[basic motion]\tChecked mode\r\n");
 		// #endif
 
-		xQueuePeek(modeQ, (void *)&mode, (TickType_t)0);
+		mode = waitForMode(modeBit(CMD_TST_BASIC_MOTION));
 
 		if (mode == CMD_TST_BASIC_MOTION)
 		{
@@ -480,7 +704,7 @@ void basic_bldc(void *pvParameters)
 		//#if DEBUG
 		// 		SERCOM_USB.print("[basic BLDC]\tChecked mode\r\n");
 		// #endif
-		xQueuePeek(modeQ, &mode, 0);
+		mode = waitForMode(modeBit(CMD_TST_BLDC));
         int t0 = millis();
 		int ct = millis();
 
@@ -532,10 +756,9 @@ void basic_bldc(void *pvParameters)
 			state_machine_transition(mode);
 		}
 
+		//vTaskDelay(pdMS_TO_TICKS(1000));
+		vTaskDelay(pdMS_TO_TICKS(10));
 	}
-	//vTaskDelay(pdMS_TO_TICKS(1000));
-	vTaskDelay(pdMS_TO_TICKS(10));
-	
 }
 
 /**
@@ -577,7 +800,7 @@ void basic_mtx(void *pvParameters)
 		// #if DEBUG
 		// 		SERCOM_USB.print("[basic MTX]\tChecked mode\r\n");
 		// #endif
-		xQueuePeek(modeQ, &mode, 0);
+		mode = waitForMode(modeBit(CMD_TST_MTX));
 
 		int t0 = millis();
 		int ct = millis();
@@ -585,8 +808,6 @@ void basic_mtx(void *pvParameters)
 		if (mode == CMD_TST_MTX)
 		{
 			// 1. Measure B field components
-			xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-			//xQueuePeek(IMUq, &imu, 0);
 			
 			//IMUdata bField = readIMU( *pvParameters);
 			//Bx = bField.magX;
@@ -611,8 +832,7 @@ void basic_mtx(void *pvParameters)
 					Mtx2.stop();
 					mtxState = 0;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 				
 				if(ct - t0 >= t_00 && ct - t0 < t1 ){
@@ -620,8 +840,7 @@ void basic_mtx(void *pvParameters)
 					Mtx1.fwd();
 					mtxState = 1;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 
 				if(ct - t0 >= t1 && ct - t0 < t2 ){
@@ -629,8 +848,7 @@ void basic_mtx(void *pvParameters)
 					Mtx1.standby();
 					mtxState = 0;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 
 				if(ct - t0 >= t2 && ct - t0 < t3 ){
@@ -638,8 +856,7 @@ void basic_mtx(void *pvParameters)
 					Mtx1.rev();
 					mtxState = -1;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 
 				if(ct - t0 >= t3 && ct - t0 < t4 ){
@@ -647,8 +864,7 @@ void basic_mtx(void *pvParameters)
 					Mtx1.standby();
 					mtxState = 0;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 
 				if(ct - t0 >= t4 && ct - t0 < t5 ){
@@ -656,8 +872,7 @@ void basic_mtx(void *pvParameters)
 					Mtx2.fwd();
 					mtxState = 1;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 
 				if(ct - t0 >= t5 && ct - t0 < t6 ){
@@ -665,8 +880,7 @@ void basic_mtx(void *pvParameters)
 					Mtx2.standby();
 					mtxState = 0;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 
 				if(ct - t0 >= t6 && ct - t0 < t7 ){
@@ -674,8 +888,7 @@ void basic_mtx(void *pvParameters)
 					Mtx2.rev();
 					mtxState = -1;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 
 				if(ct-t0 > t7){
@@ -683,8 +896,7 @@ void basic_mtx(void *pvParameters)
 					Mtx2.stop();
 					mtxState = 0;
 
-					xSemaphoreTake(IMUsemphr, portMAX_DELAY);
-					xQueuePeek(IMUq, &imu, 0);
+					imu_topic.read(imu);
 				}
 
 				Bx = imu.magX;
@@ -704,6 +916,8 @@ void basic_mtx(void *pvParameters)
 					SERCOM_USB.print(" \r\n");
 				#endif
 
+				// one line per IMU sample
+				vTaskDelay(pdMS_TO_TICKS(IMU_BATCH_PERIOD_MS));
 				ct = millis();
 			}
 			mode = CMD_HEARTBEAT;
@@ -735,7 +949,7 @@ void basic_attitude_determination(void *pvParameters)
 		// #if DEBUG
 		// 		SERCOM_USB.print("[basic AD]\tChecked mode\r\n");
 		// #endif
-		xQueuePeek(modeQ, &mode, 0);
+		mode = waitForMode(modeBit(CMD_TST_BASIC_AD));
 
 		if (mode == CMD_TST_BASIC_AD)
 		{
@@ -767,7 +981,7 @@ void basic_attitude_control(void *pvParameters)
 		// #if DEBUG
 		// 		SERCOM_USB.print("[basic AC]\tChecked mode\r\n");
 		// #endif
-		xQueuePeek(modeQ, &mode, 0);
+		mode = waitForMode(modeBit(CMD_TST_BASIC_AC));
 
 		if (mode == CMD_TST_BASIC_AC)
 		{
@@ -805,19 +1019,25 @@ void simple_detumble(void *pvParameters)
 	int pwm_output = 0; // init at zero, signed to represent direction
 
 	IMUdata imu;
+	uint32_t imu_seq = 0; // sequence number of the last IMU sample used
+	Periodic &period = periodic[PERIODIC_DETUMBLE];
+
+	period.start();
 
 	while (true)
 	{
 		// #if DEBUG
 		// 		SERCOM_USB.print("[basic detumbl]\tChecked mode\r\n");
 		// #endif
-		xQueuePeek(modeQ, &mode, 0);
+		period.wait();
+		mode = waitForMode(modeBit(CMD_TST_SIMPLE_DETUMBLE));
 
-		if (mode == CMD_TST_SIMPLE_DETUMBLE)
+		// only update the output when readIMU has a new sample
+		if (mode == CMD_TST_SIMPLE_DETUMBLE && imu_topic.readIfNewer(imu, imu_seq))
 		{
-			xSemaphoreTake(IMUsemphr, portMAX_DELAY);
+			TRACE(TP_DETUMBLE_INPUT, imu_seq);
+
 			// calculate error
-			xQueuePeek(IMUq, &imu, 0);
 			float rot_vel_z = imu.gyrZ;
 
 			error = rot_vel_z - target_rot_vel; // difference between current state and target state
@@ -852,6 +1072,7 @@ void simple_detumble(void *pvParameters)
 				// TODO: desaturate with magnetorquers if |pwm_output| == 255 or in state of equilibrium
 				// for the meantime, just keep doing the same thing
 			}
+			TRACE(TP_WHEEL_OUTPUT, imu_seq);
 
 			#if DEBUG
 				SERCOM_USB.print("[basic detumbl]\t====== PID LOOP ======\r\n");
@@ -870,7 +1091,7 @@ void simple_detumble(void *pvParameters)
 
 			prev_error = error;
 		}
-		vTaskDelay(pdMS_TO_TICKS(10));
+		period.done();
 	}
 }
 
@@ -883,6 +1104,8 @@ void simple_detumble(void *pvParameters)
 void simple_orient(void *pvParameters)
 {
 	uint8_t mode;
+	PDdata_int pdata;
+	uint32_t pd_seq = 0;
 
 	#if DEBUG
 		char debug_str[16];
@@ -895,13 +1118,12 @@ void simple_orient(void *pvParameters)
 		// 		SERCOM_USB.print("[simple orient]\tChecked mode\r\n");
 		// #endif
 
-		xQueuePeek(modeQ, &mode, 0);
+		mode = waitForMode(modeBit(CMD_TST_SIMPLE_ORIENT));
 
-		if (mode == CMD_TST_SIMPLE_ORIENT)
-		{
-			// read photodiodes
-			PDdata pdata = readPD();
-			// read the direction the satellite needs to move to align
+		// latest photodiode sample of readSlowSensors, the motor is only
+		// set again when there is a new one
+		if (mode == CMD_TST_SIMPLE_ORIENT && pd_topic.readIfNewer(pdata, pd_seq))
+		{			// read the direction the satellite needs to move to align
 			MotorDirection md = getDirection(pdata);
 
 			// spin motor so that X+ is pointed at light
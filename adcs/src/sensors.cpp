@@ -1,4 +1,14 @@
 #include "sensors.h"
+#include "comm.h"
+#include "rtos_objects.h"
+#include "periodic.h"
+#include "trace.h"
+#include "power.h"
+#include "rtos_tasks.h"
+#include <ICMFifo.h>
+#if IMU_DMP
+	#include <DMPFifo.h>
+#endif
 
 ICM_20948_I2C IMU1;
 ICM_20948_I2C IMU2;
@@ -7,16 +17,277 @@ INA209 ina209(1000000);
 
 ADCSPhotodiodeArray sunSensors(A0, 13, 12, 11);
 
-QueueHandle_t IMUq;
-QueueHandle_t INAq;
-QueueHandle_t PDq;
+// sensor topics, published by readIMU and readSlowSensors. Reads never
+// block, a topic holds zeros until its first sample.
+Topic<IMUdata> imu_topic;
+Topic<IMUdata> imu_raw_topic;
+Topic<IMUattitude> attitude_topic;
+Topic<INAdata> ina_topic;
+Topic<PDdata_int> pd_topic;
 
-SemaphoreHandle_t IMUsemphr;
-SemaphoreHandle_t INAsemphr;
-SemaphoreHandle_t PDsemphr;
+// filled by the imu_raw_topic subscriber below
+static IMUbatch imu_batch;
+
+#if IMU_FIFO && NUM_IMUS >= 2
+	#error "IMU_FIFO reads IMU1 only"
+#endif
+
+#if IMU_DMP && !IMU_FIFO
+	#error "the DMP packets are read with IMU_FIFO"
+#endif
+
+#if !IMU_FIFO
+// task woken by the IMU data ready interrupt, and micros() and millis() at the
+// last interrupt
+static TaskHandle_t imu_task = NULL;
+static volatile uint32_t imu_int_us = 0;
+static volatile uint32_t imu_int_ms = 0;
+#endif
+
+// millis() when the sample being published was taken, for the batch
+static uint32_t imu_sample_ms = 0;
+
+// what readIMU reads, only readIMU changes it
+static volatile IMUMode imu_mode = IMU_MODE_RAW;
+
+// INA209 configuration written by initINA, and the same with the ADC powered
+// down for standby
+#define INA209_CFG 0x399f
+#define INA209_CFG_POWER_DOWN 0x3998
+
+/* I2C TRANSFERS ============================================================ */
+
+/**
+ * @brief      Register write of the ICM-20948 driver on the I2C transfer queue,
+ *             in place of its Wire one
+ *
+ * @param[in]  reg   The register
+ * @param      data  The bytes, at most INV_MAX_SERIAL_WRITE as the driver
+ *                   writes its memory in chunks of that size
+ * @param[in]  len   Number of bytes
+ * @param      user  The ICM_20948_I2C
+ */
+static ICM_20948_Status_e imuWrite(uint8_t reg, uint8_t *data, uint32_t len, void *user)
+{
+	uint8_t tx[1 + INV_MAX_SERIAL_WRITE];
+
+	if (len > INV_MAX_SERIAL_WRITE)
+		return ICM_20948_Stat_ParamErr;
+
+	tx[0] = reg;
+	memcpy(tx + 1, data, len);
+	if (!i2cTransfer(((ICM_20948_I2C *)user)->_addr, tx, 1 + len, NULL, 0, imuI2CDone))
+		return ICM_20948_Stat_Err;
+	return ICM_20948_Stat_Ok;
+}
+
+/**
+ * @brief      Register read of the ICM-20948 driver on the I2C transfer queue,
+ *             the register address and the read in one transfer
+ */
+static ICM_20948_Status_e imuRead(uint8_t reg, uint8_t *data, uint32_t len, void *user)
+{
+	if (len > UINT16_MAX)
+		return ICM_20948_Stat_ParamErr;
+
+	if (!i2cTransfer(((ICM_20948_I2C *)user)->_addr, &reg, 1, data, len, imuI2CDone))
+		return ICM_20948_Stat_Err;
+	return ICM_20948_Stat_Ok;
+}
+
+/**
+ * @brief      Transfers of the INA209 on the I2C transfer queue
+ */
+static bool inaTransfer(uint8_t addr, const uint8_t *tx, uint8_t tx_len, uint8_t *rx, uint8_t rx_len, void *context)
+{
+	return i2cTransfer(addr, tx, tx_len, rx, rx_len, inaI2CDone);
+}
+
+/**
+ * @brief      Send the transfers of an IMU through the queue, after begin set
+ *             up the Wire ones
+ */
+static void useI2Cqueue(ICM_20948_I2C &imu)
+{
+	imu._serif.write = imuWrite;
+	imu._serif.read = imuRead;
+}
+
+/* TOPIC SUBSCRIBERS ======================================================== */
+
+/**
+ * @brief      Adds every raw IMU sample to the batch frame whenever the
+ *             heartbeat is running, runs in readIMU
+ *
+ * @param[in]  sample   The sample
+ * @param[in]  seq      Its sequence number, not used
+ * @param      context  The IMUbatch
+ */
+static void batchIMUSample(const IMUdata &sample, uint32_t seq, void *context)
+{
+	IMUbatch *batch = (IMUbatch *)context;
+	uint8_t mode;
+
+	xQueuePeek(modeQ, (void *)&mode, (TickType_t)0);
+	if (mode != CMD_STANDBY && mode != CMD_TST_PHOTODIODES)
+		batch->add(sample, imu_sample_ms);
+	else
+		batch->send();
+}
+
+#if DEBUG
+/**
+ * @brief      Prints the averaged IMU reading, runs in readIMU
+ */
+static void printIMUSample(const IMUdata &imu, uint32_t seq, void *context)
+{
+	SERCOM_USB.print("[imu]\t\tgyr ");
+	printFormattedFloat(imu.gyrX, 3, 2);
+	printFormattedFloat(imu.gyrY, 3, 2);
+	printFormattedFloat(imu.gyrZ, 3, 2);
+	SERCOM_USB.print(" mag ");
+	printFormattedFloat(imu.magX, 3, 2);
+	printFormattedFloat(imu.magY, 3, 2);
+	printFormattedFloat(imu.magZ, 3, 2);
+	SERCOM_USB.print("\r\n");
+}
+
+/**
+ * @brief      Prints the 9 axis quaternion of the DMP, runs in readIMU
+ */
+static void printAttitude(const IMUattitude &attitude, uint32_t seq, void *context)
+{
+	SERCOM_USB.print("[imu]\t\tquat9 ");
+	for (uint8_t i = 0; i < 4; i++)
+		printFormattedFloat(attitude.quat9[i], 1, 4);
+	SERCOM_USB.print(" accuracy ");
+	SERCOM_USB.print(attitude.quat9_accuracy);
+	SERCOM_USB.print("\r\n");
+}
+#endif
 
 /* HARDWARE INIT FUNCTIONS ================================================== */
 
+/**
+ * @brief      Sets the output data rate and either makes the INT pin pulse for
+ *             every new sample or queues the samples in the FIFO
+ *
+ * @param      imu   The IMU
+ */
+static void initIMUsampling(ICM_20948_I2C &imu)
+{
+	ICM_20948_smplrt_t rate;
+	rate.a = IMU_SMPLRT_DIV;
+	rate.g = IMU_SMPLRT_DIV;
+
+	// startupDefault turns the DLPF off, which runs the gyroscope at 9 kHz
+	// and ignores the divider. Bandwidths below the Nyquist rate.
+	ICM_20948_dlpcfg_t dlpf;
+	dlpf.a = acc_d50bw4_n68bw8;
+	dlpf.g = gyr_d51bw2_n73bw3;
+
+	imu.setDLPFcfg(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr, dlpf);
+	imu.enableDLPF(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr, true);
+	imu.setSampleRate(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr, rate);
+
+#if IMU_FIFO
+	// accelerometer and gyroscope frames, the magnetometer is read once per
+	// burst. Snapshot mode stops at a full FIFO rather than overwriting the
+	// oldest frame part way.
+	uint8_t fifo_en = ICM_FIFO_EN_2_ACCEL_GYRO;
+	imu.setBank(0);
+	imu.write(ICM_FIFO_EN_2, &fifo_en, 1);
+	imu.setFIFOmode(true);
+	imu.enableFIFO(true);
+	imu.resetFIFO();
+
+	// fills in the full scale settings that gyrX() and magX() scale with
+	imu.getAGMT();
+#else
+	// a 50 us pulse per sample. A latched INT only goes inactive when read,
+	// so one missed read would stop the interrupts for good.
+	imu.cfgIntActiveLow(false);
+	imu.cfgIntOpenDrain(false);
+	imu.cfgIntLatch(false);
+	imu.intEnableRawDataReady(true);
+#endif
+}
+
+#if IMU_DMP
+/**
+ * @brief      Configure the IMU for raw samples. With the DMP in the driver,
+ *             begin skips the end of startupDefault and initializeDMP changes
+ *             the IMU for the DMP, so this does that part of startupDefault
+ *             again and undoes the rest: continuous sampling at the default
+ *             full scale ranges, the magnetometer measuring on its own at
+ *             100 Hz and read by peripheral 0. The firmware stays loaded.
+ *
+ * @param      imu   The IMU, initIMUsampling follows
+ */
+static void startIMUraw(ICM_20948_I2C &imu)
+{
+	ICM_20948_fss_t fss;
+	fss.a = gpm2;
+	fss.g = dps250;
+	uint8_t mst_odr = 0;
+
+	imu.enableDMP(false);
+	imu.resetDMP();
+	imu.setSampleMode(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr, ICM_20948_Sample_Mode_Continuous);
+	imu.setFullScale(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr, fss);
+
+	// initializeDMP has peripheral 1 start each magnetometer measurement and
+	// slows the I2C master down to 68.75 Hz
+	imu.i2cControllerConfigurePeripheral(1, MAG_AK09916_I2C_ADDR, AK09916_REG_CNTL2, 1, false, false);
+	imu.setBank(3);
+	imu.write(AGB3_REG_I2C_MST_ODR_CONFIG, &mst_odr, 1);
+	imu.startupMagnetometer(false);
+}
+
+/**
+ * @brief      Configure the IMU for the DMP and start it. The first call loads
+ *             the firmware, about 14 KB over I2C, the later ones only write
+ *             the configuration. The DMP writes the 9 and 6 axis quaternions,
+ *             the gyroscope with its bias and the calibrated magnetometer to
+ *             the FIFO, with their accuracies, once per sample.
+ *
+ * @param      imu   The IMU
+ *
+ * @return     True if the DMP runs
+ */
+static bool startIMUdmp(ICM_20948_I2C &imu)
+{
+	const inv_icm20948_sensor sensors[] = {
+		INV_ICM20948_SENSOR_ROTATION_VECTOR,	  // Quat9
+		INV_ICM20948_SENSOR_GAME_ROTATION_VECTOR, // Quat6
+		INV_ICM20948_SENSOR_GYROSCOPE,			  // Gyro and Gyro_Calibr
+		INV_ICM20948_SENSOR_GEOMAGNETIC_FIELD	  // Compass_Calibr
+	};
+	const DMP_ODR_Registers odrs[] = {
+		DMP_ODR_Reg_Quat9, DMP_ODR_Reg_Quat6, DMP_ODR_Reg_Gyro, DMP_ODR_Reg_Gyro_Calibr, DMP_ODR_Reg_Cpass_Calibr
+	};
+	bool ok = imu.initializeDMP() == ICM_20948_Stat_Ok;
+
+	for (uint8_t i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++)
+		ok = imu.enableDMPSensor(sensors[i]) == ICM_20948_Stat_Ok && ok;
+
+	// a packet for every sample
+	for (uint8_t i = 0; i < sizeof(odrs) / sizeof(odrs[0]); i++)
+		ok = imu.setDMPODRrate(odrs[i], 0) == ICM_20948_Stat_Ok && ok;
+
+	ok = imu.enableFIFO(true) == ICM_20948_Stat_Ok && ok;
+	ok = imu.enableDMP(true) == ICM_20948_Stat_Ok && ok;
+	ok = imu.resetDMP() == ICM_20948_Stat_Ok && ok;
+	ok = imu.resetFIFO() == ICM_20948_Stat_Ok && ok;
+
+	#if DEBUG
+		SERCOM_USB.print(ok ? "[imu]\t\tDMP started\r\n" : "[imu]\t\tDMP failed to start\r\n");
+	#endif
+
+	return ok;
+}
+#endif
+
 /**
  * @brief      Initializes the IMU I2C connection
  */
@@ -29,10 +300,20 @@ void initIMU(void)
     IMU1.begin(SERCOM_I2C, AD0_VAL);
     while (IMU1.status != ICM_20948_Stat_Ok);  // wait for initialization to
                                                // complete
+	useI2Cqueue(IMU1);
 	#if DEBUG
 	    SERCOM_USB.print("[system init]\tIMU1 initialized\r\n");
 	#endif
 
+	#if IMU_DMP
+		// load the firmware now, before the scheduler, rather than in the
+		// IMU task when CMD_IMU_DMP comes
+		if (IMU1.initializeDMP() == ICM_20948_Stat_Ok && IMU_DMP_AT_BOOT)
+			requestIMUMode(IMU_MODE_DMP);
+		startIMUraw(IMU1);
+	#endif
+	initIMUsampling(IMU1);
+
 	#if NUM_IMUS >= 2
 		/**
 		 * Initialize second IMU
@@ -42,23 +323,21 @@ void initIMU(void)
 											// value for bit 0
 	    while (IMU2.status != ICM_20948_Stat_Ok);  // wait for initialization to
 	                                               // complete
+		useI2Cqueue(IMU2);
 		#if DEBUG
 		    SERCOM_USB.print("[system init]\tIMU2 initialized\r\n");
 		#endif
+		initIMUsampling(IMU2); // same rate, only the INT of IMU1 is wired
 	#endif
 
-	IMUq = xQueueCreate(1, sizeof(IMUdata));
-	IMUdata dummy_init;
-	dummy_init.magX = 0.0f;
-	dummy_init.magY = 0.0f;
-	dummy_init.magZ = 0.0f;
-	dummy_init.gyrZ = 0.0f;
-	xQueueSend(IMUq, (void *)&dummy_init, (TickType_t)0);
-
-	IMUsemphr = xSemaphoreCreateBinary();
-	xSemaphoreGive(IMUsemphr);
+	// subscribe before the publisher starts
+	imu_raw_topic.subscribe(IMU_BATCH_DECIMATION, batchIMUSample, &imu_batch);
+	#if DEBUG
+		imu_topic.subscribe(IMU_PRINT_DECIMATION, printIMUSample);
+		attitude_topic.subscribe(IMU_DMP_PRINT_DECIMATION, printAttitude);
+	#endif
 
-	xTaskCreate(readIMU, "IMU read", 256, NULL, 1, NULL);
+	createTask(TASK_READ_IMU);
 	#if DEBUG
 		SERCOM_USB.print("[rtos]\t\tCreated IMU read task\r\n");
 	#endif
@@ -79,7 +358,8 @@ void initINA(void)
 	 * ADC conversion time: 532us
 	 * Mode: shunt and bus, continuous
 	 */
-    ina209.writeCfgReg(0x399f);
+	ina209.setTransfer(inaTransfer, NULL);
+    ina209.writeCfgReg(INA209_CFG);
 
 	/**
 	 * Calibrate INA209
@@ -94,16 +374,6 @@ void initINA(void)
 	    SERCOM_USB.print("[system init]\tINA209 initialized\r\n");
 	#endif
 
-	INAq = xQueueCreate(1, sizeof(INAdata));
-	INAdata dummy_init;
-	dummy_init.voltage = 0.0f;
-	dummy_init.current = 0.0f;
-	xQueueSend(INAq, (void *)&dummy_init, (TickType_t)0);
-
-	INAsemphr = xSemaphoreCreateBinary();
-	xSemaphoreGive(INAsemphr);
-
-	// xTaskCreate(readINA_rtos, "INA read", 256, NULL, 1, NULL);
 }
 
 /**
@@ -239,10 +509,285 @@ PDdata_int read_filtered_PD(void)
 
 
 
+/* IMU MODE ================================================================= */
+
+/**
+ * @brief      Ask readIMU to read IMU1 in mode from its next burst on. A
+ *             request it has not taken yet is replaced.
+ *
+ * @param[in]  mode  The mode, IMU_MODE_DMP needs IMU_DMP
+ */
+void requestIMUMode(IMUMode mode)
+{
+	uint8_t m = mode;
+	xQueueOverwrite(imuModeQ, (void *)&m);
+}
+
+/**
+ * @brief      The mode readIMU reads IMU1 in
+ */
+IMUMode getIMUMode(void)
+{
+	return imu_mode;
+}
+
+/* STANDBY ================================================================== */
+
+/**
+ * @brief      Put the IMUs to sleep or wake them up, gyro, accelerometer and
+ *             the magnetometer behind them
+ *
+ * @param[in]  asleep  True to sleep
+ */
+static void sleepIMU(bool asleep)
+{
+	IMU1.sleep(asleep);
+	#if NUM_IMUS >= 2
+		IMU2.sleep(asleep);
+	#endif
+}
+
+#if INA
+/**
+ * @brief      Power the INA209 ADC down or up again
+ *
+ * @param[in]  asleep  True to power down
+ */
+static void sleepINA(bool asleep)
+{
+	ina209.writeCfgReg(asleep ? INA209_CFG_POWER_DOWN : INA209_CFG);
+}
+#endif
+
+#if IMU_FIFO
+/* IMU FIFO ================================================================= */
+
+/**
+ * @brief      Register access to an IMU for ICMFifoReader, bank 0 has to be
+ *             selected
+ */
+class IMUBus
+{
+private:
+	ICM_20948_I2C &_imu;
+
+public:
+	IMUBus(ICM_20948_I2C &imu) : _imu(imu) {}
+
+	bool read(uint8_t reg, uint8_t *data, uint16_t len)
+	{
+		return _imu.read(reg, data, len) == ICM_20948_Stat_Ok;
+	}
+
+	bool write(uint8_t reg, const uint8_t *data, uint16_t len)
+	{
+		// the driver takes a non-const buffer, the reader writes single
+		// registers
+		uint8_t buf[4];
+
+		if (len > sizeof(buf))
+			return false;
+		memcpy(buf, data, len);
+		return _imu.write(reg, buf, len) == ICM_20948_Stat_Ok;
+	}
+};
+
+static IMUBus imu_bus(IMU1);
+static ICMFifoReader<IMUBus> imu_fifo(imu_bus, IMU_SAMPLE_PERIOD_US);
+static ICMFifoSample imu_fifo_samples[ICM_FIFO_MAX_BURST];
+
+#if IMU_DMP
+static DMPFifoReader<IMUBus> imu_dmp(imu_bus);
+static DMPPacket imu_dmp_packets[IMU_DMP_MAX_PACKETS];
+#endif
+
+/**
+ * @brief      Reads the samples queued in the FIFO of IMU1 and its latest
+ *             magnetometer reading. The magnetometer goes into IMU1.agmt.
+ *
+ * @param[in]  now_us  micros() just before the call
+ *
+ * @return     Number of samples in imu_fifo_samples
+ */
+static uint8_t readIMUfifo(uint32_t now_us)
+{
+	uint8_t n;
+	uint8_t mag[9];
+
+	IMU1.setBank(0);
+	n = imu_fifo.read(imu_fifo_samples, ICM_FIFO_MAX_BURST, now_us);
+
+	// ST1, X, Y, Z little endian, TMPS, ST2 as get_agmt reads them
+	if (n > 0 && IMU1.read(AGB0_REG_EXT_PERIPH_SENS_DATA_00, mag, sizeof(mag)) == ICM_20948_Stat_Ok)
+	{
+		IMU1.agmt.magStat1 = mag[0];
+		IMU1.agmt.mag.axes.x = (mag[2] << 8) | mag[1];
+		IMU1.agmt.mag.axes.y = (mag[4] << 8) | mag[3];
+		IMU1.agmt.mag.axes.z = (mag[6] << 8) | mag[5];
+		IMU1.agmt.magStat2 = mag[8];
+	}
+
+	return n;
+}
+
+/**
+ * @brief      Empties the FIFO of IMU1, after it slept
+ */
+static void resetIMUfifo(void)
+{
+	IMU1.setBank(0);
+	#if IMU_DMP
+		if (imu_mode == IMU_MODE_DMP)
+		{
+			imu_dmp.reset();
+			return;
+		}
+	#endif
+	imu_fifo.reset();
+}
+
+#if IMU_DMP
+/**
+ * @brief      Reads the packets the DMP of IMU1 queued in the FIFO and
+ *             publishes them, the quaternions to attitude_topic and the
+ *             calibrated gyroscope and magnetometer to imu_raw_topic. The DMP
+ *             filters the samples, they are not averaged here.
+ *
+ * @param[in]  now_ms  millis() just before the call
+ * @param      result  Set to the latest sample, for imu_topic
+ *
+ * @return     Number of packets with a gyroscope sample, result only has a
+ *             new rate when it is not 0
+ */
+static uint8_t readIMUdmp(uint32_t now_ms, IMUdata &result)
+{
+	IMUattitude attitude;
+	uint8_t n;
+	uint8_t gyro = 0;
+
+	IMU1.setBank(0);
+	n = imu_dmp.read(imu_dmp_packets, IMU_DMP_MAX_PACKETS);
+
+	for (uint8_t i = 0; i < n; i++)
+	{
+		const DMPPacket &p = imu_dmp_packets[i];
+
+		// one sample period apart, the last one just taken
+		imu_sample_ms = now_ms - (n - 1 - i) * IMU_DMP_PERIOD_US / 1000;
+
+		if (p.header & DMP_HEADER_GYRO)
+		{
+			result.gyrX = (p.gyro[0] - p.gyro_bias[0]) * IMU_DMP_GYRO_DPS / 32768.0f;
+			result.gyrY = (p.gyro[1] - p.gyro_bias[1]) * IMU_DMP_GYRO_DPS / 32768.0f;
+			result.gyrZ = (p.gyro[2] - p.gyro_bias[2]) * IMU_DMP_GYRO_DPS / 32768.0f;
+			gyro++;
+		}
+
+		// the DMP turns the magnetometer into the axes of the gyroscope, Y and
+		// Z of the AK09916 point the other way. Back to those of magX().
+		if (p.header & DMP_HEADER_COMPASS_CALIBR)
+		{
+			result.magX = p.compass[0] / 65536.0f;
+			result.magY = -p.compass[1] / 65536.0f;
+			result.magZ = -p.compass[2] / 65536.0f;
+		}
+
+		if (p.header & (DMP_HEADER_GYRO | DMP_HEADER_COMPASS_CALIBR))
+			imu_raw_topic.publish(result);
+
+		if (p.header & DMP_HEADER_QUAT9)
+		{
+			dmpQuaternion(p.quat9, attitude.quat9);
+			dmpQuaternion(p.quat6, attitude.quat6);
+			attitude.quat9_accuracy = p.quat9_accuracy;
+			attitude_topic.publish(attitude);
+		}
+	}
+
+	return gyro;
+}
+
+/**
+ * @brief      Switch IMU1 between raw samples and the DMP, in readIMU. When
+ *             the DMP does not start the IMU goes back to raw samples.
+ *
+ * @param[in]  mode  The mode
+ */
+static void switchIMUMode(IMUMode mode)
+{
+	if (mode == IMU_MODE_DMP && startIMUdmp(IMU1))
+	{
+		imu_mode = IMU_MODE_DMP;
+	}
+	else
+	{
+		startIMUraw(IMU1);
+		initIMUsampling(IMU1);
+		imu_mode = IMU_MODE_RAW;
+	}
+
+	resetIMUfifo();
+}
+#endif
+
+#else
+/* IMU DATA READY INTERRUPT ================================================= */
+
+/**
+ * @brief      INT of IMU1 pulsed, a new sample is in its output registers.
+ *             Notifies the IMU task once per sample.
+ */
+static void imuDataReady(void)
+{
+	BaseType_t task_woken = pdFALSE;
+
+	// power.cpp brings the clocks up to date before an interrupt that ends
+	// a sleep runs, so these are right even then
+	imu_int_us = micros();
+	imu_int_ms = millis();
+	TRACE(TP_IMU_INT, imu_topic.sequence() + 1);
+
+	if (imu_task != NULL)
+		vTaskNotifyGiveFromISR(imu_task, &task_woken);
+
+	portYIELD_FROM_ISR(task_woken);
+}
+
+/**
+ * @brief      Route the INT pin of IMU1 to imuDataReady, which notifies task
+ *
+ * @param[in]  task  Task to notify, it should block in ulTaskNotifyTake
+ */
+static void attachIMUint(TaskHandle_t task)
+{
+	imu_task = task;
+
+	pinMode(IMU_INT_PIN, INPUT);
+	attachInterrupt(digitalPinToInterrupt(IMU_INT_PIN), imuDataReady, RISING);
+
+	#if !ADCS_SIM
+		// the core enables the EIC interrupts at priority 0, above the max
+		// syscall priority that FromISR calls need
+		NVIC_SetPriority((IRQn_Type)(EIC_0_IRQn + g_APinDescription[IMU_INT_PIN].ulExtInt),
+						 configLIBRARY_LOWEST_INTERRUPT_PRIORITY);
+	#endif
+
+	#if DEBUG
+		SERCOM_USB.print("[system init]\tIMU data ready interrupt attached\r\n");
+	#endif
+}
+#endif
+
 /* SENSOR RTOS TASKS ======================================================== */
 
 /**
- * @brief      Reads IMU data, gyroscope (deg/sec) and magentometer (uTeslas) and stores in struct
+ * @brief      Reads IMU data, gyroscope (deg/sec) and magentometer (uTeslas) and stores in struct.
+ *             Each sample is read once at the rate set by IMU_SMPLRT_DIV,
+ *             with IMU_FIFO in bursts from the FIFO every IMU_FIFO_BURST_MS,
+ *             otherwise woken by the data ready interrupt for every one. In
+ *             IMU_MODE_DMP the bursts read the packets of the DMP instead,
+ *             see readIMUdmp. In standby the IMU sleeps and the task waits
+ *             for another mode.
  *
  * @param      pvParameters  RTOS task input params, not used
  */
@@ -254,8 +799,10 @@ void readIMU(void *pvParameters)
 	#endif
 
 	IMUdata result;
+	IMUdata sample;	 // single read, not averaged, for imu_raw_topic
 
-	const int DECIMATION = 4;
+	// the same averaging window at any sample rate
+	const int DECIMATION = 4 * IMU_BATCH_DECIMATION;
 	const int NUM_DECIMATIONS = 8;
 
 	float gyrXavgs[NUM_DECIMATIONS];
@@ -283,36 +830,142 @@ void readIMU(void *pvParameters)
 		gyrZavgs[i] = 0.0f;
 	}
 	
+	// standby policy, see power.h
+	const EventBits_t sensor_modes = sensorModes();
+	Periodic &period = periodic[PERIODIC_READ_IMU];
+	uint32_t sample_us;
+	uint8_t n;
+	bool fresh;	 // result holds a rate not yet published
+
+#if IMU_FIFO
+	period.start();
+#else
+	attachIMUint(xTaskGetCurrentTaskHandle());
+#endif
+
 	while (1)
 	{
-		#if NUM_IMUS >= 2
-			if (IMU1.dataReady() && IMU2.dataReady())
-			{
+		if ((xEventGroupGetBits(modeEvents) & sensor_modes) == 0)
+		{
+			// nothing reads the IMU in standby, it sleeps until another mode
+			// is entered
+			imu_batch.send();
+			sleepIMU(true);
+			waitForMode(sensor_modes);
+			sleepIMU(false);
+
+		#if IMU_FIFO
+			// the FIFO stopped when the IMU slept, start over empty
+			resetIMUfifo();
+			period.start();
 		#else
-			if (IMU1.dataReady())
-			{
+			// drop a notification of a sample from before the sleep
+			ulTaskNotifyTake(pdTRUE, 0);
 		#endif
-				xSemaphoreTake(IMUsemphr, 0);
-				IMU1.getAGMT();
-		#if NUM_IMUS >= 2
+		}
+
+	#if IMU_FIFO
+		period.wait();
+
+	#if IMU_DMP
+		uint8_t requested;
+		if (xQueueReceive(imuModeQ, (void *)&requested, (TickType_t)0) == pdTRUE && requested != imu_mode)
+			switchIMUMode((IMUMode)requested);
+	#endif
+
+		// tagged with the sequence number the first sample gets in imu_topic
+		TRACE(TP_IMU_READ, imu_topic.sequence() + 1);
+
+		// the IMU shares the I2C bus with the INA209. Two transfers for all
+		// the samples since the last burst and one for the magnetometer.
+		sample_us = micros();
+		uint32_t now_ms = millis();
+	#if IMU_DMP
+		if (imu_mode == IMU_MODE_DMP)
+		{
+			// two transfers for the packets, published as they are read
+			fresh = readIMUdmp(now_ms, result) > 0;
+			n = 0;
+		}
+		else
+	#endif
+		{
+			n = readIMUfifo(sample_us);
+			fresh = n > 0;
+		}
+	#else
+		// more than one notification means samples were overwritten before
+		// they were read, only the latest one is there to read
+		bool notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IMU_INT_TIMEOUT_MS)) > 0;
+
+		if (notified)
+		{
+			taskENTER_CRITICAL();
+			sample_us = imu_int_us;
+			imu_sample_ms = imu_int_ms;
+			taskEXIT_CRITICAL();
+		}
+		else
+		{
+			sample_us = micros();
+			imu_sample_ms = millis();
+		}
+		period.release(sample_us);
+
+		// tagged with the sequence number the sample gets in imu_topic
+		TRACE(TP_IMU_READ, imu_topic.sequence() + 1);
+
+		// the interrupt says a sample is ready, only a timeout asks the IMU
+		bool ready = notified || IMU1.dataReady();
+		if (ready)
+		{
+			IMU1.getAGMT();
+			#if NUM_IMUS >= 2
 				IMU2.getAGMT();
-		#endif
-				xSemaphoreGive(IMUsemphr);
+			#endif
+		}
+
+		n = ready ? 1 : 0;
+		fresh = ready;
+	#endif
+
+		TRACE(TP_IMU_SAMPLE, imu_topic.sequence() + 1);
+
+		for (uint8_t i = 0; i < n; i++)
+		{
+			#if IMU_FIFO
+				// scaled by the driver like a getAGMT() reading
+				for (uint8_t axis = 0; axis < 3; axis++)
+				{
+					IMU1.agmt.acc.raw.i16bit[axis] = imu_fifo_samples[i].accel[axis];
+					IMU1.agmt.gyr.raw.i16bit[axis] = imu_fifo_samples[i].gyro[axis];
+				}
+				imu_sample_ms = now_ms - (sample_us - imu_fifo_samples[i].t_us) / 1000;
+			#endif
 
 				result.magX = sensor_ptr1->magX();
 				result.magY = sensor_ptr1->magY();
 				result.magZ = sensor_ptr1->magZ();
 
 			#if NUM_IMUS >= 2
-				gyrXavgs[avgcntr] += ((sensor_ptr1->gyrX() + sensor_ptr2->gyrX()) / 2);
-				gyrYavgs[avgcntr] += ((sensor_ptr1->gyrY() + sensor_ptr2->gyrY()) / 2);
-				gyrZavgs[avgcntr] += ((sensor_ptr1->gyrZ() + sensor_ptr2->gyrZ()) / 2);
+				sample.gyrX = (sensor_ptr1->gyrX() + sensor_ptr2->gyrX()) / 2;
+				sample.gyrY = (sensor_ptr1->gyrY() + sensor_ptr2->gyrY()) / 2;
+				sample.gyrZ = (sensor_ptr1->gyrZ() + sensor_ptr2->gyrZ()) / 2;
 			#else
-				gyrXavgs[avgcntr] += sensor_ptr1->gyrX();
-				gyrYavgs[avgcntr] += sensor_ptr1->gyrY();
-				gyrZavgs[avgcntr] += sensor_ptr1->gyrZ();
+				sample.gyrX = sensor_ptr1->gyrX();
+				sample.gyrY = sensor_ptr1->gyrY();
+				sample.gyrZ = sensor_ptr1->gyrZ();
 			#endif
 
+				gyrXavgs[avgcntr] += sample.gyrX;
+				gyrYavgs[avgcntr] += sample.gyrY;
+				gyrZavgs[avgcntr] += sample.gyrZ;
+
+				sample.magX = result.magX;
+				sample.magY = result.magY;
+				sample.magZ = result.magZ;
+				imu_raw_topic.publish(sample);
+
 				readcntr++;
 
 				if (readcntr >= DECIMATION)
@@ -346,20 +999,57 @@ void readIMU(void *pvParameters)
 				}
 		}
 
-		xQueueOverwrite(IMUq, &result);
+		// an empty burst would bump the sequence and readers of imu_topic
+		// would take the old rate for a new one
+		if (fresh)
+		{
+			imu_topic.publish(result);
+			TRACE(TP_IMU_PUBLISH, imu_topic.sequence());
+		}
 
-		vTaskDelay(5 / portTICK_PERIOD_MS);
+		period.done();
 	}
 }
 
 /**
- * @brief      Read INA209 as an RTOS task, not currently implemented, left until needed.
+ * @brief      Reads the sensors that change slowly, INA209 power and the
+ *             filtered photodiodes, and publishes them for the heartbeat.
+ *             In standby the INA209 is powered down and the task waits for
+ *             another mode.
  *
- * @param      pvParameters  RTOS params, not currently used
+ * @param      pvParameters  RTOS task input params, not used
  */
-void readINA_rtos(void *pvParameters)
+void readSlowSensors(void *pvParameters)
 {
+	const EventBits_t sensor_modes = sensorModes();
+	Periodic &period = periodic[PERIODIC_SLOW_SENSORS];
+	period.start();
 
+	while (1)
+	{
+		if ((xEventGroupGetBits(modeEvents) & sensor_modes) == 0)
+		{
+			// parked in standby like readIMU
+			#if INA
+				sleepINA(true);
+			#endif
+			waitForMode(sensor_modes);
+			#if INA
+				sleepINA(false);
+			#endif
+			period.start();
+		}
+
+		period.wait();
+
+		#if INA
+			ina_topic.publish(readINA());
+		#endif
+
+		pd_topic.publish(read_filtered_PD());
+
+		period.done();
+	}
 }
 
 /* PRINTING FUNCTIONS ======================================================= */
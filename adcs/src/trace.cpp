@@ -0,0 +1,101 @@
+#include "trace.h"
+
+#if ADCS_TRACE
+
+#if !DEBUG
+	#error "the trace is dumped on SERCOM_USB, which is only set up with DEBUG"
+#endif
+
+// tasks named in a dump, the mission tasks, two mode tasks, idle and timers
+#define TRACE_MAX_TASKS 12
+
+static TraceBuffer<TRACE_BUFFER_LEN> trace_buf;
+static bool tracing = false; // false while the buffer is dumped
+
+/**
+ * @brief      Start the DWT cycle counter and the trace
+ */
+void initTrace(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	tracing = true;
+
+	SERCOM_USB.print("[system init]\tTrace started\r\n");
+}
+
+/**
+ * @brief      Record a trace point, from a task or an interrupt. Use TRACE
+ *             instead, which is compiled out without ADCS_TRACE.
+ *
+ * @param[in]  point  The TracePoint
+ * @param[in]  tag    Tag shared by the trace points of one pass through a
+ *                    path, e.g. the sequence number of a sample
+ */
+void traceEvent(uint8_t point, uint16_t tag)
+{
+	uint8_t task = TRACE_TASK_ISR;
+
+	if (!xPortIsInsideInterrupt() && xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+		task = (uint8_t)pxGetCurrentTaskNumber();
+
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+	if (tracing)
+		trace_buf.record(DWT->CYCCNT, point, task, tag);
+	taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+/**
+ * @brief      Print the trace on SERCOM_USB in the format of Trace.h, then
+ *             start over with an empty buffer. Nothing is recorded while the
+ *             dump is printed.
+ */
+void dumpTrace(void)
+{
+	static TaskStatus_t tasks[TRACE_MAX_TASKS];
+	char line[160];
+	uint8_t event[TRACE_EVENT_LEN];
+
+	taskENTER_CRITICAL();
+	tracing = false;
+	taskEXIT_CRITICAL();
+
+	sprintf(line, TRACE_LINE_TAG "begin %lu %u %lu\r\n", (unsigned long)F_CPU, (unsigned)trace_buf.size(),
+			(unsigned long)trace_buf.overwritten());
+	SERCOM_USB.print(line);
+
+	// tasks deleted since their events were recorded are left unnamed
+	UBaseType_t num_tasks = uxTaskGetSystemState(tasks, TRACE_MAX_TASKS, NULL);
+	for (UBaseType_t i = 0; i < num_tasks; i++)
+	{
+		sprintf(line, TRACE_LINE_TAG "task %lu %s\r\n", (unsigned long)tasks[i].xTaskNumber, tasks[i].pcTaskName);
+		SERCOM_USB.print(line);
+	}
+
+	for (uint16_t i = 0; i < trace_buf.size(); i += 8)
+	{
+		int n = sprintf(line, TRACE_LINE_TAG);
+
+		for (uint16_t j = i; j < i + 8 && j < trace_buf.size(); j++)
+		{
+			encodeTraceEvent(trace_buf[j], event);
+			for (uint8_t k = 0; k < TRACE_EVENT_LEN; k++)
+				n += sprintf(line + n, "%02x", event[k]);
+			line[n++] = ' ';
+		}
+
+		sprintf(line + n - 1, "\r\n");
+		SERCOM_USB.print(line);
+	}
+
+	SERCOM_USB.print(TRACE_LINE_TAG "end\r\n");
+
+	taskENTER_CRITICAL();
+	trace_buf.clear();
+	tracing = true;
+	taskEXIT_CRITICAL();
+}
+
+#endif
@@ -0,0 +1,300 @@
+/**
+ * @brief      Round trip property tests and packing benchmark for the bit
+ *             packed heartbeat. Random field values are packed with the
+ *             heartbeat schema and decoded again, values in range must come
+ *             back exact and values out of range must saturate.
+ */
+#include <unity.h>
+#include <BitPack.h>
+#include <HeartbeatSchema.h>
+#include <CRC16.h>
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+
+// size of the byte aligned ADCSdata union the schema replaces
+#define UNION_PACKET_LEN 30
+
+static std::mt19937 rng;
+
+void setUp(void)
+{
+	rng.seed(0xadc5);
+}
+
+void tearDown(void)
+{
+}
+
+static int32_t randomIn(int64_t lo, int64_t hi)
+{
+	return (int32_t)std::uniform_int_distribution<int64_t>(lo, hi)(rng);
+}
+
+static void randomValues(int32_t *values)
+{
+	for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+	{
+		const FieldSpec &spec = heartbeat_schema[f];
+		values[f] = randomIn(fieldMin(spec.bits, spec.is_signed), fieldMax(spec.bits, spec.is_signed));
+	}
+}
+
+// pack a heartbeat and append its CRC, the same bytes ADCSdata sends
+static void encode(const int32_t *values, uint8_t *packet)
+{
+	memset(packet, 0, HEARTBEAT_LEN);
+	packFields(heartbeat_schema, HB_NUM_FIELDS, values, packet);
+
+	CRC16 crcGen;
+	crcGen.add(packet, HEARTBEAT_PAYLOAD_LEN);
+	uint16_t crc = crcGen.getCRC();
+	packet[HEARTBEAT_PAYLOAD_LEN] = crc & 0xff;
+	packet[HEARTBEAT_PAYLOAD_LEN + 1] = crc >> 8;
+}
+
+void test_heartbeat_size(void)
+{
+	char msg[80];
+	snprintf(msg, sizeof(msg), "heartbeat %d bits, %d bytes with CRC (was %d)",
+			 heartbeatOffset(HB_NUM_FIELDS), HEARTBEAT_LEN, UNION_PACKET_LEN);
+	TEST_MESSAGE(msg);
+
+	// at least 20% smaller than the union
+	TEST_ASSERT_TRUE(HEARTBEAT_LEN * 5 <= UNION_PACKET_LEN * 4);
+	TEST_ASSERT_EQUAL_UINT16(heartbeatOffset(HB_NUM_FIELDS), heartbeat_offsets[HB_PD_ZNEG] + heartbeat_bits[HB_PD_ZNEG]);
+}
+
+void test_bits_roundtrip(void)
+{
+	uint8_t buf[16];
+
+	for (int i = 0; i < 10000; i++)
+	{
+		uint8_t bits = randomIn(1, 32);
+		uint16_t offset = randomIn(0, sizeof(buf) * 8 - bits);
+		uint32_t value = rng();
+
+		for (uint8_t j = 0; j < sizeof(buf); j++)
+			buf[j] = rng();
+		uint8_t before[sizeof(buf)];
+		memcpy(before, buf, sizeof(buf));
+
+		packBits(buf, offset, bits, value);
+
+		uint32_t mask = (bits == 32) ? 0xFFFFFFFF : (((uint32_t)1 << bits) - 1);
+		TEST_ASSERT_EQUAL_HEX32(value & mask, unpackBits(buf, offset, bits));
+
+		// bits outside the field are untouched
+		for (uint16_t b = 0; b < sizeof(buf) * 8; b++)
+		{
+			if (b >= offset && b < offset + bits)
+				continue;
+			TEST_ASSERT_EQUAL((before[b >> 3] >> (b & 7)) & 1, (buf[b >> 3] >> (b & 7)) & 1);
+		}
+	}
+}
+
+void test_byte_aligned_is_little_endian(void)
+{
+	uint8_t buf[4] = {0};
+	packBits(buf, 8, 16, 0x1234);
+
+	TEST_ASSERT_EQUAL_HEX8(0x00, buf[0]);
+	TEST_ASSERT_EQUAL_HEX8(0x34, buf[1]);
+	TEST_ASSERT_EQUAL_HEX8(0x12, buf[2]);
+	TEST_ASSERT_EQUAL_HEX8(0x00, buf[3]);
+}
+
+void test_heartbeat_roundtrip(void)
+{
+	int32_t values[HB_NUM_FIELDS];
+	int32_t decoded[HB_NUM_FIELDS];
+	uint8_t packet[HEARTBEAT_LEN];
+
+	for (int i = 0; i < 10000; i++)
+	{
+		randomValues(values);
+		encode(values, packet);
+
+		TEST_ASSERT_TRUE(decodeHeartbeat(packet, decoded));
+		TEST_ASSERT_EQUAL_INT32_ARRAY(values, decoded, HB_NUM_FIELDS);
+
+		// field by field, the way ADCSdata sets them, gives the same bytes
+		uint8_t fields[HEARTBEAT_PAYLOAD_LEN] = {0};
+		for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+			packField(fields, heartbeat_offsets[f], heartbeat_schema[f], values[f]);
+		TEST_ASSERT_EQUAL_HEX8_ARRAY(packet, fields, HEARTBEAT_PAYLOAD_LEN);
+	}
+}
+
+void test_saturation(void)
+{
+	int32_t values[HB_NUM_FIELDS];
+	int32_t decoded[HB_NUM_FIELDS];
+	uint8_t packet[HEARTBEAT_LEN];
+
+	for (int i = 0; i < 10000; i++)
+	{
+		for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+			values[f] = randomIn(-100000, 100000);
+		encode(values, packet);
+		decodeHeartbeat(packet, decoded);
+
+		for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+		{
+			const FieldSpec &spec = heartbeat_schema[f];
+			int64_t expected = values[f];
+			if (expected < fieldMin(spec.bits, spec.is_signed))
+				expected = fieldMin(spec.bits, spec.is_signed);
+			if (expected > fieldMax(spec.bits, spec.is_signed))
+				expected = fieldMax(spec.bits, spec.is_signed);
+
+			TEST_ASSERT_EQUAL_INT32((int32_t)expected, decoded[f]);
+		}
+	}
+}
+
+void test_status_first_byte(void)
+{
+	int32_t values[HB_NUM_FIELDS];
+	uint8_t packet[HEARTBEAT_LEN];
+
+	randomValues(values);
+	values[HB_STATUS] = 0xaa;
+	encode(values, packet);
+
+	TEST_ASSERT_EQUAL_HEX8(0xaa, packet[0]);
+}
+
+void test_physical_units(void)
+{
+	int32_t values[HB_NUM_FIELDS] = {0};
+	int32_t decoded[HB_NUM_FIELDS];
+	uint8_t packet[HEARTBEAT_LEN];
+
+	values[HB_VOLTAGE] = 41;	 // 5.125 V in fixed5_3
+	values[HB_GYRO_Y] = -12; // -1.5 dps
+	values[HB_PD_ZNEG] = 4095;
+	encode(values, packet);
+	decodeHeartbeat(packet, decoded);
+
+	TEST_ASSERT_EQUAL_FLOAT(5.125f, heartbeatValue(decoded, HB_VOLTAGE));
+	TEST_ASSERT_EQUAL_FLOAT(-1.5f, heartbeatValue(decoded, HB_GYRO_Y));
+	TEST_ASSERT_EQUAL_FLOAT(4095.0f, heartbeatValue(decoded, HB_PD_ZNEG));
+}
+
+void test_corruption_detected(void)
+{
+	int32_t values[HB_NUM_FIELDS];
+	int32_t decoded[HB_NUM_FIELDS];
+	uint8_t packet[HEARTBEAT_LEN];
+
+	for (int i = 0; i < 1000; i++)
+	{
+		randomValues(values);
+		encode(values, packet);
+
+		// any single bit error is caught by CRC16
+		uint16_t bit = randomIn(0, HEARTBEAT_LEN * 8 - 1);
+		packet[bit >> 3] ^= 1 << (bit & 7);
+
+		TEST_ASSERT_FALSE(decodeHeartbeat(packet, decoded));
+	}
+}
+
+/* BENCHMARK ================================================================ */
+
+// same fields as ADCSdata before the schema, byte aligned
+typedef union
+{
+	uint8_t data[UNION_PACKET_LEN];
+
+	struct
+	{
+		uint16_t status;
+		int8_t voltage;
+		int16_t current;
+		uint8_t freq;
+		uint8_t motor_en, buck_en, mtx1, mtx2;
+		int8_t mag[3];
+		int8_t gyro[3];
+		uint16_t pd[6];
+	};
+} UnionPacket;
+
+void test_packing_throughput(void)
+{
+	const int rounds = 200000;
+	const int sets = 64;
+	int32_t values[sets][HB_NUM_FIELDS];
+	int32_t decoded[HB_NUM_FIELDS];
+	uint8_t packet[HEARTBEAT_LEN] = {0};
+	UnionPacket u;
+	uint32_t sink = 0;
+
+	for (int s = 0; s < sets; s++)
+		randomValues(values[s]);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		packFields(heartbeat_schema, HB_NUM_FIELDS, values[r % sets], packet);
+		sink += packet[r % HEARTBEAT_PAYLOAD_LEN];
+	}
+	std::chrono::duration<double> pack = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		packet[0] = r;
+		unpackFields(heartbeat_schema, HB_NUM_FIELDS, packet, decoded);
+		sink += decoded[r % HB_NUM_FIELDS];
+	}
+	std::chrono::duration<double> unpack = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		const int32_t *v = values[r % sets];
+		u.status = v[HB_STATUS];
+		u.voltage = v[HB_VOLTAGE];
+		u.current = v[HB_CURRENT];
+		u.freq = v[HB_FREQ];
+		u.motor_en = v[HB_MOTOR_EN];
+		u.buck_en = v[HB_BUCK_EN];
+		u.mtx1 = v[HB_MTX1];
+		u.mtx2 = v[HB_MTX2];
+		for (int i = 0; i < 3; i++)
+		{
+			u.mag[i] = v[HB_MAG_X + i];
+			u.gyro[i] = v[HB_GYRO_X + i];
+		}
+		for (int i = 0; i < 6; i++)
+			u.pd[i] = v[HB_PD_XPOS + i];
+		sink += u.data[r % UNION_PACKET_LEN];
+	}
+	std::chrono::duration<double> fill = std::chrono::steady_clock::now() - start;
+
+	char msg[96];
+	snprintf(msg, sizeof(msg), "pack %.1f ns/heartbeat, unpack %.1f ns/heartbeat, union fill %.1f ns (%u)",
+			 pack.count() * 1e9 / rounds, unpack.count() * 1e9 / rounds, fill.count() * 1e9 / rounds, sink & 1);
+	TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_heartbeat_size);
+	RUN_TEST(test_bits_roundtrip);
+	RUN_TEST(test_byte_aligned_is_little_endian);
+	RUN_TEST(test_heartbeat_roundtrip);
+	RUN_TEST(test_saturation);
+	RUN_TEST(test_status_first_byte);
+	RUN_TEST(test_physical_units);
+	RUN_TEST(test_corruption_detected);
+	RUN_TEST(test_packing_throughput);
+	return UNITY_END();
+}
@@ -0,0 +1,267 @@
+/**
+ * @brief      Tests for the capture scanner behind tools/capture_decoder.
+ *             Synthetic captures of heartbeats, IMU batch frames and noise are
+ *             scanned whole and in chunks, every frame must be found once at
+ *             its offset.
+ */
+#include <unity.h>
+#include <CaptureScanner.h>
+
+#include <random>
+#include <vector>
+#include <string.h>
+
+static std::mt19937 rng;
+static StatusSet status(heartbeat_status_codes, sizeof(heartbeat_status_codes));
+
+typedef struct
+{
+	uint64_t offset;
+	bool heartbeat;
+} Frame;
+
+/**
+ * @brief      Records every frame the scanner reports
+ */
+class FrameLog
+{
+public:
+	std::vector<Frame> frames;
+
+	void heartbeat(uint64_t pos, const uint8_t *frame)
+	{
+		int32_t fast[HB_NUM_FIELDS], slow[HB_NUM_FIELDS];
+		unpackHeartbeat(frame, fast);
+		unpackFields(heartbeat_schema, HB_NUM_FIELDS, frame, slow);
+		TEST_ASSERT_EQUAL_INT32_ARRAY(slow, fast, HB_NUM_FIELDS);
+
+		Frame f = {pos, true};
+		frames.push_back(f);
+	}
+
+	void batch(uint64_t pos, const uint8_t *frame, uint8_t len)
+	{
+		TEST_ASSERT_EQUAL_UINT8(frame[1], len);
+
+		Frame f = {pos, false};
+		frames.push_back(f);
+	}
+};
+
+void setUp(void)
+{
+	rng.seed(0xadc5);
+}
+
+void tearDown(void)
+{
+}
+
+static void addHeartbeat(std::vector<uint8_t> &capture)
+{
+	int32_t values[HB_NUM_FIELDS];
+	uint8_t packet[HEARTBEAT_LEN] = {0};
+
+	for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+		values[f] = (int32_t)(rng() & 0xff);
+	values[HB_STATUS] = heartbeat_status_codes[rng() % sizeof(heartbeat_status_codes)];
+
+	packFields(heartbeat_schema, HB_NUM_FIELDS, values, packet);
+	uint16_t crc = capture_crc::calculate(packet, HEARTBEAT_PAYLOAD_LEN);
+	packet[HEARTBEAT_PAYLOAD_LEN] = crc & 0xff;
+	packet[HEARTBEAT_PAYLOAD_LEN + 1] = crc >> 8;
+
+	capture.insert(capture.end(), packet, packet + HEARTBEAT_LEN);
+}
+
+static void addBatch(std::vector<uint8_t> &capture)
+{
+	SampleBatchEncoder<128> encoder(8);
+	BatchSample s;
+
+	encoder.begin(5);
+	for (uint32_t i = 0; i < 1 + rng() % 8; i++)
+	{
+		for (uint8_t c = 0; c < BATCH_CHANNELS; c++)
+			s.v[c] = (int16_t)(rng() % 200);
+		encoder.add(s, i * 5);
+	}
+
+	uint8_t len;
+	const uint8_t *frame = encoder.finish(len);
+	capture.insert(capture.end(), frame, frame + len);
+}
+
+/**
+ * @brief      Random capture, returns the frames it holds
+ *
+ * @param[in]  noise  Add random bytes between some frames
+ */
+static std::vector<Frame> makeCapture(std::vector<uint8_t> &capture, size_t frames, bool noise, uint64_t &noise_bytes)
+{
+	std::vector<Frame> expected;
+	noise_bytes = 0;
+
+	for (size_t i = 0; i < frames; i++)
+	{
+		if (noise && rng() % 8 == 0)
+		{
+			// never a status code or batch id, so noise cannot start a frame
+			uint8_t n = 1 + rng() % 5;
+			for (uint8_t k = 0; k < n; k++)
+				capture.push_back(0x11 + rng() % 0x40);
+			noise_bytes += n;
+		}
+
+		Frame f = {capture.size(), rng() % 4 != 0};
+		expected.push_back(f);
+
+		if (f.heartbeat)
+			addHeartbeat(capture);
+		else
+			addBatch(capture);
+	}
+
+	return expected;
+}
+
+static void assertFrames(const std::vector<Frame> &expected, const std::vector<Frame> &found)
+{
+	TEST_ASSERT_EQUAL_UINT32(expected.size(), found.size());
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		TEST_ASSERT_EQUAL_UINT32(expected[i].offset, found[i].offset);
+		TEST_ASSERT_EQUAL(expected[i].heartbeat, found[i].heartbeat);
+	}
+}
+
+void test_clean_capture(void)
+{
+	std::vector<uint8_t> capture;
+	uint64_t noise;
+	std::vector<Frame> expected = makeCapture(capture, 2000, false, noise);
+
+	FrameLog log;
+	CaptureStats stats = scanCapture(capture.data(), capture.size(), 0, capture.size(), status, log);
+
+	assertFrames(expected, log.frames);
+	TEST_ASSERT_EQUAL_UINT32(0, stats.bad_bytes);
+	TEST_ASSERT_EQUAL_UINT32(expected.size(), stats.heartbeats + stats.batches);
+}
+
+void test_noise_between_frames(void)
+{
+	std::vector<uint8_t> capture;
+	uint64_t noise;
+	std::vector<Frame> expected = makeCapture(capture, 2000, true, noise);
+
+	FrameLog log;
+	CaptureStats stats = scanCapture(capture.data(), capture.size(), 0, capture.size(), status, log);
+
+	assertFrames(expected, log.frames);
+	TEST_ASSERT_EQUAL_UINT32(noise, stats.bad_bytes);
+}
+
+void test_corrupt_frames_skipped(void)
+{
+	std::vector<uint8_t> capture;
+	uint64_t noise;
+	std::vector<Frame> expected = makeCapture(capture, 400, false, noise);
+
+	// flip a bit inside every 10th heartbeat
+	std::vector<Frame> kept;
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		if (expected[i].heartbeat && i % 10 == 0)
+			capture[expected[i].offset + 1 + rng() % (HEARTBEAT_LEN - 1)] ^= 1 << (rng() % 8);
+		else
+			kept.push_back(expected[i]);
+	}
+
+	FrameLog log;
+	scanCapture(capture.data(), capture.size(), 0, capture.size(), status, log);
+
+	assertFrames(kept, log.frames);
+}
+
+void test_chunks_match_whole_scan(void)
+{
+	std::vector<uint8_t> capture;
+	uint64_t noise;
+	makeCapture(capture, 5000, true, noise);
+
+	FrameLog whole;
+	CaptureStats total = scanCapture(capture.data(), capture.size(), 0, capture.size(), status, whole);
+
+	for (int round = 0; round < 20; round++)
+	{
+		FrameLog chunked;
+		CaptureStats sum = {0, 0, 0};
+		size_t begin = 0;
+
+		while (begin < capture.size())
+		{
+			size_t end = begin + 1 + rng() % 4000;
+			CaptureStats s = scanCapture(capture.data(), capture.size(), begin, end, status, chunked);
+			sum.heartbeats += s.heartbeats;
+			sum.batches += s.batches;
+			sum.bad_bytes += s.bad_bytes;
+			begin = end;
+		}
+
+		assertFrames(whole.frames, chunked.frames);
+		TEST_ASSERT_EQUAL_UINT32(total.heartbeats, sum.heartbeats);
+		TEST_ASSERT_EQUAL_UINT32(total.batches, sum.batches);
+		TEST_ASSERT_EQUAL_UINT32(total.bad_bytes, sum.bad_bytes);
+	}
+}
+
+void test_heartbeat_run(void)
+{
+	std::vector<uint8_t> capture;
+	for (int i = 0; i < CAPTURE_LANES; i++)
+		addHeartbeat(capture);
+
+	TEST_ASSERT_EQUAL_UINT8(CAPTURE_LANES, heartbeatRun(capture.data(), capture.size(), status));
+
+	// the run stops at the first bad frame
+	capture[2 * HEARTBEAT_LEN + 5] ^= 0x10;
+	TEST_ASSERT_EQUAL_UINT8(2, heartbeatRun(capture.data(), capture.size(), status));
+
+	capture[5] ^= 0x10;
+	TEST_ASSERT_EQUAL_UINT8(0, heartbeatRun(capture.data(), capture.size(), status));
+
+	// truncated frame at the end of the capture
+	TEST_ASSERT_EQUAL_UINT8(0, heartbeatRun(capture.data() + HEARTBEAT_LEN, HEARTBEAT_LEN - 1, status));
+}
+
+void test_zero_bytes_not_heartbeats(void)
+{
+	std::vector<uint8_t> capture;
+	uint64_t noise;
+	std::vector<Frame> expected = makeCapture(capture, 20, false, noise);
+
+	// the logger filled a gap with zeros, they pass the CRC with status 0x00
+	size_t gap = 8 * HEARTBEAT_LEN + 3;
+	capture.insert(capture.end(), gap, 0);
+	std::vector<Frame> more = makeCapture(capture, 20, false, noise);
+	expected.insert(expected.end(), more.begin(), more.end());
+
+	FrameLog log;
+	CaptureStats stats = scanCapture(capture.data(), capture.size(), 0, capture.size(), status, log);
+
+	assertFrames(expected, log.frames);
+	TEST_ASSERT_EQUAL_UINT32(gap, stats.bad_bytes);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_clean_capture);
+	RUN_TEST(test_noise_between_frames);
+	RUN_TEST(test_corrupt_frames_skipped);
+	RUN_TEST(test_chunks_match_whole_scan);
+	RUN_TEST(test_heartbeat_run);
+	RUN_TEST(test_zero_bytes_not_heartbeats);
+	return UNITY_END();
+}
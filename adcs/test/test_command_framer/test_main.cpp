@@ -0,0 +1,299 @@
+/**
+ * @brief      Fuzz and benchmark harness for the self-resynchronizing command
+ *             framer. Streams of valid commands are corrupted with dropped,
+ *             inserted and bit flipped bytes, then fed through the framer to
+ *             check that alignment is recovered within one frame and to
+ *             measure recovery time and throughput.
+ */
+#include <unity.h>
+#include <CommandFramer.h>
+#include <CRC16.h>
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#define COMMAND_LEN 4
+
+// arbitrary command values
+#define CMD_A 0xa0
+#define CMD_B 0xa1
+#define CMD_C 0xc0
+
+typedef CommandFramer<COMMAND_LEN> Framer;
+
+static std::mt19937 rng;
+
+void setUp(void)
+{
+	rng.seed(0xadc5);
+}
+
+void tearDown(void)
+{
+}
+
+// build a command frame with its CRC16, laid out like TEScommand
+static void appendCommand(std::vector<uint8_t> &stream, uint8_t cmd, uint8_t arg)
+{
+	uint8_t payload[2] = {cmd, arg};
+	CRC16 crcGen;
+	crcGen.add(payload, 2);
+	uint16_t crc = crcGen.getCRC();
+
+	stream.push_back(cmd);
+	stream.push_back(arg);
+	stream.push_back(crc & 0xff);
+	stream.push_back(crc >> 8);
+}
+
+static std::vector<uint8_t> randomCommands(int n)
+{
+	std::vector<uint8_t> stream;
+
+	for (int i = 0; i < n; i++)
+		appendCommand(stream, rng() & 0xff, rng() & 0xff);
+
+	return stream;
+}
+
+static int countFrames(Framer &framer, const std::vector<uint8_t> &stream)
+{
+	int frames = 0;
+
+	for (size_t i = 0; i < stream.size(); i++)
+	{
+		if (framer.push(stream[i]) == FRAMER_FRAME)
+			frames++;
+	}
+
+	return frames;
+}
+
+void test_clean_stream(void)
+{
+	Framer framer;
+	std::vector<uint8_t> stream = randomCommands(1000);
+
+	TEST_ASSERT_EQUAL(1000, countFrames(framer, stream));
+	TEST_ASSERT_EQUAL_UINT32(0, framer.stats().crc_failures);
+	TEST_ASSERT_EQUAL_UINT32(0, framer.stats().resyncs);
+	TEST_ASSERT_EQUAL_UINT32(0, framer.stats().bytes_discarded);
+}
+
+void test_dropped_byte_recovers_next_frame(void)
+{
+	Framer framer;
+	std::vector<uint8_t> stream;
+
+	appendCommand(stream, CMD_A, 0);
+	appendCommand(stream, CMD_B, 0);
+	appendCommand(stream, CMD_C, 0);
+	stream.erase(stream.begin() + 5); // second frame loses a byte
+
+	std::vector<uint8_t> got;
+	for (size_t i = 0; i < stream.size(); i++)
+	{
+		if (framer.push(stream[i]) == FRAMER_FRAME)
+			got.push_back(framer.frame()[0]);
+	}
+
+	TEST_ASSERT_EQUAL(2, got.size());
+	TEST_ASSERT_EQUAL_UINT8(CMD_A, got[0]);
+	TEST_ASSERT_EQUAL_UINT8(CMD_C, got[1]);
+	TEST_ASSERT_EQUAL_UINT32(1, framer.stats().crc_failures);
+	TEST_ASSERT_EQUAL_UINT32(1, framer.stats().resyncs);
+	TEST_ASSERT_EQUAL_UINT32(3, framer.stats().bytes_discarded);
+	TEST_ASSERT_TRUE(framer.synced());
+}
+
+void test_inserted_byte_recovers_same_frame(void)
+{
+	Framer framer;
+	std::vector<uint8_t> stream;
+
+	appendCommand(stream, CMD_A, 0);
+	stream.push_back(0x55); // line noise between frames
+	appendCommand(stream, CMD_B, 0);
+
+	TEST_ASSERT_EQUAL(2, countFrames(framer, stream));
+	TEST_ASSERT_EQUAL_UINT32(1, framer.stats().bytes_discarded);
+}
+
+void test_crc_error_reported_once(void)
+{
+	Framer framer;
+	std::vector<uint8_t> stream;
+	int errors = 0;
+
+	appendCommand(stream, CMD_A, 0);
+	appendCommand(stream, CMD_B, 0);
+	stream[1] ^= 0x10;
+
+	for (size_t i = 0; i < stream.size(); i++)
+	{
+		if (framer.push(stream[i]) == FRAMER_CRC_ERROR)
+			errors++;
+	}
+
+	TEST_ASSERT_EQUAL(1, errors);
+	TEST_ASSERT_EQUAL_UINT32(1, framer.stats().frames);
+}
+
+/**
+ * Corrupt a long stream with random drops, insertions and bit flips that are
+ * at least two frames apart. Every frame that was not touched by corruption
+ * and is not the frame directly after it must be delivered.
+ */
+void test_fuzz_recovery(void)
+{
+	const int NUM_FRAMES = 20000;
+	std::vector<uint8_t> clean = randomCommands(NUM_FRAMES);
+	std::vector<uint8_t> stream;
+	std::vector<bool> damaged(NUM_FRAMES, false);
+
+	int next_fault = 2 * COMMAND_LEN;
+	for (int i = 0; i < (int)clean.size(); i++)
+	{
+		if (i != next_fault)
+		{
+			stream.push_back(clean[i]);
+			continue;
+		}
+
+		int f = i / COMMAND_LEN;
+		damaged[f] = true;
+		if (f + 1 < NUM_FRAMES)
+			damaged[f + 1] = true; // inserted bytes can land on the next frame
+
+		switch (rng() % 3)
+		{
+			case 0: // drop
+				break;
+			case 1: // insert
+				stream.push_back(rng() & 0xff);
+				stream.push_back(clean[i]);
+				break;
+			default: // flip
+				stream.push_back(clean[i] ^ (1 << (rng() % 8)));
+				break;
+		}
+
+		next_fault = i + 2 * COMMAND_LEN + (rng() % (8 * COMMAND_LEN));
+	}
+
+	int undamaged = 0;
+	for (int f = 0; f < NUM_FRAMES; f++)
+		undamaged += damaged[f] ? 0 : 1;
+
+	Framer framer;
+	std::vector<uint8_t> seen(256 * 256, 0);
+	for (size_t i = 0; i < stream.size(); i++)
+	{
+		if (framer.push(stream[i]) == FRAMER_FRAME)
+			seen[framer.frame()[0] << 8 | framer.frame()[1]]++;
+	}
+
+	int recovered = 0;
+	for (int f = 0; f < NUM_FRAMES; f++)
+	{
+		if (!damaged[f] && seen[clean[4 * f] << 8 | clean[4 * f + 1]])
+			recovered++;
+	}
+
+	char msg[160];
+	snprintf(msg, sizeof(msg), "%d/%d undamaged frames recovered, %lu resyncs, %lu CRC failures, %lu bytes discarded",
+			 recovered, undamaged,
+			 (unsigned long)framer.stats().resyncs,
+			 (unsigned long)framer.stats().crc_failures,
+			 (unsigned long)framer.stats().bytes_discarded);
+	TEST_MESSAGE(msg);
+
+	// a 16 bit CRC over a 2 byte payload lets through roughly 1 in 65536
+	// misaligned windows, so allow a tiny number of false syncs
+	TEST_ASSERT_GREATER_OR_EQUAL(undamaged - undamaged / 1000, recovered);
+	TEST_ASSERT_EQUAL_UINT32(framer.stats().crc_failures, framer.stats().resyncs + (framer.synced() ? 0 : 1));
+}
+
+/**
+ * Measure the number of bytes between a single dropped byte and the next
+ * frame delivered, averaged over many trials.
+ */
+void test_benchmark_recovery_time(void)
+{
+	const int TRIALS = 10000;
+	unsigned long total = 0;
+	unsigned long worst = 0;
+
+	for (int t = 0; t < TRIALS; t++)
+	{
+		Framer framer;
+		std::vector<uint8_t> stream = randomCommands(4);
+		stream.erase(stream.begin() + COMMAND_LEN + (rng() % COMMAND_LEN));
+
+		unsigned long bytes = 0;
+		bool lost = false;
+		for (size_t i = 0; i < stream.size(); i++)
+		{
+			FramerResult r = framer.push(stream[i]);
+			if (r == FRAMER_CRC_ERROR)
+				lost = true;
+			if (lost)
+				bytes++;
+			if (lost && r == FRAMER_FRAME)
+				break;
+		}
+
+		total += bytes;
+		if (bytes > worst)
+			worst = bytes;
+	}
+
+	char msg[96];
+	snprintf(msg, sizeof(msg), "recovery after a dropped byte: %.2f bytes average, %lu bytes worst case",
+			 (double)total / TRIALS, worst);
+	TEST_MESSAGE(msg);
+
+	TEST_ASSERT_LESS_OR_EQUAL(2 * COMMAND_LEN, worst);
+}
+
+void test_benchmark_throughput(void)
+{
+	std::vector<uint8_t> clean = randomCommands(250000);
+	std::vector<uint8_t> noisy = clean;
+
+	for (size_t i = 0; i < noisy.size(); i += 97)
+		noisy[i] ^= 0x01; // roughly one bit error per 24 frames
+
+	const std::vector<uint8_t> *streams[2] = {&clean, &noisy};
+	const char *names[2] = {"clean", "noisy"};
+
+	for (int s = 0; s < 2; s++)
+	{
+		Framer framer;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int frames = countFrames(framer, *streams[s]);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		char msg[96];
+		snprintf(msg, sizeof(msg), "%s stream: %d frames, %.1f MB/s",
+				 names[s], frames, streams[s]->size() / elapsed.count() / 1e6);
+		TEST_MESSAGE(msg);
+
+		TEST_ASSERT_GREATER_THAN(0, frames);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_clean_stream);
+	RUN_TEST(test_dropped_byte_recovers_next_frame);
+	RUN_TEST(test_inserted_byte_recovers_same_frame);
+	RUN_TEST(test_crc_error_reported_once);
+	RUN_TEST(test_fuzz_recovery);
+	RUN_TEST(test_benchmark_recovery_time);
+	RUN_TEST(test_benchmark_throughput);
+	return UNITY_END();
+}
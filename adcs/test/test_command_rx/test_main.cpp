@@ -0,0 +1,208 @@
+/**
+ * @brief      Host tests for the interrupt driven command receive path. Bytes
+ *             are pushed into the ring buffer the way the UART interrupt does
+ *             and drained through the framer the way receiveCommand does.
+ */
+#include <unity.h>
+#include <SPSCRingBuffer.h>
+#include <CommandFramer.h>
+#include <CRC16.h>
+
+#include <thread>
+#include <vector>
+
+#define COMMAND_LEN 4
+
+static SPSCRingBuffer<uint8_t, 64> *ring;
+
+void setUp(void)
+{
+	ring = new SPSCRingBuffer<uint8_t, 64>();
+}
+
+void tearDown(void)
+{
+	delete ring;
+}
+
+// append a command with its CRC16, laid out like TEScommand
+static void pushCommand(uint8_t cmd)
+{
+	uint8_t payload[2] = {cmd, 0x00};
+	CRC16 crcGen;
+	crcGen.add(payload, 2);
+	uint16_t crc = crcGen.getCRC();
+
+	ring->push(payload[0]);
+	ring->push(payload[1]);
+	ring->push(crc & 0xff);
+	ring->push(crc >> 8);
+}
+
+// drain the ring buffer through a framer and collect the completed frames
+static std::vector<std::vector<uint8_t> > drain(CommandFramer<COMMAND_LEN> &framer)
+{
+	std::vector<std::vector<uint8_t> > frames;
+	uint8_t b;
+
+	while (ring->pop(b))
+	{
+		if (framer.push(b) == FRAMER_FRAME)
+			frames.push_back(std::vector<uint8_t>(framer.frame(), framer.frame() + COMMAND_LEN));
+	}
+
+	return frames;
+}
+
+void test_ring_fifo_order(void)
+{
+	uint8_t b;
+
+	for (int i = 0; i < 10; i++)
+		TEST_ASSERT_TRUE(ring->push(i));
+
+	TEST_ASSERT_EQUAL_UINT16(10, ring->available());
+
+	for (int i = 0; i < 10; i++)
+	{
+		TEST_ASSERT_TRUE(ring->pop(b));
+		TEST_ASSERT_EQUAL_UINT8(i, b);
+	}
+
+	TEST_ASSERT_FALSE(ring->pop(b));
+	TEST_ASSERT_TRUE(ring->empty());
+}
+
+void test_ring_full_drops(void)
+{
+	for (int i = 0; i < 64; i++)
+		TEST_ASSERT_TRUE(ring->push(i));
+
+	TEST_ASSERT_FALSE(ring->push(0xff));
+	TEST_ASSERT_EQUAL_UINT32(1, ring->dropped());
+	TEST_ASSERT_EQUAL_UINT16(64, ring->available());
+}
+
+void test_ring_index_wraparound(void)
+{
+	uint8_t b;
+
+	// run the free running 16 bit indices past their overflow point
+	for (uint32_t i = 0; i < 70000; i++)
+	{
+		TEST_ASSERT_TRUE(ring->push((uint8_t)i));
+		TEST_ASSERT_TRUE(ring->pop(b));
+		TEST_ASSERT_EQUAL_UINT8((uint8_t)i, b);
+	}
+
+	TEST_ASSERT_TRUE(ring->empty());
+}
+
+void test_framer_splits_commands(void)
+{
+	CommandFramer<COMMAND_LEN> framer;
+
+	pushCommand(0xa0);
+	pushCommand(0xc0);
+
+	std::vector<std::vector<uint8_t> > frames = drain(framer);
+
+	TEST_ASSERT_EQUAL(2, frames.size());
+	TEST_ASSERT_EQUAL_UINT8(0xa0, frames[0][0]);
+	TEST_ASSERT_EQUAL_UINT8(0xc0, frames[1][0]);
+	TEST_ASSERT_FALSE(framer.partial());
+}
+
+void test_framer_partial_then_reset(void)
+{
+	CommandFramer<COMMAND_LEN> framer;
+	uint8_t b;
+
+	// first command is cut short, receiveCommand resets after the timeout
+	pushCommand(0xa0);
+	ring->pop(b);
+	ring->pop(b);
+	TEST_ASSERT_EQUAL(0, drain(framer).size());
+	TEST_ASSERT_TRUE(framer.partial());
+
+	TEST_ASSERT_TRUE(framer.reset());
+	TEST_ASSERT_EQUAL_UINT32(2, framer.stats().bytes_discarded);
+
+	pushCommand(0xa1);
+
+	std::vector<std::vector<uint8_t> > frames = drain(framer);
+	TEST_ASSERT_EQUAL(1, frames.size());
+	TEST_ASSERT_EQUAL_UINT8(0xa1, frames[0][0]);
+}
+
+void test_bad_frame_then_timeout_one_error(void)
+{
+	CommandFramer<COMMAND_LEN> framer;
+	std::vector<uint8_t> bytes;
+	uint8_t b;
+	int errors = 0;
+
+	pushCommand(0xa0);
+	while (ring->pop(b))
+		bytes.push_back(b);
+	bytes[1] ^= 0x10;
+
+	// receiveCommand answers every FRAMER_CRC_ERROR, and a timeout only when
+	// reset() drops an unreported frame
+	for (size_t i = 0; i < bytes.size(); i++)
+	{
+		if (framer.push(bytes[i]) == FRAMER_CRC_ERROR)
+			errors++;
+	}
+	TEST_ASSERT_TRUE(framer.partial());
+
+	if (framer.reset())
+		errors++;
+	TEST_ASSERT_EQUAL(1, errors);
+
+	// the next command starts a frame again and is delivered
+	pushCommand(0xa1);
+
+	std::vector<std::vector<uint8_t> > frames = drain(framer);
+	TEST_ASSERT_EQUAL(1, frames.size());
+	TEST_ASSERT_EQUAL_UINT8(0xa1, frames[0][0]);
+	TEST_ASSERT_TRUE(framer.synced());
+}
+
+void test_concurrent_producer_consumer(void)
+{
+	const uint32_t N = 100000;
+	bool in_order = true;
+
+	std::thread producer([&]() {
+		for (uint32_t i = 0; i < N; i++)
+			while (!ring->push((uint8_t)i))
+				std::this_thread::yield();
+	});
+
+	uint8_t b;
+	for (uint32_t i = 0; i < N; i++)
+	{
+		while (!ring->pop(b))
+			std::this_thread::yield();
+		if (b != (uint8_t)i)
+			in_order = false;
+	}
+
+	producer.join();
+	TEST_ASSERT_TRUE(in_order);
+	TEST_ASSERT_TRUE(ring->empty());
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_ring_fifo_order);
+	RUN_TEST(test_ring_full_drops);
+	RUN_TEST(test_ring_index_wraparound);
+	RUN_TEST(test_framer_splits_commands);
+	RUN_TEST(test_framer_partial_then_reset);
+	RUN_TEST(test_bad_frame_then_timeout_one_error);
+	RUN_TEST(test_concurrent_producer_consumer);
+	return UNITY_END();
+}
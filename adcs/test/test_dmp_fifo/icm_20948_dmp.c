@@ -0,0 +1,7 @@
+/**
+ * @brief      The C interface of the ICM-20948 driver with its DMP support, so
+ *             the tests can check DMPFifo.h against the packet parser of the
+ *             driver. See test_icm_agmt/icm_20948_c.c.
+ */
+#define ICM_20948_USE_DMP
+#include "ICM_20948_C.c"
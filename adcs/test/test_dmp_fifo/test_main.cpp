@@ -0,0 +1,394 @@
+/**
+ * @brief      Tests for the DMP packet parser and its burst reader, against
+ *             packets laid out the way the DMP writes them with the outputs
+ *             the ADCS enables, and against the packet parser of the driver.
+ */
+#include <unity.h>
+#include <string.h>
+#include <DMPFifo.h>
+#include <ICM_20948_C.h>
+
+// gyroscope, both quaternions, calibrated gyroscope and magnetometer, with
+// their accuracies, as readIMU enables them
+static const uint8_t PACKET_ADCS[] = {
+	0x4c, 0x68, 0x30, 0x00,										// headers
+	0x01, 0x23, 0xff, 0xfe, 0x80, 0x00, 0x00, 0x05, 0xff, 0xf9, 0x00, 0x00, // gyro, bias
+	0x20, 0x00, 0x00, 0x00, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // quat6
+	0x10, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0xf0, 0x00, 0x00, 0x00, // quat9
+	0x00, 0xc8,																// heading accuracy
+	0x00, 0x14, 0x00, 0x00, 0xff, 0xfb, 0x00, 0x00, 0xff, 0xd7, 0x80, 0x00, // compass calibr
+	0x00, 0x03, 0x00, 0x02,													// gyro, compass accuracy
+	0x00, 0x07,																// footer
+};
+
+// only the 9 axis quaternion, as when its output rate is lower than the others
+static const uint8_t PACKET_QUAT9[] = {
+	0x04, 0x08, 0x10, 0x00,
+	0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x01, 0x00,
+	0x00, 0x03,
+	0x00, 0x08,
+};
+
+// only the gyroscope, without the second header
+static const uint8_t PACKET_GYRO[] = {
+	0x40, 0x00,
+	0x7f, 0xff, 0x00, 0x01, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x09,
+};
+
+// outputs the ADCS does not use around a quaternion: accelerometer, light,
+// pressure, step detector, pickup and activity
+static const uint8_t PACKET_OTHERS[] = {
+	0x94, 0x98, 0x44, 0x80,
+	0x11, 0x11, 0x22, 0x22, 0x33, 0x33,
+	0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8,
+	0x08, 0x00, 0x00, 0x00, 0xf8, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x2a,
+	0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+	0xc1, 0xc2, 0xc3, 0xc4,
+	0x00, 0x01,
+	0x00, 0x02,
+	0x01, 0x20, 0xd1, 0xd2, 0xd3, 0xd4,
+	0x00, 0x0a,
+};
+
+/**
+ * @brief      FIFO of the IMU behind the bus of DMPFifoReader and the serial
+ *             interface of the driver
+ */
+class MockICM
+{
+public:
+	uint8_t fifo[2 * ICM_FIFO_SIZE];
+	uint16_t len;
+	uint32_t transfers;
+	bool fail_data; // the next FIFO data read fails after taking the bytes
+	uint8_t countl; // latched by reading the high byte, for the driver
+
+	MockICM() : len(0), transfers(0), fail_data(false), countl(0) {}
+
+	void push(const uint8_t *data, uint16_t n)
+	{
+		memcpy(fifo + len, data, n);
+		len += n;
+	}
+
+	bool read(uint8_t reg, uint8_t *data, uint16_t n)
+	{
+		transfers++;
+
+		if (reg == ICM_FIFO_COUNTH && n == 2)
+		{
+			data[0] = len >> 8;
+			data[1] = len & 0xff;
+			return true;
+		}
+		if (reg == ICM_FIFO_R_W && n <= len)
+		{
+			memcpy(data, fifo, n);
+			memmove(fifo, fifo + n, len - n);
+			len -= n;
+
+			bool ok = !fail_data;
+			fail_data = false;
+			return ok;
+		}
+		return false;
+	}
+
+	bool write(uint8_t reg, const uint8_t *data, uint16_t n)
+	{
+		transfers++;
+
+		if (reg == ICM_FIFO_RST && (data[0] & 0x1f) == 0x1f)
+			len = 0;
+		return true;
+	}
+};
+
+static MockICM icm;
+static ICM_20948_Device_t dev;
+
+static ICM_20948_Status_e driverWrite(uint8_t reg, uint8_t *data, uint32_t len, void *user)
+{
+	return ICM_20948_Stat_Ok; // bank select
+}
+
+static ICM_20948_Status_e driverRead(uint8_t reg, uint8_t *data, uint32_t len, void *user)
+{
+	// the driver reads the count one byte at a time
+	if (reg == AGB0_REG_FIFO_COUNT_H && len == 1)
+	{
+		data[0] = icm.len >> 8;
+		icm.countl = icm.len & 0xff;
+		return ICM_20948_Stat_Ok;
+	}
+	if (reg == AGB0_REG_FIFO_COUNT_L && len == 1)
+	{
+		data[0] = icm.countl;
+		return ICM_20948_Stat_Ok;
+	}
+	return icm.read(reg, data, len) ? ICM_20948_Stat_Ok : ICM_20948_Stat_Err;
+}
+
+static const ICM_20948_Serif_t driverSerif = {driverWrite, driverRead, NULL};
+
+void setUp(void)
+{
+	icm = MockICM();
+
+	ICM_20948_init_struct(&dev);
+	ICM_20948_link_serif(&dev, &driverSerif);
+	dev._dmp_firmware_available = true;
+}
+
+void tearDown(void)
+{
+}
+
+void test_parse_adcs_packet(void)
+{
+	DMPPacket p;
+
+	TEST_ASSERT_EQUAL_UINT16(sizeof(PACKET_ADCS), parseDMPPacket(PACKET_ADCS, sizeof(PACKET_ADCS), &p));
+	TEST_ASSERT_EQUAL_HEX16(0x4c68, p.header);
+	TEST_ASSERT_EQUAL_HEX16(0x3000, p.header2);
+
+	TEST_ASSERT_EQUAL_INT16(0x0123, p.gyro[0]);
+	TEST_ASSERT_EQUAL_INT16(-2, p.gyro[1]);
+	TEST_ASSERT_EQUAL_INT16(-32768, p.gyro[2]);
+	TEST_ASSERT_EQUAL_INT16(5, p.gyro_bias[0]);
+	TEST_ASSERT_EQUAL_INT16(-7, p.gyro_bias[1]);
+	TEST_ASSERT_EQUAL_INT16(0, p.gyro_bias[2]);
+
+	TEST_ASSERT_EQUAL_INT32(1 << 29, p.quat6[0]);
+	TEST_ASSERT_EQUAL_INT32(-(1 << 29), p.quat6[1]);
+	TEST_ASSERT_EQUAL_INT32(1 << 28, p.quat9[0]);
+	TEST_ASSERT_EQUAL_INT32(1 << 29, p.quat9[1]);
+	TEST_ASSERT_EQUAL_INT32(-(1 << 28), p.quat9[2]);
+	TEST_ASSERT_EQUAL_INT16(200, p.quat9_accuracy);
+
+	// 20, -5 and -40.5 uT
+	TEST_ASSERT_EQUAL_INT32(20 << 16, p.compass[0]);
+	TEST_ASSERT_EQUAL_INT32(-5 * 65536, p.compass[1]);
+	TEST_ASSERT_EQUAL_INT32(-81 * 32768, p.compass[2]);
+
+	TEST_ASSERT_EQUAL_UINT16(0, p.accuracy[0]);
+	TEST_ASSERT_EQUAL_UINT16(3, p.accuracy[1]);
+	TEST_ASSERT_EQUAL_UINT16(2, p.accuracy[2]);
+}
+
+void test_parse_skips_other_outputs(void)
+{
+	DMPPacket p;
+
+	TEST_ASSERT_EQUAL_UINT16(sizeof(PACKET_OTHERS), parseDMPPacket(PACKET_OTHERS, sizeof(PACKET_OTHERS), &p));
+	TEST_ASSERT_EQUAL_INT32(1 << 27, p.quat9[0]);
+	TEST_ASSERT_EQUAL_INT32(-(1 << 27), p.quat9[1]);
+	TEST_ASSERT_EQUAL_INT32(1 << 26, p.quat9[2]);
+	TEST_ASSERT_EQUAL_INT16(42, p.quat9_accuracy);
+	TEST_ASSERT_EQUAL_UINT16(1, p.accuracy[0]);
+
+	// outputs not in the packet are zero
+	TEST_ASSERT_EQUAL_INT16(0, p.gyro[0]);
+	TEST_ASSERT_EQUAL_INT32(0, p.quat6[0]);
+	TEST_ASSERT_EQUAL_INT32(0, p.compass[2]);
+}
+
+void test_incomplete_packet(void)
+{
+	DMPPacket p;
+
+	// nothing is taken until the footer is there
+	for (uint16_t n = 0; n < sizeof(PACKET_ADCS); n++)
+		TEST_ASSERT_EQUAL_UINT16(0, parseDMPPacket(PACKET_ADCS, n, &p));
+	for (uint16_t n = 0; n < sizeof(PACKET_GYRO); n++)
+		TEST_ASSERT_EQUAL_UINT16(0, parseDMPPacket(PACKET_GYRO, n, &p));
+}
+
+void test_quaternion(void)
+{
+	DMPPacket p;
+	float q[4];
+
+	parseDMPPacket(PACKET_ADCS, sizeof(PACKET_ADCS), &p);
+	dmpQuaternion(p.quat9, q);
+	TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.25f, q[1]);
+	TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.5f, q[2]);
+	TEST_ASSERT_FLOAT_WITHIN(1e-6f, -0.25f, q[3]);
+	TEST_ASSERT_FLOAT_WITHIN(1e-6f, sqrtf(0.625f), q[0]);
+
+	// half a turn about x, and the rounding of a full x part
+	parseDMPPacket(PACKET_QUAT9, sizeof(PACKET_QUAT9), &p);
+	dmpQuaternion(p.quat9, q);
+	TEST_ASSERT_FLOAT_WITHIN(1e-6f, -1.0f, q[1]);
+	TEST_ASSERT_EQUAL_FLOAT(0.0f, q[0]);
+
+	const int32_t over[3] = {INT32_MAX, 0, 0};
+	dmpQuaternion(over, q);
+	TEST_ASSERT_EQUAL_FLOAT(0.0f, q[0]);
+}
+
+void test_matches_driver(void)
+{
+	const uint8_t *packets[] = {PACKET_ADCS, PACKET_QUAT9, PACKET_GYRO, PACKET_OTHERS};
+	const uint16_t lens[] = {sizeof(PACKET_ADCS), sizeof(PACKET_QUAT9), sizeof(PACKET_GYRO), sizeof(PACKET_OTHERS)};
+
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		icm_20948_DMP_data_t d;
+		DMPPacket p;
+
+		// the driver takes the packet from the FIFO one output at a time and
+		// leaves the next one there
+		icm.len = 0;
+		icm.push(packets[i], lens[i]);
+		icm.push(PACKET_GYRO, sizeof(PACKET_GYRO));
+		TEST_ASSERT_EQUAL(ICM_20948_Stat_FIFOMoreDataAvail, inv_icm20948_read_dmp_data(&dev, &d));
+		TEST_ASSERT_EQUAL_UINT16(sizeof(PACKET_GYRO), icm.len);
+
+		TEST_ASSERT_EQUAL_UINT16(lens[i], parseDMPPacket(packets[i], lens[i], &p));
+		TEST_ASSERT_EQUAL_HEX16(d.header, p.header);
+		TEST_ASSERT_EQUAL_HEX16(d.header2, p.header2);
+
+		if (p.header & DMP_HEADER_GYRO)
+		{
+			TEST_ASSERT_EQUAL_INT16(d.Raw_Gyro.Data.X, p.gyro[0]);
+			TEST_ASSERT_EQUAL_INT16(d.Raw_Gyro.Data.Y, p.gyro[1]);
+			TEST_ASSERT_EQUAL_INT16(d.Raw_Gyro.Data.Z, p.gyro[2]);
+			TEST_ASSERT_EQUAL_INT16(d.Raw_Gyro.Data.BiasX, p.gyro_bias[0]);
+			TEST_ASSERT_EQUAL_INT16(d.Raw_Gyro.Data.BiasZ, p.gyro_bias[2]);
+		}
+		if (p.header & DMP_HEADER_QUAT6)
+		{
+			TEST_ASSERT_EQUAL_INT32(d.Quat6.Data.Q1, p.quat6[0]);
+			TEST_ASSERT_EQUAL_INT32(d.Quat6.Data.Q2, p.quat6[1]);
+			TEST_ASSERT_EQUAL_INT32(d.Quat6.Data.Q3, p.quat6[2]);
+		}
+		if (p.header & DMP_HEADER_QUAT9)
+		{
+			TEST_ASSERT_EQUAL_INT32(d.Quat9.Data.Q1, p.quat9[0]);
+			TEST_ASSERT_EQUAL_INT32(d.Quat9.Data.Q2, p.quat9[1]);
+			TEST_ASSERT_EQUAL_INT32(d.Quat9.Data.Q3, p.quat9[2]);
+			TEST_ASSERT_EQUAL_INT16(d.Quat9.Data.Accuracy, p.quat9_accuracy);
+		}
+		if (p.header & DMP_HEADER_COMPASS_CALIBR)
+		{
+			TEST_ASSERT_EQUAL_INT32(d.Compass_Calibr.Data.X, p.compass[0]);
+			TEST_ASSERT_EQUAL_INT32(d.Compass_Calibr.Data.Y, p.compass[1]);
+			TEST_ASSERT_EQUAL_INT32(d.Compass_Calibr.Data.Z, p.compass[2]);
+		}
+		if (p.header2 & DMP_HEADER2_ACCEL_ACCURACY)
+			TEST_ASSERT_EQUAL_UINT16(d.Accel_Accuracy, p.accuracy[0]);
+		if (p.header2 & DMP_HEADER2_GYRO_ACCURACY)
+			TEST_ASSERT_EQUAL_UINT16(d.Gyro_Accuracy, p.accuracy[1]);
+		if (p.header2 & DMP_HEADER2_COMPASS_ACCURACY)
+			TEST_ASSERT_EQUAL_UINT16(d.Compass_Accuracy, p.accuracy[2]);
+	}
+}
+
+void test_reader_burst(void)
+{
+	DMPFifoReader<MockICM> reader(icm);
+	DMPPacket p[8];
+
+	// an empty FIFO costs the count only
+	TEST_ASSERT_EQUAL_UINT8(0, reader.read(p, 8));
+	TEST_ASSERT_EQUAL_UINT32(1, icm.transfers);
+
+	// four packets in two transfers, the driver takes about ten each
+	icm.transfers = 0;
+	icm.push(PACKET_ADCS, sizeof(PACKET_ADCS));
+	icm.push(PACKET_QUAT9, sizeof(PACKET_QUAT9));
+	icm.push(PACKET_ADCS, sizeof(PACKET_ADCS));
+	icm.push(PACKET_GYRO, sizeof(PACKET_GYRO));
+
+	TEST_ASSERT_EQUAL_UINT8(4, reader.read(p, 8));
+	TEST_ASSERT_EQUAL_UINT32(2, icm.transfers);
+	TEST_ASSERT_EQUAL_UINT16(0, icm.len);
+	TEST_ASSERT_EQUAL_HEX16(0x4c68, p[0].header);
+	TEST_ASSERT_EQUAL_HEX16(0x0408, p[1].header);
+	TEST_ASSERT_EQUAL_INT32(-(1 << 30), p[1].quat9[0]);
+	TEST_ASSERT_EQUAL_INT16(32767, p[3].gyro[0]);
+}
+
+void test_reader_partial_packet(void)
+{
+	DMPFifoReader<MockICM> reader(icm);
+	DMPPacket p[8];
+
+	// the DMP is part way through writing the second packet
+	icm.push(PACKET_QUAT9, sizeof(PACKET_QUAT9));
+	icm.push(PACKET_ADCS, 30);
+
+	TEST_ASSERT_EQUAL_UINT8(1, reader.read(p, 8));
+	TEST_ASSERT_EQUAL_UINT16(0, icm.len);
+
+	// the rest of it arrives with the next one
+	icm.push(PACKET_ADCS + 30, sizeof(PACKET_ADCS) - 30);
+	icm.push(PACKET_GYRO, sizeof(PACKET_GYRO));
+
+	TEST_ASSERT_EQUAL_UINT8(2, reader.read(p, 8));
+	TEST_ASSERT_EQUAL_INT32(20 << 16, p[0].compass[0]);
+	TEST_ASSERT_EQUAL_INT16(-7, p[0].gyro_bias[1]);
+	TEST_ASSERT_EQUAL_HEX16(0x4000, p[1].header);
+}
+
+void test_reader_room(void)
+{
+	DMPFifoReader<MockICM> reader(icm);
+	DMPPacket p[2];
+
+	// more packets than room, the others wait in the reader
+	for (uint8_t i = 0; i < 5; i++)
+		icm.push(PACKET_ADCS, sizeof(PACKET_ADCS));
+
+	TEST_ASSERT_EQUAL_UINT8(2, reader.read(p, 2));
+	TEST_ASSERT_EQUAL_UINT8(2, reader.read(p, 2));
+	TEST_ASSERT_EQUAL_UINT8(1, reader.read(p, 2));
+	TEST_ASSERT_EQUAL_UINT8(0, reader.read(p, 2));
+	TEST_ASSERT_EQUAL_INT16(200, p[0].quat9_accuracy);
+}
+
+void test_reader_overflow_resets(void)
+{
+	DMPFifoReader<MockICM> reader(icm);
+	DMPPacket p[8];
+
+	// a nearly full FIFO may have cut a packet, it is emptied with the count
+	// and two writes
+	while (icm.len <= ICM_FIFO_SIZE - DMP_PACKET_MAX_LEN)
+		icm.push(PACKET_ADCS, sizeof(PACKET_ADCS));
+
+	TEST_ASSERT_EQUAL_UINT8(0, reader.read(p, 8));
+	TEST_ASSERT_EQUAL_UINT32(1, reader.overflows());
+	TEST_ASSERT_EQUAL_UINT16(0, icm.len);
+	TEST_ASSERT_EQUAL_UINT32(3, icm.transfers);
+
+	// a failed data read drops the bytes carried over as well
+	icm.push(PACKET_ADCS, 10);
+	TEST_ASSERT_EQUAL_UINT8(0, reader.read(p, 8));
+	icm.push(PACKET_ADCS + 10, sizeof(PACKET_ADCS) - 10);
+	icm.fail_data = true;
+	TEST_ASSERT_EQUAL_UINT8(0, reader.read(p, 8));
+
+	icm.push(PACKET_GYRO, sizeof(PACKET_GYRO));
+	TEST_ASSERT_EQUAL_UINT8(1, reader.read(p, 8));
+	TEST_ASSERT_EQUAL_HEX16(0x4000, p[0].header);
+	TEST_ASSERT_EQUAL_UINT32(1, reader.overflows());
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_parse_adcs_packet);
+	RUN_TEST(test_parse_skips_other_outputs);
+	RUN_TEST(test_incomplete_packet);
+	RUN_TEST(test_quaternion);
+	RUN_TEST(test_matches_driver);
+	RUN_TEST(test_reader_burst);
+	RUN_TEST(test_reader_partial_packet);
+	RUN_TEST(test_reader_room);
+	RUN_TEST(test_reader_overflow_resets);
+	return UNITY_END();
+}
@@ -0,0 +1,246 @@
+/**
+ * @brief      Tests and conversion benchmark for the Fixed Q format template
+ *             that replaced the hand written fixed5_3_t conversions.
+ */
+#include <unity.h>
+#include <Fixed.h>
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+
+typedef Fixed<5, 3, int8_t> q5_3;
+typedef Fixed<1, 15, int16_t> q1_15;
+typedef Fixed<16, 16, int32_t> q16_16;
+typedef Fixed<4, 4, uint8_t> uq4_4;
+
+// conversions compile to constants
+static_assert(q5_3::fromFloat(1.5f).raw() == 12, "constexpr conversion");
+static_assert(q5_3::fromFloat(100.0f).raw() == 127, "constexpr saturation");
+static_assert((q5_3::fromFloat(2.0f) * q5_3::fromFloat(-1.5f)).raw() == -24, "constexpr product");
+
+// the conversions fixed5_3_t used before, kept for comparison
+static int8_t oldFloatToFixed(float f)
+{
+	int8_t fix;
+	fix = (uint8_t)(f * (1 << 3));
+	return fix;
+}
+
+static float oldFixedToFloat(int8_t fix)
+{
+	float f;
+	f = ((float)fix) / (1 << 3);
+	return f;
+}
+
+static std::mt19937 rng;
+
+void setUp(void)
+{
+	rng.seed(0xadc5);
+}
+
+void tearDown(void)
+{
+}
+
+void test_range(void)
+{
+	TEST_ASSERT_EQUAL_FLOAT(-16.0f, q5_3::min().toFloat());
+	TEST_ASSERT_EQUAL_FLOAT(15.875f, q5_3::max().toFloat());
+	TEST_ASSERT_EQUAL_FLOAT(0.125f, q5_3::lsb());
+
+	TEST_ASSERT_EQUAL_FLOAT(-1.0f, q1_15::min().toFloat());
+	TEST_ASSERT_EQUAL_FLOAT(0.0f, uq4_4::min().toFloat());
+	TEST_ASSERT_EQUAL_FLOAT(15.9375f, uq4_4::max().toFloat());
+}
+
+void test_float_saturates(void)
+{
+	// the old conversion wrapped 20 dps around to a negative rate
+	TEST_ASSERT_TRUE(oldFixedToFloat(oldFloatToFixed(20.0f)) < 0);
+
+	TEST_ASSERT_EQUAL_INT8(127, q5_3::fromFloat(20.0f).raw());
+	TEST_ASSERT_EQUAL_INT8(-128, q5_3::fromFloat(-20.0f).raw());
+	TEST_ASSERT_EQUAL_INT8(127, q5_3::fromFloat(INFINITY).raw());
+	TEST_ASSERT_EQUAL_INT8(-128, q5_3::fromFloat(-INFINITY).raw());
+	TEST_ASSERT_EQUAL_INT8(0, q5_3::fromFloat(NAN).raw());
+	TEST_ASSERT_EQUAL_INT8(0, uq4_4::fromFloat(-3.0f).raw());
+	TEST_ASSERT_EQUAL_INT32(INT32_MAX, q16_16::fromFloat(1e12f).raw());
+	TEST_ASSERT_EQUAL_INT32(INT32_MIN, q16_16::fromFloat(-1e12f).raw());
+}
+
+void test_rounding_modes(void)
+{
+	// 0.0625 is half a step of q5_3
+	TEST_ASSERT_EQUAL_INT8(1, q5_3::fromFloat(0.0625f).raw());
+	TEST_ASSERT_EQUAL_INT8(-1, q5_3::fromFloat(-0.0625f).raw());
+	TEST_ASSERT_EQUAL_INT8(0, q5_3::fromFloat(0.0624f).raw());
+
+	TEST_ASSERT_EQUAL_INT8(0, q5_3::fromFloat(0.1f, FIXED_ROUND_TRUNCATE).raw());
+	TEST_ASSERT_EQUAL_INT8(0, q5_3::fromFloat(-0.1f, FIXED_ROUND_TRUNCATE).raw());
+	TEST_ASSERT_EQUAL_INT8(0, q5_3::fromFloat(0.1f, FIXED_ROUND_FLOOR).raw());
+	TEST_ASSERT_EQUAL_INT8(-1, q5_3::fromFloat(-0.1f, FIXED_ROUND_FLOOR).raw());
+	TEST_ASSERT_EQUAL_INT8(-2, q5_3::fromFloat(-0.25f, FIXED_ROUND_FLOOR).raw());
+}
+
+void test_nearest_matches_float(void)
+{
+	for (int i = 0; i < 100000; i++)
+	{
+		float f = std::uniform_real_distribution<float>(-15.9f, 15.8f)(rng);
+		q5_3 q = q5_3::fromFloat(f);
+
+		TEST_ASSERT_TRUE(std::fabs(q.toFloat() - f) <= q5_3::lsb() / 2 + 1e-6f);
+		TEST_ASSERT_EQUAL_INT8((int8_t)std::lround(f * 8), q.raw());
+	}
+}
+
+void test_int_conversion(void)
+{
+	TEST_ASSERT_EQUAL_INT8(40, q5_3::fromInt(5).raw());
+	TEST_ASSERT_EQUAL_INT8(127, q5_3::fromInt(16).raw());
+	TEST_ASSERT_EQUAL_INT8(-128, q5_3::fromInt(-100000).raw());
+	TEST_ASSERT_EQUAL_INT32(-16, q5_3::fromInt(-16).toInt());
+
+	// integer part rounds toward minus infinity
+	TEST_ASSERT_EQUAL_INT32(2, q5_3::fromFloat(2.5f).toInt());
+	TEST_ASSERT_EQUAL_INT32(-3, q5_3::fromFloat(-2.5f).toInt());
+}
+
+void test_arithmetic_saturates(void)
+{
+	q5_3 big = q5_3::fromInt(10);
+
+	TEST_ASSERT_TRUE(big + big == q5_3::max());
+	TEST_ASSERT_TRUE(-big - big == q5_3::min());
+	TEST_ASSERT_TRUE(-q5_3::min() == q5_3::max());
+	TEST_ASSERT_TRUE(big * big == q5_3::max());
+	TEST_ASSERT_TRUE(big * -big == q5_3::min());
+	TEST_ASSERT_TRUE(big / q5_3::fromFloat(0.125f) == q5_3::max());
+	TEST_ASSERT_TRUE(big / q5_3() == q5_3::max());
+	TEST_ASSERT_TRUE(-big / q5_3() == q5_3::min());
+	TEST_ASSERT_TRUE(uq4_4::fromInt(1) - uq4_4::fromInt(2) == uq4_4::min());
+
+	q16_16 a = q16_16::fromInt(30000);
+	TEST_ASSERT_TRUE(a * a == q16_16::max());
+}
+
+static int16_t clamp16(double v)
+{
+	return (int16_t)(v < -32768 ? -32768 : v > 32767 ? 32767 : v);
+}
+
+void test_arithmetic_matches_exact(void)
+{
+	// products of two Q1.15 values need more bits than a float has, compare
+	// against the exact result instead
+	for (int i = 0; i < 100000; i++)
+	{
+		q1_15 a = q1_15::fromRaw((int16_t)rng());
+		q1_15 b = q1_15::fromRaw((int16_t)rng());
+
+		double p = (double)a.raw() * b.raw() / 32768;
+		TEST_ASSERT_EQUAL_INT16(clamp16(std::round(p)), (a * b).raw());
+		TEST_ASSERT_EQUAL_INT16(clamp16(std::floor(p)), a.mul(b, FIXED_ROUND_FLOOR).raw());
+		TEST_ASSERT_EQUAL_INT16(clamp16(std::trunc(p)), a.mul(b, FIXED_ROUND_TRUNCATE).raw());
+
+		TEST_ASSERT_EQUAL_INT16(clamp16((double)a.raw() + b.raw()), (a + b).raw());
+		TEST_ASSERT_EQUAL_INT16(clamp16((double)a.raw() - b.raw()), (a - b).raw());
+
+		if (b.raw() != 0)
+		{
+			double d = (double)a.raw() * 32768 / b.raw();
+			TEST_ASSERT_EQUAL_INT16(clamp16(std::trunc(d)), (a / b).raw());
+		}
+	}
+}
+
+void test_format_conversion(void)
+{
+	q16_16 wide = q16_16::fromFloat(3.3f);
+	TEST_ASSERT_EQUAL_FLOAT(3.25f, q5_3::from(wide).toFloat());
+	TEST_ASSERT_EQUAL_FLOAT(3.25f, q5_3::from(wide, FIXED_ROUND_FLOOR).toFloat());
+	TEST_ASSERT_TRUE(q5_3::from(q16_16::fromInt(1000)) == q5_3::max());
+	TEST_ASSERT_TRUE(q16_16::from(q5_3::fromFloat(-2.375f)) == q16_16::fromFloat(-2.375f));
+	TEST_ASSERT_TRUE(q1_15::from(q5_3::fromInt(3)) == q1_15::max());
+}
+
+/* BENCHMARK ================================================================ */
+
+void test_conversion_benchmark(void)
+{
+	const int n = 4096;
+	const int rounds = 500;
+	static float in[n];
+	volatile int32_t sink = 0;
+
+	for (int i = 0; i < n; i++)
+		in[i] = std::uniform_real_distribution<float>(-15.0f, 15.0f)(rng);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		int32_t acc = 0;
+		for (int i = 0; i < n; i++)
+			acc += oldFloatToFixed(in[i]);
+		sink = sink + acc;
+	}
+	std::chrono::duration<double> old_to = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		int32_t acc = 0;
+		for (int i = 0; i < n; i++)
+			acc += q5_3::fromFloat(in[i]).raw();
+		sink = sink + acc;
+	}
+	std::chrono::duration<double> new_to = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		float acc = 0;
+		for (int i = 0; i < n; i++)
+			acc += oldFixedToFloat((int8_t)i);
+		sink = sink + (int32_t)acc;
+	}
+	std::chrono::duration<double> old_from = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		float acc = 0;
+		for (int i = 0; i < n; i++)
+			acc += q5_3::fromRaw((int8_t)i).toFloat();
+		sink = sink + (int32_t)acc;
+	}
+	std::chrono::duration<double> new_from = std::chrono::steady_clock::now() - start;
+
+	double scale = 1e9 / ((double)n * rounds);
+	char msg[128];
+	snprintf(msg, sizeof(msg), "float to fixed: old %.2f ns, Fixed %.2f ns (saturating, rounded)",
+			 old_to.count() * scale, new_to.count() * scale);
+	TEST_MESSAGE(msg);
+	snprintf(msg, sizeof(msg), "fixed to float: old %.2f ns, Fixed %.2f ns",
+			 old_from.count() * scale, new_from.count() * scale);
+	TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_range);
+	RUN_TEST(test_float_saturates);
+	RUN_TEST(test_rounding_modes);
+	RUN_TEST(test_nearest_matches_float);
+	RUN_TEST(test_int_conversion);
+	RUN_TEST(test_arithmetic_saturates);
+	RUN_TEST(test_arithmetic_matches_exact);
+	RUN_TEST(test_format_conversion);
+	RUN_TEST(test_conversion_benchmark);
+	return UNITY_END();
+}
@@ -0,0 +1,385 @@
+/**
+ * @brief      Tests for the interrupt driven I2C transfer queue, against a
+ *             fake master that times the bus in clocks and raises one event
+ *             per address or data byte.
+ */
+#include <unity.h>
+#include <string.h>
+#include <I2CBus.h>
+
+#define IMU_ADDR 0x69
+#define INA_ADDR 0x40
+#define ADDR_CLOCKS 10 // start and address byte
+#define BYTE_CLOCKS 9
+
+/**
+ * @brief      Register file of a device on the fake bus, the first byte
+ *             written selects the register
+ */
+typedef struct
+{
+	uint8_t addr;
+	uint8_t regs[256];
+	uint8_t reg;
+	bool addressed;
+} FakeDevice;
+
+/**
+ * @brief      The fake master, one event pending at a time like the SERCOM
+ */
+class FakeMaster
+{
+public:
+	FakeDevice *devices[2];
+
+	uint32_t now;  // bus clocks
+	uint32_t due;  // when the pending event is raised
+	I2CEvent pending;
+
+	FakeDevice *selected;
+	uint8_t start_addr[16]; // the address of each start, read in bit 7
+	uint8_t starts;
+	uint8_t stops;
+	uint8_t resets;
+	bool error_next; // the next byte ends in a bus error
+
+	FakeMaster() { memset(this, 0, sizeof(*this)); }
+
+	void raise(I2CEvent e, uint32_t clocks)
+	{
+		if (error_next)
+		{
+			error_next = false;
+			e = I2C_EVENT_ERROR;
+		}
+		pending = e;
+		due = now + clocks;
+	}
+
+	void start(uint8_t addr, bool read)
+	{
+		start_addr[starts++] = addr | (read ? 0x80 : 0);
+
+		selected = NULL;
+		for (uint8_t i = 0; i < 2; i++)
+			if (devices[i] != NULL && devices[i]->addr == addr)
+				selected = devices[i];
+
+		if (selected == NULL)
+			raise(I2C_EVENT_NACK, ADDR_CLOCKS);
+		else if (read)
+			raise(I2C_EVENT_DATA, ADDR_CLOCKS + BYTE_CLOCKS);
+		else
+		{
+			selected->addressed = false;
+			raise(I2C_EVENT_ACK, ADDR_CLOCKS);
+		}
+	}
+
+	void write(uint8_t data)
+	{
+		if (!selected->addressed)
+		{
+			selected->reg = data;
+			selected->addressed = true;
+		}
+		else
+			selected->regs[selected->reg++] = data;
+		raise(I2C_EVENT_ACK, BYTE_CLOCKS);
+	}
+
+	uint8_t read(bool last)
+	{
+		uint8_t data = selected->regs[selected->reg++];
+
+		if (last)
+		{
+			stops++;
+			pending = I2C_EVENT_NONE;
+		}
+		else
+			raise(I2C_EVENT_DATA, BYTE_CLOCKS);
+		return data;
+	}
+
+	void stop(void)
+	{
+		stops++;
+		pending = I2C_EVENT_NONE;
+	}
+
+	void reset(void)
+	{
+		resets++;
+		pending = I2C_EVENT_NONE;
+	}
+};
+
+static FakeDevice imu, ina;
+static FakeMaster master;
+static I2CTransfer *finished[8];
+static uint8_t n_finished;
+static uint32_t interrupts;
+
+/**
+ * @brief      Raise the pending events of the master until the bus is idle
+ */
+static void run(I2CBus<FakeMaster> &bus)
+{
+	while (master.pending != I2C_EVENT_NONE)
+	{
+		I2CEvent e = master.pending;
+
+		master.now = master.due;
+		master.pending = I2C_EVENT_NONE;
+		interrupts++;
+
+		I2CTransfer *t = bus.event(e);
+		if (t != NULL)
+			finished[n_finished++] = t;
+	}
+}
+
+static void transfer(I2CTransfer *t, uint8_t addr, const uint8_t *tx, uint16_t tx_len, uint8_t *rx, uint16_t rx_len)
+{
+	memset(t, 0, sizeof(*t));
+	t->addr = addr;
+	t->tx = tx;
+	t->tx_len = tx_len;
+	t->rx = rx;
+	t->rx_len = rx_len;
+}
+
+void setUp(void)
+{
+	memset(&imu, 0, sizeof(imu));
+	memset(&ina, 0, sizeof(ina));
+	imu.addr = IMU_ADDR;
+	ina.addr = INA_ADDR;
+	for (int i = 0; i < 256; i++)
+		imu.regs[i] = i;
+
+	master = FakeMaster();
+	master.devices[0] = &imu;
+	master.devices[1] = &ina;
+
+	n_finished = 0;
+	interrupts = 0;
+}
+
+void tearDown(void)
+{
+}
+
+void test_write_then_read(void)
+{
+	I2CBus<FakeMaster> bus(master);
+	I2CTransfer t;
+	uint8_t reg = 0x2d;
+	uint8_t rx[6];
+
+	transfer(&t, IMU_ADDR, &reg, 1, rx, sizeof(rx));
+	bus.submit(&t);
+	TEST_ASSERT_TRUE(bus.busy());
+	TEST_ASSERT_EQUAL(I2C_PENDING, t.status);
+
+	run(bus);
+	TEST_ASSERT_FALSE(bus.busy());
+	TEST_ASSERT_EQUAL(I2C_OK, t.status);
+	TEST_ASSERT_EQUAL_UINT8(1, n_finished);
+	TEST_ASSERT_EQUAL_PTR(&t, finished[0]);
+
+	// a repeated start for the read, a single stop after the last byte
+	TEST_ASSERT_EQUAL_UINT8(2, master.starts);
+	TEST_ASSERT_EQUAL_HEX8(IMU_ADDR, master.start_addr[0]);
+	TEST_ASSERT_EQUAL_HEX8(IMU_ADDR | 0x80, master.start_addr[1]);
+	TEST_ASSERT_EQUAL_UINT8(1, master.stops);
+
+	for (uint8_t i = 0; i < sizeof(rx); i++)
+		TEST_ASSERT_EQUAL_HEX8(0x2d + i, rx[i]);
+	TEST_ASSERT_EQUAL_UINT32(1, bus.completed());
+}
+
+void test_write_and_read_only(void)
+{
+	I2CBus<FakeMaster> bus(master);
+	I2CTransfer w, r;
+	uint8_t tx[3] = {0x05, 0xab, 0xcd};
+	uint8_t rx[2];
+
+	transfer(&w, INA_ADDR, tx, sizeof(tx), NULL, 0);
+	bus.submit(&w);
+	run(bus);
+	TEST_ASSERT_EQUAL(I2C_OK, w.status);
+	TEST_ASSERT_EQUAL_HEX8(0xab, ina.regs[0x05]);
+	TEST_ASSERT_EQUAL_HEX8(0xcd, ina.regs[0x06]);
+	TEST_ASSERT_EQUAL_UINT8(1, master.starts);
+
+	// a read alone continues from the register selected before
+	ina.reg = 0x05;
+	transfer(&r, INA_ADDR, NULL, 0, rx, sizeof(rx));
+	bus.submit(&r);
+	run(bus);
+	TEST_ASSERT_EQUAL(I2C_OK, r.status);
+	TEST_ASSERT_EQUAL_HEX8(INA_ADDR | 0x80, master.start_addr[1]);
+	TEST_ASSERT_EQUAL_HEX8(0xab, rx[0]);
+	TEST_ASSERT_EQUAL_HEX8(0xcd, rx[1]);
+}
+
+void test_order_of_submission(void)
+{
+	I2CBus<FakeMaster> bus(master);
+	I2CTransfer a, b, c;
+	uint8_t reg_a = 0x2d, reg_b = 0x01, tx_c[2] = {0x7f, 0x20};
+	uint8_t rx_a[12], rx_b[2];
+
+	// the INA209 and a second IMU transfer queue behind the first IMU read
+	transfer(&a, IMU_ADDR, &reg_a, 1, rx_a, sizeof(rx_a));
+	transfer(&b, INA_ADDR, &reg_b, 1, rx_b, sizeof(rx_b));
+	transfer(&c, IMU_ADDR, tx_c, sizeof(tx_c), NULL, 0);
+	bus.submit(&a);
+	bus.submit(&b);
+	TEST_ASSERT_EQUAL_UINT8(1, master.starts);
+	bus.submit(&c);
+	TEST_ASSERT_EQUAL_UINT8(1, master.starts);
+
+	run(bus);
+	TEST_ASSERT_EQUAL_UINT8(3, n_finished);
+	TEST_ASSERT_EQUAL_PTR(&a, finished[0]);
+	TEST_ASSERT_EQUAL_PTR(&b, finished[1]);
+	TEST_ASSERT_EQUAL_PTR(&c, finished[2]);
+	TEST_ASSERT_EQUAL(I2C_OK, a.status);
+	TEST_ASSERT_EQUAL(I2C_OK, b.status);
+	TEST_ASSERT_EQUAL(I2C_OK, c.status);
+	TEST_ASSERT_EQUAL_HEX8(0x20, imu.regs[0x7f]);
+
+	TEST_ASSERT_EQUAL_UINT8(5, master.starts);
+	TEST_ASSERT_EQUAL_HEX8(INA_ADDR, master.start_addr[2]);
+	TEST_ASSERT_EQUAL_HEX8(IMU_ADDR, master.start_addr[4]);
+	TEST_ASSERT_EQUAL_UINT32(3, bus.completed());
+}
+
+void test_nack(void)
+{
+	I2CBus<FakeMaster> bus(master);
+	I2CTransfer missing, next;
+	uint8_t reg = 0x00;
+	uint8_t rx[2];
+
+	// a device that does not answer does not hold up the queue
+	transfer(&missing, 0x42, &reg, 1, rx, sizeof(rx));
+	transfer(&next, IMU_ADDR, &reg, 1, rx, sizeof(rx));
+	bus.submit(&missing);
+	bus.submit(&next);
+
+	run(bus);
+	TEST_ASSERT_EQUAL(I2C_NACK, missing.status);
+	TEST_ASSERT_EQUAL(I2C_OK, next.status);
+	TEST_ASSERT_EQUAL_UINT8(2, master.stops);
+	TEST_ASSERT_EQUAL_UINT32(1, bus.failed());
+	TEST_ASSERT_EQUAL_UINT32(1, bus.completed());
+}
+
+void test_bus_error(void)
+{
+	I2CBus<FakeMaster> bus(master);
+	I2CTransfer a, b;
+	uint8_t reg = 0x10;
+	uint8_t rx[4];
+
+	transfer(&a, IMU_ADDR, &reg, 1, rx, sizeof(rx));
+	transfer(&b, INA_ADDR, &reg, 1, rx, sizeof(rx));
+	bus.submit(&a);
+	bus.submit(&b);
+
+	// the register address is lost on the bus
+	master.error_next = true;
+	run(bus);
+	TEST_ASSERT_EQUAL(I2C_ERROR, a.status);
+	TEST_ASSERT_EQUAL(I2C_OK, b.status);
+	TEST_ASSERT_EQUAL_UINT8(1, master.resets);
+
+	// as is an event that does not fit the transfer
+	transfer(&a, IMU_ADDR, NULL, 0, rx, sizeof(rx));
+	bus.submit(&a);
+	master.pending = I2C_EVENT_NONE;
+	TEST_ASSERT_EQUAL_PTR(&a, bus.event(I2C_EVENT_ACK));
+	TEST_ASSERT_EQUAL(I2C_ERROR, a.status);
+	TEST_ASSERT_EQUAL_UINT8(2, master.resets);
+	TEST_ASSERT_NULL(bus.event(I2C_EVENT_DATA));
+}
+
+void test_cancel(void)
+{
+	I2CBus<FakeMaster> bus(master);
+	I2CTransfer a, b, c;
+	uint8_t reg = 0x00;
+	uint8_t rx[2];
+
+	transfer(&a, IMU_ADDR, &reg, 1, rx, sizeof(rx));
+	transfer(&b, INA_ADDR, &reg, 1, rx, sizeof(rx));
+	transfer(&c, IMU_ADDR, &reg, 1, rx, sizeof(rx));
+	bus.submit(&a);
+	bus.submit(&b);
+	bus.submit(&c);
+
+	// a queued transfer is unlinked without touching the bus
+	TEST_ASSERT_TRUE(bus.cancel(&c));
+	TEST_ASSERT_EQUAL(I2C_CANCELLED, c.status);
+	TEST_ASSERT_EQUAL_UINT8(0, master.resets);
+
+	// the one on the bus resets the master and the next one starts
+	TEST_ASSERT_TRUE(bus.cancel(&a));
+	TEST_ASSERT_EQUAL(I2C_CANCELLED, a.status);
+	TEST_ASSERT_EQUAL_UINT8(1, master.resets);
+	TEST_ASSERT_EQUAL_HEX8(INA_ADDR, master.start_addr[1]);
+
+	run(bus);
+	TEST_ASSERT_EQUAL_UINT8(1, n_finished);
+	TEST_ASSERT_EQUAL_PTR(&b, finished[0]);
+	TEST_ASSERT_EQUAL(I2C_OK, b.status);
+
+	// a finished transfer is left alone
+	TEST_ASSERT_FALSE(bus.cancel(&b));
+	TEST_ASSERT_EQUAL(I2C_OK, b.status);
+	TEST_ASSERT_EQUAL_UINT32(2, bus.failed());
+
+	// the tail is kept when the last one is cancelled
+	bus.submit(&a);
+	bus.submit(&c);
+	TEST_ASSERT_TRUE(bus.cancel(&c));
+	bus.submit(&b);
+	run(bus);
+	TEST_ASSERT_EQUAL_PTR(&a, finished[1]);
+	TEST_ASSERT_EQUAL_PTR(&b, finished[2]);
+}
+
+void test_interrupts_per_transfer(void)
+{
+	I2CBus<FakeMaster> bus(master);
+	I2CTransfer t;
+	uint8_t reg = 0x2d;
+	uint8_t rx[23];
+
+	// the sample read of the IMU: the CPU takes one interrupt per byte and
+	// is free for the rest of the bus time
+	transfer(&t, IMU_ADDR, &reg, 1, rx, sizeof(rx));
+	bus.submit(&t);
+	run(bus);
+
+	TEST_ASSERT_EQUAL_UINT32(1 + 1 + sizeof(rx), interrupts);
+	TEST_ASSERT_EQUAL_UINT32(2 * ADDR_CLOCKS + (1 + sizeof(rx)) * BYTE_CLOCKS, master.now);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_write_then_read);
+	RUN_TEST(test_write_and_read_only);
+	RUN_TEST(test_order_of_submission);
+	RUN_TEST(test_nack);
+	RUN_TEST(test_bus_error);
+	RUN_TEST(test_cancel);
+	RUN_TEST(test_interrupts_per_transfer);
+	return UNITY_END();
+}
@@ -0,0 +1,6 @@
+/**
+ * @brief      The C interface of the ICM-20948 driver for the host tests. The
+ *             native environment ignores the driver library, whose C++ side
+ *             needs Arduino, and builds its C side here.
+ */
+#include "ICM_20948_C.c"
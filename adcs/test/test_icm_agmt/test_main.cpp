@@ -0,0 +1,213 @@
+/**
+ * @brief      Tests for the configuration shadows of the ICM-20948 driver,
+ *             against a mock serial interface that holds the register banks
+ *             and counts the bus transfers.
+ */
+#include <string.h>
+#include <unity.h>
+#include <ICM_20948_C.h>
+
+#define SAMPLES 100
+
+/**
+ * @brief      Register banks of the IMU behind the serial interface
+ */
+typedef struct
+{
+	uint8_t regs[4][128];
+	uint32_t transfers;
+	uint32_t bank2_reads;
+	bool fail_write; // the next write fails
+} MockICM;
+
+static MockICM icm;
+static ICM_20948_Device_t dev;
+
+static uint8_t bank(void)
+{
+	return (icm.regs[0][REG_BANK_SEL] >> 4) & 0x03;
+}
+
+static ICM_20948_Status_e mockWrite(uint8_t reg, uint8_t *data, uint32_t len, void *user)
+{
+	icm.transfers++;
+
+	if (icm.fail_write)
+	{
+		icm.fail_write = false;
+		return ICM_20948_Stat_Err;
+	}
+
+	if (reg == REG_BANK_SEL)
+	{
+		for (uint8_t b = 0; b < 4; b++)
+			icm.regs[b][REG_BANK_SEL] = data[0];
+		return ICM_20948_Stat_Ok;
+	}
+
+	uint8_t b = bank();
+	if (b == 0 && reg == AGB0_REG_PWR_MGMT_1 && (data[0] & 0x80))
+	{
+		// a reset returns the full scale settings to the defaults
+		icm.regs[2][AGB2_REG_ACCEL_CONFIG] = 0x01;
+		icm.regs[2][AGB2_REG_GYRO_CONFIG_1] = 0x01;
+		return ICM_20948_Stat_Ok;
+	}
+
+	memcpy(&icm.regs[b][reg], data, len);
+	return ICM_20948_Stat_Ok;
+}
+
+static ICM_20948_Status_e mockRead(uint8_t reg, uint8_t *data, uint32_t len, void *user)
+{
+	icm.transfers++;
+
+	uint8_t b = bank();
+	if (b == 2)
+		icm.bank2_reads++;
+
+	memcpy(data, &icm.regs[b][reg], len);
+	return ICM_20948_Stat_Ok;
+}
+
+static const ICM_20948_Serif_t mockSerif = {mockWrite, mockRead, NULL};
+
+void setUp(void)
+{
+	memset(&icm, 0, sizeof(icm));
+	icm.regs[2][AGB2_REG_ACCEL_CONFIG] = 0x01;
+	icm.regs[2][AGB2_REG_GYRO_CONFIG_1] = 0x01;
+
+	ICM_20948_init_struct(&dev);
+	ICM_20948_link_serif(&dev, &mockSerif);
+}
+
+void tearDown(void)
+{
+}
+
+void test_parse(void)
+{
+	// accelerometer, gyroscope and temperature big endian, then the
+	// magnetometer little endian between its two status registers
+	uint8_t out[23] = {0x12, 0x34, 0xff, 0xfe, 0x80, 0x00, 0x00, 0x01, 0x7f, 0xff, 0xc0, 0x00, 0x01, 0x02,
+					   0x01, 0x34, 0x12, 0xfe, 0xff, 0x00, 0x80, 0x00, 0x18};
+	ICM_20948_AGMT_t agmt;
+
+	memcpy(&icm.regs[0][AGB0_REG_ACCEL_XOUT_H], out, sizeof(out));
+	TEST_ASSERT_EQUAL(ICM_20948_Stat_Ok, ICM_20948_get_agmt(&dev, &agmt));
+
+	TEST_ASSERT_EQUAL_INT16(0x1234, agmt.acc.axes.x);
+	TEST_ASSERT_EQUAL_INT16(-2, agmt.acc.axes.y);
+	TEST_ASSERT_EQUAL_INT16(-32768, agmt.acc.axes.z);
+	TEST_ASSERT_EQUAL_INT16(1, agmt.gyr.axes.x);
+	TEST_ASSERT_EQUAL_INT16(32767, agmt.gyr.axes.y);
+	TEST_ASSERT_EQUAL_INT16(-16384, agmt.gyr.axes.z);
+	TEST_ASSERT_EQUAL_INT16(0x0102, agmt.tmp.val);
+	TEST_ASSERT_EQUAL_UINT8(0x01, agmt.magStat1);
+	TEST_ASSERT_EQUAL_INT16(0x1234, agmt.mag.axes.x);
+	TEST_ASSERT_EQUAL_INT16(-2, agmt.mag.axes.y);
+	TEST_ASSERT_EQUAL_INT16(-32768, agmt.mag.axes.z);
+	TEST_ASSERT_EQUAL_UINT8(0x18, agmt.magStat2);
+}
+
+void test_single_burst(void)
+{
+	ICM_20948_AGMT_t agmt;
+
+	// the first sample reads the full scale settings once
+	ICM_20948_get_agmt(&dev, &agmt);
+	TEST_ASSERT_EQUAL_UINT32(2, icm.bank2_reads);
+
+	// then each sample is one transfer, with one bank change back to 0
+	icm.transfers = 0;
+	for (int i = 0; i < SAMPLES; i++)
+		TEST_ASSERT_EQUAL(ICM_20948_Stat_Ok, ICM_20948_get_agmt(&dev, &agmt));
+
+	TEST_ASSERT_EQUAL_UINT32(SAMPLES + 1, icm.transfers);
+	TEST_ASSERT_EQUAL_UINT32(2, icm.bank2_reads);
+	TEST_ASSERT_EQUAL_UINT8(0, agmt.fss.a);
+	TEST_ASSERT_EQUAL_UINT8(0, agmt.fss.g);
+}
+
+void test_setters_keep_shadow(void)
+{
+	ICM_20948_AGMT_t agmt;
+	ICM_20948_fss_t fss;
+	ICM_20948_dlpcfg_t dlpf;
+
+	ICM_20948_get_agmt(&dev, &agmt);
+	icm.bank2_reads = 0;
+
+	fss.a = gpm8;
+	fss.g = dps1000;
+	ICM_20948_set_full_scale(&dev, (ICM_20948_InternalSensorID_bm)(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr), fss);
+
+	dlpf.a = acc_d50bw4_n68bw8;
+	dlpf.g = gyr_d51bw2_n73bw3;
+	ICM_20948_set_dlpf_cfg(&dev, (ICM_20948_InternalSensorID_bm)(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr), dlpf);
+	ICM_20948_enable_dlpf(&dev, ICM_20948_Internal_Gyr, false);
+
+	// the setters read each register before changing it, get_agmt does not
+	uint32_t setter_reads = icm.bank2_reads;
+	ICM_20948_get_agmt(&dev, &agmt);
+	TEST_ASSERT_EQUAL_UINT32(setter_reads, icm.bank2_reads);
+
+	TEST_ASSERT_EQUAL_UINT8(gpm8, agmt.fss.a);
+	TEST_ASSERT_EQUAL_UINT8(dps1000, agmt.fss.g);
+	TEST_ASSERT_EQUAL_MEMORY(&icm.regs[2][AGB2_REG_ACCEL_CONFIG], &dev._accel_config, 1);
+	TEST_ASSERT_EQUAL_MEMORY(&icm.regs[2][AGB2_REG_GYRO_CONFIG_1], &dev._gyro_config_1, 1);
+}
+
+void test_reset_rereads(void)
+{
+	ICM_20948_AGMT_t agmt;
+	ICM_20948_fss_t fss;
+
+	fss.a = gpm16;
+	fss.g = dps2000;
+	ICM_20948_set_full_scale(&dev, (ICM_20948_InternalSensorID_bm)(ICM_20948_Internal_Acc | ICM_20948_Internal_Gyr), fss);
+	ICM_20948_get_agmt(&dev, &agmt);
+	TEST_ASSERT_EQUAL_UINT8(dps2000, agmt.fss.g);
+
+	// the reset restores the default scales, which get_agmt reads again
+	ICM_20948_sw_reset(&dev);
+	icm.bank2_reads = 0;
+	ICM_20948_get_agmt(&dev, &agmt);
+	TEST_ASSERT_EQUAL_UINT32(2, icm.bank2_reads);
+	TEST_ASSERT_EQUAL_UINT8(gpm2, agmt.fss.a);
+	TEST_ASSERT_EQUAL_UINT8(dps250, agmt.fss.g);
+}
+
+void test_failed_write_rereads(void)
+{
+	ICM_20948_AGMT_t agmt;
+	ICM_20948_fss_t fss;
+
+	ICM_20948_get_agmt(&dev, &agmt);
+
+	// a failed write leaves the register unknown to the driver. The bank is
+	// selected already, so the next write is the register itself.
+	ICM_20948_set_bank(&dev, 2);
+	icm.fail_write = true;
+	fss.a = gpm4;
+	fss.g = dps500;
+	TEST_ASSERT_NOT_EQUAL(ICM_20948_Stat_Ok, ICM_20948_set_full_scale(&dev, ICM_20948_Internal_Acc, fss));
+	TEST_ASSERT_FALSE(dev._config_shadowed);
+
+	icm.bank2_reads = 0;
+	ICM_20948_get_agmt(&dev, &agmt);
+	TEST_ASSERT_EQUAL_UINT32(2, icm.bank2_reads);
+	TEST_ASSERT_EQUAL_UINT8(gpm2, agmt.fss.a);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_parse);
+	RUN_TEST(test_single_burst);
+	RUN_TEST(test_setters_keep_shadow);
+	RUN_TEST(test_reset_rereads);
+	RUN_TEST(test_failed_write_rereads);
+	return UNITY_END();
+}
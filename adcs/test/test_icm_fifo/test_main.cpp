@@ -0,0 +1,241 @@
+/**
+ * @brief      Tests for the ICM-20948 FIFO burst reads, against a mock of the
+ *             FIFO registers that counts the bus transfers.
+ */
+#include <unity.h>
+#include <string.h>
+#include <ICMFifo.h>
+
+#define PERIOD_US 2666
+
+/**
+ * @brief      FIFO registers of the IMU behind a bus
+ */
+class MockICM
+{
+public:
+	uint8_t fifo[2 * ICM_FIFO_SIZE];
+	uint16_t len;
+	uint32_t transfers;
+	bool fail_data; // the next FIFO data read fails after taking the bytes
+
+	MockICM() : len(0), transfers(0), fail_data(false) {}
+
+	void push(int16_t a, int16_t g)
+	{
+		int16_t values[6] = {a, (int16_t)(a + 1), (int16_t)(a + 2), g, (int16_t)(g + 1), (int16_t)(g + 2)};
+
+		for (uint8_t i = 0; i < 6; i++)
+		{
+			fifo[len++] = (uint16_t)values[i] >> 8;
+			fifo[len++] = values[i] & 0xff;
+		}
+	}
+
+	bool read(uint8_t reg, uint8_t *data, uint16_t n)
+	{
+		transfers++;
+
+		if (reg == ICM_FIFO_COUNTH && n == 2)
+		{
+			data[0] = len >> 8;
+			data[1] = len & 0xff;
+			return true;
+		}
+		if (reg == ICM_FIFO_R_W && n <= len)
+		{
+			memcpy(data, fifo, n);
+			memmove(fifo, fifo + n, len - n);
+			len -= n;
+
+			bool ok = !fail_data;
+			fail_data = false;
+			return ok;
+		}
+		return false;
+	}
+
+	bool write(uint8_t reg, const uint8_t *data, uint16_t n)
+	{
+		transfers++;
+
+		if (reg == ICM_FIFO_RST && (data[0] & 0x1f) == 0x1f)
+			len = 0;
+		return true;
+	}
+};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_parse(void)
+{
+	uint8_t frame[ICM_FIFO_FRAME_LEN] = {0x12, 0x34, 0xff, 0xfe, 0x80, 0x00, 0x00, 0x01, 0x7f, 0xff, 0xc0, 0x00};
+	ICMFifoSample s;
+
+	parseICMFifo(frame, 1, &s);
+	TEST_ASSERT_EQUAL_INT16(0x1234, s.accel[0]);
+	TEST_ASSERT_EQUAL_INT16(-2, s.accel[1]);
+	TEST_ASSERT_EQUAL_INT16(-32768, s.accel[2]);
+	TEST_ASSERT_EQUAL_INT16(1, s.gyro[0]);
+	TEST_ASSERT_EQUAL_INT16(32767, s.gyro[1]);
+	TEST_ASSERT_EQUAL_INT16(-16384, s.gyro[2]);
+}
+
+void test_burst_transfers(void)
+{
+	MockICM icm;
+	ICMFifoReader<MockICM> reader(icm, PERIOD_US);
+	ICMFifoSample s[ICM_FIFO_MAX_BURST];
+
+	// an empty FIFO costs the count only
+	TEST_ASSERT_EQUAL_UINT8(0, reader.read(s, ICM_FIFO_MAX_BURST, 1000));
+	TEST_ASSERT_EQUAL_UINT32(1, icm.transfers);
+
+	// 16 samples in two transfers, an eighth of a transfer each
+	icm.transfers = 0;
+	for (int16_t i = 0; i < 16; i++)
+		icm.push(100 * i, -100 * i);
+
+	TEST_ASSERT_EQUAL_UINT8(16, reader.read(s, ICM_FIFO_MAX_BURST, 50000));
+	TEST_ASSERT_EQUAL_UINT32(2, icm.transfers);
+	TEST_ASSERT_EQUAL_UINT16(0, icm.len);
+
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		TEST_ASSERT_EQUAL_INT16(100 * i, s[i].accel[0]);
+		TEST_ASSERT_EQUAL_INT16(100 * i + 2, s[i].accel[2]);
+		TEST_ASSERT_EQUAL_INT16(-100 * i, s[i].gyro[0]);
+		TEST_ASSERT_EQUAL_INT16(-100 * i + 1, s[i].gyro[1]);
+	}
+}
+
+void test_partial_frame_stays(void)
+{
+	MockICM icm;
+	ICMFifoReader<MockICM> reader(icm, PERIOD_US);
+	ICMFifoSample s[4];
+
+	// the IMU is part way through writing the third frame
+	icm.push(1, 2);
+	icm.push(3, 4);
+	icm.push(5, 6);
+	icm.len -= 5;
+
+	TEST_ASSERT_EQUAL_UINT8(2, reader.read(s, 4, 10000));
+	TEST_ASSERT_EQUAL_UINT16(7, icm.len);
+	TEST_ASSERT_EQUAL_INT16(3, s[1].accel[0]);
+}
+
+void test_burst_limit(void)
+{
+	MockICM icm;
+	ICMFifoReader<MockICM> reader(icm, PERIOD_US);
+	ICMFifoSample s[ICM_FIFO_MAX_BURST];
+
+	for (int16_t i = 0; i < 30; i++)
+		icm.push(i, 0);
+
+	// a burst is at most 255 bytes, the rest waits for the next read
+	uint8_t n = reader.read(s, ICM_FIFO_MAX_BURST, 100000);
+	TEST_ASSERT_EQUAL_UINT8(21, n);
+	TEST_ASSERT_EQUAL_UINT16(9 * ICM_FIFO_FRAME_LEN, icm.len);
+
+	// and the newest one read was taken before the 9 still in the FIFO
+	TEST_ASSERT_EQUAL_UINT32(100000 - 9 * PERIOD_US, s[20].t_us);
+	TEST_ASSERT_EQUAL_UINT32(100000 - 29 * PERIOD_US, s[0].t_us);
+
+	// room for fewer samples
+	TEST_ASSERT_EQUAL_UINT8(4, reader.read(s, 4, 100100));
+	TEST_ASSERT_EQUAL_INT16(21, s[0].accel[0]);
+}
+
+void test_overflow_resets(void)
+{
+	MockICM icm;
+	ICMFifoReader<MockICM> reader(icm, PERIOD_US);
+	ICMFifoSample s[ICM_FIFO_MAX_BURST];
+
+	for (int16_t i = 0; i < ICM_FIFO_SIZE / ICM_FIFO_FRAME_LEN; i++)
+		icm.push(i, 0);
+	icm.len += ICM_FIFO_SIZE % ICM_FIFO_FRAME_LEN;
+
+	// a full FIFO lost samples, it is emptied with the count and two writes
+	TEST_ASSERT_EQUAL_UINT8(0, reader.read(s, ICM_FIFO_MAX_BURST, 1000));
+	TEST_ASSERT_EQUAL_UINT32(1, reader.overflows());
+	TEST_ASSERT_EQUAL_UINT16(0, icm.len);
+	TEST_ASSERT_EQUAL_UINT32(3, icm.transfers);
+
+	// a failed data read leaves the frames misaligned, also emptied
+	icm.push(1, 1);
+	icm.push(2, 2);
+	icm.fail_data = true;
+	icm.len += 3;
+	TEST_ASSERT_EQUAL_UINT8(0, reader.read(s, 1, 2000));
+	TEST_ASSERT_EQUAL_UINT16(0, icm.len);
+	TEST_ASSERT_EQUAL_UINT32(1, reader.overflows());
+}
+
+void test_clock_spacing(void)
+{
+	ICMFifoClock clock(1000);
+	ICMFifoSample s[4];
+
+	// the first burst ends at the read
+	clock.stamp(s, 3, 10000, 0);
+	TEST_ASSERT_EQUAL_UINT32(8000, s[0].t_us);
+	TEST_ASSERT_EQUAL_UINT32(10000, s[2].t_us);
+
+	// the next continues one period after it while that fits the window
+	clock.stamp(s, 4, 14300, 0);
+	TEST_ASSERT_EQUAL_UINT32(11000, s[0].t_us);
+	TEST_ASSERT_EQUAL_UINT32(14000, s[3].t_us);
+
+	// the IMU clock runs slow: 3 samples cannot be taken after the read
+	clock.stamp(s, 3, 16500, 0);
+	TEST_ASSERT_EQUAL_UINT32(16500, s[2].t_us);
+	TEST_ASSERT_EQUAL_UINT32(14500, s[0].t_us);
+
+	// or fast: the newest one is at most a period before the read
+	clock.stamp(s, 2, 21000, 0);
+	TEST_ASSERT_EQUAL_UINT32(20001, s[1].t_us);
+	TEST_ASSERT_EQUAL_UINT32(19001, s[0].t_us);
+
+	// after a reset the burst ends at the read again
+	clock.reset();
+	clock.stamp(s, 1, 30000, 0);
+	TEST_ASSERT_EQUAL_UINT32(30000, s[0].t_us);
+}
+
+void test_clock_wrap(void)
+{
+	ICMFifoClock clock(1000);
+	ICMFifoSample s[4];
+
+	clock.stamp(s, 2, 0xfffffc00, 0);
+	TEST_ASSERT_EQUAL_HEX32(0xfffff818, s[0].t_us);
+
+	// the clock wraps between the bursts, the samples stay one period apart
+	clock.stamp(s, 4, 0x00000d00, 0);
+	TEST_ASSERT_EQUAL_HEX32(0xffffffe8, s[0].t_us);
+	TEST_ASSERT_EQUAL_HEX32(0x000003d0, s[1].t_us);
+	TEST_ASSERT_EQUAL_HEX32(0x00000ba0, s[3].t_us);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_parse);
+	RUN_TEST(test_burst_transfers);
+	RUN_TEST(test_partial_frame_stays);
+	RUN_TEST(test_burst_limit);
+	RUN_TEST(test_overflow_resets);
+	RUN_TEST(test_clock_spacing);
+	RUN_TEST(test_clock_wrap);
+	return UNITY_END();
+}
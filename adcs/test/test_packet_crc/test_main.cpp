@@ -0,0 +1,213 @@
+/**
+ * @brief      Tests and micro-benchmark for the incremental packet CRC used by
+ *             ADCSdata. Random field updates are applied to a packet laid out
+ *             like ADCSdata and the incremental CRC is compared against a full
+ *             recompute after every send.
+ */
+#include <unity.h>
+#include <PacketCRC.h>
+#include <CRC16.h>
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+
+// bytes covered by the ADCSdata CRC, PACKET_LEN - 2
+#define CRC_LEN 28
+
+typedef PacketCRC<CRC_LEN> Packet;
+
+// field offsets and sizes as laid out in ADCSdata
+typedef struct
+{
+	uint8_t offset;
+	uint8_t size;
+} Field;
+
+static const Field fields[] = {
+	{0, 2},	 // status
+	{2, 1},	 // voltage
+	{4, 2},	 // current
+	{6, 1},	 // freq
+	{7, 4},	 // motor_en, buck_en, mtx1, mtx2
+	{11, 6}, // mag, gyro
+	{18, 12}, // photodiodes, partly beyond the CRC
+};
+
+#define NUM_FIELDS (sizeof(fields) / sizeof(fields[0]))
+
+static std::mt19937 rng;
+static uint8_t data[32];
+
+void setUp(void)
+{
+	rng.seed(0xadc5);
+	memset(data, 0, sizeof(data));
+}
+
+void tearDown(void)
+{
+}
+
+static uint16_t fullCRC(const uint8_t *bytes)
+{
+	CRC16 crcGen;
+	crcGen.add(bytes, CRC_LEN);
+	return crcGen.getCRC();
+}
+
+static void writeField(Packet &packet, const Field &f)
+{
+	for (uint8_t i = 0; i < f.size; i++)
+		data[f.offset + i] = rng() & 0xff;
+
+	packet.markDirty(f.offset, f.size);
+}
+
+void test_initial_crc(void)
+{
+	Packet packet;
+
+	TEST_ASSERT_EQUAL_HEX16(fullCRC(data), packet.update(data));
+	TEST_ASSERT_FALSE(packet.dirty());
+}
+
+void test_random_updates_match_recompute(void)
+{
+	Packet packet;
+
+	for (int send = 0; send < 100000; send++)
+	{
+		int writes = rng() % 4;
+		for (int w = 0; w < writes; w++)
+			writeField(packet, fields[rng() % NUM_FIELDS]);
+
+		TEST_ASSERT_EQUAL_HEX16(fullCRC(data), packet.update(data));
+	}
+}
+
+void test_single_byte_every_position(void)
+{
+	Packet packet;
+
+	for (uint8_t pos = 0; pos < CRC_LEN; pos++)
+	{
+		for (int v = 0; v < 256; v++)
+		{
+			data[pos] = v;
+			packet.markDirty(pos, 1);
+			TEST_ASSERT_EQUAL_HEX16(fullCRC(data), packet.update(data));
+		}
+	}
+}
+
+void test_unchanged_resend_costs_nothing(void)
+{
+	Packet packet;
+
+	writeField(packet, fields[0]);
+	packet.update(data);
+
+	uint32_t work = packet.work();
+	for (int i = 0; i < 1000; i++)
+		packet.update(data);
+	TEST_ASSERT_EQUAL_UINT32(work, packet.work());
+
+	// writing the same value again does not cost anything either
+	packet.markDirty(fields[0].offset, fields[0].size);
+	packet.update(data);
+	TEST_ASSERT_EQUAL_UINT32(work, packet.work());
+
+	// only the changed bytes are run through the CRC
+	data[0] ^= 0x01;
+	data[1] ^= 0x01;
+	packet.markDirty(fields[0].offset, fields[0].size);
+	TEST_ASSERT_EQUAL_HEX16(fullCRC(data), packet.update(data));
+	TEST_ASSERT_EQUAL_UINT32(work + 2, packet.work());
+
+	// a cleared and rebuilt packet only pays for the bytes that differ
+	work = packet.work();
+	data[9] ^= 0x10;
+	packet.markDirty(0, CRC_LEN);
+	TEST_ASSERT_EQUAL_HEX16(fullCRC(data), packet.update(data));
+	TEST_ASSERT_EQUAL_UINT32(work + 1, packet.work());
+}
+
+void test_unmarked_write_needs_recompute(void)
+{
+	Packet packet;
+
+	data[5] = 0x5a;
+	TEST_ASSERT_NOT_EQUAL(fullCRC(data), packet.update(data));
+	TEST_ASSERT_EQUAL_HEX16(fullCRC(data), packet.recompute(data));
+
+	data[0] = 0xa5;
+	packet.markDirty(0, 1);
+	TEST_ASSERT_EQUAL_HEX16(fullCRC(data), packet.update(data));
+}
+
+template <typename F>
+static double nsPerSend(F send, int rounds)
+{
+	volatile uint16_t sink = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+		sink ^= send(r);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return elapsed.count() * 1e9 / rounds;
+}
+
+void test_benchmark(void)
+{
+	const int rounds = 1000000;
+	Packet packet;
+	char msg[96];
+
+	double full = nsPerSend([](int r) {
+		data[0] = r;
+		return fullCRC(data);
+	}, rounds);
+
+	double status = nsPerSend([&packet](int r) {
+		data[0] = r;
+		packet.markDirty(0, 2);
+		return packet.update(data);
+	}, rounds);
+
+	double imu = nsPerSend([&packet](int r) {
+		data[11] = r;
+		data[16] = r >> 8;
+		packet.markDirty(11, 6);
+		return packet.update(data);
+	}, rounds);
+
+	double unchanged = nsPerSend([&packet](int) {
+		return packet.update(data);
+	}, rounds);
+
+	snprintf(msg, sizeof(msg), "full recompute %.1f ns/send", full);
+	TEST_MESSAGE(msg);
+	snprintf(msg, sizeof(msg), "status changed %.1f ns/send", status);
+	TEST_MESSAGE(msg);
+	snprintf(msg, sizeof(msg), "imu fields changed %.1f ns/send", imu);
+	TEST_MESSAGE(msg);
+	snprintf(msg, sizeof(msg), "unchanged %.1f ns/send", unchanged);
+	TEST_MESSAGE(msg);
+
+	TEST_ASSERT_EQUAL_HEX16(fullCRC(data), packet.update(data));
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_initial_crc);
+	RUN_TEST(test_random_updates_match_recompute);
+	RUN_TEST(test_single_byte_every_position);
+	RUN_TEST(test_unchanged_resend_costs_nothing);
+	RUN_TEST(test_unmarked_write_needs_recompute);
+	RUN_TEST(test_benchmark);
+	return UNITY_END();
+}
@@ -0,0 +1,195 @@
+/**
+ * @brief      Tests for the periodic task timing statistics. Release and
+ *             completion times of simulated schedules are fed in and the
+ *             histograms, misses and report frames are checked.
+ */
+#include <unity.h>
+#include <PeriodStats.h>
+
+#include <random>
+
+#define PERIOD_US 5000
+#define DEADLINE_US 4000
+
+static std::mt19937 rng;
+
+void setUp(void)
+{
+	rng.seed(0xadc5);
+}
+
+void tearDown(void)
+{
+}
+
+static uint32_t histTotal(const uint16_t *hist)
+{
+	uint32_t n = 0;
+	for (uint8_t i = 0; i < PERIOD_HIST_BINS; i++)
+		n += hist[i];
+	return n;
+}
+
+void test_bins(void)
+{
+	TEST_ASSERT_EQUAL_UINT8(0, periodBin(0));
+	TEST_ASSERT_EQUAL_UINT8(0, periodBin(PERIOD_HIST_MIN_US - 1));
+	TEST_ASSERT_EQUAL_UINT8(1, periodBin(PERIOD_HIST_MIN_US));
+	TEST_ASSERT_EQUAL_UINT8(1, periodBin(2 * PERIOD_HIST_MIN_US - 1));
+	TEST_ASSERT_EQUAL_UINT8(2, periodBin(2 * PERIOD_HIST_MIN_US));
+	TEST_ASSERT_EQUAL_UINT8(PERIOD_HIST_BINS - 1, periodBin(0xffffffff));
+}
+
+void test_on_time_schedule(void)
+{
+	PeriodStats stats(PERIOD_US, DEADLINE_US);
+	uint32_t t = 1000;
+
+	stats.restart(t);
+	for (int i = 0; i < 100; i++)
+	{
+		t += PERIOD_US;
+		stats.release(t);
+		stats.complete(t + 300);
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(100, stats.periods());
+	TEST_ASSERT_EQUAL_UINT32(0, stats.misses());
+	TEST_ASSERT_EQUAL_UINT32(0, stats.maxJitter());
+	TEST_ASSERT_EQUAL_UINT32(300, stats.maxExec());
+	TEST_ASSERT_EQUAL_UINT16(100, stats.jitterHist()[0]);
+	TEST_ASSERT_EQUAL_UINT16(100, stats.execHist()[periodBin(300)]);
+}
+
+void test_jitter_does_not_drift(void)
+{
+	// a task that sleeps a fixed time after its work drifts further behind
+	// the schedule every period, jitter against the ideal schedule shows it
+	PeriodStats stats(PERIOD_US, DEADLINE_US);
+	uint32_t t = 0;
+
+	stats.restart(t);
+	for (int i = 0; i < 10; i++)
+	{
+		t += PERIOD_US + 200;
+		stats.release(t);
+		stats.complete(t + 200);
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(2000, stats.maxJitter());
+	TEST_ASSERT_EQUAL_UINT32(10, histTotal(stats.jitterHist()));
+}
+
+void test_deadline_misses(void)
+{
+	PeriodStats stats(PERIOD_US, DEADLINE_US);
+	uint32_t ideal = 0;
+	uint32_t expected = 0;
+
+	stats.restart(0);
+	for (int i = 0; i < 1000; i++)
+	{
+		ideal += PERIOD_US;
+		uint32_t jitter = rng() % 500;
+		uint32_t exec = rng() % 5000;
+
+		stats.release(ideal + jitter);
+		stats.complete(ideal + jitter + exec);
+		if (jitter + exec > DEADLINE_US)
+			expected++;
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(1000, stats.periods());
+	TEST_ASSERT_EQUAL_UINT32(expected, stats.misses());
+	TEST_ASSERT_EQUAL_UINT32(1000, histTotal(stats.jitterHist()));
+	TEST_ASSERT_EQUAL_UINT32(1000, histTotal(stats.execHist()));
+}
+
+void test_counter_wraps(void)
+{
+	PeriodStats stats(PERIOD_US, DEADLINE_US);
+	uint32_t t = 0xffffffff - 2 * PERIOD_US;
+
+	stats.restart(t);
+	for (int i = 0; i < 5; i++)
+	{
+		t += PERIOD_US;
+		stats.release(t + 10);
+		stats.complete(t + 100);
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(0, stats.misses());
+	TEST_ASSERT_EQUAL_UINT32(10, stats.maxJitter());
+	TEST_ASSERT_EQUAL_UINT32(90, stats.maxExec());
+}
+
+void test_first_release_anchors(void)
+{
+	PeriodStats stats(PERIOD_US, DEADLINE_US);
+
+	stats.release(123456);
+	stats.complete(123556);
+	stats.release(123456 + PERIOD_US + 40);
+	stats.complete(123456 + PERIOD_US + 100);
+
+	TEST_ASSERT_EQUAL_UINT32(40, stats.maxJitter());
+	TEST_ASSERT_EQUAL_UINT32(2, stats.periods());
+
+	// completing twice counts once
+	stats.complete(123456 + PERIOD_US + 200);
+	TEST_ASSERT_EQUAL_UINT32(2, stats.periods());
+}
+
+void test_frame_round_trip(void)
+{
+	PeriodStats stats(PERIOD_US, DEADLINE_US);
+	uint32_t t = 0;
+
+	stats.restart(t);
+	for (int i = 0; i < 5000; i++)
+	{
+		t += PERIOD_US;
+		uint32_t jitter = rng() % 2000;
+		stats.release(t + jitter);
+		stats.complete(t + jitter + rng() % 6000);
+	}
+
+	uint8_t frame[PERIOD_FRAME_LEN];
+	TEST_ASSERT_EQUAL_UINT8(PERIOD_FRAME_LEN, stats.encode(3, frame));
+
+	PeriodStats decoded;
+	uint8_t id = 0;
+	TEST_ASSERT_TRUE(decoded.decode(frame, sizeof(frame), id));
+	TEST_ASSERT_EQUAL_UINT8(3, id);
+	TEST_ASSERT_EQUAL_UINT32(PERIOD_US, decoded.period());
+	TEST_ASSERT_EQUAL_UINT32(DEADLINE_US, decoded.deadline());
+	TEST_ASSERT_EQUAL_UINT32(stats.periods(), decoded.periods());
+	TEST_ASSERT_EQUAL_UINT32(stats.misses(), decoded.misses());
+	TEST_ASSERT_EQUAL_UINT32(stats.maxJitter(), decoded.maxJitter());
+	TEST_ASSERT_EQUAL_UINT32(stats.maxExec(), decoded.maxExec());
+	TEST_ASSERT_EQUAL_UINT16_ARRAY(stats.jitterHist(), decoded.jitterHist(), PERIOD_HIST_BINS);
+	TEST_ASSERT_EQUAL_UINT16_ARRAY(stats.execHist(), decoded.execHist(), PERIOD_HIST_BINS);
+
+	// any flipped bit fails the CRC
+	for (uint8_t i = 2; i < PERIOD_FRAME_LEN; i++)
+	{
+		frame[i] ^= 0x04;
+		TEST_ASSERT_FALSE(decoded.decode(frame, sizeof(frame), id));
+		frame[i] ^= 0x04;
+	}
+
+	TEST_ASSERT_FALSE(decoded.decode(frame, PERIOD_FRAME_LEN - 1, id));
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_bins);
+	RUN_TEST(test_on_time_schedule);
+	RUN_TEST(test_jitter_does_not_drift);
+	RUN_TEST(test_deadline_misses);
+	RUN_TEST(test_counter_wraps);
+	RUN_TEST(test_first_release_anchors);
+	RUN_TEST(test_frame_round_trip);
+	return UNITY_END();
+}
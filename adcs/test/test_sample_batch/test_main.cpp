@@ -0,0 +1,298 @@
+/**
+ * @brief      Round trip tests and size benchmark for the batched IMU sample
+ *             frame. Frames are encoded from random and simulated sensor
+ *             signals, decoded again and compared sample by sample.
+ */
+#include <unity.h>
+#include <SampleBatch.h>
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+// transmit buffer size used by the firmware
+#define FRAME_LEN 128
+#define PERIOD_MS 5
+
+typedef SampleBatchEncoder<FRAME_LEN> Encoder;
+
+static std::mt19937 rng;
+
+void setUp(void)
+{
+	rng.seed(0xadc5);
+}
+
+void tearDown(void)
+{
+}
+
+/**
+ * @brief      Simulated readIMU output: slow rotation with sensor noise
+ */
+static BatchSample simulatedSample(int i)
+{
+	std::normal_distribution<float> noise(0.0f, 1.0f);
+	BatchSample s;
+	float t = i * PERIOD_MS / 1000.0f;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float rate = 5.0f * sinf(0.5f * t + axis);	  // dps
+		float field = 40.0f * cosf(0.05f * t + axis); // uT
+		s.v[axis] = batchQuantize(rate + 0.1f * noise(rng), BATCH_GYRO_LSB);
+		s.v[3 + axis] = batchQuantize(field + 0.3f * noise(rng), BATCH_MAG_LSB);
+	}
+
+	return s;
+}
+
+static BatchSample randomSample(int range)
+{
+	std::uniform_int_distribution<int> dist(-range, range - 1);
+	BatchSample s;
+
+	for (int c = 0; c < BATCH_CHANNELS; c++)
+		s.v[c] = dist(rng);
+
+	return s;
+}
+
+/**
+ * @brief      Encode samples until the frame is full, decode and compare
+ */
+static void roundTrip(std::vector<BatchSample> &in, std::vector<uint32_t> &in_ms)
+{
+	Encoder enc;
+	enc.begin(PERIOD_MS);
+
+	size_t n = 0;
+	while (n < in.size() && enc.add(in[n], in_ms[n]))
+		n++;
+
+	uint8_t len;
+	const uint8_t *frame = enc.finish(len);
+	TEST_ASSERT_TRUE(len <= FRAME_LEN);
+
+	BatchSample out[255];
+	uint32_t out_ms[255];
+	TEST_ASSERT_EQUAL_INT(n, decodeSampleBatch(frame, len, out, out_ms, 255));
+
+	for (size_t i = 0; i < n; i++)
+	{
+		TEST_ASSERT_EQUAL_UINT32(in_ms[i], out_ms[i]);
+		TEST_ASSERT_EQUAL_INT16_ARRAY(in[i].v, out[i].v, BATCH_CHANNELS);
+	}
+
+	in.erase(in.begin(), in.begin() + n);
+	in_ms.erase(in_ms.begin(), in_ms.begin() + n);
+}
+
+void test_empty_frame(void)
+{
+	Encoder enc;
+	enc.begin(PERIOD_MS);
+
+	uint8_t len;
+	const uint8_t *frame = enc.finish(len);
+	BatchSample out[1];
+	uint32_t out_ms[1];
+
+	TEST_ASSERT_EQUAL_UINT8(BATCH_HEADER_LEN + BATCH_CRC_LEN, len);
+	TEST_ASSERT_EQUAL_INT(0, decodeSampleBatch(frame, len, out, out_ms, 1));
+}
+
+void test_round_trip_random(void)
+{
+	for (int round = 0; round < 2000; round++)
+	{
+		// mix of small and full range changes, and jittery timestamps
+		int range = (round % 3 == 0) ? 32768 : 64;
+		std::vector<BatchSample> in;
+		std::vector<uint32_t> in_ms;
+		uint32_t t = rng();
+
+		for (int i = 0; i < 40; i++)
+		{
+			in.push_back(randomSample(range));
+			in_ms.push_back(t);
+			t += PERIOD_MS + (int)(rng() % 7) - 3;
+		}
+
+		while (!in.empty())
+			roundTrip(in, in_ms);
+	}
+}
+
+void test_round_trip_extremes(void)
+{
+	std::vector<BatchSample> in;
+	std::vector<uint32_t> in_ms;
+
+	for (int i = 0; i < 20; i++)
+	{
+		BatchSample s;
+		for (int c = 0; c < BATCH_CHANNELS; c++)
+			s.v[c] = ((i + c) & 1) ? 32767 : -32768;
+		in.push_back(s);
+		// timestamps wrap around
+		in_ms.push_back(0xFFFFFFF0 + i * 200);
+	}
+
+	while (!in.empty())
+		roundTrip(in, in_ms);
+}
+
+void test_quantize(void)
+{
+	for (int i = 0; i < 100000; i++)
+	{
+		float dps = (rng() % 4000000) / 1000.0f - 2000.0f;
+		int16_t q = batchQuantize(dps, BATCH_GYRO_LSB);
+		TEST_ASSERT_TRUE(fabsf(q * BATCH_GYRO_LSB - dps) <= BATCH_GYRO_LSB / 2 + 1e-3f);
+	}
+
+	TEST_ASSERT_EQUAL_INT16(32767, batchQuantize(1e6f, BATCH_MAG_LSB));
+	TEST_ASSERT_EQUAL_INT16(-32768, batchQuantize(-1e6f, BATCH_MAG_LSB));
+}
+
+void test_corrupt_frame_rejected(void)
+{
+	Encoder enc;
+	enc.begin(PERIOD_MS);
+	for (int i = 0; i < 10; i++)
+		enc.add(simulatedSample(i), i * PERIOD_MS);
+
+	uint8_t len;
+	const uint8_t *frame = enc.finish(len);
+	uint8_t copy[FRAME_LEN];
+	BatchSample out[255];
+	uint32_t out_ms[255];
+
+	for (int i = 0; i < len; i++)
+	{
+		for (int bit = 0; bit < 8; bit++)
+		{
+			memcpy(copy, frame, len);
+			copy[i] ^= 1 << bit;
+			TEST_ASSERT_EQUAL_INT(-1, decodeSampleBatch(copy, len, out, out_ms, 255));
+		}
+	}
+
+	// truncated, or not enough room for the samples
+	TEST_ASSERT_EQUAL_INT(-1, decodeSampleBatch(frame, len - 1, out, out_ms, 255));
+	TEST_ASSERT_EQUAL_INT(-1, decodeSampleBatch(frame, len, out, out_ms, 9));
+	TEST_ASSERT_EQUAL_INT(10, decodeSampleBatch(frame, len, out, out_ms, 10));
+}
+
+void test_bad_length_byte_rejected(void)
+{
+	Encoder enc;
+	enc.begin(PERIOD_MS);
+	for (int i = 0; i < 10; i++)
+		enc.add(simulatedSample(i), i * PERIOD_MS);
+
+	uint8_t len;
+	const uint8_t *frame = enc.finish(len);
+	uint8_t copy[FRAME_LEN];
+	BatchSample out[255];
+	uint32_t out_ms[255];
+
+	// a length byte shorter than the header and CRC must not be trusted for
+	// the CRC range
+	for (int frame_len = 0; frame_len < BATCH_HEADER_LEN + BATCH_CRC_LEN; frame_len++)
+	{
+		memcpy(copy, frame, len);
+		copy[1] = frame_len;
+		TEST_ASSERT_EQUAL_INT(-1, decodeSampleBatch(copy, len, out, out_ms, 255));
+	}
+
+	// longer than the bytes given
+	memcpy(copy, frame, len);
+	copy[1] = len + 1;
+	TEST_ASSERT_EQUAL_INT(-1, decodeSampleBatch(copy, len, out, out_ms, 255));
+
+	// shorter than the caller's buffer is fine
+	memcpy(copy, frame, len);
+	TEST_ASSERT_EQUAL_INT(10, decodeSampleBatch(copy, FRAME_LEN, out, out_ms, 255));
+}
+
+void test_bytes_per_sample(void)
+{
+	const int SAMPLES = 200000;
+	std::vector<BatchSample> in;
+	for (int i = 0; i < SAMPLES; i++)
+		in.push_back(simulatedSample(i));
+
+	std::vector<uint8_t> frames;
+	int frame_count = 0;
+	Encoder enc;
+	enc.begin(PERIOD_MS);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < SAMPLES; i++)
+	{
+		// readIMU timing jitters by a tick now and then
+		uint32_t t = i * PERIOD_MS + ((i % 17) == 0);
+
+		if (!enc.add(in[i], t))
+		{
+			uint8_t len;
+			const uint8_t *frame = enc.finish(len);
+			frames.insert(frames.end(), frame, frame + len);
+			frame_count++;
+			enc.begin(PERIOD_MS);
+			enc.add(in[i], t);
+		}
+	}
+	std::chrono::duration<double> encode = std::chrono::steady_clock::now() - start;
+
+	// decode everything again
+	BatchSample out[255];
+	uint32_t out_ms[255];
+	size_t pos = 0;
+	int decoded = 0;
+
+	start = std::chrono::steady_clock::now();
+	while (pos < frames.size())
+	{
+		int n = decodeSampleBatch(&frames[pos], frames[pos + 1], out, out_ms, 255);
+		TEST_ASSERT_TRUE(n > 0);
+		TEST_ASSERT_EQUAL_INT16_ARRAY(in[decoded].v, out[0].v, BATCH_CHANNELS);
+		decoded += n;
+		pos += frames[pos + 1];
+	}
+	std::chrono::duration<double> decode = std::chrono::steady_clock::now() - start;
+
+	TEST_ASSERT_EQUAL_INT(SAMPLES - enc.count(), decoded);
+
+	double bps = (double)frames.size() / decoded;
+	char msg[128];
+	snprintf(msg, sizeof(msg), "heartbeat 30.0 bytes/sample, raw int16 %d bytes/sample, batch %.2f bytes/sample (%.1f samples/frame)",
+			 2 * BATCH_CHANNELS, bps, (double)decoded / frame_count);
+	TEST_MESSAGE(msg);
+	snprintf(msg, sizeof(msg), "200 Hz sampling needs %.0f bytes/s of the %d bytes/s link",
+			 bps * 1000 / PERIOD_MS, 115200 / 11);
+	TEST_MESSAGE(msg);
+	snprintf(msg, sizeof(msg), "encode %.1f ns/sample, decode %.1f ns/sample",
+			 encode.count() * 1e9 / SAMPLES, decode.count() * 1e9 / decoded);
+	TEST_MESSAGE(msg);
+
+	// delta encoding must beat sending raw int16 samples with a timestamp each
+	TEST_ASSERT_TRUE(bps < 2 * BATCH_CHANNELS);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_empty_frame);
+	RUN_TEST(test_round_trip_random);
+	RUN_TEST(test_round_trip_extremes);
+	RUN_TEST(test_quantize);
+	RUN_TEST(test_corrupt_frame_rejected);
+	RUN_TEST(test_bad_length_byte_rejected);
+	RUN_TEST(test_bytes_per_sample);
+	return UNITY_END();
+}
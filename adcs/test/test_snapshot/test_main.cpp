@@ -0,0 +1,236 @@
+/**
+ * @brief      Tests and read latency benchmark for the Snapshot channel that
+ *             replaced IMUq and IMUsemphr. A writer thread publishes values
+ *             whose fields all equal their sequence number while reader
+ *             threads check that they never see a torn or older value. The
+ *             benchmark compares reads against a one deep mailbox guarded by
+ *             a lock, the way xQueueOverwrite/xQueuePeek guard IMUq with a
+ *             critical section.
+ */
+#include <unity.h>
+#include <Snapshot.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+// same size as IMUdata, six floats
+typedef struct
+{
+	uint32_t v[6];
+} Sample;
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @brief      One deep overwrite/peek mailbox, stands in for the FreeRTOS queue
+ */
+class Mailbox
+{
+private:
+	std::mutex _lock;
+	Sample _value;
+	uint32_t _seq;
+
+public:
+	Mailbox() : _seq(0) { memset(&_value, 0, sizeof(_value)); }
+
+	void overwrite(const Sample &s)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_value = s;
+		_seq++;
+	}
+
+	uint32_t peek(Sample &s)
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		s = _value;
+		return _seq;
+	}
+};
+
+static Sample sample(uint32_t n)
+{
+	Sample s;
+	for (int i = 0; i < 6; i++)
+		s.v[i] = n;
+	return s;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_empty(void)
+{
+	Snapshot<Sample> snap;
+	Sample s = sample(7);
+
+	TEST_ASSERT_EQUAL_UINT32(0, snap.sequence());
+	TEST_ASSERT_EQUAL_UINT32(0, snap.read(s));
+	TEST_ASSERT_EQUAL_UINT32(0, s.v[0]);
+	TEST_ASSERT_EQUAL_UINT32(0, s.v[5]);
+}
+
+void test_sequence_and_freshness(void)
+{
+	Snapshot<Sample> snap;
+	Sample s;
+	uint32_t last = 0;
+
+	TEST_ASSERT_FALSE(snap.readIfNewer(s, last));
+
+	snap.publish(sample(1));
+	TEST_ASSERT_TRUE(snap.readIfNewer(s, last));
+	TEST_ASSERT_EQUAL_UINT32(1, last);
+	TEST_ASSERT_EQUAL_UINT32(1, s.v[3]);
+	TEST_ASSERT_FALSE(snap.readIfNewer(s, last));
+
+	// a reader that missed values skips straight to the latest
+	snap.publish(sample(2));
+	snap.publish(sample(3));
+	TEST_ASSERT_TRUE(snap.readIfNewer(s, last));
+	TEST_ASSERT_EQUAL_UINT32(3, last);
+	TEST_ASSERT_EQUAL_UINT32(3, s.v[0]);
+}
+
+void test_odd_sized_value(void)
+{
+	typedef struct
+	{
+		uint8_t b[7];
+	} Odd;
+
+	Snapshot<Odd> snap;
+	Odd in = {{1, 2, 3, 4, 5, 6, 7}};
+	Odd out;
+
+	snap.publish(in);
+	TEST_ASSERT_EQUAL_UINT32(1, snap.read(out));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(in.b, out.b, 7);
+}
+
+void test_concurrent_readers_never_tear(void)
+{
+	const uint32_t writes = 2000000;
+	const int readers = 3;
+
+	Snapshot<Sample> snap;
+	std::atomic<bool> done(false);
+	std::atomic<uint32_t> torn(0), backwards(0), mismatched(0);
+	std::atomic<uint64_t> reads(0);
+	std::vector<std::thread> threads;
+
+	for (int r = 0; r < readers; r++)
+	{
+		threads.push_back(std::thread([&]() {
+			uint32_t prev = 0;
+			uint64_t n = 0;
+			Sample s;
+
+			while (!done.load(std::memory_order_relaxed))
+			{
+				uint32_t seq = snap.read(s);
+				n++;
+
+				for (int i = 1; i < 6; i++)
+				{
+					if (s.v[i] != s.v[0])
+						torn++;
+				}
+				if (s.v[0] != seq)
+					mismatched++;
+				if (seq < prev)
+					backwards++;
+				prev = seq;
+			}
+
+			reads += n;
+		}));
+	}
+
+	for (uint32_t i = 1; i <= writes; i++)
+		snap.publish(sample(i));
+
+	done = true;
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+
+	char msg[96];
+	snprintf(msg, sizeof(msg), "%lu writes, %llu reads checked", (unsigned long)writes, (unsigned long long)reads.load());
+	TEST_MESSAGE(msg);
+
+	TEST_ASSERT_EQUAL_UINT32(0, torn.load());
+	TEST_ASSERT_EQUAL_UINT32(0, mismatched.load());
+	TEST_ASSERT_EQUAL_UINT32(0, backwards.load());
+	TEST_ASSERT_EQUAL_UINT32(writes, snap.sequence());
+}
+
+/* BENCHMARK ================================================================ */
+
+template <typename Read>
+static double readNs(Read read, uint32_t n)
+{
+	Clock::time_point start = Clock::now();
+	for (uint32_t i = 0; i < n; i++)
+		read();
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+}
+
+void test_read_latency_benchmark(void)
+{
+	const uint32_t n = 5000000;
+	Snapshot<Sample> snap;
+	Mailbox box;
+	Sample s;
+	volatile uint32_t sink = 0;
+
+	snap.publish(sample(1));
+	box.overwrite(sample(1));
+
+	double snap_idle = readNs([&]() { sink = sink + snap.read(s); }, n);
+	double box_idle = readNs([&]() { sink = sink + box.peek(s); }, n);
+
+	// same again with a writer publishing as fast as it can
+	std::atomic<bool> done(false);
+	std::thread writer([&]() {
+		uint32_t i = 2;
+		while (!done.load(std::memory_order_relaxed))
+		{
+			snap.publish(sample(i));
+			box.overwrite(sample(i));
+			i++;
+		}
+	});
+
+	double snap_busy = readNs([&]() { sink = sink + snap.read(s); }, n);
+	double box_busy = readNs([&]() { sink = sink + box.peek(s); }, n);
+
+	done = true;
+	writer.join();
+
+	char msg[128];
+	snprintf(msg, sizeof(msg), "read, no writer: snapshot %.1f ns, locked mailbox %.1f ns", snap_idle, box_idle);
+	TEST_MESSAGE(msg);
+	snprintf(msg, sizeof(msg), "read, busy writer: snapshot %.1f ns, locked mailbox %.1f ns", snap_busy, box_busy);
+	TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_empty);
+	RUN_TEST(test_sequence_and_freshness);
+	RUN_TEST(test_odd_sized_value);
+	RUN_TEST(test_concurrent_readers_never_tear);
+	RUN_TEST(test_read_latency_benchmark);
+	return UNITY_END();
+}
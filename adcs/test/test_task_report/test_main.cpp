@@ -0,0 +1,159 @@
+/**
+ * @brief      Tests for the task diagnostics frames and the CPU share of each
+ *             task between reports.
+ */
+#include <unity.h>
+#include <TaskReport.h>
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_system_round_trip(void)
+{
+	SystemReport r, d;
+	uint8_t frame[SYSTEM_FRAME_LEN(TASK_REPORT_MAX_QUEUES)];
+
+	memset(&r, 0, sizeof(r));
+	r.run_time_us = 0xfedcba98;
+	r.interval_us = 1000000;
+	r.heap_free = 20480;
+	r.heap_min_free = 19976;
+	r.tasks = 7;
+	r.queues = 2;
+	r.queue_waiting[0] = 1;
+	r.queue_length[0] = 1;
+	r.queue_waiting[1] = 3;
+	r.queue_length[1] = 8;
+
+	uint8_t len = encodeSystemReport(r, frame);
+	TEST_ASSERT_EQUAL_UINT8(SYSTEM_FRAME_LEN(2), len);
+	TEST_ASSERT_EQUAL_HEX8(SYSTEM_FRAME_ID, frame[0]);
+
+	TEST_ASSERT_TRUE(decodeSystemReport(frame, len, d));
+	TEST_ASSERT_EQUAL_HEX32(r.run_time_us, d.run_time_us);
+	TEST_ASSERT_EQUAL_UINT32(r.interval_us, d.interval_us);
+	TEST_ASSERT_EQUAL_UINT32(r.heap_free, d.heap_free);
+	TEST_ASSERT_EQUAL_UINT32(r.heap_min_free, d.heap_min_free);
+	TEST_ASSERT_EQUAL_UINT8(7, d.tasks);
+	TEST_ASSERT_EQUAL_UINT8(2, d.queues);
+	TEST_ASSERT_EQUAL_UINT8(3, d.queue_waiting[1]);
+	TEST_ASSERT_EQUAL_UINT8(8, d.queue_length[1]);
+
+	// truncated or corrupted frames are rejected
+	TEST_ASSERT_FALSE(decodeSystemReport(frame, len - 1, d));
+	frame[12] ^= 0x01;
+	TEST_ASSERT_FALSE(decodeSystemReport(frame, len, d));
+}
+
+void test_task_round_trip(void)
+{
+	TaskReport r, d;
+	uint8_t frame[TASK_FRAME_LEN];
+
+	memset(&r, 0, sizeof(r));
+	r.number = 9;
+	r.state = 2;
+	r.priority = 1;
+	r.run_time_us = 123456789;
+	r.share = 3728;
+	r.stack_words = 256;
+	r.stack_free_words = 17;
+	strcpy(r.name, "BLDC TEST");
+
+	uint8_t len = encodeTaskReport(r, frame);
+	TEST_ASSERT_EQUAL_UINT8(TASK_FRAME_LEN, len);
+
+	TEST_ASSERT_TRUE(decodeTaskReport(frame, len, d));
+	TEST_ASSERT_EQUAL_UINT8(9, d.number);
+	TEST_ASSERT_EQUAL_UINT8(2, d.state);
+	TEST_ASSERT_EQUAL_UINT8(1, d.priority);
+	TEST_ASSERT_EQUAL_UINT32(123456789, d.run_time_us);
+	TEST_ASSERT_EQUAL_UINT16(3728, d.share);
+	TEST_ASSERT_EQUAL_UINT16(256, d.stack_words);
+	TEST_ASSERT_EQUAL_UINT16(17, d.stack_free_words);
+	TEST_ASSERT_EQUAL_STRING("BLDC TEST", d.name);
+
+	// a name of the full length has no terminator in the frame
+	strcpy(r.name, "0123456789abcdef");
+	encodeTaskReport(r, frame);
+	TEST_ASSERT_TRUE(decodeTaskReport(frame, len, d));
+	TEST_ASSERT_EQUAL_STRING("0123456789abcdef", d.name);
+
+	// a system frame is not a task frame
+	SystemReport s;
+	memset(&s, 0, sizeof(s));
+	len = encodeSystemReport(s, frame);
+	TEST_ASSERT_FALSE(decodeTaskReport(frame, len, d));
+}
+
+void test_shares_between_reports(void)
+{
+	RunTimeShares<4> shares;
+
+	// first report, since the counters started
+	shares.begin(1000000);
+	TEST_ASSERT_EQUAL_UINT32(1000000, shares.interval());
+	TEST_ASSERT_EQUAL_UINT16(2500, shares.share(1, 250000));
+	TEST_ASSERT_EQUAL_UINT16(7500, shares.share(2, 750000));
+	shares.end();
+
+	// task 1 used all of the next 500 ms, task 2 none, task 3 is new
+	shares.begin(1500000);
+	TEST_ASSERT_EQUAL_UINT32(500000, shares.interval());
+	TEST_ASSERT_EQUAL_UINT16(TASK_SHARE_FULL, shares.share(1, 750000));
+	TEST_ASSERT_EQUAL_UINT16(0, shares.share(2, 750000));
+	TEST_ASSERT_EQUAL_UINT16(200, shares.share(3, 10000));
+	shares.end();
+}
+
+void test_shares_across_wrap(void)
+{
+	RunTimeShares<4> shares;
+
+	shares.begin(0xfff00000);
+	shares.share(1, 0xffe00000);
+	shares.end();
+
+	// the clock and the counter wrapped, 2^20 us passed and the task ran half
+	shares.begin(0x00000000);
+	TEST_ASSERT_EQUAL_UINT32(0x00100000, shares.interval());
+	TEST_ASSERT_EQUAL_UINT16(5000, shares.share(1, 0xffe80000));
+	shares.end();
+}
+
+void test_no_interval(void)
+{
+	RunTimeShares<2> shares;
+
+	shares.begin(0);
+	TEST_ASSERT_EQUAL_UINT16(0, shares.share(1, 0));
+	shares.end();
+
+	// more tasks than tracked, the extra one is measured from 0 next time
+	shares.begin(100);
+	shares.share(1, 10);
+	shares.share(2, 10);
+	shares.share(3, 10);
+	shares.end();
+
+	shares.begin(200);
+	TEST_ASSERT_EQUAL_UINT16(TASK_SHARE_FULL, shares.share(3, 110));
+	TEST_ASSERT_EQUAL_UINT16(TASK_SHARE_FULL / 2, shares.share(1, 60));
+	shares.end();
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_system_round_trip);
+	RUN_TEST(test_task_round_trip);
+	RUN_TEST(test_shares_between_reports);
+	RUN_TEST(test_shares_across_wrap);
+	RUN_TEST(test_no_interval);
+	return UNITY_END();
+}
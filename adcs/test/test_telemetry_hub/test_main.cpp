@@ -0,0 +1,197 @@
+/**
+ * @brief      Tests for the telemetry hub topics. Checks callback decimation,
+ *             that callbacks get the publisher's sample instead of a copy,
+ *             readers, and compares the sensor reads of one publisher feeding
+ *             every consumer against each consumer reading the sensor itself.
+ */
+#include <unity.h>
+#include <TelemetryHub.h>
+
+#include <stdio.h>
+
+// same size as IMUdata, six floats
+typedef struct
+{
+	float v[6];
+} Sample;
+
+typedef struct
+{
+	uint32_t calls;
+	uint32_t last_seq;
+	const Sample *last_addr;
+	float last_v0;
+} Counter;
+
+static void count(const Sample &s, uint32_t seq, void *context)
+{
+	Counter *c = (Counter *)context;
+	c->calls++;
+	c->last_seq = seq;
+	c->last_addr = &s;
+	c->last_v0 = s.v[0];
+}
+
+static Sample sample(float x)
+{
+	Sample s;
+	for (int i = 0; i < 6; i++)
+		s.v[i] = x;
+	return s;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_decimation(void)
+{
+	Topic<Sample> topic;
+	Counter every = {0}, tenth = {0}, zero = {0};
+
+	TEST_ASSERT_TRUE(topic.subscribe(1, count, &every));
+	TEST_ASSERT_TRUE(topic.subscribe(10, count, &tenth));
+	TEST_ASSERT_TRUE(topic.subscribe(0, count, &zero)); // treated as 1
+	TEST_ASSERT_EQUAL_UINT8(3, topic.subscribers());
+
+	for (int i = 1; i <= 95; i++)
+		topic.publish(sample((float)i));
+
+	TEST_ASSERT_EQUAL_UINT32(95, every.calls);
+	TEST_ASSERT_EQUAL_UINT32(95, zero.calls);
+	TEST_ASSERT_EQUAL_UINT32(9, tenth.calls);
+
+	// the tenth subscriber saw samples 10, 20, ... 90
+	TEST_ASSERT_EQUAL_UINT32(90, tenth.last_seq);
+	TEST_ASSERT_EQUAL_FLOAT(90.0f, tenth.last_v0);
+	TEST_ASSERT_EQUAL_UINT32(95, every.last_seq);
+}
+
+void test_callbacks_get_publisher_sample(void)
+{
+	Topic<Sample> topic;
+	Counter a = {0}, b = {0};
+	Sample s = sample(3.0f);
+
+	topic.subscribe(1, count, &a);
+	topic.subscribe(1, count, &b);
+	topic.publish(s);
+
+	TEST_ASSERT_EQUAL_PTR(&s, a.last_addr);
+	TEST_ASSERT_EQUAL_PTR(&s, b.last_addr);
+}
+
+void test_subscriber_limit(void)
+{
+	Topic<Sample, 2> topic;
+	Counter c = {0};
+
+	TEST_ASSERT_TRUE(topic.subscribe(1, count, &c));
+	TEST_ASSERT_TRUE(topic.subscribe(1, count, &c));
+	TEST_ASSERT_FALSE(topic.subscribe(1, count, &c));
+	TEST_ASSERT_FALSE(Topic<Sample>().subscribe(1, NULL));
+	TEST_ASSERT_EQUAL_UINT8(2, topic.subscribers());
+
+	topic.publish(sample(1.0f));
+	TEST_ASSERT_EQUAL_UINT32(2, c.calls);
+}
+
+void test_readers(void)
+{
+	Topic<Sample> topic;
+	Sample s;
+	uint32_t last = 0;
+
+	TEST_ASSERT_EQUAL_UINT32(0, topic.read(s));
+	TEST_ASSERT_FALSE(topic.readIfNewer(s, last));
+
+	topic.publish(sample(1.0f));
+	topic.publish(sample(2.0f));
+	TEST_ASSERT_TRUE(topic.readIfNewer(s, last));
+	TEST_ASSERT_EQUAL_UINT32(2, last);
+	TEST_ASSERT_EQUAL_FLOAT(2.0f, s.v[5]);
+	TEST_ASSERT_FALSE(topic.readIfNewer(s, last));
+	TEST_ASSERT_EQUAL_UINT32(2, topic.sequence());
+}
+
+/* BUS TRAFFIC ============================================================== */
+
+// stands in for an IMU on the I2C bus, counts transactions
+typedef struct
+{
+	uint32_t reads;
+	float value;
+} FakeSensor;
+
+static Sample readSensor(FakeSensor &sensor)
+{
+	sensor.reads++;
+	sensor.value += 1.0f;
+	return sample(sensor.value);
+}
+
+/**
+ * The IMU is read at 200 Hz. Consumers: batch frames every sample, detumble
+ * every sample, the heartbeat at 2 Hz and the debug printer at 1 Hz.
+ */
+void test_bus_transactions(void)
+{
+	const uint32_t RATE_HZ = 200;
+	const uint32_t SECONDS = 10;
+	const uint16_t decimations[] = {1, 1, RATE_HZ / 2, RATE_HZ};
+	const uint8_t consumers = sizeof(decimations) / sizeof(decimations[0]);
+
+	// point to point: every consumer reads the sensor at its own rate
+	FakeSensor direct = {0, 0.0f};
+	uint32_t direct_samples = 0;
+	for (uint32_t t = 1; t <= RATE_HZ * SECONDS; t++)
+	{
+		for (uint8_t i = 0; i < consumers; i++)
+		{
+			if (t % decimations[i] == 0)
+			{
+				readSensor(direct);
+				direct_samples++;
+			}
+		}
+	}
+
+	// hub: one read per sample, fanned out to the subscribers
+	FakeSensor hubbed = {0, 0.0f};
+	Topic<Sample> topic;
+	Counter counters[consumers] = {};
+	for (uint8_t i = 0; i < consumers; i++)
+		topic.subscribe(decimations[i], count, &counters[i]);
+
+	for (uint32_t t = 1; t <= RATE_HZ * SECONDS; t++)
+		topic.publish(readSensor(hubbed));
+
+	uint32_t hub_samples = 0;
+	for (uint8_t i = 0; i < consumers; i++)
+		hub_samples += counters[i].calls;
+
+	// consumers get the same samples either way
+	TEST_ASSERT_EQUAL_UINT32(direct_samples, hub_samples);
+	TEST_ASSERT_EQUAL_UINT32(RATE_HZ * SECONDS, hubbed.reads);
+	TEST_ASSERT_LESS_THAN_UINT32(direct.reads, hubbed.reads);
+
+	char msg[128];
+	snprintf(msg, sizeof(msg), "%u consumers, sensor reads/s: point to point %lu, hub %lu", consumers,
+			 (unsigned long)(direct.reads / SECONDS), (unsigned long)(hubbed.reads / SECONDS));
+	TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_decimation);
+	RUN_TEST(test_callbacks_get_publisher_sample);
+	RUN_TEST(test_subscriber_limit);
+	RUN_TEST(test_readers);
+	RUN_TEST(test_bus_transactions);
+	return UNITY_END();
+}
@@ -0,0 +1,174 @@
+/**
+ * @brief      Tests for the latency trace. Events are recorded into the ring
+ *             buffer and encoded, and interleaved passes through the paths are
+ *             rebuilt by the matcher.
+ */
+#include <unity.h>
+#include <Trace.h>
+
+#include <string.h>
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static uint8_t pathIndex(const char *name)
+{
+	for (uint8_t p = 0; p < TRACE_NUM_PATHS; p++)
+	{
+		if (strcmp(trace_paths[p].name, name) == 0)
+			return p;
+	}
+
+	TEST_FAIL_MESSAGE("no such path");
+	return 0;
+}
+
+static TraceEvent event(uint8_t point, uint16_t tag)
+{
+	TraceEvent e;
+	e.cycles = 0;
+	e.point = point;
+	e.task = 1;
+	e.tag = tag;
+	return e;
+}
+
+void test_encode_decode(void)
+{
+	TraceEvent e = {0x89abcdef, TP_WHEEL_OUTPUT, 7, 0xbeef};
+	uint8_t buf[TRACE_EVENT_LEN];
+
+	encodeTraceEvent(e, buf);
+	TEST_ASSERT_EQUAL_HEX8(0xef, buf[0]);
+	TEST_ASSERT_EQUAL_HEX8(0x89, buf[3]);
+	TEST_ASSERT_EQUAL_HEX8(TP_WHEEL_OUTPUT, buf[4]);
+	TEST_ASSERT_EQUAL_HEX8(0xef, buf[6]);
+
+	TraceEvent d = decodeTraceEvent(buf);
+	TEST_ASSERT_EQUAL_HEX32(e.cycles, d.cycles);
+	TEST_ASSERT_EQUAL_UINT8(e.point, d.point);
+	TEST_ASSERT_EQUAL_UINT8(e.task, d.task);
+	TEST_ASSERT_EQUAL_HEX16(e.tag, d.tag);
+}
+
+void test_buffer_keeps_latest(void)
+{
+	TraceBuffer<8> buf;
+
+	for (uint16_t i = 0; i < 5; i++)
+		buf.record(100 + i, TP_IMU_READ, 1, i);
+	TEST_ASSERT_EQUAL_UINT16(5, buf.size());
+	TEST_ASSERT_EQUAL_UINT32(0, buf.overwritten());
+	TEST_ASSERT_EQUAL_UINT16(0, buf[0].tag);
+
+	for (uint16_t i = 5; i < 20; i++)
+		buf.record(100 + i, TP_IMU_READ, 1, i);
+	TEST_ASSERT_EQUAL_UINT16(8, buf.size());
+	TEST_ASSERT_EQUAL_UINT32(12, buf.overwritten());
+
+	// oldest first
+	for (uint16_t i = 0; i < 8; i++)
+	{
+		TEST_ASSERT_EQUAL_UINT16(12 + i, buf[i].tag);
+		TEST_ASSERT_EQUAL_UINT32(112 + i, buf[i].cycles);
+	}
+
+	buf.clear();
+	TEST_ASSERT_EQUAL_UINT16(0, buf.size());
+}
+
+void test_clock_unwraps(void)
+{
+	TraceClock clock;
+
+	TEST_ASSERT_EQUAL_UINT64(0, clock.unwrap(0xfffffff0));
+	TEST_ASSERT_EQUAL_UINT64(0x10, clock.unwrap(0));
+	TEST_ASSERT_EQUAL_UINT64(0x20, clock.unwrap(0x10));
+	TEST_ASSERT_EQUAL_UINT64(0x100000000ULL, clock.unwrap(0xfffffff0));
+}
+
+void test_interleaved_passes(void)
+{
+	TracePathMatcher matcher;
+	TracePass done[TRACE_NUM_PATHS];
+	uint8_t wheel = pathIndex("imu_to_wheel");
+	uint8_t read = pathIndex("imu_read");
+
+	// sample 1 is read, sample 2 is read before the detumble loop picks up 1
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(0, event(TP_IMU_READ, 1), done));
+	TEST_ASSERT_EQUAL_UINT8(1, matcher.push(10, event(TP_IMU_SAMPLE, 1), done));
+	TEST_ASSERT_EQUAL_UINT8(read, done[0].path);
+	TEST_ASSERT_EQUAL_UINT64(10, done[0].times[1] - done[0].times[0]);
+
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(12, event(TP_IMU_PUBLISH, 1), done));
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(50, event(TP_IMU_READ, 2), done));
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(55, event(TP_DETUMBLE_INPUT, 1), done));
+	TEST_ASSERT_EQUAL_UINT8(1, matcher.push(60, event(TP_IMU_SAMPLE, 2), done));
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(62, event(TP_IMU_PUBLISH, 2), done));
+
+	TEST_ASSERT_EQUAL_UINT8(1, matcher.push(70, event(TP_WHEEL_OUTPUT, 1), done));
+	TEST_ASSERT_EQUAL_UINT8(wheel, done[0].path);
+	TEST_ASSERT_EQUAL_UINT16(1, done[0].tag);
+	TEST_ASSERT_EQUAL_UINT64(0, done[0].times[0]);
+	TEST_ASSERT_EQUAL_UINT64(12, done[0].times[1]);
+	TEST_ASSERT_EQUAL_UINT64(55, done[0].times[2]);
+	TEST_ASSERT_EQUAL_UINT64(70, done[0].times[3]);
+
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(80, event(TP_DETUMBLE_INPUT, 2), done));
+	TEST_ASSERT_EQUAL_UINT8(1, matcher.push(81, event(TP_WHEEL_OUTPUT, 2), done));
+	TEST_ASSERT_EQUAL_UINT64(50, done[0].times[0]);
+}
+
+void test_points_out_of_order_ignored(void)
+{
+	TracePathMatcher matcher;
+	TracePass done[TRACE_NUM_PATHS];
+
+	// a sample the detumble loop skipped never completes, nor does a tag
+	// that was never started
+	matcher.push(0, event(TP_IMU_READ, 3), done);
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(5, event(TP_DETUMBLE_INPUT, 3), done));
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(6, event(TP_WHEEL_OUTPUT, 3), done));
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(7, event(TP_MODE_ENTERED, 0xa4), done));
+
+	matcher.push(10, event(TP_COMMAND_FRAME, 0xa4), done);
+	TEST_ASSERT_EQUAL_UINT8(0, matcher.push(11, event(TP_MODE_ENTERED, 0xc0), done));
+	TEST_ASSERT_EQUAL_UINT8(1, matcher.push(12, event(TP_MODE_ENTERED, 0xa4), done));
+	TEST_ASSERT_EQUAL_UINT8(pathIndex("command"), done[0].path);
+}
+
+void test_restart_and_evict(void)
+{
+	TracePathMatcher matcher;
+	TracePass done[TRACE_NUM_PATHS];
+
+	// a pass started again with the same tag measures from the new start
+	matcher.push(0, event(TP_COMMAND_FRAME, 0xa0), done);
+	matcher.push(100, event(TP_COMMAND_FRAME, 0xa0), done);
+	TEST_ASSERT_EQUAL_UINT8(1, matcher.push(110, event(TP_MODE_ENTERED, 0xa0), done));
+	TEST_ASSERT_EQUAL_UINT64(100, done[0].times[0]);
+
+	// more passes in flight than slots, the matcher keeps going
+	for (uint16_t tag = 0; tag < 3 * TRACE_PATH_IN_FLIGHT; tag++)
+		matcher.push(200 + tag, event(TP_COMMAND_FRAME, tag), done);
+	uint16_t last = 3 * TRACE_PATH_IN_FLIGHT - 1;
+	TEST_ASSERT_EQUAL_UINT8(1, matcher.push(300, event(TP_MODE_ENTERED, last), done));
+	TEST_ASSERT_EQUAL_UINT16(last, done[0].tag);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_encode_decode);
+	RUN_TEST(test_buffer_keeps_latest);
+	RUN_TEST(test_clock_unwraps);
+	RUN_TEST(test_interleaved_passes);
+	RUN_TEST(test_points_out_of_order_ignored);
+	RUN_TEST(test_restart_and_evict);
+	return UNITY_END();
+}
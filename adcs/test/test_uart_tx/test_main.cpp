@@ -0,0 +1,306 @@
+/**
+ * @brief      Tests for the transmit buffer pool behind ADCSdata::send, and a
+ *             simulation of the 115200 baud UART that measures how long a
+ *             producer task is blocked per packet with a synchronous write
+ *             compared to the pool and interrupt driven transmitter.
+ */
+#include <unity.h>
+#include <PacketPool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define PACKET_LEN 30
+#define TX_POOL_LEN 4
+
+// 8O1 framing, 11 bits per byte at 115200 baud
+#define BYTE_TIME std::chrono::nanoseconds(11 * 1000000000LL / 115200)
+
+typedef PacketPool<TX_POOL_LEN, PACKET_LEN> Pool;
+typedef std::chrono::steady_clock Clock;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void fill(uint8_t *buf, uint8_t producer, uint32_t n)
+{
+	memset(buf, 0, PACKET_LEN);
+	buf[0] = producer;
+	memcpy(buf + 1, &n, sizeof(n));
+}
+
+void test_commit_order(void)
+{
+	Pool pool;
+	uint8_t len;
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		uint8_t *buf = pool.acquire();
+		TEST_ASSERT_NOT_NULL(buf);
+		fill(buf, 0, i);
+		pool.commit(buf, PACKET_LEN - i);
+	}
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		const uint8_t *buf = pool.next(len);
+		TEST_ASSERT_NOT_NULL(buf);
+		TEST_ASSERT_EQUAL_UINT8(i, buf[1]);
+		TEST_ASSERT_EQUAL_UINT8(PACKET_LEN - i, len);
+		pool.complete();
+	}
+
+	TEST_ASSERT_NULL(pool.next(len));
+	TEST_ASSERT_EQUAL_UINT32(3, pool.sent());
+	TEST_ASSERT_EQUAL_UINT8(0, pool.busy());
+}
+
+void test_full_pool_drops(void)
+{
+	Pool pool;
+	uint8_t *bufs[TX_POOL_LEN];
+
+	for (int i = 0; i < TX_POOL_LEN; i++)
+		TEST_ASSERT_NOT_NULL(bufs[i] = pool.acquire());
+
+	TEST_ASSERT_NULL(pool.acquire());
+	TEST_ASSERT_EQUAL_UINT32(1, pool.dropped());
+
+	// a released buffer can be acquired again
+	pool.release(bufs[2]);
+	TEST_ASSERT_TRUE(pool.acquire() == bufs[2]);
+	TEST_ASSERT_EQUAL_UINT8(TX_POOL_LEN, pool.busy());
+}
+
+void test_filling_buffer_not_sent(void)
+{
+	Pool pool;
+	uint8_t len;
+	int owner;
+
+	uint8_t *a = pool.acquire();
+	uint8_t *b = pool.acquire();
+	pool.commit(b, PACKET_LEN, &owner);
+
+	// a is still being filled, only b goes out
+	TEST_ASSERT_TRUE(pool.next(len) == b);
+	TEST_ASSERT_TRUE(pool.complete() == &owner);
+	TEST_ASSERT_NULL(pool.next(len));
+
+	pool.commit(a, PACKET_LEN);
+	TEST_ASSERT_TRUE(pool.next(len) == a);
+	TEST_ASSERT_NULL(pool.complete());
+}
+
+/**
+ * @brief      Several producers and one transmitter. Nothing may be lost or
+ *             duplicated and each producer's packets must stay in order.
+ */
+void test_concurrent_producers(void)
+{
+	const int PRODUCERS = 3;
+	const uint32_t PACKETS = 20000;
+
+	Pool pool;
+	std::atomic<int> running(PRODUCERS);
+	uint32_t accepted[PRODUCERS] = {0};
+	std::vector<uint32_t> received[PRODUCERS];
+
+	std::thread transmitter([&]() {
+		uint8_t len;
+		while (running.load() > 0 || pool.busy() > 0)
+		{
+			const uint8_t *buf = pool.next(len);
+			if (buf == NULL)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			uint32_t n;
+			memcpy(&n, buf + 1, sizeof(n));
+			received[buf[0]].push_back(n);
+			pool.complete();
+		}
+	});
+
+	std::vector<std::thread> producers;
+	for (int p = 0; p < PRODUCERS; p++)
+	{
+		producers.push_back(std::thread([&, p]() {
+			for (uint32_t n = 0; n < PACKETS; n++)
+			{
+				uint8_t *buf = pool.acquire();
+				if (buf == NULL)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				fill(buf, p, n);
+				pool.commit(buf, PACKET_LEN);
+				accepted[p]++;
+			}
+			running--;
+		}));
+	}
+
+	for (size_t p = 0; p < producers.size(); p++)
+		producers[p].join();
+	transmitter.join();
+
+	uint32_t total = 0;
+	for (int p = 0; p < PRODUCERS; p++)
+	{
+		TEST_ASSERT_EQUAL_UINT32(accepted[p], received[p].size());
+		TEST_ASSERT_TRUE(std::is_sorted(received[p].begin(), received[p].end()));
+		TEST_ASSERT_TRUE(std::adjacent_find(received[p].begin(), received[p].end()) == received[p].end());
+		total += accepted[p];
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(total, pool.sent());
+	TEST_ASSERT_EQUAL_UINT32(PRODUCERS * PACKETS, pool.sent() + pool.dropped());
+}
+
+/**
+ * @brief      UART with one byte transmit register, a byte occupies the wire
+ *             for BYTE_TIME. write() returns once the byte is accepted.
+ */
+class SimUART
+{
+private:
+	Clock::time_point _free;
+
+public:
+	SimUART() : _free(Clock::now()) {}
+
+	void write(uint8_t)
+	{
+		// sleep_until is too coarse for a 95 us byte
+		while (Clock::now() < _free)
+			std::this_thread::yield();
+
+		_free = std::max(Clock::now(), _free) + BYTE_TIME;
+	}
+};
+
+typedef struct
+{
+	double avg_us;
+	double max_us;
+} Blocking;
+
+static Blocking measure(std::vector<double> &samples)
+{
+	Blocking b = {0, 0};
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		b.avg_us += samples[i];
+		b.max_us = std::max(b.max_us, samples[i]);
+	}
+	b.avg_us /= samples.size();
+	return b;
+}
+
+void test_blocking_time(void)
+{
+	const int PACKETS = 40;
+	uint8_t packet[PACKET_LEN];
+	std::vector<double> sync_us, async_us;
+	char msg[96];
+
+	// before: the producer writes every byte itself
+	{
+		SimUART uart;
+		for (int i = 0; i < PACKETS; i++)
+		{
+			fill(packet, 0, i);
+			Clock::time_point start = Clock::now();
+			for (int j = 0; j < PACKET_LEN; j++)
+				uart.write(packet[j]);
+			sync_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+		}
+	}
+
+	// after: the producer fills a pool buffer, the transmitter (interrupt)
+	// feeds the UART and notifies the producer when the packet is out
+	{
+		Pool pool;
+		std::atomic<bool> done(false);
+		std::atomic<int> notified(0);
+
+		std::thread transmitter([&]() {
+			SimUART uart;
+			uint8_t len;
+			while (!done.load() || pool.busy() > 0)
+			{
+				const uint8_t *buf = pool.next(len);
+				if (buf == NULL)
+				{
+					std::this_thread::sleep_for(BYTE_TIME);
+					continue;
+				}
+
+				for (int j = 0; j < len; j++)
+					uart.write(buf[j]);
+
+				if (pool.complete() != NULL)
+					notified++;
+			}
+		});
+
+		int sent = 0;
+		for (int i = 0; i < PACKETS; i++)
+		{
+			Clock::time_point start = Clock::now();
+			uint8_t *buf = pool.acquire();
+			if (buf != NULL)
+			{
+				fill(buf, 0, i);
+				pool.commit(buf, PACKET_LEN, &notified);
+				sent++;
+			}
+			async_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+
+			// producers run slower than the wire, like the 500 ms heartbeat
+			std::this_thread::sleep_for(BYTE_TIME * PACKET_LEN * 2);
+		}
+
+		done = true;
+		transmitter.join();
+		TEST_ASSERT_EQUAL_INT(sent, notified.load());
+		TEST_ASSERT_EQUAL_INT(PACKETS, sent);
+	}
+
+	Blocking before = measure(sync_us);
+	Blocking after = measure(async_us);
+
+	snprintf(msg, sizeof(msg), "synchronous write: %.1f us avg, %.1f us max blocked per packet", before.avg_us, before.max_us);
+	TEST_MESSAGE(msg);
+	snprintf(msg, sizeof(msg), "packet pool: %.2f us avg, %.2f us max blocked per packet", after.avg_us, after.max_us);
+	TEST_MESSAGE(msg);
+
+	TEST_ASSERT_TRUE(after.avg_us * 10 < before.avg_us);
+}
+
+int main(int argc, char **argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_commit_order);
+	RUN_TEST(test_full_pool_drops);
+	RUN_TEST(test_filling_buffer_not_sent);
+	RUN_TEST(test_concurrent_producers);
+	RUN_TEST(test_blocking_time);
+	return UNITY_END();
+}
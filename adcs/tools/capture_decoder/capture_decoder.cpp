@@ -0,0 +1,482 @@
+/**
+ * @brief      Decodes heartbeats from raw captures of the ADCS UART stream.
+ * @details    The capture is memory mapped and scanned for frames with
+ *             CaptureScanner.h. Heartbeat fields are unpacked straight from the
+ *             mapped bytes with the field table in HeartbeatSchema.h, so the
+ *             decoder always matches the firmware it was built with. Large
+ *             captures are split into blocks decoded by several threads, the
+ *             output is written in capture order.
+ *
+ *             Output formats:
+ *               csv  one row per heartbeat: byte offset of the frame in the
+ *                    capture, then every field in physical units
+ *               col  a directory with one little endian file per column,
+ *                    offset.u64 and <FIELD>.i32 raw field values, e.g. for
+ *                    numpy.fromfile
+ *
+ *             Build and run on a PC from the adcs folder:
+ *
+ *               g++ -O2 -std=gnu++11 -pthread -Ilib/ADCSComm/src -Ilib/CRC tools/capture_decoder/capture_decoder.cpp -o capture_decoder
+ *               ./capture_decoder -f csv -o run1.csv run1.bin
+ *               ./capture_decoder --bench 1024
+ */
+#include <CaptureScanner.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// TX_FRAME_LEN in include/comm.h, longest frame the firmware sends
+#define FRAME_LEN 128
+
+// bytes of capture decoded by one thread at a time
+#define BLOCK_LEN (16UL << 20)
+
+enum OutputFormat
+{
+	OUTPUT_CSV,
+	OUTPUT_COLUMNS,
+	OUTPUT_NONE, // decode only, for the benchmark
+};
+
+/* DECODING ================================================================= */
+
+/**
+ * @brief      Scanner visitor collecting the heartbeats of one block as columns
+ */
+class ColumnSink
+{
+public:
+	size_t rows;
+	std::vector<uint64_t> offset;
+	std::vector<int32_t> field[HB_NUM_FIELDS];
+
+	ColumnSink() : rows(0) {}
+
+	/**
+	 * @brief      Drop all rows and make room for max_rows, so adding a row
+	 *             never reallocates
+	 */
+	void reset(size_t max_rows)
+	{
+		rows = 0;
+		offset.resize(max_rows);
+		for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+			field[f].resize(max_rows);
+	}
+
+	void heartbeat(uint64_t pos, const uint8_t *frame)
+	{
+		int32_t values[HB_NUM_FIELDS];
+		unpackHeartbeat(frame, values);
+
+		offset[rows] = pos;
+		for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+			field[f][rows] = values[f];
+		rows++;
+	}
+
+	void batch(uint64_t, const uint8_t *, uint8_t) {}
+};
+
+/**
+ * @brief      One block of the capture and its decoded heartbeats
+ */
+typedef struct
+{
+	size_t begin;
+	size_t end;
+	ColumnSink columns;
+	std::string csv;
+	CaptureStats stats;
+} Block;
+
+static void formatCSV(Block &block)
+{
+	char line[32 * (HB_NUM_FIELDS + 1)];
+
+	block.csv.clear();
+	for (size_t row = 0; row < block.columns.rows; row++)
+	{
+		int n = snprintf(line, sizeof(line), "%llu", (unsigned long long)block.columns.offset[row]);
+
+		for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+		{
+			int32_t v = block.columns.field[f][row];
+
+			if (heartbeat_schema[f].scale == 1.0f)
+				n += snprintf(line + n, sizeof(line) - n, ",%d", v);
+			else
+				n += snprintf(line + n, sizeof(line) - n, ",%g", v * heartbeat_schema[f].scale);
+		}
+
+		line[n++] = '\n';
+		block.csv.append(line, n);
+	}
+}
+
+static void decodeBlock(const uint8_t *data, size_t len, const StatusSet &status, OutputFormat format, Block &block)
+{
+	// heartbeats start at least HEARTBEAT_LEN bytes apart
+	block.columns.reset((block.end - block.begin + HEARTBEAT_LEN - 1) / HEARTBEAT_LEN);
+	block.stats = scanCapture(data, len, block.begin, block.end, status, block.columns);
+
+	if (format == OUTPUT_CSV)
+		formatCSV(block);
+}
+
+/* OUTPUT =================================================================== */
+
+class Output
+{
+private:
+	OutputFormat _format;
+	FILE *_csv;
+	FILE *_columns[HB_NUM_FIELDS + 1];
+
+public:
+	Output() : _format(OUTPUT_NONE), _csv(NULL)
+	{
+		memset(_columns, 0, sizeof(_columns));
+	}
+
+	bool open(OutputFormat format, const char *path)
+	{
+		_format = format;
+
+		if (format == OUTPUT_CSV)
+		{
+			_csv = (path == NULL) ? stdout : fopen(path, "w");
+			if (_csv == NULL)
+				return false;
+
+			fprintf(_csv, "offset");
+			for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+				fprintf(_csv, ",%s", heartbeat_schema[f].name);
+			fprintf(_csv, "\n");
+		}
+		else if (format == OUTPUT_COLUMNS)
+		{
+			if (path == NULL || (mkdir(path, 0777) != 0 && errno != EEXIST))
+				return false;
+
+			std::string dir(path);
+			_columns[0] = fopen((dir + "/offset.u64").c_str(), "wb");
+			for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+				_columns[f + 1] = fopen((dir + "/" + heartbeat_schema[f].name + ".i32").c_str(), "wb");
+
+			for (uint8_t c = 0; c <= HB_NUM_FIELDS; c++)
+			{
+				if (_columns[c] == NULL)
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	void write(const Block &block)
+	{
+		if (_format == OUTPUT_CSV)
+		{
+			fwrite(block.csv.data(), 1, block.csv.size(), _csv);
+		}
+		else if (_format == OUTPUT_COLUMNS)
+		{
+			const ColumnSink &c = block.columns;
+
+			fwrite(c.offset.data(), sizeof(uint64_t), c.rows, _columns[0]);
+			for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+				fwrite(c.field[f].data(), sizeof(int32_t), c.rows, _columns[f + 1]);
+		}
+	}
+
+	void close()
+	{
+		if (_csv != NULL && _csv != stdout)
+			fclose(_csv);
+		for (uint8_t c = 0; c <= HB_NUM_FIELDS; c++)
+		{
+			if (_columns[c] != NULL)
+				fclose(_columns[c]);
+		}
+	}
+};
+
+/**
+ * @brief      Decode a whole capture, up to threads blocks at a time
+ *
+ * @return     Counts for the whole capture
+ */
+static CaptureStats decodeCapture(const uint8_t *data, size_t len, unsigned threads, OutputFormat format, Output &out)
+{
+	StatusSet status(heartbeat_status_codes, sizeof(heartbeat_status_codes));
+	CaptureStats total = {0, 0, 0};
+	std::vector<Block> blocks(threads);
+
+	for (size_t start = 0; start < len; start += threads * BLOCK_LEN)
+	{
+		std::vector<std::thread> workers;
+		unsigned used = 0;
+
+		for (; used < threads && start + used * BLOCK_LEN < len; used++)
+		{
+			Block &b = blocks[used];
+			b.begin = start + used * BLOCK_LEN;
+			b.end = (b.begin + BLOCK_LEN < len) ? b.begin + BLOCK_LEN : len;
+
+			if (threads == 1)
+				decodeBlock(data, len, status, format, b);
+			else
+				workers.push_back(std::thread(decodeBlock, data, len, std::cref(status), format, std::ref(b)));
+		}
+
+		for (size_t w = 0; w < workers.size(); w++)
+			workers[w].join();
+
+		for (unsigned i = 0; i < used; i++)
+		{
+			out.write(blocks[i]);
+			total.heartbeats += blocks[i].stats.heartbeats;
+			total.batches += blocks[i].stats.batches;
+			total.bad_bytes += blocks[i].stats.bad_bytes;
+		}
+	}
+
+	return total;
+}
+
+static const uint8_t *mapFile(const char *path, size_t &len)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	len = (size_t)st.st_size;
+	void *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	madvise(data, len, MADV_SEQUENTIAL);
+	return (const uint8_t *)data;
+}
+
+/* BENCHMARK ================================================================ */
+
+/**
+ * @brief      Write a synthetic capture: heartbeats with random fields, an IMU
+ *             batch frame after every 8th heartbeat and a few noise bytes
+ */
+static bool writeSyntheticCapture(const char *path, size_t mb)
+{
+	const size_t tile_len = 4UL << 20;
+	std::vector<uint8_t> tile;
+	std::mt19937 rng(0xadc5);
+
+	tile.reserve(tile_len + FRAME_LEN);
+	while (tile.size() < tile_len)
+	{
+		for (int h = 0; h < 8; h++)
+		{
+			int32_t values[HB_NUM_FIELDS];
+			uint8_t packet[HEARTBEAT_LEN] = {0};
+
+			for (uint8_t f = 0; f < HB_NUM_FIELDS; f++)
+			{
+				const FieldSpec &spec = heartbeat_schema[f];
+				values[f] = (int32_t)(fieldMin(spec.bits, spec.is_signed) +
+									  rng() % (fieldMax(spec.bits, spec.is_signed) - fieldMin(spec.bits, spec.is_signed) + 1));
+			}
+			values[HB_STATUS] = heartbeat_status_codes[rng() % sizeof(heartbeat_status_codes)];
+
+			packFields(heartbeat_schema, HB_NUM_FIELDS, values, packet);
+			uint16_t crc = capture_crc::calculate(packet, HEARTBEAT_PAYLOAD_LEN);
+			packet[HEARTBEAT_PAYLOAD_LEN] = crc & 0xff;
+			packet[HEARTBEAT_PAYLOAD_LEN + 1] = crc >> 8;
+			tile.insert(tile.end(), packet, packet + HEARTBEAT_LEN);
+		}
+
+		SampleBatchEncoder<FRAME_LEN> encoder(16);
+		BatchSample s;
+		encoder.begin(5);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint8_t c = 0; c < BATCH_CHANNELS; c++)
+				s.v[c] = (int16_t)(rng() % 64);
+			encoder.add(s, i * 5);
+		}
+		uint8_t len;
+		const uint8_t *frame = encoder.finish(len);
+		tile.insert(tile.end(), frame, frame + len);
+
+		if (rng() % 16 == 0)
+			tile.push_back((uint8_t)rng());
+	}
+
+	FILE *f = fopen(path, "wb");
+	if (f == NULL)
+		return false;
+
+	size_t written = 0;
+	while (written < mb << 20)
+	{
+		size_t n = std::min(tile.size(), (mb << 20) - written);
+		if (fwrite(tile.data(), 1, n, f) != n)
+		{
+			fclose(f);
+			return false;
+		}
+		written += n;
+	}
+
+	return fclose(f) == 0;
+}
+
+static int benchmark(size_t mb, unsigned threads)
+{
+	const char *path = "capture_decoder_bench.bin";
+
+	fprintf(stderr, "writing %zu MB synthetic capture to %s\n", mb, path);
+	if (!writeSyntheticCapture(path, mb))
+	{
+		perror(path);
+		return 1;
+	}
+
+	size_t len;
+	const uint8_t *data = mapFile(path, len);
+	if (data == NULL)
+	{
+		perror(path);
+		return 1;
+	}
+
+	// first pass faults the file into the page cache
+	Output none;
+	decodeCapture(data, len, threads, OUTPUT_NONE, none);
+
+	unsigned counts[] = {1, threads};
+	for (unsigned i = 0; i < (threads > 1 ? 2u : 1u); i++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		CaptureStats stats = decodeCapture(data, len, counts[i], OUTPUT_NONE, none);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		printf("%u thread(s): %.2f GB/s, %llu heartbeats, %llu batch frames, %llu bad bytes\n",
+			   counts[i], len / elapsed.count() / 1e9, (unsigned long long)stats.heartbeats,
+			   (unsigned long long)stats.batches, (unsigned long long)stats.bad_bytes);
+	}
+
+	munmap((void *)data, len);
+	unlink(path);
+	return 0;
+}
+
+/* MAIN ===================================================================== */
+
+static void usage(void)
+{
+	fprintf(stderr,
+			"usage: capture_decoder [-f csv|col] [-o output] [-t threads] capture.bin\n"
+			"       capture_decoder --bench [size_mb] [-t threads]\n");
+}
+
+int main(int argc, char **argv)
+{
+	OutputFormat format = OUTPUT_CSV;
+	const char *out_path = NULL;
+	const char *in_path = NULL;
+	unsigned threads = std::thread::hardware_concurrency();
+	bool bench = false;
+	size_t bench_mb = 1024;
+
+	if (threads == 0)
+		threads = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+		{
+			i++;
+			if (strcmp(argv[i], "csv") == 0)
+				format = OUTPUT_CSV;
+			else if (strcmp(argv[i], "col") == 0)
+				format = OUTPUT_COLUMNS;
+			else
+			{
+				usage();
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			out_path = argv[++i];
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = (unsigned)atoi(argv[++i]) > 0 ? (unsigned)atoi(argv[i]) : 1;
+		else if (strcmp(argv[i], "--bench") == 0)
+		{
+			bench = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				bench_mb = (size_t)atol(argv[++i]);
+		}
+		else if (argv[i][0] != '-' && in_path == NULL)
+			in_path = argv[i];
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	if (bench)
+		return benchmark(bench_mb, threads);
+
+	if (in_path == NULL)
+	{
+		usage();
+		return 2;
+	}
+
+	size_t len;
+	const uint8_t *data = mapFile(in_path, len);
+	if (data == NULL)
+	{
+		perror(in_path);
+		return 1;
+	}
+
+	Output out;
+	if (!out.open(format, out_path))
+	{
+		perror(out_path ? out_path : "stdout");
+		return 1;
+	}
+
+	CaptureStats stats = decodeCapture(data, len, threads, format, out);
+	out.close();
+	munmap((void *)data, len);
+
+	fprintf(stderr, "%llu heartbeats, %llu batch frames, %llu bad bytes\n", (unsigned long long)stats.heartbeats,
+			(unsigned long long)stats.batches, (unsigned long long)stats.bad_bytes);
+	return 0;
+}
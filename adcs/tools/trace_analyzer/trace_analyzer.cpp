@@ -0,0 +1,376 @@
+/**
+ * @brief      Latency of the hot paths from trace dumps of the ADCS.
+ * @details    Reads a log of the SERCOM_USB debug output holding one or more
+ *             dumps of the trace (CMD_DBG_TRACE), other lines are skipped. The
+ *             passes through every path of Trace.h are rebuilt from the tags,
+ *             and the latency of each path and of each step along it is
+ *             printed as percentiles.
+ *
+ *             With -o the trace is also written as a Chrome trace JSON
+ *             timeline, for chrome://tracing or ui.perfetto.dev: every trace
+ *             point on the track of the task that recorded it, and every pass
+ *             as a span with its steps nested inside, on the track of its
+ *             path.
+ *
+ *             Build and run on a PC from the adcs folder:
+ *
+ *               g++ -O2 -std=gnu++11 -Ilib/ADCSComm/src tools/trace_analyzer/trace_analyzer.cpp -o trace_analyzer
+ *               ./trace_analyzer -o run1.json usb.log
+ */
+#include <Trace.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Events of one dump
+ */
+typedef struct
+{
+	double clock_hz;
+	uint32_t overwritten;
+	std::vector<TraceEvent> events;
+} Dump;
+
+/* PARSING ================================================================== */
+
+/**
+ * @brief      Parse the events of one dump line, 16 hex digits each
+ *
+ * @return     False if the line is not a list of events
+ */
+static bool parseEvents(const char *s, std::vector<TraceEvent> &events)
+{
+	uint8_t buf[TRACE_EVENT_LEN];
+
+	while (*s != '\0' && *s != '\r' && *s != '\n')
+	{
+		if (*s == ' ')
+		{
+			s++;
+			continue;
+		}
+
+		for (uint8_t i = 0; i < TRACE_EVENT_LEN; i++)
+		{
+			unsigned byte;
+			if (sscanf(s, "%2x", &byte) != 1 || strchr("0123456789abcdefABCDEF", s[1]) == NULL)
+				return false;
+			buf[i] = (uint8_t)byte;
+			s += 2;
+		}
+
+		events.push_back(decodeTraceEvent(buf));
+	}
+
+	return true;
+}
+
+/**
+ * @brief      Read every dump in a log
+ *
+ * @param      f      The log
+ * @param      dumps  Receives the dumps, in log order
+ * @param      tasks  Receives the task names by number
+ *
+ * @return     Number of lines that looked like trace lines but did not parse
+ */
+static unsigned readLog(FILE *f, std::vector<Dump> &dumps, std::map<unsigned, std::string> &tasks)
+{
+	char line[512];
+	bool in_dump = false;
+	unsigned bad = 0;
+	const size_t tag_len = strlen(TRACE_LINE_TAG);
+
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		// the tag may follow other output on the same line
+		const char *s = strstr(line, TRACE_LINE_TAG);
+		if (s == NULL)
+			continue;
+		s += tag_len;
+
+		unsigned long hz, count, overwritten;
+		unsigned number;
+		char name[64];
+
+		if (sscanf(s, "begin %lu %lu %lu", &hz, &count, &overwritten) == 3)
+		{
+			Dump d;
+			d.clock_hz = (double)hz;
+			d.overwritten = (uint32_t)overwritten;
+			dumps.push_back(d);
+			in_dump = true;
+		}
+		else if (strncmp(s, "end", 3) == 0)
+			in_dump = false;
+		else if (sscanf(s, "task %u %63[^\r\n]", &number, name) == 2)
+			tasks[number] = name;
+		else if (!in_dump || !parseEvents(s, dumps.back().events))
+			bad++;
+	}
+
+	return bad;
+}
+
+/* LATENCY ================================================================== */
+
+static double percentile(std::vector<double> &v, double p)
+{
+	size_t i = (size_t)(p / 100.0 * (v.size() - 1) + 0.5);
+	std::nth_element(v.begin(), v.begin() + i, v.end());
+	return v[i];
+}
+
+static void printLatency(const std::string &name, std::vector<double> v)
+{
+	if (v.empty())
+	{
+		printf("%-40s %8u\n", name.c_str(), 0u);
+		return;
+	}
+
+	double max = *std::max_element(v.begin(), v.end());
+	double min = *std::min_element(v.begin(), v.end());
+	double p50 = percentile(v, 50);
+	double p90 = percentile(v, 90);
+	double p99 = percentile(v, 99);
+
+	printf("%-40s %8u %10.1f %10.1f %10.1f %10.1f %10.1f\n", name.c_str(), (unsigned)v.size(), min, p50, p90, p99,
+		   max);
+}
+
+/* TIMELINE ================================================================= */
+
+/**
+ * @brief      Chrome trace JSON writer
+ */
+class Timeline
+{
+private:
+	FILE *_f;
+	bool _first;
+
+	void begin(void)
+	{
+		fprintf(_f, _first ? "\n" : ",\n");
+		_first = false;
+	}
+
+public:
+	Timeline() : _f(NULL), _first(true) {}
+
+	bool open(const char *path)
+	{
+		_f = fopen(path, "w");
+		if (_f == NULL)
+			return false;
+		fprintf(_f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+		return true;
+	}
+
+	bool isOpen(void) const { return _f != NULL; }
+
+	void close(void)
+	{
+		if (_f == NULL)
+			return;
+		fprintf(_f, "\n]}\n");
+		fclose(_f);
+		_f = NULL;
+	}
+
+	void name(const char *what, unsigned pid, unsigned tid, const char *name)
+	{
+		begin();
+		fprintf(_f, "{\"name\": \"%s\", \"ph\": \"M\", \"pid\": %u, \"tid\": %u, \"args\": {\"name\": \"%s\"}}", what, pid,
+				tid, name);
+	}
+
+	void instant(const char *name, double us, unsigned pid, unsigned tid, unsigned tag)
+	{
+		begin();
+		fprintf(_f,
+				"{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, \"pid\": %u, \"tid\": %u, \"args\": {\"tag\": %u}}",
+				name, us, pid, tid, tag);
+	}
+
+	// nestable async span, spans with the same id nest
+	void span(const char *name, char ph, double us, unsigned pid, unsigned tid, unsigned long id)
+	{
+		begin();
+		fprintf(_f, "{\"name\": \"%s\", \"cat\": \"path\", \"ph\": \"%c\", \"id\": %lu, \"ts\": %.3f, \"pid\": %u, \"tid\": %u}",
+				name, ph, id, us, pid, tid);
+	}
+};
+
+#define PID_TASKS 1
+#define PID_PATHS 2
+
+/* MAIN ===================================================================== */
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: trace_analyzer [-o timeline.json] usb.log\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *in_path = NULL;
+	const char *json_path = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			json_path = argv[++i];
+		else if (argv[i][0] != '-' && in_path == NULL)
+			in_path = argv[i];
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	if (in_path == NULL)
+	{
+		usage();
+		return 2;
+	}
+
+	FILE *f = fopen(in_path, "r");
+	if (f == NULL)
+	{
+		perror(in_path);
+		return 1;
+	}
+
+	std::vector<Dump> dumps;
+	std::map<unsigned, std::string> tasks;
+	unsigned bad = readLog(f, dumps, tasks);
+	fclose(f);
+
+	if (dumps.empty())
+	{
+		fprintf(stderr, "%s: no trace dump found\n", in_path);
+		return 1;
+	}
+
+	Timeline timeline;
+	if (json_path != NULL && !timeline.open(json_path))
+	{
+		perror(json_path);
+		return 1;
+	}
+
+	// latency of each path, then of each of its steps, in us
+	std::vector<double> latency[TRACE_NUM_PATHS][TRACE_PATH_MAX_POINTS];
+	std::map<unsigned, bool> seen_tasks;
+	unsigned long events = 0, overwritten = 0, passes = 0;
+
+	// one clock over all dumps, they follow each other by much less than a
+	// wrap of the cycle counter
+	TraceClock clock;
+	uint64_t origin = 0;
+	bool have_origin = false;
+
+	for (size_t d = 0; d < dumps.size(); d++)
+	{
+		// the buffer starts over after each dump, so do the paths
+		TracePathMatcher matcher;
+		TracePass done[TRACE_NUM_PATHS];
+		double us_per_cycle = 1e6 / dumps[d].clock_hz;
+
+		events += dumps[d].events.size();
+		overwritten += dumps[d].overwritten;
+
+		for (size_t i = 0; i < dumps[d].events.size(); i++)
+		{
+			const TraceEvent &e = dumps[d].events[i];
+			uint64_t t = clock.unwrap(e.cycles);
+
+			if (!have_origin)
+			{
+				origin = t;
+				have_origin = true;
+			}
+
+			if (timeline.isOpen() && e.point < TP_NUM_POINTS)
+			{
+				timeline.instant(trace_point_names[e.point], (t - origin) * us_per_cycle, PID_TASKS, e.task, e.tag);
+				seen_tasks[e.task] = true;
+			}
+
+			uint8_t n = matcher.push(t, e, done);
+			for (uint8_t k = 0; k < n; k++)
+			{
+				const TracePath &path = trace_paths[done[k].path];
+				const uint64_t *times = done[k].times;
+
+				latency[done[k].path][0].push_back((times[path.len - 1] - times[0]) * us_per_cycle);
+				for (uint8_t s = 1; s < path.len; s++)
+					latency[done[k].path][s].push_back((times[s] - times[s - 1]) * us_per_cycle);
+
+				if (timeline.isOpen())
+				{
+					timeline.span(path.name, 'b', (times[0] - origin) * us_per_cycle, PID_PATHS, done[k].path, passes);
+					for (uint8_t s = 1; s < path.len; s++)
+					{
+						const char *step = trace_point_names[path.points[s]];
+						timeline.span(step, 'b', (times[s - 1] - origin) * us_per_cycle, PID_PATHS, done[k].path, passes);
+						timeline.span(step, 'e', (times[s] - origin) * us_per_cycle, PID_PATHS, done[k].path, passes);
+					}
+					timeline.span(path.name, 'e', (times[path.len - 1] - origin) * us_per_cycle, PID_PATHS, done[k].path,
+								  passes);
+				}
+
+				passes++;
+			}
+		}
+	}
+
+	if (timeline.isOpen())
+	{
+		timeline.name("process_name", PID_TASKS, 0, "ADCS tasks");
+		timeline.name("process_name", PID_PATHS, 0, "Paths");
+
+		for (std::map<unsigned, bool>::iterator it = seen_tasks.begin(); it != seen_tasks.end(); ++it)
+		{
+			char name[80];
+			if (it->first == TRACE_TASK_ISR)
+				snprintf(name, sizeof(name), "interrupts");
+			else if (tasks.count(it->first))
+				snprintf(name, sizeof(name), "%s", tasks[it->first].c_str());
+			else
+				snprintf(name, sizeof(name), "task %u", it->first);
+			timeline.name("thread_name", PID_TASKS, it->first, name);
+		}
+
+		for (uint8_t p = 0; p < TRACE_NUM_PATHS; p++)
+			timeline.name("thread_name", PID_PATHS, p, trace_paths[p].name);
+
+		timeline.close();
+	}
+
+	printf("%-40s %8s %10s %10s %10s %10s %10s\n", "latency (us)", "count", "min", "p50", "p90", "p99", "max");
+	for (uint8_t p = 0; p < TRACE_NUM_PATHS; p++)
+	{
+		const TracePath &path = trace_paths[p];
+
+		printLatency(path.name, latency[p][0]);
+		for (uint8_t s = 1; s < path.len; s++)
+			printLatency(std::string("  ") + trace_point_names[path.points[s - 1]] + " > " +
+							 trace_point_names[path.points[s]],
+						 latency[p][s]);
+	}
+
+	fprintf(stderr, "%zu dumps, %lu events, %lu overwritten before a dump, %lu passes, %u bad lines\n", dumps.size(),
+			events, overwritten, passes, bad);
+	return 0;
+}